@@ -0,0 +1,424 @@
+// RHAES128.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHAES128.h>
+#ifdef RH_ENABLE_ENCRYPTION_MODULE
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <wmmintrin.h>
+ #include <cpuid.h>
+ #define RH_AES128_HAVE_AESNI
+#elif defined(__aarch64__) && defined(__linux__)
+ #include <arm_neon.h>
+ #include <sys/auxv.h>
+ #include <asm/hwcap.h>
+ #define RH_AES128_HAVE_ARMV8
+ #ifdef __clang__
+  #define RH_AES128_ARMV8_TARGET "crypto"
+ #else
+  #define RH_AES128_ARMV8_TARGET "+crypto"
+ #endif
+#endif
+
+////////////////////////////////////////////////////////////////////
+// Software AES, as in FIPS-197. The state is 16 octets, column by column
+static const uint8_t sbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static const uint8_t invSbox[256] =
+{
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
+};
+
+// Multiplies by x (ie 2) in GF(2^8)
+static inline uint8_t xtime(uint8_t a)
+{
+    return (a << 1) ^ ((a & 0x80) ? 0x1b : 0);
+}
+
+// Applies MixColumns to one column
+static inline void mixColumn(uint8_t* c)
+{
+    uint8_t all = c[0] ^ c[1] ^ c[2] ^ c[3];
+    uint8_t first = c[0];
+    c[0] ^= all ^ xtime(c[0] ^ c[1]);
+    c[1] ^= all ^ xtime(c[1] ^ c[2]);
+    c[2] ^= all ^ xtime(c[2] ^ c[3]);
+    c[3] ^= all ^ xtime(c[3] ^ first);
+}
+
+// Applies InvMixColumns to one column, as a multiplication by 4x^2 + 5 followed by MixColumns
+static inline void invMixColumn(uint8_t* c)
+{
+    uint8_t u = xtime(xtime(c[0] ^ c[2]));
+    uint8_t v = xtime(xtime(c[1] ^ c[3]));
+    c[0] ^= u;
+    c[1] ^= v;
+    c[2] ^= u;
+    c[3] ^= v;
+    mixColumn(c);
+}
+
+static void softwareEncrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input)
+{
+    uint8_t s[16], t[16];
+    uint8_t i, c, r;
+    for (i = 0; i < 16; i++)
+	s[i] = input[i] ^ keys[i];
+    for (r = 1; r <= 10; r++)
+    {
+	// SubBytes and ShiftRows: row i moves left by i
+	for (c = 0; c < 4; c++)
+	    for (i = 0; i < 4; i++)
+		t[4 * c + i] = sbox[s[4 * ((c + i) & 3) + i]];
+	if (r < 10)
+	    for (c = 0; c < 16; c += 4)
+		mixColumn(t + c);
+	for (i = 0; i < 16; i++)
+	    s[i] = t[i] ^ keys[16 * r + i];
+    }
+    memcpy(output, s, sizeof(s));
+}
+
+// The equivalent inverse cipher of FIPS-197, with round keys already through InvMixColumns
+static void softwareDecrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input)
+{
+    uint8_t s[16], t[16];
+    uint8_t i, c, r;
+    for (i = 0; i < 16; i++)
+	s[i] = input[i] ^ keys[i];
+    for (r = 1; r <= 10; r++)
+    {
+	// InvSubBytes and InvShiftRows: row i moves right by i
+	for (c = 0; c < 4; c++)
+	    for (i = 0; i < 4; i++)
+		t[4 * ((c + i) & 3) + i] = invSbox[s[4 * c + i]];
+	if (r < 10)
+	    for (c = 0; c < 16; c += 4)
+		invMixColumn(t + c);
+	for (i = 0; i < 16; i++)
+	    s[i] = t[i] ^ keys[16 * r + i];
+    }
+    memcpy(output, s, sizeof(s));
+}
+
+////////////////////////////////////////////////////////////////////
+// AES-NI. The functions are compiled for AES-NI whatever the compiler options, and only called when
+// the CPU has it
+#ifdef RH_AES128_HAVE_AESNI
+__attribute__((target("aes,sse2")))
+static void aesniEncrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    __m128i k[11];
+    __m128i b[RH_AES128_BATCH];
+    uint8_t i, r;
+    for (r = 0; r < 11; r++)
+	k[r] = _mm_load_si128((const __m128i*)(keys + 16 * r));
+    for (i = 0; i < blocks; i++)
+	b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input + 16 * i)), k[0]);
+    // Round by round across the blocks, so the AES unit works on them all at once
+    for (r = 1; r < 10; r++)
+	for (i = 0; i < blocks; i++)
+	    b[i] = _mm_aesenc_si128(b[i], k[r]);
+    for (i = 0; i < blocks; i++)
+	_mm_storeu_si128((__m128i*)(output + 16 * i), _mm_aesenclast_si128(b[i], k[10]));
+}
+
+__attribute__((target("aes,sse2")))
+static void aesniDecrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    __m128i k[11];
+    __m128i b[RH_AES128_BATCH];
+    uint8_t i, r;
+    for (r = 0; r < 11; r++)
+	k[r] = _mm_load_si128((const __m128i*)(keys + 16 * r));
+    for (i = 0; i < blocks; i++)
+	b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input + 16 * i)), k[0]);
+    for (r = 1; r < 10; r++)
+	for (i = 0; i < blocks; i++)
+	    b[i] = _mm_aesdec_si128(b[i], k[r]);
+    for (i = 0; i < blocks; i++)
+	_mm_storeu_si128((__m128i*)(output + 16 * i), _mm_aesdeclast_si128(b[i], k[10]));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////
+// ARMv8 crypto extensions. AESE and AESD add the round key first, so the rounds are offset by one
+// from AES-NI, but the round keys are the same
+#ifdef RH_AES128_HAVE_ARMV8
+__attribute__((target(RH_AES128_ARMV8_TARGET)))
+static void armv8Encrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    uint8x16_t k[11];
+    uint8x16_t b[RH_AES128_BATCH];
+    uint8_t i, r;
+    for (r = 0; r < 11; r++)
+	k[r] = vld1q_u8(keys + 16 * r);
+    for (i = 0; i < blocks; i++)
+	b[i] = vld1q_u8(input + 16 * i);
+    for (r = 0; r < 9; r++)
+	for (i = 0; i < blocks; i++)
+	    b[i] = vaesmcq_u8(vaeseq_u8(b[i], k[r]));
+    for (i = 0; i < blocks; i++)
+	vst1q_u8(output + 16 * i, veorq_u8(vaeseq_u8(b[i], k[9]), k[10]));
+}
+
+__attribute__((target(RH_AES128_ARMV8_TARGET)))
+static void armv8Decrypt(const uint8_t* keys, uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    uint8x16_t k[11];
+    uint8x16_t b[RH_AES128_BATCH];
+    uint8_t i, r;
+    for (r = 0; r < 11; r++)
+	k[r] = vld1q_u8(keys + 16 * r);
+    for (i = 0; i < blocks; i++)
+	b[i] = vld1q_u8(input + 16 * i);
+    for (r = 0; r < 9; r++)
+	for (i = 0; i < blocks; i++)
+	    b[i] = vaesimcq_u8(vaesdq_u8(b[i], k[r]));
+    for (i = 0; i < blocks; i++)
+	vst1q_u8(output + 16 * i, veorq_u8(vaesdq_u8(b[i], k[9]), k[10]));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////
+RHAES128::RHAES128()
+    :
+    _backend(bestBackend())
+{
+    clear();
+}
+
+RHAES128::~RHAES128()
+{
+    clear();
+}
+
+size_t RHAES128::blockSize() const
+{
+    return 16;
+}
+
+size_t RHAES128::keySize() const
+{
+    return 16;
+}
+
+bool RHAES128::setKey(const uint8_t* key, size_t len)
+{
+    if (len != 16)
+	return false;
+
+    // Key expansion, a 4 octet word at a time
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    memcpy(_encKeys, key, 16);
+    for (uint8_t i = 4; i < 44; i++)
+    {
+	uint8_t* w = _encKeys + 4 * i;
+	const uint8_t* prev = w - 4;
+	if (i % 4 == 0)
+	{
+	    // RotWord, SubWord and Rcon
+	    w[0] = sbox[prev[1]] ^ rcon[i / 4 - 1];
+	    w[1] = sbox[prev[2]];
+	    w[2] = sbox[prev[3]];
+	    w[3] = sbox[prev[0]];
+	}
+	else
+	    memcpy(w, prev, 4);
+	for (uint8_t j = 0; j < 4; j++)
+	    w[j] ^= w[j - 16];
+    }
+
+    // Decryption keys for the equivalent inverse cipher: in reverse order, all but the first and last
+    // through InvMixColumns
+    for (uint8_t r = 0; r < 11; r++)
+    {
+	memcpy(_decKeys + 16 * r, _encKeys + 16 * (10 - r), 16);
+	if (r > 0 && r < 10)
+	    for (uint8_t c = 0; c < 16; c += 4)
+		invMixColumn(_decKeys + 16 * r + c);
+    }
+    return true;
+}
+
+void RHAES128::encryptBlock(uint8_t* output, const uint8_t* input)
+{
+    encryptBatch(output, input, 1);
+}
+
+void RHAES128::decryptBlock(uint8_t* output, const uint8_t* input)
+{
+    decryptBatch(output, input, 1);
+}
+
+void RHAES128::clear()
+{
+    // Through a volatile pointer so that it is not optimised away
+    volatile uint8_t* p = _encKeys;
+    for (uint8_t i = 0; i < sizeof(_encKeys); i++)
+	p[i] = 0;
+    p = _decKeys;
+    for (uint8_t i = 0; i < sizeof(_decKeys); i++)
+	p[i] = 0;
+}
+
+void RHAES128::encryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks)
+{
+    while (blocks)
+    {
+	uint8_t n = blocks < RH_AES128_BATCH ? blocks : RH_AES128_BATCH;
+	encryptBatch(output, input, n);
+	output += 16 * n;
+	input += 16 * n;
+	blocks -= n;
+    }
+}
+
+void RHAES128::decryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks)
+{
+    while (blocks)
+    {
+	uint8_t n = blocks < RH_AES128_BATCH ? blocks : RH_AES128_BATCH;
+	decryptBatch(output, input, n);
+	output += 16 * n;
+	input += 16 * n;
+	blocks -= n;
+    }
+}
+
+void RHAES128::encryptCTR(uint8_t* data, size_t len, uint8_t* counter)
+{
+    uint8_t stream[16 * RH_AES128_BATCH];
+    while (len)
+    {
+	// Encrypt the next batch of counters
+	uint8_t n = 0;
+	while (n < RH_AES128_BATCH && 16 * n < len)
+	{
+	    memcpy(stream + 16 * n, counter, 16);
+	    // Increment the last 32 bits, big endian
+	    for (uint8_t i = 15; i >= 12 && ++counter[i] == 0; i--)
+		;
+	    n++;
+	}
+	encryptBatch(stream, stream, n);
+	size_t octets = len < 16U * n ? len : 16U * n;
+	for (size_t i = 0; i < octets; i++)
+	    data[i] ^= stream[i];
+	data += octets;
+	len -= octets;
+    }
+}
+
+RHAES128::Backend RHAES128::bestBackend()
+{
+#if defined(RH_AES128_HAVE_AESNI)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES))
+	return BackendAESNI;
+#elif defined(RH_AES128_HAVE_ARMV8)
+    if (getauxval(AT_HWCAP) & HWCAP_AES)
+	return BackendARMv8;
+#endif
+    return BackendSoftware;
+}
+
+bool RHAES128::setBackend(Backend backend)
+{
+    if (backend != BackendSoftware && backend != bestBackend())
+	return false;
+    _backend = backend;
+    return true;
+}
+
+const char* RHAES128::backendName(Backend backend)
+{
+    switch (backend)
+    {
+    case BackendAESNI:
+	return "AES-NI";
+    case BackendARMv8:
+	return "ARMv8";
+    default:
+	return "software";
+    }
+}
+
+void RHAES128::encryptBatch(uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    switch (_backend)
+    {
+#ifdef RH_AES128_HAVE_AESNI
+    case BackendAESNI:
+	aesniEncrypt(_encKeys, output, input, blocks);
+	break;
+#endif
+#ifdef RH_AES128_HAVE_ARMV8
+    case BackendARMv8:
+	armv8Encrypt(_encKeys, output, input, blocks);
+	break;
+#endif
+    default:
+	for (uint8_t i = 0; i < blocks; i++)
+	    softwareEncrypt(_encKeys, output + 16 * i, input + 16 * i);
+	break;
+    }
+}
+
+void RHAES128::decryptBatch(uint8_t* output, const uint8_t* input, uint8_t blocks)
+{
+    switch (_backend)
+    {
+#ifdef RH_AES128_HAVE_AESNI
+    case BackendAESNI:
+	aesniDecrypt(_decKeys, output, input, blocks);
+	break;
+#endif
+#ifdef RH_AES128_HAVE_ARMV8
+    case BackendARMv8:
+	armv8Decrypt(_decKeys, output, input, blocks);
+	break;
+#endif
+    default:
+	for (uint8_t i = 0; i < blocks; i++)
+	    softwareDecrypt(_decKeys, output + 16 * i, input + 16 * i);
+	break;
+    }
+}
+
+#endif
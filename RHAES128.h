@@ -0,0 +1,142 @@
+// RHAES128.h
+//
+// AES-128 block cipher for RHEncryptedDriver, using the AES instructions of the CPU where it has them
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHAES128_h
+#define RHAES128_h
+
+#include <RadioHead.h>
+#ifdef RH_ENABLE_ENCRYPTION_MODULE
+#include <BlockCipher.h>
+
+// Blocks processed at once by the batch functions, to keep the AES units of the CPU busy
+#define RH_AES128_BATCH 4
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHAES128 RHAES128.h <RHAES128.h>
+/// \brief AES-128 BlockCipher using AES-NI on x86-64 or the ARMv8 crypto extensions, with a software fallback
+///
+/// A drop in replacement for the AES128 class of the arduinolibs Crypto library, for use with
+/// RHEncryptedDriver on Linux gateways and other hosts that decrypt traffic from many nodes. It produces
+/// exactly the same results as any other AES-128, so nodes using arduinolibs AES128 can talk to it.
+///
+/// The constructor chooses the fastest backend the CPU supports, found at run time:
+/// - BackendAESNI on x86 and x86-64 processors with the AES-NI instructions (most since 2010)
+/// - BackendARMv8 on 64 bit ARM processors with the crypto extensions (such as Raspberry Pi 5
+///   running a 64 bit OS, but not Raspberry Pi 3 or 4, which lack them)
+/// - BackendSoftware otherwise, a portable byte oriented AES
+///
+/// As well as the BlockCipher functions, there are batch functions that encrypt or decrypt many blocks
+/// at once (ECB), and encryptCTR() for counter mode (as used by CTR, CCM and GCM), which keep several
+/// blocks in flight in the AES unit and are several times faster per block than encryptBlock() with the
+/// hardware backends.
+///
+/// It is fine for the input and output of all the functions to be the same.
+///
+/// Needs the BlockCipher class from arduinolibs, like RHEncryptedDriver. On microcontrollers, use
+/// the AES128 class of arduinolibs instead, which keeps its tables in flash.
+class RHAES128 : public BlockCipher
+{
+public:
+    /// The ways of doing AES
+    typedef enum
+    {
+	BackendSoftware = 0,     ///< Portable C++
+	BackendAESNI,            ///< x86 AES-NI instructions
+	BackendARMv8             ///< 64 bit ARMv8 crypto extension instructions
+    } Backend;
+
+    /// Constructor. Chooses the best backend for this CPU
+    RHAES128();
+
+    /// Destructor. Clears the key schedule
+    virtual ~RHAES128();
+
+    /// \return 16, the block size in octets
+    size_t blockSize() const;
+
+    /// \return 16, the key size in octets
+    size_t keySize() const;
+
+    /// Sets the key
+    /// \param[in] key The 16 octet key
+    /// \param[in] len The length of key. Must be 16
+    /// \return true if the key was set
+    bool setKey(const uint8_t* key, size_t len);
+
+    /// Encrypts one block
+    /// \param[out] output The 16 octet ciphertext
+    /// \param[in] input The 16 octet plaintext
+    void encryptBlock(uint8_t* output, const uint8_t* input);
+
+    /// Decrypts one block
+    /// \param[out] output The 16 octet plaintext
+    /// \param[in] input The 16 octet ciphertext
+    void decryptBlock(uint8_t* output, const uint8_t* input);
+
+    /// Clears the key schedule from memory
+    void clear();
+
+    /// Encrypts several blocks independently (ECB)
+    /// \param[out] output The ciphertext, blocks * 16 octets
+    /// \param[in] input The plaintext, blocks * 16 octets
+    /// \param[in] blocks Number of blocks
+    void encryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks);
+
+    /// Decrypts several blocks independently (ECB)
+    /// \param[out] output The plaintext, blocks * 16 octets
+    /// \param[in] input The ciphertext, blocks * 16 octets
+    /// \param[in] blocks Number of blocks
+    void decryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks);
+
+    /// Encrypts or decrypts in counter mode: XORs data with the encryption of counter, counter + 1 etc.
+    /// The last 4 octets of the counter are incremented as a big endian number (as in GCM. This is the
+    /// same as CCM, whose counter field is 2 or more octets, for messages up to 65535 blocks)
+    /// \param[in,out] data The data
+    /// \param[in] len Length of data in octets. Need not be a whole number of blocks
+    /// \param[in,out] counter The 16 octet counter block. Set to the counter following the last one used
+    void encryptCTR(uint8_t* data, size_t len, uint8_t* counter);
+
+    /// Returns the best backend this CPU supports
+    /// \return The backend
+    static Backend bestBackend();
+
+    /// Sets the backend to use. This is normally only useful for testing and benchmarks
+    /// \param[in] backend The backend
+    /// \return true if this CPU supports the backend
+    bool setBackend(Backend backend);
+
+    /// Returns the backend in use
+    /// \return The backend
+    Backend backend() { return _backend;}
+
+    /// Returns the name of a backend
+    /// \param[in] backend The backend
+    /// \return Its name, such as "AES-NI"
+    static const char* backendName(Backend backend);
+
+protected:
+    /// Encrypts up to RH_AES128_BATCH blocks with the backend in use
+    void encryptBatch(uint8_t* output, const uint8_t* input, uint8_t blocks);
+
+    /// Decrypts up to RH_AES128_BATCH blocks with the backend in use
+    void decryptBatch(uint8_t* output, const uint8_t* input, uint8_t blocks);
+
+private:
+    /// The backend in use
+    Backend          _backend;
+
+    /// Round keys for encryption
+    uint8_t          _encKeys[11 * 16] __attribute__((aligned(16)));
+
+    /// Round keys for decryption with the equivalent inverse cipher, as used by the AES instructions
+    uint8_t          _decKeys[11 * 16] __attribute__((aligned(16)));
+};
+
+/// @example encrypted_aes_benchmark.pde
+
+#endif
+#endif
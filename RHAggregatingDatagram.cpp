@@ -0,0 +1,268 @@
+// RHAggregatingDatagram.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHAggregatingDatagram.h>
+
+////////////////////////////////////////////////////////////////////
+// Constructors
+RHAggregatingDatagram::RHAggregatingDatagram(RHGenericDriver& driver, uint8_t thisAddress) 
+    : RHReliableDatagram(driver, thisAddress)
+{
+    _maxDelay = RH_AGGREGATE_DEFAULT_DELAY;
+    memset(_batches, 0, sizeof(_batches));
+    _rxLen = _rxPos = 0;
+    resetAggregationStats();
+}
+
+////////////////////////////////////////////////////////////////////
+// Public methods
+void RHAggregatingDatagram::setMaxDelay(uint16_t maxDelay)
+{
+    _maxDelay = maxDelay;
+}
+
+////////////////////////////////////////////////////////////////////
+uint8_t RHAggregatingDatagram::maxFrameLength()
+{
+    uint8_t driver_len = _driver.maxMessageLength();
+    return driver_len < RH_AGGREGATE_MAX_FRAME_LEN ? driver_len : RH_AGGREGATE_MAX_FRAME_LEN;
+}
+
+////////////////////////////////////////////////////////////////////
+uint8_t RHAggregatingDatagram::maxMessageLength()
+{
+    // Room for one message and its sub-header
+    return maxFrameLength() - 1;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::queueto(uint8_t* buf, uint8_t len, uint8_t address)
+{
+    ScopedLock lock(*this);
+    if (len > maxMessageLength())
+	return false;
+    bool ret = true;
+    sendExpiredBatches();
+
+    // Find the batch for this address, else a free one, else send the oldest to make room
+    uint8_t i;
+    Batch* batch = NULL;
+    Batch* oldest = &_batches[0];
+    for (i = 0; i < RH_AGGREGATE_BATCHES; i++)
+    {
+	if (_batches[i].count && _batches[i].address == address)
+	{
+	    batch = &_batches[i];
+	    break;
+	}
+	if (!_batches[i].count)
+	    oldest = &_batches[i];
+	else if (oldest->count && (long)(_batches[i].since - oldest->since) < 0)
+	    oldest = &_batches[i];
+    }
+    if (batch && (uint16_t)batch->len + len + 1 > maxFrameLength())
+    {
+	// Wont fit: send what we have and start again
+	ret = sendBatch(batch);
+    }
+    else if (!batch)
+    {
+	batch = oldest;
+	if (batch->count)
+	    ret = sendBatch(batch);
+    }
+    if (!batch->count)
+    {
+	batch->address = address;
+	batch->len = 0;
+	batch->since = millis();
+	batch->queuedSum = 0;
+    }
+
+    batch->buf[batch->len++] = len;
+    memcpy(batch->buf + batch->len, buf, len);
+    batch->len += len;
+    batch->count++;
+    batch->queuedSum += millis() - batch->since;
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
+{
+    ScopedLock lock(*this);
+    bool ret = queueto(buf, len, address);
+    return flush(address) && ret;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::flush(uint8_t address)
+{
+    ScopedLock lock(*this);
+    uint8_t i;
+    for (i = 0; i < RH_AGGREGATE_BATCHES; i++)
+	if (_batches[i].count && _batches[i].address == address)
+	    return sendBatch(&_batches[i]);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::flushAll()
+{
+    ScopedLock lock(*this);
+    bool ret = true;
+    uint8_t i;
+    for (i = 0; i < RH_AGGREGATE_BATCHES; i++)
+	if (_batches[i].count)
+	    ret = sendBatch(&_batches[i]) && ret;
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::available()
+{
+    ScopedLock lock(*this);
+    sendExpiredBatches();
+    return _rxPos < _rxLen || RHReliableDatagram::available();
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{
+    ScopedLock lock(*this);
+    sendExpiredBatches();
+    if (_rxPos >= _rxLen)
+    {
+	// Nothing left in the last frame, get a new one
+	_rxLen = sizeof(_rxBuf);
+	_rxPos = 0;
+	if (!RHReliableDatagram::recvfromAck(_rxBuf, &_rxLen, &_rxFrom, &_rxTo, &_rxId, &_rxFlags))
+	{
+	    _rxLen = 0;
+	    return false;
+	}
+	if (!(_rxFlags & RH_AGGREGATE_FLAGS_AGGREGATED))
+	{
+	    // An ordinary message from a node that does not aggregate
+	    if (buf && len)
+	    {
+		if (*len > _rxLen)
+		    *len = _rxLen;
+		memcpy(buf, _rxBuf, *len);
+	    }
+	    _rxLen = 0;
+	    if (from)  *from =  _rxFrom;
+	    if (to)    *to =    _rxTo;
+	    if (id)    *id =    _rxId;
+	    if (flags) *flags = _rxFlags;
+	    return true;
+	}
+	_rxFlags &= ~RH_AGGREGATE_FLAGS_AGGREGATED;
+    }
+
+    uint8_t msgLen = _rxBuf[_rxPos++];
+    if (msgLen > _rxLen - _rxPos)
+    {
+	// Malformed or truncated frame: discard the rest of it
+	_rxLen = 0;
+	return false;
+    }
+    if (buf && len)
+    {
+	if (*len > msgLen)
+	    *len = msgLen;
+	memcpy(buf, _rxBuf + _rxPos, *len);
+    }
+    _rxPos += msgLen;
+    if (from)  *from =  _rxFrom;
+    if (to)    *to =    _rxTo;
+    if (id)    *id =    _rxId;
+    if (flags) *flags = _rxFlags;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHAggregatingDatagram::recvfromAckTimeout(uint8_t* buf, uint8_t* len, uint16_t timeout, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{
+    unsigned long starttime = millis();
+    int32_t timeLeft;
+    while ((timeLeft = timeout - (millis() - starttime)) > 0)
+    {
+	// Wake up at least every _maxDelay to send expired batches
+	uint16_t slice = timeLeft;
+	if (_maxDelay && slice > _maxDelay)
+	    slice = _maxDelay;
+	if (_rxPos < _rxLen || waitAvailableTimeout(slice))
+	{
+	    if (recvfromAck(buf, len, from, to, id, flags))
+		return true;
+	}
+	else
+	    sendExpiredBatches();
+	YIELD;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+uint32_t RHAggregatingDatagram::aggregatedMessages()
+{
+    return _aggregatedMessages;
+}
+
+////////////////////////////////////////////////////////////////////
+uint32_t RHAggregatingDatagram::aggregatedFrames()
+{
+    return _aggregatedFrames;
+}
+
+////////////////////////////////////////////////////////////////////
+uint16_t RHAggregatingDatagram::averageAddedLatency()
+{
+    return _aggregatedMessages ? _totalAddedLatency / _aggregatedMessages : 0;
+}
+
+////////////////////////////////////////////////////////////////////
+uint16_t RHAggregatingDatagram::maxAddedLatency()
+{
+    return _maxAddedLatency;
+}
+
+////////////////////////////////////////////////////////////////////
+void RHAggregatingDatagram::resetAggregationStats()
+{
+    _aggregatedMessages = 0;
+    _aggregatedFrames = 0;
+    _totalAddedLatency = 0;
+    _maxAddedLatency = 0;
+}
+
+////////////////////////////////////////////////////////////////////
+// Protected methods
+bool RHAggregatingDatagram::sendBatch(Batch* batch)
+{
+    // The first message queued has waited longest
+    unsigned long held = millis() - batch->since;
+    _aggregatedMessages += batch->count;
+    _aggregatedFrames++;
+    _totalAddedLatency += held * batch->count - batch->queuedSum;
+    if (held > _maxAddedLatency)
+	_maxAddedLatency = held;
+
+    batch->count = 0;
+    setHeaderFlags(RH_AGGREGATE_FLAGS_AGGREGATED);
+    bool ret = RHReliableDatagram::sendtoWait(batch->buf, batch->len, batch->address);
+    setHeaderFlags(RH_FLAGS_NONE, RH_AGGREGATE_FLAGS_AGGREGATED);
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+void RHAggregatingDatagram::sendExpiredBatches()
+{
+    uint8_t i;
+    for (i = 0; i < RH_AGGREGATE_BATCHES; i++)
+	if (_batches[i].count && (millis() - _batches[i].since) >= _maxDelay)
+	    sendBatch(&_batches[i]);
+}
@@ -0,0 +1,206 @@
+// RHAggregatingDatagram.h
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHAggregatingDatagram_h
+#define RHAggregatingDatagram_h
+
+#include <RHReliableDatagram.h>
+
+/// The largest aggregated frame that will be built or accepted. The actual limit is the smaller of this
+/// and the driver's maxMessageLength(). Each batch and the receive buffer use this many octets of RAM.
+#ifndef RH_AGGREGATE_MAX_FRAME_LEN
+#define RH_AGGREGATE_MAX_FRAME_LEN 64
+#endif
+
+/// The number of destinations for which messages can be batched at the same time. If a message 
+/// is queued for another destination, the oldest batch is sent first
+#ifndef RH_AGGREGATE_BATCHES
+#define RH_AGGREGATE_BATCHES 2
+#endif
+
+/// The default maximum time in milliseconds that a message can be held waiting for more messages to the
+/// same destination
+#define RH_AGGREGATE_DEFAULT_DELAY 100
+
+/// The header FLAGS bit that marks a frame holding aggregated messages. This is one of the application
+/// specific bits (see RHGenericDriver), so applications using RHAggregatingDatagram must not use it
+#define RH_AGGREGATE_FLAGS_AGGREGATED 0x04
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHAggregatingDatagram RHAggregatingDatagram.h <RHAggregatingDatagram.h>
+/// \brief RHReliableDatagram subclass that packs several small messages into each radio frame
+///
+/// Manager class that extends RHReliableDatagram to batch small messages to the same destination
+/// into a single frame, so that the driver headers, preamble and acknowledgement are paid once per frame
+/// instead of once per message. This is useful for sensors sending frequent short readings.
+///
+/// Messages queued with queueto() are held for up to the maximum delay (see setMaxDelay()),
+/// and are sent in one frame when the delay expires, when the next message would not fit in the frame, or when
+/// flush() is called. The frame is sent with RHReliableDatagram::sendtoWait(), so it is acknowledged and 
+/// retransmitted as a whole. You must call queueto(), available(), recvfromAck() or recvfromAckTimeout() frequently
+/// (eg in your main loop) so that expired batches are sent on time.
+///
+/// Each message in a frame is preceded by a 1 octet sub-header containing its length, and the frame is sent
+/// with the RH_AGGREGATE_FLAGS_AGGREGATED bit set in its FLAGS header.
+/// recvfromAck() unpacks the frame and returns the messages one at a time, each with the headers of the
+/// frame that carried it (less RH_AGGREGATE_FLAGS_AGGREGATED). Frames without that bit, as sent by 
+/// a plain RHReliableDatagram, are returned as a single message (of up to RH_AGGREGATE_MAX_FRAME_LEN octets), so RHAggregatingDatagram can receive from 
+/// nodes that do not aggregate. But nodes that do not use RHAggregatingDatagram cannot unpack aggregated frames:
+/// they can only recognise them by the flag, so send aggregated messages only to nodes that use it.
+///
+/// RHAggregatingDatagram, RHRouter and RHMesh all extend RHReliableDatagram, so RHAggregatingDatagram cannot
+/// be used underneath RHRouter or RHMesh. It batches messages per destination of a single hop, and does not
+/// batch routed traffic per next hop.
+///
+/// simulator_aggregating_datagram measures the aggregation ratio and the latency added.
+///
+/// Statistics are kept of the number of messages and frames sent, and of the latency added
+/// by holding messages, so the aggregation ratio and cost can be monitored and the delay tuned.
+class RHAggregatingDatagram : public RHReliableDatagram
+{
+public:
+    /// Constructor. 
+    /// \param[in] driver The RadioHead driver to use to transport messages.
+    /// \param[in] thisAddress The address to assign to this node. Defaults to 0
+    RHAggregatingDatagram(RHGenericDriver& driver, uint8_t thisAddress = 0);
+
+    /// Sets the maximum time a message may be held waiting for more messages to the same destination.
+    /// \param[in] maxDelay The maximum delay in milliseconds. Defaults to RH_AGGREGATE_DEFAULT_DELAY.
+    void setMaxDelay(uint16_t maxDelay);
+
+    /// Queues a message to be sent to the given address, in a frame with other messages to the same address.
+    /// Also sends any batches whose delay has expired. If the message does not fit in the batch for the address, 
+    /// the batch is sent first (blocking until it is acknowledged or the retries are exhausted).
+    /// \param[in] buf Pointer to the binary message to send
+    /// \param[in] len Number of octets to send. Must be no more than maxMessageLength()
+    /// \param[in] address The address to send the message to.
+    /// \return false if the message was too long, or if a batch that had to be sent first was not acknowledged
+    bool queueto(uint8_t* buf, uint8_t len, uint8_t address);
+
+    /// Queues a message to the given address, and sends it at once together with any
+    /// others already queued for the same address.
+    /// \param[in] buf Pointer to the binary message to send
+    /// \param[in] len Number of octets to send
+    /// \param[in] address The address to send the message to.
+    /// \return true if the frame was sent and acknowledged
+    bool sendtoWait(uint8_t* buf, uint8_t len, uint8_t address);
+
+    /// Sends the batch of messages queued for the given address now, if there is one.
+    /// \param[in] address The address whose batch is to be sent
+    /// \return true if there was nothing to send, or the batch was acknowledged
+    bool flush(uint8_t address);
+
+    /// Sends all the batches of queued messages now
+    /// \return true if all the batches were acknowledged
+    bool flushAll();
+
+    /// Returns the maximum length of a message that can be queued by queueto()
+    /// \return The maximum message length
+    uint8_t maxMessageLength();
+
+    /// Tests whether a new message is available, either from the last received frame or from the driver.
+    /// Also sends any batches whose delay has expired.
+    /// \return true if a message is available to be collected by recvfromAck()
+    bool available();
+
+    /// Returns the next message received by this node, from the last received frame if it contained more
+    /// than one message, else from the driver (acknowledging the frame). Also sends any batches whose delay has expired.
+    /// The from, to, id and flags are those of the frame that carried the message.
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Available space in buf. Set to the actual number of octets copied.
+    /// \param[in] from If present and not NULL, the referenced uint8_t will be set to the SRC address
+    /// \param[in] to If present and not NULL, the referenced uint8_t will be set to the DEST address
+    /// \param[in] id If present and not NULL, the referenced uint8_t will be set to the ID
+    /// \param[in] flags If present and not NULL, the referenced uint8_t will be set to the FLAGS
+    /// \return true if a message was copied to buf
+    bool recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* from = NULL, uint8_t* to = NULL, uint8_t* id = NULL, uint8_t* flags = NULL);
+
+    /// Similar to recvfromAck(), this will block until either a message is available or the timeout expires,
+    /// sending batches as their delays expire.
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Available space in buf. Set to the actual number of octets copied.
+    /// \param[in] timeout Maximum time to wait in milliseconds
+    /// \param[in] from If present and not NULL, the referenced uint8_t will be set to the SRC address
+    /// \param[in] to If present and not NULL, the referenced uint8_t will be set to the DEST address
+    /// \param[in] id If present and not NULL, the referenced uint8_t will be set to the ID
+    /// \param[in] flags If present and not NULL, the referenced uint8_t will be set to the FLAGS
+    /// \return true if a message was copied to buf
+    bool recvfromAckTimeout(uint8_t* buf, uint8_t* len,  uint16_t timeout, uint8_t* from = NULL, uint8_t* to = NULL, uint8_t* id = NULL, uint8_t* flags = NULL);
+
+    /// Returns the number of messages sent in frames since starting or the last resetAggregationStats()
+    /// \return The number of messages sent
+    uint32_t aggregatedMessages();
+
+    /// Returns the number of frames sent since starting or the last resetAggregationStats()
+    /// The aggregation ratio is aggregatedMessages() / aggregatedFrames().
+    /// \return The number of frames sent
+    uint32_t aggregatedFrames();
+
+    /// Returns the average time messages were held before being sent, since starting 
+    /// or the last resetAggregationStats()
+    /// \return The average added latency in milliseconds
+    uint16_t averageAddedLatency();
+
+    /// Returns the longest time a message was held before being sent, since starting 
+    /// or the last resetAggregationStats()
+    /// \return The maximum added latency in milliseconds
+    uint16_t maxAddedLatency();
+
+    /// Resets the aggregation statistics to 0
+    void resetAggregationStats();
+
+protected:
+    /// \brief Messages queued for a destination
+    typedef struct
+    {
+	uint8_t        address;   ///< Destination address
+	uint8_t        count;     ///< Number of messages in the batch. 0 if the entry is free
+	uint8_t        len;       ///< Octets used in buf
+	unsigned long  since;     ///< millis() when the first message was queued
+	uint32_t       queuedSum; ///< Sum over the messages of the time they were queued after the first
+	uint8_t        buf[RH_AGGREGATE_MAX_FRAME_LEN]; ///< Length-prefixed messages
+    } Batch;
+
+    /// Sends a batch and frees it
+    /// \param[in] batch The batch to send
+    /// \return true if the frame was acknowledged
+    bool sendBatch(Batch* batch);
+
+    /// Sends the batches whose delay has expired
+    void sendExpiredBatches();
+
+    /// Returns the largest frame that can be built
+    /// \return The frame length limit in octets
+    uint8_t maxFrameLength();
+
+private:
+    /// Maximum delay in milliseconds
+    uint16_t      _maxDelay;
+
+    /// Batches being accumulated
+    Batch         _batches[RH_AGGREGATE_BATCHES];
+
+    /// The last received frame
+    uint8_t       _rxBuf[RH_AGGREGATE_MAX_FRAME_LEN];
+
+    /// Length of the last received frame
+    uint8_t       _rxLen;
+
+    /// Offset of the next message to be returned from _rxBuf
+    uint8_t       _rxPos;
+
+    /// Headers of the last received frame
+    uint8_t       _rxFrom, _rxTo, _rxId, _rxFlags;
+
+    /// Statistics
+    uint32_t      _aggregatedMessages;
+    uint32_t      _aggregatedFrames;
+    uint32_t      _totalAddedLatency;
+    uint16_t      _maxAddedLatency;
+};
+
+/// @example simulator_aggregating_datagram.pde
+
+#endif
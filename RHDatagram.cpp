@@ -10,12 +10,23 @@ RHDatagram::RHDatagram(RHGenericDriver& driver, uint8_t thisAddress)
     _driver(driver),
     _thisAddress(thisAddress)
 {
+    _txHeader.to = RH_BROADCAST_ADDRESS;
+    _txHeader.from = thisAddress;
+    _txHeader.id = 0;
+    _txHeader.flags = RH_FLAGS_NONE;
+#if RH_THREAD_SAFE_MANAGERS
+    pthread_mutex_init(&_lockMutex, NULL);
+    pthread_cond_init(&_lockCond, NULL);
+    _lockDepth = 0;
+    _lockNextTicket = _lockServing = 0;
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////
 // Public methods
 bool RHDatagram::init()
 {
+    ScopedLock lock(*this);
     bool ret = _driver.init();
     if (ret)
 	setThisAddress(_thisAddress);
@@ -24,6 +35,7 @@ bool RHDatagram::init()
 
 void RHDatagram::setThisAddress(uint8_t thisAddress)
 {
+    ScopedLock lock(*this);
     _driver.setThisAddress(thisAddress);
     // Use this address in the transmitted FROM header
     setHeaderFrom(thisAddress);
@@ -32,18 +44,31 @@ void RHDatagram::setThisAddress(uint8_t thisAddress)
 
 bool RHDatagram::sendto(uint8_t* buf, uint8_t len, uint8_t address)
 {
-    setHeaderTo(address);
-    return _driver.send(buf, len);
+    ScopedLock lock(*this);
+    _txHeader.to = address;
+    return _driver.sendWithHeader(buf, len, _txHeader);
+}
+
+bool RHDatagram::sendto(uint8_t* buf, uint8_t len, uint8_t address, uint8_t id, uint8_t set, uint8_t clear)
+{
+    ScopedLock lock(*this);
+    RHGenericDriver::MessageHeader header = _txHeader;
+    header.to = address;
+    header.id = id;
+    header.flags = (header.flags & ~clear) | set;
+    return _driver.sendWithHeader(buf, len, header);
 }
 
 bool RHDatagram::recvfrom(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
 {
-    if (_driver.recv(buf, len))
+    ScopedLock lock(*this);
+    RHGenericDriver::RxMessageInfo info;
+    if (_driver.recvWithInfo(buf, len, &info))
     {
-	if (from)  *from =  headerFrom();
-	if (to)    *to =    headerTo();
-	if (id)    *id =    headerId();
-	if (flags) *flags = headerFlags();
+	if (from)  *from =  info.header.from;
+	if (to)    *to =    info.header.to;
+	if (id)    *id =    info.header.id;
+	if (flags) *flags = info.header.flags;
 	return true;
     }
     return false;
@@ -51,27 +76,48 @@ bool RHDatagram::recvfrom(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to
 
 bool RHDatagram::available()
 {
+    ScopedLock lock(*this);
     return _driver.available();
 }
 
 void RHDatagram::waitAvailable()
 {
+#if RH_THREAD_SAFE_MANAGERS
+    // Poll, so other threads can use the driver in between
+    while (!available())
+	RHPollWait(millis() + 1);
+#else
     _driver.waitAvailable();
+#endif
 }
 
 bool RHDatagram::waitPacketSent()
 {
+    ScopedLock lock(*this);
     return _driver.waitPacketSent();
 }
 
 bool RHDatagram::waitPacketSent(uint16_t timeout)
 {
+    ScopedLock lock(*this);
     return _driver.waitPacketSent(timeout);
 }
 
 bool RHDatagram::waitAvailableTimeout(uint16_t timeout)
 {
+#if RH_THREAD_SAFE_MANAGERS
+    // Poll, so other threads can use the driver in between
+    unsigned long starttime = millis();
+    while ((millis() - starttime) < timeout)
+    {
+	if (available())
+	    return true;
+	RHPollWait(starttime + timeout);
+    }
+    return false;
+#else
     return _driver.waitAvailableTimeout(timeout);
+#endif
 }
 
 uint8_t RHDatagram::thisAddress()
@@ -81,22 +127,22 @@ uint8_t RHDatagram::thisAddress()
 
 void RHDatagram::setHeaderTo(uint8_t to)
 {
-    _driver.setHeaderTo(to);
+    _txHeader.to = to;
 }
 
 void RHDatagram::setHeaderFrom(uint8_t from)
 {
-    _driver.setHeaderFrom(from);
+    _txHeader.from = from;
 }
 
 void RHDatagram::setHeaderId(uint8_t id)
 {
-    _driver.setHeaderId(id);
+    _txHeader.id = id;
 }
 
 void RHDatagram::setHeaderFlags(uint8_t set, uint8_t clear)
 {
-    _driver.setHeaderFlags(set, clear);
+    _txHeader.flags = (_txHeader.flags & ~clear) | set;
 }
 
 uint8_t RHDatagram::headerTo()
@@ -119,5 +165,35 @@ uint8_t RHDatagram::headerFlags()
     return _driver.headerFlags();
 }
 
+#if RH_THREAD_SAFE_MANAGERS
+void RHDatagram::lock()
+{
+    pthread_mutex_lock(&_lockMutex);
+    if (_lockDepth && pthread_equal(_lockOwner, pthread_self()))
+    {
+	// Already ours
+	_lockDepth++;
+	pthread_mutex_unlock(&_lockMutex);
+	return;
+    }
+    // Wait our turn
+    uint32_t ticket = _lockNextTicket++;
+    while (ticket != _lockServing)
+	pthread_cond_wait(&_lockCond, &_lockMutex);
+    _lockOwner = pthread_self();
+    _lockDepth = 1;
+    pthread_mutex_unlock(&_lockMutex);
+}
 
-
+void RHDatagram::unlock()
+{
+    pthread_mutex_lock(&_lockMutex);
+    if (_lockDepth && --_lockDepth == 0)
+    {
+	// Serve the next ticket
+	_lockServing++;
+	pthread_cond_broadcast(&_lockCond);
+    }
+    pthread_mutex_unlock(&_lockMutex);
+}
+#endif
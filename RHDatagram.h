@@ -12,6 +12,20 @@
 // Not all radios support this length, and many are much smaller
 #define RH_MAX_MESSAGE_LEN 255
 
+// On Linux and other Unix hosts, the managers can be used by several threads at once
+// (see "Threads" below). Define to 0 to leave the locking out
+#ifndef RH_THREAD_SAFE_MANAGERS
+ #if (RH_PLATFORM == RH_PLATFORM_RASPI) || (RH_PLATFORM == RH_PLATFORM_UNIX)
+  #define RH_THREAD_SAFE_MANAGERS 1
+ #else
+  #define RH_THREAD_SAFE_MANAGERS 0
+ #endif
+#endif
+
+#if RH_THREAD_SAFE_MANAGERS
+ #include <pthread.h>
+#endif
+
 /////////////////////////////////////////////////////////////////////
 /// \class RHDatagram RHDatagram.h <RHDatagram.h>
 /// \brief Manager class for addressed, unreliable messages
@@ -42,6 +56,34 @@
 /// \b FLAGS A bitmask of flags. The most significant 4 bits are reserved for use by RadioHead. The least
 /// significant 4 bits are reserved for applications.<br>
 ///
+/// The manager keeps the headers set with setHeaderTo() etc, and passes them to the driver with
+/// each message (RHGenericDriver::sendWithHeader()). The headers of a received message come back
+/// from the driver in the same call as the message (RHGenericDriver::recvWithInfo()).
+/// So the headers of one manager do not change those of another manager using the same driver, and
+/// drivers that queue messages (such as RHThreadedDriver) send each one with its own headers.
+/// It also means that headers set directly on the driver of a manager (driver.setHeaderFlags(), 
+/// driver.setHeaderId() etc) are ignored for the messages the manager sends. Older versions of the managers
+/// sent the driver's headers, so code that sets them on the driver must call the manager's setHeaderFlags()
+/// etc instead.
+///
+/// \par Threads
+///
+/// On Linux and other Unix hosts (when RH_THREAD_SAFE_MANAGERS is 1, the default there), several threads
+/// may call the same manager at once, such as a gateway with several producers of messages and a thread
+/// that receives. Each manager has a lock that serialises all access to the driver and the manager's own
+/// state (sequence numbers, buffers, routing tables). A call that sends holds it from setting
+/// the headers until the driver has the message, and RHReliableDatagram::sendtoWait() etc hold it until
+/// the ACK arrives or the retries are exhausted, so messages and headers from different threads are never
+/// mixed. Threads waiting to send queue for the lock, and are served in the order they arrived.
+/// Waits for messages (waitAvailable(), waitAvailableTimeout() and the recvfrom*Timeout() functions)
+/// only take the lock for a moment each time they poll the driver (every RH_POLL_INTERVAL_US), so they do not hold up
+/// threads that want to send. To set headers and send as one operation from your own code,
+/// hold the lock with lock() and unlock(), or a ScopedLock.
+/// The lock is recursive, so a thread that holds it may call any function of the manager.
+/// As with a single thread, messages (other than ACKs) that arrive while sendtoWait() waits for an ACK
+/// are discarded, so a receiving thread may see fewer messages while other threads are sending.
+/// The stress test in examples/simulator/simulator_multithread shows the managers in use by several threads.
+///
 class RHDatagram
 {
 public:
@@ -151,12 +193,76 @@ public:
     /// \return The address of this node
     uint8_t         thisAddress();
 
+    /// Takes the lock of this manager, waiting for other threads in turn (see "Threads" above).
+    /// Does nothing unless RH_THREAD_SAFE_MANAGERS is 1
+#if RH_THREAD_SAFE_MANAGERS
+    void            lock();
+#else
+    void            lock() {}
+#endif
+
+    /// Releases the lock of this manager, once for each call to lock()
+#if RH_THREAD_SAFE_MANAGERS
+    void            unlock();
+#else
+    void            unlock() {}
+#endif
+
+    /// Holds the lock of a manager from its construction until the end of its scope
+    class ScopedLock
+    {
+    public:
+	/// Constructor. Takes the lock
+	/// \param[in] manager The manager to lock
+	ScopedLock(RHDatagram& manager) : _manager(manager) { _manager.lock();}
+
+	/// Destructor. Releases the lock
+	~ScopedLock() { _manager.unlock();}
+
+    private:
+	RHDatagram& _manager;
+    };
+
 protected:
+    /// Sends a message to the node(s) with the given address, with the ID given and with the FLAGS
+    /// set by setHeaderFlags() modified as given, without changing the headers set for sendto()
+    /// \return true if the message is not too long for the driver, and the message was transmitted.
+    /// \param[in] len Number of octets to send
+    /// \param[in] address The address to send the message to.
+    /// \param[in] id The ID header to send
+    /// \param[in] set Bitmask of FLAGS bits to set
+    /// \param[in] clear Bitmask of FLAGS bits to clear
+    /// \return true if the message not too loing fot eh driver, and the message was transmitted.
+    bool            sendto(uint8_t* buf, uint8_t len, uint8_t address, uint8_t id, uint8_t set, uint8_t clear);
+
     /// The Driver we are to use
     RHGenericDriver&        _driver;
 
     /// The address of this node
     uint8_t         _thisAddress;
+
+    /// The headers set by setHeaderTo(), setHeaderFrom(), setHeaderId() and setHeaderFlags(),
+    /// which are passed to the driver with each message
+    RHGenericDriver::MessageHeader _txHeader;
+
+#if RH_THREAD_SAFE_MANAGERS
+private:
+    /// Protects the lock state
+    pthread_mutex_t _lockMutex;
+
+    /// Threads waiting for the lock wait on this
+    pthread_cond_t  _lockCond;
+
+    /// The thread holding the lock, if _lockDepth is not 0
+    pthread_t       _lockOwner;
+
+    /// Number of times the owner has taken the lock
+    uint16_t        _lockDepth;
+
+    /// Tickets: each thread waiting for the lock takes the next, and gets the lock when it is served
+    uint32_t        _lockNextTicket;
+    uint32_t        _lockServing;
+#endif
 };
 
 #endif
@@ -10,16 +10,162 @@
 
 RHEncryptedDriver::RHEncryptedDriver(RHGenericDriver& driver, BlockCipher& blockcipher)
     : _driver(driver),
-      _blockcipher(blockcipher)
+      _blockcipher(blockcipher),
+      _cipherMode(CipherModeECB),
+      _tagLen(RH_ENCRYPTED_TAG_LEN),
+      _txCounter(0),
+      _peerKeys(NULL),
+      _peerKeysSize(0),
+      _numPeerKeys(0),
+      _rxAuthFailures(0),
+      _rxReplays(0)
 {
-    _buffer = (uint8_t *)calloc(_driver.maxMessageLength(), sizeof(uint8_t));
+    _bufferLen = _driver.maxMessageLength();
+    _buffer = (uint8_t *)calloc(_bufferLen, sizeof(uint8_t));
+    if (!_buffer)
+	_bufferLen = 0;
+    for (uint8_t i = 0; i < RH_ENCRYPTED_REPLAY_PEERS; i++)
+	_replayWindows[i].valid = false;
+}
+
+RHEncryptedDriver::RHEncryptedDriver(RHGenericDriver& driver, BlockCipher& blockcipher, uint8_t* buffer, uint8_t bufferLen)
+    : _driver(driver),
+      _blockcipher(blockcipher),
+      _buffer(buffer),
+      _bufferLen(bufferLen),
+      _cipherMode(CipherModeECB),
+      _tagLen(RH_ENCRYPTED_TAG_LEN),
+      _txCounter(0),
+      _peerKeys(NULL),
+      _peerKeysSize(0),
+      _numPeerKeys(0),
+      _rxAuthFailures(0),
+      _rxReplays(0)
+{
+    for (uint8_t i = 0; i < RH_ENCRYPTED_REPLAY_PEERS; i++)
+	_replayWindows[i].valid = false;
+}
+
+bool RHEncryptedDriver::setCipherMode(CipherMode mode, uint8_t tagLen)
+{
+    if (mode == CipherModeCCM && (_blockcipher.blockSize() != 16 || tagLen < 4 || tagLen > 16 || (tagLen & 1)))
+	return false;
+    _cipherMode = mode;
+    _tagLen = tagLen;
+    return true;
+}
+
+void RHEncryptedDriver::setKeyTable(PeerKey* table, uint16_t size)
+{
+    _peerKeys = table;
+    _peerKeysSize = table ? size : 0;
+    _numPeerKeys = 0;
+}
+
+bool RHEncryptedDriver::addPeerKey(uint8_t address, uint8_t keyId, BlockCipher& cipher, BlockCipher* spare)
+{
+    if (keyId == 0 || keyId > RH_ENCRYPTED_MAX_KEY_ID)
+	return false;
+    PeerKey* peer = findPeerKey(address);
+    if (!peer)
+    {
+	if (_numPeerKeys >= _peerKeysSize)
+	    return false;
+	// Insert it in order of address
+	uint16_t i = _numPeerKeys;
+	while (i > 0 && _peerKeys[i - 1].address > address)
+	    i--;
+	memmove(&_peerKeys[i + 1], &_peerKeys[i], (_numPeerKeys - i) * sizeof(PeerKey));
+	_numPeerKeys++;
+	peer = &_peerKeys[i];
+	peer->address = address;
+	peer->window.valid = false;
+    }
+    peer->txSlot = 0;
+    peer->keyIds[0] = keyId;
+    peer->keyIds[1] = 0;
+    peer->ciphers[0] = &cipher;
+    peer->ciphers[1] = spare;
+    peer->rekeyState = RekeyNone;
+    return true;
+}
+
+bool RHEncryptedDriver::removePeerKey(uint8_t address)
+{
+    PeerKey* peer = findPeerKey(address);
+    if (!peer)
+	return false;
+    _numPeerKeys--;
+    memmove(peer, peer + 1, (&_peerKeys[_numPeerKeys] - peer) * sizeof(PeerKey));
+    return true;
+}
+
+uint8_t RHEncryptedDriver::peerKeyId(uint8_t address)
+{
+    PeerKey* peer = findPeerKey(address);
+    return peer ? peer->keyIds[peer->txSlot] : 0;
+}
+
+RHEncryptedDriver::PeerKey* RHEncryptedDriver::findPeerKey(uint8_t address)
+{
+    // Binary search
+    uint16_t low = 0, high = _numPeerKeys;
+    while (low < high)
+    {
+	uint16_t mid = (low + high) / 2;
+	if (_peerKeys[mid].address < address)
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    return (low < _numPeerKeys && _peerKeys[low].address == address) ? &_peerKeys[low] : NULL;
+}
+
+bool RHEncryptedDriver::rekey(uint8_t address)
+{
+    PeerKey* peer = findPeerKey(address);
+    if (_cipherMode != CipherModeCCM || !peer || !peer->ciphers[1])
+	return false;
+
+    // The next key ID, after the one we send with
+    uint8_t keyId = peer->keyIds[peer->txSlot];
+    uint8_t nextKeyId = (keyId % RH_ENCRYPTED_MAX_KEY_ID) + 1;
+    uint8_t request[2] = { RH_ENCRYPTED_REKEY_REQUEST, nextKeyId };
+    MessageHeader header = { address, _thisAddress, 0, 0 };
+    uint32_t counter = _txCounter;
+    if (!sendCCM(request, sizeof(request), header, keyId | RH_ENCRYPTED_KEY_ID_CONTROL, *peer->ciphers[peer->txSlot]))
+	return false;
+    peer->rekeyState = RekeyRequested;
+    peer->rekeyId = nextKeyId;
+    peer->rekeyCounter = counter;
+    return true;
 }
 
 bool RHEncryptedDriver::recv(uint8_t* buf, uint8_t* len)
 {
+    return recvWithInfo(buf, len, NULL);
+}
+
+bool RHEncryptedDriver::recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info)
+{
+    if (!_buffer)
+    {
+	// Nowhere to decrypt it: discard it, so available() does not stay true
+	_driver.recv(NULL, NULL);
+	return false;
+    }
+    if (_cipherMode == CipherModeCCM)
+	return recvCCM(buf, len, info);
+
     int h = 0; // Index of output _buffer
 
-    bool status = _driver.recv(_buffer, len);
+    // Never let the driver copy more than _buffer holds
+    uint8_t rxLen = _bufferLen;
+    if (len && *len < rxLen)
+	rxLen = *len;
+    bool status = _driver.recvWithInfo(_buffer, &rxLen, info);
+    if (status && len)
+	*len = rxLen;
     if (status && buf && len)
     {
 	int blockSize = _blockcipher.blockSize(); // Size of blocks used by encryption
@@ -51,6 +197,30 @@ bool RHEncryptedDriver::recv(uint8_t* buf, uint8_t* len)
 
 bool RHEncryptedDriver::send(const uint8_t* data, uint8_t len)
 {
+    return encryptAndSend(data, len, NULL);
+}
+
+bool RHEncryptedDriver::sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header)
+{
+    return encryptAndSend(data, len, &header);
+}
+
+bool RHEncryptedDriver::encryptAndSend(const uint8_t* data, uint8_t len, const MessageHeader* header)
+{
+    if (!_buffer)
+	return false;
+    if (_cipherMode == CipherModeCCM)
+    {
+	// The headers are authenticated, so we need to know them
+	MessageHeader headerSet = { _txHeaderTo, _txHeaderFrom, _txHeaderId, _txHeaderFlags };
+	if (!header)
+	    header = &headerSet;
+	PeerKey* peer = _peerKeys ? findPeerKey(header->to) : NULL;
+	if (peer)
+	    return sendCCM(data, len, *header, peer->keyIds[peer->txSlot], *peer->ciphers[peer->txSlot]);
+	return sendCCM(data, len, *header, 0, _blockcipher);
+    }
+
     if (len > maxMessageLength())
 	return false;
     
@@ -58,15 +228,24 @@ bool RHEncryptedDriver::send(const uint8_t* data, uint8_t len)
     int blockSize = _blockcipher.blockSize(); // Size of blocks used by encryption
 	
     if (len == 0) // PassThru
-	return _driver.send(data, len);
+	return driverSend(data, len, header);
 
-    if (_cipheringBlocks.blockSize != blockSize)
-    {
-	// Cipher has changed it's block size
-	_cipheringBlocks.inputBlock = (uint8_t *)realloc(_cipheringBlocks.inputBlock, blockSize);
-	_cipheringBlocks.blockSize = blockSize;	
-    }
-	
+    // The blocks are assembled in _buffer and encrypted in place, so no other buffers are needed
+#ifndef ALLOW_MULTIPLE_MSG	
+    int h = 0; // h is _buffer index
+#ifdef STRICT_CONTENT_LEN
+    _buffer[h++] = len; // put in first byte of first block the message length
+#endif
+    memcpy(&_buffer[h], data, len);
+    h += len;
+    int nbBytes = ((h + blockSize - 1) / blockSize) * blockSize; // Whole blocks needed for that message
+    memset(&_buffer[h], 0, nbBytes - h); // Completing with trailing 0
+    for (int k = 0; k < nbBytes; k += blockSize)
+	_blockcipher.encryptBlock(&_buffer[k], &_buffer[k]); // Cipher each block in place
+//    printBuffer("single send", _buffer, nbBytes);
+    if (!driverSend(_buffer, nbBytes, header))  // We now send that message with it's new length
+	status = false;
+#else	
     int max_message_length = maxMessageLength();
 #ifdef STRICT_CONTENT_LEN	
     uint8_t nbBlocks = len / blockSize + 1; // How many blocks do we need for that message
@@ -76,38 +255,6 @@ bool RHEncryptedDriver::send(const uint8_t* data, uint8_t len)
     uint8_t nbBpM = max_message_length / blockSize; // Max number of blocks per message
 #endif	
     int k = 0, j = 0; // k is block index, j is original message index
-#ifndef ALLOW_MULTIPLE_MSG	
-#ifdef STRICT_CONTENT_LEN
-    for (k = 0; k < nbBpM && k * blockSize < len + 1; k++)
-#else
-    for (k = 0; k < nbBpM && k * blockSize < len; k++)
-#endif
-    {
-	// k blocks in that message
-	int h = 0; // h is block content index
-#ifdef STRICT_CONTENT_LEN
-	if (k == 0)
-	    _cipheringBlocks.inputBlock[h++] = len; // put in first byte of first block the message length
-#endif		
-	while (h < blockSize)
-	{	
-	    // Copy each msg byte into inputBlock, and trail with 0 if necessary
-	    if (j < len)
-		_cipheringBlocks.inputBlock[h++] = data[j++];
-	    else
-		_cipheringBlocks.inputBlock[h++] = 0; // Completing with trailing 0
-	}
-	_blockcipher.encryptBlock(&_buffer[k * blockSize], _cipheringBlocks.inputBlock); // Cipher that message into _buffer
-    }
-//    Serial.println(max_message_length);
-//    Serial.println(nbBlocks);
-//    Serial.println(nbBpM);
-//    Serial.println(k);
-//    Serial.println(blockSize);
-//    printBuffer("single send", _buffer, k * blockSize);
-    if (!_driver.send(_buffer, k*blockSize))  // We now send that message with it's new length
-	status = false;
-#else	
     uint8_t nbMsg = (nbBlocks * blockSize) / max_message_length + 1; // How many message do we need
 
     for (int i = 0; i < nbMsg; i++)
@@ -116,23 +263,24 @@ bool RHEncryptedDriver::send(const uint8_t* data, uint8_t len)
 	for (k = 0; k < nbBpM && k * blockSize < len ; k++)
 	{
 	    // k blocks in that message
+	    uint8_t* block = &_buffer[k * blockSize];
 	    int h = 0;
 #ifdef STRICT_CONTENT_LEN
 	    if (k == 0 && i == 0)
-		_cipheringBlocks.inputBlock[h++] = len; // put in first byte of first block of first message the message length
+		block[h++] = len; // put in first byte of first block of first message the message length
 #endif			
 	    while (h < blockSize)
 	    {		
-		// Copy each msg byte into inputBlock, and trail with 0 if necessary
+		// Copy each msg byte into the block, and trail with 0 if necessary
 		if (j < len)
-		    _cipheringBlocks.inputBlock[h++] = data[j++];
+		    block[h++] = data[j++];
 		else
-		    _cipheringBlocks.inputBlock[h++] = 0;
+		    block[h++] = 0;
 	    }
-	    _blockcipher.encryptBlock(&_buffer[k * blockSize], _cipheringBlocks.inputBlock); // Cipher that message into buffer
+	    _blockcipher.encryptBlock(block, block); // Cipher that block in place
 	}
 //	printBuffer("multiple send", _buffer, k * blockSize);
-	if (!_driver.send(_buffer, k * blockSize))  // We now send that message with it's new length
+	if (!driverSend(_buffer, k * blockSize, header))  // We now send that message with it's new length
 	    status = false;
     }
 #endif
@@ -142,7 +290,16 @@ bool RHEncryptedDriver::send(const uint8_t* data, uint8_t len)
 uint8_t RHEncryptedDriver::maxMessageLength()
 {
     int driver_len = _driver.maxMessageLength();
-    
+    if (driver_len > _bufferLen)
+	driver_len = _bufferLen;
+    if (!_buffer)
+	return 0;
+
+    if (_cipherMode == CipherModeCCM)
+	return (driver_len > prefixLen() + _tagLen) ? driver_len - prefixLen() - _tagLen : 0;
+
+    if (driver_len < (int)_blockcipher.blockSize())
+	return 0; // Not even one block fits
 #ifndef ALLOW_MULTIPLE_MSG
     driver_len = ((int)(driver_len/_blockcipher.blockSize()) ) * _blockcipher.blockSize();
 #endif
@@ -153,4 +310,297 @@ uint8_t RHEncryptedDriver::maxMessageLength()
     return driver_len;
 }
 
+// The message is sent as the key ID (if there is a key table), the counter (most significant octet first),
+// the encrypted message and the tag
+bool RHEncryptedDriver::sendCCM(const uint8_t* data, uint8_t len, const MessageHeader& header, uint8_t keyId, BlockCipher& cipher)
+{
+    if (len > maxMessageLength() || _txCounter == 0xffffffff)
+	return false; // Too long, or the counter is exhausted and the nonce would repeat
+
+    uint32_t counter = _txCounter++;
+    uint8_t nonce[13] = { header.from, (uint8_t)(counter >> 24), (uint8_t)(counter >> 16),
+			  (uint8_t)(counter >> 8), (uint8_t)counter };
+    // The key ID is authenticated too
+    uint8_t aad[5] = { header.to, header.from, header.id, header.flags, keyId };
+    uint8_t aadLen = 4;
+    uint8_t* p = _buffer;
+    if (_peerKeys)
+    {
+	*p++ = keyId;
+	aadLen++;
+    }
+    memcpy(p, nonce + 1, RH_ENCRYPTED_COUNTER_LEN);
+    p += RH_ENCRYPTED_COUNTER_LEN;
+    memcpy(p, data, len);
+    ccm(cipher, p, len, nonce, aad, aadLen, p + len, true);
+    return _driver.sendWithHeader(_buffer, prefixLen() + len + _tagLen, header);
+}
+
+bool RHEncryptedDriver::recvCCM(uint8_t* buf, uint8_t* len, RxMessageInfo* info)
+{
+    uint8_t rxLen = _bufferLen;
+    RxMessageInfo rxInfo;
+    if (!_driver.recvWithInfo(_buffer, &rxLen, &rxInfo))
+	return false;
+    if (rxLen < prefixLen() + _tagLen)
+    {
+	_rxAuthFailures++;
+	return false;
+    }
+
+    // Find the key, and the replay window of the sender
+    MessageHeader& header = rxInfo.header;
+    uint8_t* p = _buffer;
+    uint8_t keyId = 0;
+    PeerKey* peer = NULL;
+    uint8_t slot = 0;
+    BlockCipher* cipher = &_blockcipher;
+    if (_peerKeys)
+    {
+	keyId = *p++;
+	peer = findPeerKey(header.from);
+	uint8_t id = keyId & ~RH_ENCRYPTED_KEY_ID_CONTROL;
+	if (id)
+	{
+	    // A peer key. It must be one we have for the sender
+	    if (!peer)
+		cipher = NULL;
+	    else if (peer->keyIds[0] == id)
+		cipher = peer->ciphers[0];
+	    else if (peer->keyIds[1] == id)
+		cipher = peer->ciphers[slot = 1];
+	    else
+		cipher = NULL;
+	}
+	// Every node has the network key, so it may only be used by a peer for broadcasts,
+	// else any node could pass itself off as the peer
+	if (!cipher || ((keyId & RH_ENCRYPTED_KEY_ID_CONTROL) && !id) || (peer && !id && header.to != RH_BROADCAST_ADDRESS))
+	{
+	    // Unknown key, a control message not encrypted with a peer key, or a message from a
+	    // peer to a single node with the network key
+	    _rxAuthFailures++;
+	    return false;
+	}
+    }
+    uint32_t counter = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    if (peer ? !checkWindow(peer->window, counter, false) : !checkReplay(header.from, counter, false))
+    {
+	// Dont even bother decrypting it
+	_rxReplays++;
+	return false;
+    }
+
+    uint8_t nonce[13] = { header.from, p[0], p[1], p[2], p[3] };
+    uint8_t aad[5] = { header.to, header.from, header.id, header.flags, keyId };
+    uint8_t msgLen = rxLen - prefixLen() - _tagLen;
+    uint8_t* msg = p + RH_ENCRYPTED_COUNTER_LEN;
+    uint8_t tag[16];
+    ccm(*cipher, msg, msgLen, nonce, aad, _peerKeys ? 5 : 4, tag, false);
+    // Compare all of the tag, so the time taken does not tell how much of it matched
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < _tagLen; i++)
+	diff |= tag[i] ^ msg[msgLen + i];
+    if (diff)
+    {
+	_rxAuthFailures++;
+	return false;
+    }
+    if (peer)
+    {
+	checkWindow(peer->window, counter, true);
+	// The first message with the key we agreed to change to shows the requester has it too
+	if (peer->rekeyState == RekeyResponded && slot != peer->txSlot && peer->keyIds[slot] == peer->rekeyId)
+	{
+	    peer->txSlot = slot;
+	    peer->rekeyState = RekeyNone;
+	}
+    }
+    else
+	checkReplay(header.from, counter, true);
+
+    if (keyId & RH_ENCRYPTED_KEY_ID_CONTROL)
+    {
+	// For us, not the caller
+	handleControl(peer, slot, header, counter, msg, msgLen);
+	return false;
+    }
+
+    if (info)
+	*info = rxInfo;
+    if (buf && len)
+    {
+	if (*len > msgLen)
+	    *len = msgLen;
+	memcpy(buf, msg, *len);
+    }
+    return true;
+}
+
+// A request is the type and the new key ID. A response is the type, the new key ID and the counter of the request
+void RHEncryptedDriver::handleControl(PeerKey* peer, uint8_t slot, const MessageHeader& header, uint32_t counter, const uint8_t* msg, uint8_t len)
+{
+    uint8_t other = 1 - slot;
+    if (len < 2 || !peer->ciphers[other] || msg[1] == 0 || msg[1] > RH_ENCRYPTED_MAX_KEY_ID || msg[1] == peer->keyIds[slot])
+	return;
+    uint8_t keyId = msg[1];
+
+    if (msg[0] == RH_ENCRYPTED_REKEY_REQUEST && other != peer->txSlot)
+    {
+	// If both ends asked at once, the request from the lower address wins
+	if (peer->rekeyState == RekeyRequested && header.to < header.from)
+	    return;
+	// Agree, with the key the request was encrypted with. The next key goes in the other slot, replacing
+	// the previous key, which is no longer used. If the response is lost, the requester will ask again
+	// and the next key is derived again
+	uint8_t response[6] = { RH_ENCRYPTED_REKEY_RESPONSE, keyId, (uint8_t)(counter >> 24), (uint8_t)(counter >> 16),
+				(uint8_t)(counter >> 8), (uint8_t)counter };
+	MessageHeader responseHeader = { header.from, header.to, 0, 0 };
+	uint32_t responseCounter = _txCounter;
+	if (!sendCCM(response, sizeof(response), responseHeader, peer->keyIds[slot] | RH_ENCRYPTED_KEY_ID_CONTROL, *peer->ciphers[slot]))
+	    return;
+	deriveKey(*peer->ciphers[slot], *peer->ciphers[other], header.from, header.to, keyId, counter, responseCounter);
+	peer->keyIds[other] = keyId;
+	peer->rekeyState = RekeyResponded;
+	peer->rekeyId = keyId;
+    }
+    else if (msg[0] == RH_ENCRYPTED_REKEY_RESPONSE && len >= 6 && slot == peer->txSlot
+	     && peer->rekeyState == RekeyRequested && peer->rekeyId == keyId)
+    {
+	uint32_t requestCounter = ((uint32_t)msg[2] << 24) | ((uint32_t)msg[3] << 16) | ((uint32_t)msg[4] << 8) | msg[5];
+	if (requestCounter != peer->rekeyCounter)
+	    return; // The response to an earlier request that was lost
+	deriveKey(*peer->ciphers[slot], *peer->ciphers[other], header.to, header.from, keyId, requestCounter, counter);
+	peer->keyIds[other] = keyId;
+	peer->txSlot = other;
+	peer->rekeyState = RekeyNone;
+    }
+}
+
+void RHEncryptedDriver::deriveKey(BlockCipher& current, BlockCipher& next, uint8_t requester, uint8_t responder, uint8_t keyId,
+				  uint32_t requestCounter, uint32_t responseCounter)
+{
+    // Enough blocks for the key, each encrypting the inputs and its index
+    uint8_t key[32];
+    uint8_t keySize = next.keySize() < sizeof(key) ? next.keySize() : sizeof(key);
+    for (uint8_t i = 0; i * 16 < keySize; i++)
+    {
+	uint8_t block[16] = { 'R', 'K', requester, responder, keyId,
+			      (uint8_t)(requestCounter >> 24), (uint8_t)(requestCounter >> 16), (uint8_t)(requestCounter >> 8), (uint8_t)requestCounter,
+			      (uint8_t)(responseCounter >> 24), (uint8_t)(responseCounter >> 16), (uint8_t)(responseCounter >> 8), (uint8_t)responseCounter,
+			      0, 0, i };
+	current.encryptBlock(key + i * 16, block);
+    }
+    next.setKey(key, keySize);
+    memset(key, 0, sizeof(key));
+}
+
+bool RHEncryptedDriver::checkReplay(uint8_t from, uint32_t counter, bool update)
+{
+    uint8_t i;
+    for (i = 0; i < RH_ENCRYPTED_REPLAY_PEERS; i++)
+	if (!_replayWindows[i].valid || _replayWindows[i].from == from)
+	    break;
+    ReplayWindow window;
+    if (i < RH_ENCRYPTED_REPLAY_PEERS && _replayWindows[i].valid)
+	window = _replayWindows[i];
+    else
+    {
+	// A new sender. If the table is full, forget the one heard from least recently
+	window.from = from;
+	window.valid = false;
+    }
+    if (!checkWindow(window, counter, true))
+	return false;
+    if (update)
+    {
+	// Move it to the front
+	if (i == RH_ENCRYPTED_REPLAY_PEERS)
+	    i--;
+	memmove(&_replayWindows[1], &_replayWindows[0], i * sizeof(ReplayWindow));
+	_replayWindows[0] = window;
+    }
+    return true;
+}
+
+bool RHEncryptedDriver::checkWindow(ReplayWindow& window, uint32_t counter, bool update)
+{
+    ReplayWindow updated = window;
+    if (!window.valid)
+    {
+	updated.valid = true;
+	updated.highest = counter;
+	updated.seen = 1;
+    }
+    else if (counter > window.highest)
+    {
+	uint32_t shift = counter - window.highest;
+	updated.seen = (shift >= RH_ENCRYPTED_REPLAY_WINDOW) ? 1 : (window.seen << shift) | 1;
+	updated.highest = counter;
+    }
+    else
+    {
+	uint32_t age = window.highest - counter;
+	if (age >= RH_ENCRYPTED_REPLAY_WINDOW || (window.seen & (1UL << age)))
+	    return false;
+	updated.seen |= 1UL << age;
+    }
+    if (update)
+	window = updated;
+    return true;
+}
+
+void RHEncryptedDriver::ccm(BlockCipher& cipher, uint8_t* data, uint8_t len, const uint8_t* nonce, const uint8_t* aad, uint8_t aadLen, uint8_t* tag, bool encrypt)
+{
+    uint8_t mac[16];     // CBC-MAC
+    uint8_t ctr[16];     // Counter block
+    uint8_t stream[16];  // Key stream, and a block to add to the MAC
+    uint8_t i, j;
+
+    // First block of the MAC: flags, nonce and length. The length field is 2 octets (L = 2)
+    stream[0] = (aadLen ? 0x40 : 0) | (((_tagLen - 2) / 2) << 3) | (2 - 1);
+    memcpy(stream + 1, nonce, 13);
+    stream[14] = 0;
+    stream[15] = len;
+    cipher.encryptBlock(mac, stream);
+
+    // The additional data, preceded by its length
+    if (aadLen)
+    {
+	memset(stream, 0, sizeof(stream));
+	stream[1] = aadLen;
+	memcpy(stream + 2, aad, aadLen);
+	for (j = 0; j < 16; j++)
+	    stream[j] ^= mac[j];
+	cipher.encryptBlock(mac, stream);
+    }
+
+    // The message, a block at a time: add the plaintext to the MAC, and encrypt or decrypt in counter mode
+    ctr[0] = 2 - 1;
+    memcpy(ctr + 1, nonce, 13);
+    ctr[14] = 0;
+    for (i = 0; i * 16 < len; i++)
+    {
+	uint8_t* block = data + i * 16;
+	uint8_t blockLen = (len - i * 16 < 16) ? len - i * 16 : 16;
+	if (encrypt)
+	    for (j = 0; j < blockLen; j++)
+		mac[j] ^= block[j];
+	ctr[15] = i + 1;
+	cipher.encryptBlock(stream, ctr);
+	for (j = 0; j < blockLen; j++)
+	    block[j] ^= stream[j];
+	if (!encrypt)
+	    for (j = 0; j < blockLen; j++)
+		mac[j] ^= block[j];
+	memcpy(stream, mac, sizeof(stream));
+	cipher.encryptBlock(mac, stream);
+    }
+
+    // The tag is the MAC encrypted with counter 0
+    ctr[15] = 0;
+    cipher.encryptBlock(stream, ctr);
+    for (j = 0; j < _tagLen; j++)
+	tag[j] = mac[j] ^ stream[j];
+}
+
 #endif
@@ -26,6 +26,37 @@
 // With STRICT_CONTENT_LEN, receiver will try to extract length from every message !!!!
 //#define ALLOW_MULTIPLE_MSG  
 
+// Length of the authentication tag added to each message in CipherModeCCM, in octets.
+// One of 4, 6, 8, 10, 12, 14 or 16. May be changed with setCipherMode()
+#ifndef RH_ENCRYPTED_TAG_LEN
+ #define RH_ENCRYPTED_TAG_LEN 8
+#endif
+
+// Number of senders whose recent message counters are remembered to reject replayed messages in CipherModeCCM.
+// Should be at least the number of nodes this one hears from
+#ifndef RH_ENCRYPTED_REPLAY_PEERS
+ #define RH_ENCRYPTED_REPLAY_PEERS 8
+#endif
+
+// Octets of the message counter sent with each message in CipherModeCCM
+#define RH_ENCRYPTED_COUNTER_LEN 4
+
+// Messages older than the last this many from the same sender are rejected as replays in CipherModeCCM
+#define RH_ENCRYPTED_REPLAY_WINDOW 32
+
+// Octets of the key ID sent with each message in CipherModeCCM when there is a key table
+#define RH_ENCRYPTED_KEY_ID_LEN 1
+
+// Key IDs of peer keys are 1 to this. Key ID 0 is the key of the cipher passed to the constructor
+#define RH_ENCRYPTED_MAX_KEY_ID 0x7f
+
+// Set in the key ID octet of messages used by the driver itself to change keys
+#define RH_ENCRYPTED_KEY_ID_CONTROL 0x80
+
+// Types of control messages, the first octet of the message
+#define RH_ENCRYPTED_REKEY_REQUEST  1
+#define RH_ENCRYPTED_REKEY_RESPONSE 2
+
 /////////////////////////////////////////////////////////////////////
 /// \class RHEncryptedDriver RHEncryptedDriver <RHEncryptedDriver.h>
 /// \brief Virtual Driver to encrypt/decrypt data. Can be used with any other RadioHead driver.
@@ -40,6 +71,93 @@
 /// In order to enable this module you must uncomment #define RH_ENABLE_ENCRYPTION_MODULE at the bottom of RadioHead.h
 /// But ensure you have installed the Crypto directory from arduinolibs first:
 /// http://rweather.github.io/arduinolibs/index.html
+///
+/// \par Authenticated encryption
+///
+/// By default (CipherModeECB) each block of the message is encrypted on its own, and padded to a whole
+/// number of blocks. Identical blocks encrypt the same way, nothing detects a message that has been
+/// changed, and a recorded message can be replayed. Call setCipherMode(CipherModeCCM) on every node to
+/// use authenticated encryption instead (CCM, as in RFC 3610 and IEEE 802.15.4, which needs a 16 octet
+/// block cipher such as AES128 or Speck):
+/// - each message is sent with a 4 octet counter, which with the FROM header forms the nonce, so the same
+///   message never encrypts the same way twice
+/// - the message is encrypted as a stream (counter mode), so it is not padded: the payload is the
+///   counter, the message and the tag, RH_ENCRYPTED_COUNTER_LEN + len + the tag length octets
+/// - a tag (RH_ENCRYPTED_TAG_LEN octets by default) authenticates the message and the TO, FROM, ID and FLAGS
+///   headers. Messages whose tag does not match are discarded, and counted by rxAuthFailures()
+/// - the last RH_ENCRYPTED_REPLAY_WINDOW counters from each of the last RH_ENCRYPTED_REPLAY_PEERS senders
+///   are remembered, and messages with a counter seen before, or older than that, are discarded and
+///   counted by rxReplays()
+///
+/// The nonce must never repeat for the same key, so each node sharing a key must send with a different FROM
+/// address, and a node must not start its counter again from 0 with the same key after a reset. Either
+/// change the key, or save txCounter() (say in EEPROM every 1000 messages) and restore it, plus
+/// a margin, with setTxCounter() at startup. When the counter is exhausted, send() fails.
+/// Similarly, a receiver that forgets its replay window on a reset (or a sender that has been
+/// pushed out of it by RH_ENCRYPTED_REPLAY_PEERS others) will accept one replay of any message
+/// newer than the last one it remembers from that sender.
+/// The headers must be set through this driver (or passed with each message, as the managers do), not
+/// directly on the underlying driver, since they are authenticated too.
+///
+/// \par Peer keys
+///
+/// By default every node shares one key, so any node can read (and forge) the messages of every other, and
+/// changing the key means changing it on every node at once. In CipherModeCCM, a gateway can instead
+/// share a different key with each node it serves. Give the driver a table with room for the peers
+/// with setKeyTable(), then add a cipher for each peer with addPeerKey(), its key already set with setKey().
+/// The ciphers hold the expanded key schedules, so nothing is expanded again for each message:
+/// \code
+/// RHEncryptedDriver::PeerKey peerKeys[50];
+/// AES128 peerCiphers[50], spareCiphers[50];
+/// ...
+/// driver.setKeyTable(peerKeys, 50);
+/// peerCiphers[i].setKey(keyOfNode, 16);
+/// driver.addPeerKey(nodeAddress, 1, peerCiphers[i], &spareCiphers[i]);
+/// \endcode
+/// and each node adds the same key, with the same key ID, for the gateway. Messages to a peer in the table are
+/// encrypted with its key, other messages (including broadcasts) with the cipher passed to the constructor, and
+/// a key ID octet is sent in front of the counter to tell the receiver which key was used (0 for the cipher
+/// passed to the constructor). A message from a peer with a key ID it does not have is counted by
+/// rxAuthFailures() and discarded, and so is a message from a peer with the network key (key ID 0) that is not a
+/// broadcast: every node has the network key, so otherwise any of them could forge the peer's messages. Every node must have a key table (even if it is empty), or none.
+/// Each peer in the table gets its own replay window, so the replay protection does not depend on
+/// RH_ENCRYPTED_REPLAY_PEERS.
+///
+/// The table is kept sorted by address, so finding a peer takes at most 8 comparisons even
+/// with a peer for every address.
+///
+/// Either end can call rekey() to change a peer key that was given a spare cipher, without stopping anything:
+/// - it sends a rekey request with the next key ID, encrypted with the current key
+/// - the peer sends back a response, encrypted with the current key
+/// - each derives the new key by encrypting the addresses, the new key ID and the counters of the 2 messages
+///   with the current key, and sets it on the spare cipher, which becomes the current one
+/// - the requester sends with the new key as soon as it has the response, the other end as soon as it
+///   receives a message with the new key. Both accept the old key until the next change, so messages in
+///   flight are not lost
+///
+/// The request and response are handled within recv(), and are not returned to the caller. If
+/// either is lost, call rekey() again: peerKeyId() tells when the change is complete. The new key is
+/// only as secret as the old one, so it protects against using one key for too many messages, not against an
+/// old key having been stolen. The new key is a deterministic function of the old key and of values sent in the
+/// clear, so there is no forward secrecy: anyone who has recorded the traffic and later learns a key can derive
+/// every key after it, and read every message sent with them. Use addPeerKey() to set a new key from elsewhere.
+///
+/// \par Memory
+///
+/// Messages are encrypted and decrypted in place in one buffer the size of the largest message
+/// of the underlying driver, with no other copies. By default the constructor allocates it on the heap.
+/// To avoid the heap altogether (say on AVR, where it fragments the little RAM there is), pass a buffer
+/// sized at compile time to the other constructor:
+/// \code
+/// uint8_t encryptBuffer[RH_RF95_MAX_MESSAGE_LEN];
+/// RHEncryptedDriver driver(rf95, cipher, encryptBuffer, sizeof(encryptBuffer));
+/// \endcode
+/// If there is no buffer (the allocation failed, or buffer is NULL), maxMessageLength() is 0, and send() and
+/// recv() fail. In CipherModeECB, so is maxMessageLength() if the buffer is smaller than a cipher block.
+/// The cipher must allow the input and output of encryptBlock() to be the same, as those of arduinolibs do.
+///
+/// On a Linux gateway, use RHAES128 in place of the arduinolibs AES128: it encrypts with the AES
+/// instructions of the CPU where there are any, and interworks with nodes using AES128.
 
 class RHEncryptedDriver : public RHGenericDriver
 {
@@ -51,6 +169,110 @@ public:
     /// the blockcipher has had its key set before sending or receiving messages.
     RHEncryptedDriver(RHGenericDriver& driver, BlockCipher& blockcipher);
 
+    /// Constructor that uses a buffer you provide, instead of allocating one on the heap.
+    /// See "Memory" above.
+    /// \param[in] driver The RadioHead driver to use to transport messages.
+    /// \param[in] blockcipher The blockcipher (from arduinolibs) that crypt/decrypt data. Ensure that
+    /// the blockcipher has had its key set before sending or receiving messages.
+    /// \param[in] buffer Buffer for encrypted messages. It must last as long as the driver
+    /// \param[in] bufferLen Size of buffer. If it is less than driver.maxMessageLength(), messages are limited
+    /// to what fits
+    RHEncryptedDriver(RHGenericDriver& driver, BlockCipher& blockcipher, uint8_t* buffer, uint8_t bufferLen);
+
+    /// How messages are encrypted
+    typedef enum
+    {
+	CipherModeECB = 0,    ///< Each block encrypted on its own, and the message padded to whole blocks (the default)
+	CipherModeCCM         ///< Authenticated encryption, with replay detection. See "Authenticated encryption" above
+    } CipherMode;
+
+    /// Sets how messages are encrypted. All nodes must use the same mode and tag length
+    /// \param[in] mode The mode
+    /// \param[in] tagLen The length of the authentication tag for CipherModeCCM, in octets: 4, 6, 8, 10, 12, 14 or 16.
+    /// Longer tags are harder to forge, shorter ones take less airtime
+    /// \return true if successful, false if the mode needs a different block size from that of the cipher,
+    /// or the tag length is not valid
+    bool setCipherMode(CipherMode mode, uint8_t tagLen = RH_ENCRYPTED_TAG_LEN);
+
+    /// Returns the mode set with setCipherMode()
+    /// \return The mode
+    CipherMode cipherMode() { return _cipherMode;};
+
+    /// Sets the counter to be sent with the next message in CipherModeCCM. See "Authenticated encryption"
+    /// above for why you might need this.
+    /// \param[in] counter The counter. It increases by one for each message sent
+    void setTxCounter(uint32_t counter) { _txCounter = counter;};
+
+    /// Returns the counter to be sent with the next message in CipherModeCCM
+    /// \return The counter
+    uint32_t txCounter() { return _txCounter;};
+
+    /// Returns the number of messages discarded because their authentication tag did not match, in CipherModeCCM
+    /// \return The number of messages
+    uint16_t rxAuthFailures() { return _rxAuthFailures;};
+
+    /// Returns the number of messages discarded as replays, in CipherModeCCM
+    /// \return The number of messages
+    uint16_t rxReplays() { return _rxReplays;};
+
+    /// The replay window of a sender: the highest counter seen, and a bit for each of the
+    /// RH_ENCRYPTED_REPLAY_WINDOW counters up to it, set if seen
+    typedef struct
+    {
+	uint8_t  from;
+	bool     valid;
+	uint32_t highest;
+	uint32_t seen;
+    } ReplayWindow;
+
+    /// An entry in the key table. See "Peer keys" above.
+    /// Only declare arrays of these for setKeyTable(): the fields are managed by the driver
+    typedef struct
+    {
+	uint8_t      address;      ///< Address of the peer
+	uint8_t      txSlot;       ///< Index in keyIds and ciphers of the key to send with
+	uint8_t      keyIds[2];    ///< Key IDs of the current and the other key, 0 if none
+	BlockCipher* ciphers[2];   ///< Ciphers of the current and the other key, NULL if none
+	uint8_t      rekeyState;   ///< Whether a key change is in progress
+	uint8_t      rekeyId;      ///< Key ID of the key being changed to
+	uint32_t     rekeyCounter; ///< Counter of the rekey request we sent
+	ReplayWindow window;       ///< Replay window for messages from the peer
+    } PeerKey;
+
+    /// Sets the table of peer keys, and starts sending a key ID with each message in CipherModeCCM.
+    /// See "Peer keys" above. The table starts empty
+    /// \param[in] table Array of entries, which must last as long as the driver. NULL for no key table
+    /// \param[in] size Number of entries in table. There need never be more than 256
+    void setKeyTable(PeerKey* table, uint16_t size);
+
+    /// Adds a peer key to the table set with setKeyTable(), or replaces the one there for the peer
+    /// \param[in] address Address of the peer
+    /// \param[in] keyId ID of the key, 1 to RH_ENCRYPTED_MAX_KEY_ID. Must be the same at both ends
+    /// \param[in] cipher Cipher with the key already set. It must last as long as the driver, and
+    /// is not used for anything else
+    /// \param[in] spare Another cipher of the same type, for rekey() to set the next key on, or NULL
+    /// if the key will not be changed with rekey()
+    /// \return true if the key was added, false if the table is full or the key ID is not valid
+    bool addPeerKey(uint8_t address, uint8_t keyId, BlockCipher& cipher, BlockCipher* spare = NULL);
+
+    /// Removes a peer key from the table, so messages to and from the peer use the cipher passed to the constructor
+    /// \param[in] address Address of the peer
+    /// \return true if the peer was in the table
+    bool removePeerKey(uint8_t address);
+
+    /// Returns the ID of the key used to send messages to a peer
+    /// \param[in] address Address of the peer
+    /// \return The key ID, or 0 if the peer is not in the table
+    uint8_t peerKeyId(uint8_t address);
+
+    /// Starts changing the key shared with a peer, by sending it a rekey request. See "Peer keys" above.
+    /// Messages must then be received with recv() (as they normally would) for the response to be handled.
+    /// The request is sent from the address set with setThisAddress()
+    /// \param[in] address Address of the peer
+    /// \return true if the request was sent, false if the peer is not in the table,
+    /// or has no spare cipher, or the mode is not CipherModeCCM, or the request could not be sent
+    bool rekey(uint8_t address);
+
     /// Calls the real driver's init()
     /// \return The value returned from the driver init() method;
     virtual bool init() { return _driver.init();};
@@ -74,6 +296,13 @@ public:
     /// \return true if a valid message was copied to buf
     virtual bool recv(uint8_t* buf, uint8_t* len);
 
+    /// Receives and decrypts a message like recv(buf, len), and returns its headers etc from the underlying driver
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \param[out] info Set to the headers etc of the message, if a message was copied. May be NULL
+    /// \return true if a valid message was copied to buf
+    virtual bool recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info);
+
     /// Waits until any previous transmit packet is finished being transmitted with waitPacketSent().
     /// Then optionally waits for Channel Activity Detection (CAD) 
     /// to show the channnel is clear (if the radio supports CAD) by calling waitCAD().
@@ -86,6 +315,13 @@ public:
     /// if CAD was requested and the CAD timeout timed out before clear channel was detected.
     virtual bool send(const uint8_t* data, uint8_t len);
 
+    /// Encrypts and sends a message like send(data, len), with the headers given
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \param[in] header The headers to send with the message
+    /// \return true if the message length was valid and it was correctly queued for transmit.
+    virtual bool sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header);
+
     /// Returns the maximum message length 
     /// available in this Driver, which depends on the maximum length supported by the underlying transport driver.
     /// \return The maximum legal message length
@@ -133,19 +369,19 @@ public:
     /// You would normally set the header FROM address to be the same as thisAddress (though you dont have to, 
     /// allowing the possibilty of address spoofing).
     /// \param[in] thisAddress The address of this node.
-    virtual void setThisAddress(uint8_t thisAddress) { _driver.setThisAddress(thisAddress);};
+    virtual void setThisAddress(uint8_t thisAddress) { RHGenericDriver::setThisAddress(thisAddress); _driver.setThisAddress(thisAddress);};
 
     /// Sets the TO header to be sent in all subsequent messages
     /// \param[in] to The new TO header value
-    virtual void           setHeaderTo(uint8_t to){ _driver.setHeaderTo(to);};
+    virtual void           setHeaderTo(uint8_t to){ RHGenericDriver::setHeaderTo(to); _driver.setHeaderTo(to);};
 
     /// Sets the FROM header to be sent in all subsequent messages
     /// \param[in] from The new FROM header value
-    virtual void           setHeaderFrom(uint8_t from){ _driver.setHeaderFrom(from);};
+    virtual void           setHeaderFrom(uint8_t from){ RHGenericDriver::setHeaderFrom(from); _driver.setHeaderFrom(from);};
 
     /// Sets the ID header to be sent in all subsequent messages
     /// \param[in] id The new ID header value
-    virtual void           setHeaderId(uint8_t id){ _driver.setHeaderId(id);};
+    virtual void           setHeaderId(uint8_t id){ RHGenericDriver::setHeaderId(id); _driver.setHeaderId(id);};
 
     /// Sets and clears bits in the FLAGS header to be sent in all subsequent messages
     /// First it clears he FLAGS according to the clear argument, then sets the flags according to the 
@@ -154,7 +390,7 @@ public:
     /// \param[in] clear bitmask of flags to clear. Defaults to RH_FLAGS_APPLICATION_SPECIFIC
     ///            which clears the application specific flags, resulting in new application specific flags
     ///            identical to the set.
-    virtual void           setHeaderFlags(uint8_t set, uint8_t clear = RH_FLAGS_APPLICATION_SPECIFIC) { _driver.setHeaderFlags(set, clear);};
+    virtual void           setHeaderFlags(uint8_t set, uint8_t clear = RH_FLAGS_APPLICATION_SPECIFIC) { RHGenericDriver::setHeaderFlags(set, clear); _driver.setHeaderFlags(set, clear);};
 
     /// Tells the receiver to accept messages with any TO address, not just messages
     /// addressed to thisAddress or the broadcast address
@@ -183,6 +419,14 @@ public:
     /// \return The most recent RSSI measurement in dBm.
     int16_t        lastRssi() { return _driver.lastRssi();};
 
+    /// Returns the signal to noise ratio of the last received message, from the underlying driver
+    /// \return The SNR in dB
+    int            lastSNR() { return _driver.lastSNR();};
+
+    /// Returns when the last message was received, from the underlying driver
+    /// \return The time as returned by millis(), or 0 if unknown
+    uint32_t       lastRxTime() { return _driver.lastRxTime();};
+
     /// Returns the operating mode of the library.
     /// \return the current mode, one of RF69_MODE_*
     RHMode          mode() { return _driver.mode();};
@@ -215,25 +459,132 @@ public:
     /// \return The number of packets successfully transmitted
     virtual uint16_t       txGood() { return _driver.txGood();};
 
+protected:
+    /// Encrypts or decrypts a message in place with CCM (RFC 3610) with a 13 octet nonce, and computes
+    /// its authentication tag. Needs a 16 octet block cipher
+    /// \param[in] cipher The cipher, with the key set
+    /// \param[in,out] data The message
+    /// \param[in] len Length of the message
+    /// \param[in] nonce The 13 octet nonce
+    /// \param[in] aad Additional data to authenticate, up to 14 octets
+    /// \param[in] aadLen Length of aad
+    /// \param[out] tag Set to the authentication tag, of the length set by setCipherMode()
+    /// \param[in] encrypt true to encrypt, false to decrypt
+    void ccm(BlockCipher& cipher, uint8_t* data, uint8_t len, const uint8_t* nonce, const uint8_t* aad, uint8_t aadLen, uint8_t* tag, bool encrypt);
+
 private:
+    /// Values of PeerKey::rekeyState
+    typedef enum
+    {
+	RekeyNone = 0,        ///< No key change in progress
+	RekeyRequested,       ///< We sent a rekey request, and wait for the response
+	RekeyResponded        ///< We sent a rekey response, and wait for a message with the new key
+    } RekeyState;
+
+    /// Encrypts with CCM and sends a message
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \param[in] header The headers to send with the message
+    /// \param[in] keyId The key ID octet to send, if there is a key table
+    /// \param[in] cipher The cipher of the key
+    /// \return true if the message length was valid and it was correctly queued for transmit.
+    bool sendCCM(const uint8_t* data, uint8_t len, const MessageHeader& header, uint8_t keyId, BlockCipher& cipher);
+
+    /// Receives a message and decrypts it with CCM, if it is authentic and not a replay
+    bool recvCCM(uint8_t* buf, uint8_t* len, RxMessageInfo* info);
+
+    /// Handles a rekey request or response from a peer
+    /// \param[in] peer The entry of the peer
+    /// \param[in] slot The index in peer->ciphers of the key the message was encrypted with
+    /// \param[in] header The headers of the message
+    /// \param[in] counter The counter of the message
+    /// \param[in] msg The decrypted message
+    /// \param[in] len Length of msg
+    void handleControl(PeerKey* peer, uint8_t slot, const MessageHeader& header, uint32_t counter, const uint8_t* msg, uint8_t len);
+
+    /// Derives the key agreed by a rekey request and response, and sets it on a cipher
+    /// \param[in] current The cipher of the key the request and response were encrypted with
+    /// \param[out] next The cipher to set the new key on
+    /// \param[in] requester Address of the peer that sent the request
+    /// \param[in] responder Address of the peer that sent the response
+    /// \param[in] keyId ID of the new key
+    /// \param[in] requestCounter Counter of the request
+    /// \param[in] responseCounter Counter of the response
+    void deriveKey(BlockCipher& current, BlockCipher& next, uint8_t requester, uint8_t responder, uint8_t keyId,
+		   uint32_t requestCounter, uint32_t responseCounter);
+
+    /// Finds a peer in the key table
+    /// \param[in] address Address of the peer
+    /// \return The entry of the peer, or NULL if it is not in the table
+    PeerKey* findPeerKey(uint8_t address);
+
+    /// Returns the octets sent in front of each message in CipherModeCCM: the key ID if there is a key table, and the counter
+    uint8_t prefixLen() { return (_peerKeys ? RH_ENCRYPTED_KEY_ID_LEN : 0) + RH_ENCRYPTED_COUNTER_LEN;};
+
+    /// Checks the counter of an authentic message from a sender against its replay window,
+    /// in the table of recent senders
+    /// \param[in] from The FROM address of the sender
+    /// \param[in] counter The counter of the message
+    /// \param[in] update true to record the counter as seen, false just to check it
+    /// \return true if the counter has not been seen before
+    bool checkReplay(uint8_t from, uint32_t counter, bool update);
+
+    /// Checks the counter of a message against a replay window
+    /// \param[in,out] window The replay window. If it is not valid, any counter is new
+    /// \param[in] counter The counter of the message
+    /// \param[in] update true to record the counter as seen, false just to check it
+    /// \return true if the counter has not been seen before
+    bool checkWindow(ReplayWindow& window, uint32_t counter, bool update);
+
+    /// Encrypts and sends a message
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \param[in] header The headers to send with the message, or NULL for the headers set in the underlying driver
+    /// \return true if the message length was valid and it was correctly queued for transmit.
+    bool encryptAndSend(const uint8_t* data, uint8_t len, const MessageHeader* header);
+
+    /// Sends a ciphertext with the underlying driver
+    bool driverSend(const uint8_t* data, uint8_t len, const MessageHeader* header)
+    {
+	return header ? _driver.sendWithHeader(data, len, *header) : _driver.send(data, len);
+    }
+
     /// The underlying transport river we are to use
     RHGenericDriver&        _driver;
     
     /// The CipherBlock we are to use for encrypting/decrypting
     BlockCipher&	    _blockcipher;
     
-    /// Struct for with buffers for ciphering
-    typedef struct
-    {
-	size_t  blockSize    = 0;
-	uint8_t *inputBlock  = NULL;
-	//uint8_t *outputBlock = NULL;		
-    } CipherBlocks;
-    
-    CipherBlocks            _cipheringBlocks;
-    
-    /// Buffer to store encrypted/decrypted message
+    /// Buffer to store encrypted/decrypted message. Blocks are encrypted in place in it
     uint8_t*                _buffer;
+
+    /// Size of _buffer
+    uint8_t                 _bufferLen;
+
+    /// How messages are encrypted
+    CipherMode              _cipherMode;
+
+    /// Length of the authentication tag in CipherModeCCM
+    uint8_t                 _tagLen;
+
+    /// Counter for the next message sent in CipherModeCCM
+    uint32_t                _txCounter;
+
+    /// Replay windows of recent senders not in the key table, most recently heard first
+    ReplayWindow            _replayWindows[RH_ENCRYPTED_REPLAY_PEERS];
+
+    /// The key table, sorted by address, or NULL if there is none
+    PeerKey*                _peerKeys;
+
+    /// Number of entries in _peerKeys
+    uint16_t                _peerKeysSize;
+
+    /// Number of entries in use in _peerKeys
+    uint16_t                _numPeerKeys;
+
+    /// Messages discarded in CipherModeCCM
+    uint16_t                _rxAuthFailures;
+    uint16_t                _rxReplays;
 };
 
 /// @example nrf24_encrypted_client.pde
@@ -242,6 +593,8 @@ private:
 /// @example rf95_encrypted_server.pde
 /// @example serial_encrypted_reliable_datagram_client.pde
 /// @example serial_encrypted_reliable_datagram_server.pde
+/// @example encrypted_benchmark.pde
+/// @example encrypted_peer_keys.pde
 
 
 #else // RH_ENABLE_ENCRYPTION_MODULE
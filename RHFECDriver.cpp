@@ -0,0 +1,75 @@
+// RHFECDriver.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHFECDriver.h>
+
+RHFECDriver::RHFECDriver(RHGenericDriver& driver, uint8_t nroots)
+    : _driver(driver),
+      _rs(nroots),
+      _rxCorrected(0),
+      _octetsCorrected(0)
+{
+}
+
+bool RHFECDriver::recv(uint8_t* buf, uint8_t* len)
+{
+    return recvWithInfo(buf, len, NULL);
+}
+
+bool RHFECDriver::recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info)
+{
+    uint8_t codewordLen = sizeof(_buffer);
+    if (!_driver.recvWithInfo(_buffer, &codewordLen, info))
+	return false;
+
+    int16_t corrected = _rs.decode(_buffer, codewordLen);
+    if (corrected < 0)
+    {
+	// Too many errors to correct
+	_rxBad++;
+	return false;
+    }
+    if (corrected > 0)
+    {
+	_rxCorrected++;
+	_octetsCorrected += corrected;
+    }
+    if (buf && len)
+    {
+	uint8_t dataLen = codewordLen - _rs.roots();
+	if (*len > dataLen)
+	    *len = dataLen;
+	memcpy(buf, _buffer, *len);
+    }
+    return true;
+}
+
+bool RHFECDriver::send(const uint8_t* data, uint8_t len)
+{
+    uint8_t codewordLen = encode(data, len);
+    return codewordLen && _driver.send(_buffer, codewordLen);
+}
+
+bool RHFECDriver::sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header)
+{
+    uint8_t codewordLen = encode(data, len);
+    return codewordLen && _driver.sendWithHeader(_buffer, codewordLen, header);
+}
+
+uint8_t RHFECDriver::encode(const uint8_t* data, uint8_t len)
+{
+    if (len > maxMessageLength())
+	return 0;
+
+    memcpy(_buffer, data, len);
+    _rs.encode(_buffer, len, _buffer + len);
+    return len + _rs.roots();
+}
+
+uint8_t RHFECDriver::maxMessageLength()
+{
+    uint8_t driver_len = _driver.maxMessageLength();
+    return (driver_len > _rs.roots()) ? driver_len - _rs.roots() : 0;
+}
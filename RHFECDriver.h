@@ -0,0 +1,272 @@
+// RHFECDriver.h
+//
+// Forward error correction layer that could use any driver
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHFECDriver_h
+#define RHFECDriver_h
+
+#include <RHGenericDriver.h>
+#include <RHReedSolomon.h>
+
+/// The default number of Reed-Solomon parity octets added to each message by RHFECDriver.
+/// Allows up to 4 octets in error to be corrected.
+#define RH_FEC_DEFAULT_ROOTS 8
+
+/// The largest codeword RHFECDriver can send or receive, including the parity octets
+#define RH_FEC_MAX_CODEWORD_LEN 255
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHFECDriver RHFECDriver.h <RHFECDriver.h>
+/// \brief Virtual Driver to add forward error correction. Can be used with any other RadioHead driver.
+///
+/// This driver acts as a wrapper for any other RadioHead driver, adding Reed-Solomon parity octets
+/// (see RHReedSolomon) to each message sent, and correcting errors in messages received from the actual 
+/// radio driver. Only the message payload is protected, and not the to/from address or flags. 
+/// With N parity octets (see setRedundancy()), up to N/2 octets in error anywhere in the payload
+/// can be corrected, so that a message with a few bit errors is delivered instead of being dropped and
+/// retransmitted. Messages with more errors than can be corrected are dropped and counted by rxBad().
+///
+/// The payload sent over the air is the message followed by the parity octets, so maxMessageLength()
+/// is that of the underlying driver less the number of parity octets. 
+/// For successful communications, both sender and receiver must use the same redundancy.
+///
+/// Caution: most RadioHead drivers (and many radios) check a CRC or FCS and silently drop messages 
+/// with any errors, in which case there is nothing for the FEC to correct. 
+/// RHFECDriver is useful with drivers and radios where the CRC check can be disabled, 
+/// for example RH_RF95::setPayloadCRC(false). Then the FEC provides both the error correction
+/// and the error detection. The 4 RadioHead headers are not protected, so corrupted headers can 
+/// still cause messages to be misdelivered or dropped.
+///
+/// The parity calculations are table driven and take a few tens of microseconds per octet on 
+/// an 8 bit processor. See examples/fec/fec_benchmark for measurements of encode and decode speed,
+/// and of residual message loss against a simulated bit error rate.
+class RHFECDriver : public RHGenericDriver
+{
+public:
+    /// Constructor.
+    /// Adds a forward error correction layer to messages sent and received by the actual transport driver.
+    /// \param[in] driver The RadioHead driver to use to transport messages.
+    /// \param[in] nroots The number of parity octets to add to each message (see setRedundancy()).
+    RHFECDriver(RHGenericDriver& driver, uint8_t nroots = RH_FEC_DEFAULT_ROOTS);
+
+    /// Calls the real driver's init()
+    /// \return The value returned from the driver init() method;
+    virtual bool init() { return _driver.init();};
+    
+    /// Tests whether a new message is available
+    /// from the Driver. 
+    /// On most drivers, this will also put the Driver into RHModeRx mode until
+    /// a message is actually received by the transport, when it wil be returned to RHModeIdle.
+    /// This can be called multiple times in a timeout loop
+    /// \return true if a new, complete, error-free uncollected message is available to be retreived by recv()
+    virtual bool available() { return _driver.available();};
+
+    /// Blocks until the transmitter 
+    /// is no longer transmitting.
+    virtual bool            waitPacketSent() { return _driver.waitPacketSent();} ;
+
+    /// Blocks until the transmitter is no longer transmitting.
+    /// or until the timeout occuers, whichever happens first
+    /// \param[in] timeout Maximum time to wait in milliseconds.
+    /// \return true if the radio completed transmission within the timeout period. False if it timed out.
+    virtual bool            waitPacketSent(uint16_t timeout) {return _driver.waitPacketSent(timeout);} ;
+
+    /// Starts the receiver and blocks until a received message is available or a timeout
+    /// \param[in] timeout Maximum time to wait in milliseconds.
+    /// \return true if a message is available
+    virtual bool            waitAvailableTimeout(uint16_t timeout) {return _driver.waitAvailableTimeout(timeout);};
+
+    /// Calls the waitCAD method in the driver
+    /// \return The return value from teh drivers waitCAD() method
+    virtual bool            waitCAD() { return _driver.waitCAD();};
+
+    /// Sets the Channel Activity Detection timeout in milliseconds to be used by waitCAD().
+    /// The default is 0, which means do not wait for CAD detection.
+    /// CAD detection depends on support for isChannelActive() by your particular radio.
+    void setCADTimeout(unsigned long cad_timeout) {_driver.setCADTimeout(cad_timeout);};
+
+    /// Determine if the currently selected radio channel is active.
+    /// This is expected to be subclassed by specific radios to implement their Channel Activity Detection
+    /// if supported. If the radio does not support CAD, returns true immediately. If a RadioHead radio 
+    /// supports isChannelActive() it will be documented in the radio specific documentation.
+    /// This is called automatically by waitCAD().
+    /// \return true if the radio-specific CAD (as returned by override of isChannelActive()) shows the
+    /// current radio channel as active, else false. If there is no radio-specific CAD, returns false.
+    virtual bool            isChannelActive() { return _driver.isChannelActive();};
+
+    /// Sets the address of this node. Defaults to 0xFF. Subclasses or the user may want to change this.
+    /// This will be used to test the adddress in incoming messages. In non-promiscuous mode,
+    /// only messages with a TO header the same as thisAddress or the broadcast addess (0xFF) will be accepted.
+    /// In promiscuous mode, all messages will be accepted regardless of the TO header.
+    /// In a conventional multinode system, all nodes will have a unique address 
+    /// (which you could store in EEPROM).
+    /// You would normally set the header FROM address to be the same as thisAddress (though you dont have to, 
+    /// allowing the possibilty of address spoofing).
+    /// \param[in] thisAddress The address of this node.
+    virtual void setThisAddress(uint8_t thisAddress) { _driver.setThisAddress(thisAddress);};
+
+    /// Sets the TO header to be sent in all subsequent messages
+    /// \param[in] to The new TO header value
+    virtual void           setHeaderTo(uint8_t to){ _driver.setHeaderTo(to);};
+
+    /// Sets the FROM header to be sent in all subsequent messages
+    /// \param[in] from The new FROM header value
+    virtual void           setHeaderFrom(uint8_t from){ _driver.setHeaderFrom(from);};
+
+    /// Sets the ID header to be sent in all subsequent messages
+    /// \param[in] id The new ID header value
+    virtual void           setHeaderId(uint8_t id){ _driver.setHeaderId(id);};
+
+    /// Sets and clears bits in the FLAGS header to be sent in all subsequent messages
+    /// First it clears he FLAGS according to the clear argument, then sets the flags according to the 
+    /// set argument. The default for clear always clears the application specific flags.
+    /// \param[in] set bitmask of bits to be set. Flags are cleared with the clear mask before being set.
+    /// \param[in] clear bitmask of flags to clear. Defaults to RH_FLAGS_APPLICATION_SPECIFIC
+    ///            which clears the application specific flags, resulting in new application specific flags
+    ///            identical to the set.
+    virtual void           setHeaderFlags(uint8_t set, uint8_t clear = RH_FLAGS_APPLICATION_SPECIFIC) { _driver.setHeaderFlags(set, clear);};
+
+    /// Tells the receiver to accept messages with any TO address, not just messages
+    /// addressed to thisAddress or the broadcast address
+    /// \param[in] promiscuous true if you wish to receive messages with any TO address
+    virtual void           setPromiscuous(bool promiscuous){ _driver.setPromiscuous(promiscuous);};
+
+    /// Returns the TO header of the last received message
+    /// \return The TO header
+    virtual uint8_t        headerTo() { return _driver.headerTo();};
+
+    /// Returns the FROM header of the last received message
+    /// \return The FROM header
+    virtual uint8_t        headerFrom() { return _driver.headerFrom();};
+
+    /// Returns the ID header of the last received message
+    /// \return The ID header
+    virtual uint8_t        headerId() { return _driver.headerId();};
+
+    /// Returns the FLAGS header of the last received message
+    /// \return The FLAGS header
+    virtual uint8_t        headerFlags() { return _driver.headerFlags();};
+
+    /// Returns the most recent RSSI (Receiver Signal Strength Indicator).
+    /// Usually it is the RSSI of the last received message, which is measured when the preamble is received.
+    /// If you called readRssi() more recently, it will return that more recent value.
+    /// \return The most recent RSSI measurement in dBm.
+    int16_t        lastRssi() { return _driver.lastRssi();};
+
+    /// Returns the signal to noise ratio of the last received message, from the actual driver
+    /// \return The SNR in dB
+    int            lastSNR() { return _driver.lastSNR();};
+
+    /// Returns when the last message was received, from the actual driver
+    /// \return The time as returned by millis(), or 0 if unknown
+    uint32_t       lastRxTime() { return _driver.lastRxTime();};
+
+    /// Returns the operating mode of the library.
+    /// \return the current mode, one of RF69_MODE_*
+    RHMode          mode() { return _driver.mode();};
+
+    /// Sets the operating mode of the transport.
+    void            setMode(RHMode mode) { _driver.setMode(mode);};
+
+    /// Sets the transport hardware into low-power sleep mode
+    /// (if supported). May be overridden by specific drivers to initialte sleep mode.
+    /// If successful, the transport will stay in sleep mode until woken by 
+    /// changing mode it idle, transmit or receive (eg by calling send(), recv(), available() etc)
+    /// \return true if sleep mode is supported by transport hardware and the RadioHead driver, and if sleep mode
+    ///         was successfully entered. If sleep mode is not suported, return false.
+    virtual bool    sleep() { return _driver.sleep();};
+
+    /// Returns the count of the number of 
+    /// good received packets
+    /// \return The number of good packets received.
+    virtual uint16_t       rxGood() { return _driver.rxGood();};
+
+    /// Returns the count of the number of 
+    /// packets successfully transmitted (though not necessarily received by the destination)
+    /// \return The number of packets successfully transmitted
+    virtual uint16_t       txGood() { return _driver.txGood();};
+
+    /// Turns the receiver on if it not already on.
+    /// If there is a valid message available, corrects any errors in it, and if successful 
+    /// copies it to buf and returns true, else returns false.
+    /// If a message is copied, *len is set to the length (Caution, 0 length messages are permitted).
+    /// You should be sure to call this function frequently enough to not miss any messages
+    /// It is recommended that you call it in your main loop.
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \return true if a valid message was copied to buf
+    virtual bool recv(uint8_t* buf, uint8_t* len);
+
+    /// Receives and corrects a message like recv(buf, len), and returns its headers etc from the actual driver
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \param[out] info Set to the headers etc of the message, if a message was copied. May be NULL
+    /// \return true if a valid message was copied to buf
+    virtual bool recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info);
+
+    /// Adds the parity octets to the message and sends it with the actual driver.
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \return true if the message length was valid and it was correctly queued for transmit.
+    virtual bool send(const uint8_t* data, uint8_t len);
+
+    /// Adds the parity octets to the message and sends it with the actual driver, with the headers given
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \param[in] header The headers to send with the message
+    /// \return true if the message length was valid and it was correctly queued for transmit.
+    virtual bool sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header);
+
+    /// Returns the maximum message length 
+    /// available in this Driver, which is the maximum length supported by the underlying 
+    /// transport driver, less the number of parity octets.
+    /// \return The maximum legal message length
+    virtual uint8_t maxMessageLength();
+
+    /// Sets the number of parity octets added to each message. The number of octets in error that can be 
+    /// corrected in each message is half this.
+    /// More parity octets correct more errors, but make every message longer.
+    /// \param[in] nroots The number of parity octets, from 1 to RH_RS_MAX_ROOTS
+    /// \return true if nroots is valid
+    bool setRedundancy(uint8_t nroots) { return _rs.setRoots(nroots);};
+
+    /// Returns the count of the number of bad received packets (ie packets with bad lengths, checksum etc,
+    /// or too many errors to correct) which were rejected and not delivered to the application.
+    /// \return The number of bad packets received.
+    virtual uint16_t       rxBad() { return _driver.rxBad() + _rxBad;};
+
+    /// Returns the count of received packets that had errors which were corrected
+    /// \return The number of packets corrected
+    uint16_t               rxCorrected() { return _rxCorrected;};
+
+    /// Returns the total number of octets in error that have been corrected in received packets
+    /// \return The number of octets corrected
+    uint32_t               octetsCorrected() { return _octetsCorrected;};
+
+private:
+    /// Copies a message to _buffer and adds the parity octets
+    /// \return The length of the codeword, or 0 if the message is too long
+    uint8_t encode(const uint8_t* data, uint8_t len);
+
+    /// The underlying transport driver we are to use
+    RHGenericDriver&        _driver;
+
+    /// The Reed-Solomon codec
+    RHReedSolomon           _rs;
+
+    /// Count of packets with corrected errors
+    uint16_t                _rxCorrected;
+
+    /// Count of octets corrected
+    uint32_t                _octetsCorrected;
+
+    /// Buffer for the codeword being sent or received
+    uint8_t                 _buffer[RH_FEC_MAX_CODEWORD_LEN];
+};
+
+/// @example fec_benchmark.ino
+
+#endif
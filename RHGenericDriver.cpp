@@ -44,7 +44,11 @@ bool RHGenericDriver::waitAvailableTimeout(uint16_t timeout)
 	{
            return true;
 	}
+#ifdef RH_POLL_INTERVAL_US
+	RHPollWait(starttime + timeout); // Sleep instead of spinning
+#else
 	YIELD;
+#endif
     }
     return false;
 }
@@ -63,7 +67,11 @@ bool RHGenericDriver::waitPacketSent(uint16_t timeout)
     {
         if (_mode != RHModeTx) // Any previous transmit finished?
            return true;
+#ifdef RH_POLL_INTERVAL_US
+	RHPollWait(starttime + timeout);
+#else
 	YIELD;
+#endif
     }
     return false;
 }
@@ -156,6 +164,34 @@ int16_t RHGenericDriver::lastRssi()
     return _lastRssi;
 }
 
+bool RHGenericDriver::sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header)
+{
+    _txHeaderTo = header.to;
+    _txHeaderFrom = header.from;
+    _txHeaderId = header.id;
+    _txHeaderFlags = header.flags;
+    return send(data, len);
+}
+
+bool RHGenericDriver::recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info)
+{
+    if (!recv(buf, len))
+	return false;
+    if (info)
+    {
+	info->header.to = _rxHeaderTo;
+	info->header.from = _rxHeaderFrom;
+	info->header.id = _rxHeaderId;
+	info->header.flags = _rxHeaderFlags;
+	info->rssi = _lastRssi;
+	info->snr = lastSNR();
+	info->timestamp = lastRxTime();
+	if (!info->timestamp)
+	    info->timestamp = millis();
+    }
+    return true;
+}
+
 RHGenericDriver::RHMode  RHGenericDriver::mode()
 {
     return _mode;
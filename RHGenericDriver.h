@@ -38,6 +38,11 @@
 /// -ID A message ID, distinct (over short time scales) for each message sent by a particilar node
 /// -FLAGS A bitmask of flags. The most significant 4 bits are reserved for use by RadioHead. The least
 /// significant 4 bits are reserved for applications.
+///
+/// Some optional manager features mark frames with one of the application bits, which is then not available
+/// to applications that use the feature:
+/// - 0x04 RH_AGGREGATE_FLAGS_AGGREGATED, by RHAggregatingDatagram
+/// - 0x08 RH_ROUTER_FLAGS_COMPRESSED, by RHRouter and RHMesh when header compression is enabled
 class RHGenericDriver
 {
 public:
@@ -55,6 +60,27 @@ public:
 	RHModeCad               ///< Transport is in the process of detecting channel activity (if supported)
     } RHMode;
 
+    /// \brief The 4 headers of a message
+    ///
+    /// Passed to sendWithHeader() with each message, instead of setting them beforehand with setHeaderTo() etc,
+    /// and returned by recvWithInfo() with each received message.
+    typedef struct
+    {
+	uint8_t to;    ///< TO header
+	uint8_t from;  ///< FROM header
+	uint8_t id;    ///< ID header
+	uint8_t flags; ///< FLAGS header
+    } MessageHeader;
+
+    /// \brief Everything known about a received message apart from its payload, returned by recvWithInfo()
+    typedef struct
+    {
+	MessageHeader header;    ///< The headers of the message
+	int16_t       rssi;      ///< The RSSI, as lastRssi()
+	int16_t       snr;       ///< The signal to noise ratio in dB, as lastSNR(). 0 if the driver does not measure it
+	uint32_t      timestamp; ///< millis() when the message was received, as lastRxTime(), or if the driver does not know, when recv() collected it
+    } RxMessageInfo;
+
     /// Constructor
     RHGenericDriver();
 
@@ -99,11 +125,36 @@ public:
     /// if CAD was requested and the CAD timeout timed out before clear channel was detected.
     virtual bool send(const uint8_t* data, uint8_t len) = 0;
 
+    /// Sends a message with the headers given, instead of those set with setHeaderTo() etc.
+    /// The headers go with this message only, so that messages can be queued or sent asynchronously, each
+    /// with its own headers, and so a manager need not make 4 calls to set them for each message.
+    /// The base sets the header fields of the driver and calls send(data, len), so those headers are also
+    /// used by later calls to send(data, len). Drivers that wrap or queue messages override it.
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send (> 0)
+    /// \param[in] header The headers to send with the message
+    /// \return true if the message length was valid and it was correctly queued for transmit
+    virtual bool sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header);
+
+    /// Receives a message like recv(buf, len), and returns its headers, RSSI, SNR and the time it was received
+    /// in one call, instead of calls to headerTo(), headerFrom(), headerId(), headerFlags(), lastRssi() etc.
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \param[out] info Set to the headers etc of the message, if a message was copied. May be NULL
+    /// \return true if a valid message was copied to buf
+    virtual bool recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info);
+
     /// Returns the maximum message length 
     /// available in this Driver.
     /// \return The maximum legal message length
     virtual uint8_t maxMessageLength() = 0;
 
+    /// Does the work of the driver's interrupt handler. For use when the driver has not attached an
+    /// interrupt handler of its own (its interrupt pin is RH_INVALID_PIN), and something else detects
+    /// the interrupt and calls this instead, such as the service thread of RHThreadedDriver.
+    /// The base does nothing. Supported by RH_RF95
+    virtual void            serviceInterrupt() {}
+
     /// Starts the receiver and blocks until a valid received 
     /// message is available.
     virtual void            waitAvailable();
@@ -163,7 +214,10 @@ public:
     /// \param[in] thisAddress The address of this node.
     virtual void setThisAddress(uint8_t thisAddress);
 
-    /// Sets the TO header to be sent in all subsequent messages
+    /// Sets the TO header to be sent in all subsequent messages sent with send(data, len).
+    /// A manager (RHDatagram and the managers based on it) keeps its own headers and sends them with each
+    /// message using sendWithHeader(), so these settings are ignored for messages sent by a manager:
+    /// call the manager's setHeaderTo() etc instead. The same goes for setHeaderFrom(), setHeaderId() and setHeaderFlags()
     /// \param[in] to The new TO header value
     virtual void           setHeaderTo(uint8_t to);
 
@@ -211,6 +265,15 @@ public:
     /// \return The most recent RSSI measurement in dBm.
     virtual int16_t        lastRssi();
 
+    /// Returns the signal to noise ratio of the last received message, for drivers whose radio measures it
+    /// \return The SNR in dB. The base returns 0
+    virtual int            lastSNR() { return 0;}
+
+    /// Returns when the last message was received, for drivers that record it
+    /// (when its preamble was detected, or when it was complete, depending on the radio)
+    /// \return The time as returned by millis(). The base returns 0, which means unknown
+    virtual uint32_t       lastRxTime() { return 0;}
+
     /// Returns the operating mode of the library.
     /// \return the current mode, one of RF69_MODE_*
     virtual RHMode          mode();
@@ -29,3 +29,36 @@ void RHGenericSPI::setFrequency(Frequency frequency)
     _frequency = frequency;
 }
 
+
+uint8_t RHGenericSPI::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
+{
+    uint8_t status = transfer(reg); // Send the start address
+    while (len--)
+	*dest++ = transfer(0);
+    return status;
+}
+
+uint8_t RHGenericSPI::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
+{
+    uint8_t status = transfer(reg); // Send the start address
+    while (len--)
+	transfer(*src++);
+    return status;
+}
+
+// Emulate asynchronous transfers with synchronous ones: finished before we return
+bool RHGenericSPI::spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, TransferCallback callback, void* context)
+{
+    uint8_t status = spiBurstRead(reg, dest, len);
+    if (callback)
+	callback(context, status);
+    return true;
+}
+
+bool RHGenericSPI::spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, TransferCallback callback, void* context)
+{
+    uint8_t status = spiBurstWrite(reg, src, len);
+    if (callback)
+	callback(context, status);
+    return true;
+}
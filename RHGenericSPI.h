@@ -27,6 +27,9 @@
 /// - begin()
 /// - end() 
 /// - transfer()
+///
+/// Subclasses that can transfer whole buffers more efficiently than one octet at a time
+/// should also override spiBurstRead() and spiBurstWrite().
 class RHGenericSPI 
 {
 public:
@@ -73,6 +76,23 @@ public:
 	BitOrderLSBFirst,      ///< SPI LSB first
     } BitOrder;
 
+    /// \brief One register transaction in a batch, see spiBatch()
+    ///
+    /// A register address octet followed by len data octets, written from or read into data.
+    typedef struct
+    {
+	uint8_t      reg;    ///< Register address octet to send, including any read/write flag
+	bool         write;  ///< true to write data to the device, false to read into it
+	uint8_t*     data;   ///< The data to write, or where to put the data read
+	uint8_t      len;    ///< Number of data octets
+    } Transaction;
+
+    /// Type of the function called when an asynchronous transfer has finished, 
+    /// see spiBurstReadAsync(). DMA capable interfaces may call it from an interrupt handler.
+    /// \param[in] context The context given when the transfer was started
+    /// \param[in] status The octet read while the register address was sent
+    typedef void (*TransferCallback)(void* context, uint8_t status);
+
     /// Constructor
     /// Creates an instance of an abstract SPI interface.
     /// Do not use this contructor directly: you must instead use on of the concrete subclasses provided 
@@ -95,23 +115,60 @@ public:
     /// \param[in] byte1 The second byte to be sent on the SPI interface
     /// \return The second byte clocked in as the second byte is sent.
     virtual uint8_t transfer2B(uint8_t byte0, uint8_t byte1) = 0;
-
-    /// Read a number of bytes on the SPI interface from an NRF device
-    /// \param[in] reg The NRF device register to read
-    /// \param[out] dest The buffer to hold the bytes read
-    /// \param[in] len The number of bytes to read
-    /// \return The NRF status byte
-    virtual uint8_t spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len) = 0;
-
-    /// Wrte a number of bytes on the SPI interface to an NRF device
-    /// \param[in] reg The NRF device register to read
-    /// \param[out] src The buffer to hold the bytes write
-    /// \param[in] len The number of bytes to write
-    /// \return The NRF status byte
-    virtual uint8_t spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len) = 0;
-
 #endif
 
+    /// Sends a register address octet, then reads a number of octets, all as one SPI transaction.
+    /// The caller has already selected the device (unless the interface selects it itself, such 
+    /// as RHSpidevSPI). 
+    /// The base implementation calls transfer() for each octet. Interfaces that can move a 
+    /// whole buffer at once (such as RHSpidevSPI, which does it in one system call) override it.
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[out] dest The buffer to hold the octets read
+    /// \param[in] len The number of octets to read
+    /// \return The octet read while reg was sent (the status byte of some devices)
+    virtual uint8_t spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len);
+
+    /// Sends a register address octet, then writes a number of octets, all as one SPI transaction.
+    /// See spiBurstRead().
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[in] src The octets to write
+    /// \param[in] len The number of octets to write
+    /// \return The octet read while reg was sent (the status byte of some devices)
+    virtual uint8_t spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len);
+
+    /// Performs several register transactions as a single operation, such as one system call or one
+    /// DMA chain, releasing and reasserting the chip select between transactions. Only possible for
+    /// interfaces that drive the chip select themselves. 
+    /// The base implementation does nothing and returns false.
+    /// \param[in,out] transactions The transactions to perform, in order
+    /// \param[in] count The number of transactions
+    /// \return true if the transactions were done, false if the caller must do them one at a time
+    virtual bool    spiBatch(Transaction* transactions, uint8_t count) { (void)transactions; (void)count; return false;}
+
+    /// Starts an asynchronous burst read: like spiBurstRead(), but returns as soon as the transfer
+    /// has started, and calls callback when it has finished. dest must stay valid until then. The caller has already
+    /// selected the device, and deselects it in the callback. Interfaces with DMA can implement this
+    /// so that the CPU (and interrupts) can carry on during long FIFO transfers.
+    /// The base implementation emulates it by calling spiBurstRead() and then callback, before returning.
+    /// Only one asynchronous transfer can be in progress at a time.
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[out] dest The buffer to hold the octets read
+    /// \param[in] len The number of octets to read
+    /// \param[in] callback Function to call when the transfer has finished. May be NULL
+    /// \param[in] context Passed to callback
+    /// \return true if the transfer was started (and perhaps finished), false if another transfer is still in progress
+    virtual bool    spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, TransferCallback callback, void* context);
+
+    /// Starts an asynchronous burst write, see spiBurstReadAsync(). src must stay valid until
+    /// callback is called.
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[in] src The octets to write
+    /// \param[in] len The number of octets to write
+    /// \param[in] callback Function to call when the transfer has finished. May be NULL
+    /// \param[in] context Passed to callback
+    /// \return true if the transfer was started (and perhaps finished), false if another transfer is still in progress
+    virtual bool    spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, TransferCallback callback, void* context);
+
     /// SPI Configuration methods
     /// Enable SPI interrupts (if supported)
     /// This can be used in an SPI slave to indicate when an SPI message has been received
@@ -159,6 +216,16 @@ public:
     /// Might be overridden in subclass
     virtual void endTransaction(){}
 
+    /// Called by RHSPIDriver before it disables interrupts for a transaction, and so before beginTransaction().
+    /// Interfaces that have to get hold of something shared first, such as RHSPIBusDevice, do it here.
+    /// Base does nothing
+    /// \return true if the transaction can go ahead, false if it must not be done
+    virtual bool acquire(){ return true;}
+
+    /// Called by RHSPIDriver after a transaction, once interrupts are enabled again, to undo acquire().
+    /// Base does nothing
+    virtual void release(){}
+
     /// Specify the interrupt number of the interrupt that will use SPI transactions
     /// Tells the SPI support software that SPI transactions will occur with the interrupt
     /// handler assocated with interruptNumber
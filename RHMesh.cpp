@@ -13,13 +13,17 @@
 
 #include <RHMesh.h>
 
+#if !RH_THREAD_SAFE_MANAGERS
 uint8_t RHMesh::_tmpMessage[RH_ROUTER_MAX_MESSAGE_LEN];
+#endif
 
 ////////////////////////////////////////////////////////////////////
 // Constructors
 RHMesh::RHMesh(RHGenericDriver& driver, uint8_t thisAddress) 
     : RHRouter(driver, thisAddress)
 {
+    // Every message starts with its type, which compressed headers carry
+    _compressTypeOctet = true;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -30,6 +34,7 @@ RHMesh::RHMesh(RHGenericDriver& driver, uint8_t thisAddress)
 // waits for delivery to the next hop (but not for delivery to the final destination)
 uint8_t RHMesh::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address, uint8_t flags)
 {
+    ScopedLock lock(*this);
     if (len > RH_MESH_MAX_MESSAGE_LEN)
 	return RH_ROUTER_ERROR_INVALID_LENGTH;
 
@@ -154,6 +159,7 @@ bool RHMesh::isPhysicalAddress(uint8_t* address, uint8_t addresslen)
 ////////////////////////////////////////////////////////////////////
 bool RHMesh::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* source, uint8_t* dest, uint8_t* id, uint8_t* flags, uint8_t* hops)
 {     
+    ScopedLock lock(*this);
     uint8_t tmpMessageLen = sizeof(_tmpMessage);
     uint8_t _source;
     uint8_t _dest;
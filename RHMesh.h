@@ -95,6 +95,10 @@
 /// - MeshRouteFailureMessage (message type RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE) Informs nodes of 
 ///   route failures.
 ///
+/// Each starts with a 1 octet message type. With setHeaderCompression(true) (see "Header Compression" in RHRouter)
+/// the type is carried in the control octet of the compressed RHRouter header instead, so a message sent
+/// directly to its destination has 2 octets of RHMesh and RHRouter headers instead of 6.
+///
 /// Part of the Arduino RH library for operating with HopeRF RH compatible transceivers 
 /// (see http://www.hoperf.com)
 ///
@@ -250,8 +254,12 @@ protected:
     virtual bool isPhysicalAddress(uint8_t* address, uint8_t addresslen);
 
 private:
-    /// Temporary message buffer
+    /// Temporary message buffer. One for each instance when they may be used by different threads
+#if RH_THREAD_SAFE_MANAGERS
+    uint8_t _tmpMessage[RH_ROUTER_MAX_MESSAGE_LEN];
+#else
     static uint8_t _tmpMessage[RH_ROUTER_MAX_MESSAGE_LEN];
+#endif
 
 };
 
@@ -259,6 +267,7 @@ private:
 /// @example rf22_mesh_server1.pde
 /// @example rf22_mesh_server2.pde
 /// @example rf22_mesh_server3.pde
+/// @example simulator_mesh_compression.pde
 
 #endif
 
@@ -0,0 +1,256 @@
+// RHReedSolomon.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHReedSolomon.h>
+
+// alpha^i in GF(256) with field generator polynomial 0x11d
+PROGMEM static const uint8_t gf_exp[255] = 
+{
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
+    0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
+    0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
+    0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1,
+    0x5f, 0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0,
+    0xfd, 0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2,
+    0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce,
+    0x81, 0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc,
+    0x85, 0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54,
+    0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73,
+    0xe6, 0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff,
+    0xe3, 0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6,
+    0x51, 0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16,
+    0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e,
+};
+
+// log_alpha(i). gf_log[0] is undefined
+PROGMEM static const uint8_t gf_log[256] = 
+{
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x03, 0xdf, 0x33, 0xee, 0x1b, 0x68, 0xc7, 0x4b,
+    0x04, 0x64, 0xe0, 0x0e, 0x34, 0x8d, 0xef, 0x81, 0x1c, 0xc1, 0x69, 0xf8, 0xc8, 0x08, 0x4c, 0x71,
+    0x05, 0x8a, 0x65, 0x2f, 0xe1, 0x24, 0x0f, 0x21, 0x35, 0x93, 0x8e, 0xda, 0xf0, 0x12, 0x82, 0x45,
+    0x1d, 0xb5, 0xc2, 0x7d, 0x6a, 0x27, 0xf9, 0xb9, 0xc9, 0x9a, 0x09, 0x78, 0x4d, 0xe4, 0x72, 0xa6,
+    0x06, 0xbf, 0x8b, 0x62, 0x66, 0xdd, 0x30, 0xfd, 0xe2, 0x98, 0x25, 0xb3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xd0, 0x94, 0xce, 0x8f, 0x96, 0xdb, 0xbd, 0xf1, 0xd2, 0x13, 0x5c, 0x83, 0x38, 0x46, 0x40,
+    0x1e, 0x42, 0xb6, 0xa3, 0xc3, 0x48, 0x7e, 0x6e, 0x6b, 0x3a, 0x28, 0x54, 0xfa, 0x85, 0xba, 0x3d,
+    0xca, 0x5e, 0x9b, 0x9f, 0x0a, 0x15, 0x79, 0x2b, 0x4e, 0xd4, 0xe5, 0xac, 0x73, 0xf3, 0xa7, 0x57,
+    0x07, 0x70, 0xc0, 0xf7, 0x8c, 0x80, 0x63, 0x0d, 0x67, 0x4a, 0xde, 0xed, 0x31, 0xc5, 0xfe, 0x18,
+    0xe3, 0xa5, 0x99, 0x77, 0x26, 0xb8, 0xb4, 0x7c, 0x11, 0x44, 0x92, 0xd9, 0x23, 0x20, 0x89, 0x2e,
+    0x37, 0x3f, 0xd1, 0x5b, 0x95, 0xbc, 0xcf, 0xcd, 0x90, 0x87, 0x97, 0xb2, 0xdc, 0xfc, 0xbe, 0x61,
+    0xf2, 0x56, 0xd3, 0xab, 0x14, 0x2a, 0x5d, 0x9e, 0x84, 0x3c, 0x39, 0x53, 0x47, 0x6d, 0x41, 0xa2,
+    0x1f, 0x2d, 0x43, 0xd8, 0xb7, 0x7b, 0xa4, 0x76, 0xc4, 0x17, 0x49, 0xec, 0x7f, 0x0c, 0x6f, 0xf6,
+    0x6c, 0xa1, 0x3b, 0x52, 0x29, 0x9d, 0x55, 0xaa, 0xfb, 0x60, 0x86, 0xb1, 0xbb, 0xcc, 0x3e, 0x5a,
+    0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
+    0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf,
+};
+
+#define GF_EXP(i) pgm_read_byte(&gf_exp[i])
+#define GF_LOG(i) pgm_read_byte(&gf_log[i])
+
+RHReedSolomon::RHReedSolomon(uint8_t nroots)
+{
+    if (!setRoots(nroots))
+	setRoots(8);
+}
+
+bool RHReedSolomon::setRoots(uint8_t nroots)
+{
+    if (nroots < 1 || nroots > RH_RS_MAX_ROOTS)
+	return false;
+    _nroots = nroots;
+
+    // g(x) = (x - alpha^0)(x - alpha^1)...(x - alpha^(nroots-1))
+    memset(_genpoly, 0, sizeof(_genpoly));
+    _genpoly[0] = 1;
+    uint8_t i, j;
+    for (i = 0; i < nroots; i++)
+    {
+	uint8_t root = GF_EXP(i);
+	for (j = i + 1; j > 0; j--)
+	    _genpoly[j] = _genpoly[j - 1] ^ gfMul(_genpoly[j], root);
+	_genpoly[0] = gfMul(_genpoly[0], root);
+    }
+    return true;
+}
+
+uint8_t RHReedSolomon::gfMul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0)
+	return 0;
+    uint16_t i = GF_LOG(a) + GF_LOG(b);
+    if (i >= 255)
+	i -= 255;
+    return GF_EXP(i);
+}
+
+uint8_t RHReedSolomon::gfDiv(uint8_t a, uint8_t b)
+{
+    if (a == 0)
+	return 0;
+    int16_t i = GF_LOG(a) - GF_LOG(b);
+    if (i < 0)
+	i += 255;
+    return GF_EXP(i);
+}
+
+uint8_t RHReedSolomon::gfPow(uint16_t power)
+{
+    return GF_EXP(power % 255);
+}
+
+void RHReedSolomon::encode(const uint8_t* data, uint8_t len, uint8_t* parity)
+{
+    // Divide data(x) * x^nroots by g(x) with an LFSR. parity[0] is the highest order coefficient of the remainder
+    memset(parity, 0, _nroots);
+    uint8_t i, j;
+    for (i = 0; i < len; i++)
+    {
+	uint8_t feedback = data[i] ^ parity[0];
+	memmove(parity, parity + 1, _nroots - 1);
+	parity[_nroots - 1] = 0;
+	if (feedback)
+	{
+	    uint8_t logFeedback = GF_LOG(feedback);
+	    for (j = 0; j < _nroots; j++)
+	    {
+		uint8_t g = _genpoly[_nroots - 1 - j];
+		if (g)
+		{
+		    uint16_t k = logFeedback + GF_LOG(g);
+		    if (k >= 255)
+			k -= 255;
+		    parity[j] ^= GF_EXP(k);
+		}
+	    }
+	}
+    }
+}
+
+int16_t RHReedSolomon::decode(uint8_t* codeword, uint8_t len)
+{
+    if (len < _nroots)
+	return -1;
+
+    // Syndromes: S[i] = c(alpha^i), where codeword[0] is the highest order coefficient of c(x)
+    uint8_t syndromes[RH_RS_MAX_ROOTS];
+    bool errors = false;
+    uint8_t i, j;
+    for (i = 0; i < _nroots; i++)
+    {
+	uint8_t s = 0;
+	for (j = 0; j < len; j++)
+	{
+	    // s = s * alpha^i + c[j]
+	    if (s)
+	    {
+		uint16_t k = GF_LOG(s) + i;
+		if (k >= 255)
+		    k -= 255;
+		s = GF_EXP(k);
+	    }
+	    s ^= codeword[j];
+	}
+	syndromes[i] = s;
+	if (s)
+	    errors = true;
+    }
+    if (!errors)
+	return 0;
+
+    // Berlekamp-Massey: find the error locator polynomial lambda(x)
+    uint8_t lambda[RH_RS_MAX_ROOTS + 1];
+    uint8_t prev[RH_RS_MAX_ROOTS + 1];
+    uint8_t tmp[RH_RS_MAX_ROOTS + 1];
+    memset(lambda, 0, sizeof(lambda));
+    memset(prev, 0, sizeof(prev));
+    lambda[0] = prev[0] = 1;
+    uint8_t L = 0;     // Current number of assumed errors
+    uint8_t m = 1;     // Steps since prev was last updated
+    uint8_t b = 1;     // Discrepancy when prev was last updated
+    uint8_t n;
+    for (n = 0; n < _nroots; n++)
+    {
+	uint8_t d = syndromes[n];
+	for (i = 1; i <= L; i++)
+	    d ^= gfMul(lambda[i], syndromes[n - i]);
+	if (d == 0)
+	{
+	    m++;
+	    continue;
+	}
+	uint8_t coef = gfDiv(d, b);
+	bool grow = (2 * L <= n);
+	if (grow)
+	    memcpy(tmp, lambda, sizeof(lambda));
+	for (i = m; i <= _nroots; i++)
+	    lambda[i] ^= gfMul(coef, prev[i - m]);
+	if (grow)
+	{
+	    L = n + 1 - L;
+	    memcpy(prev, tmp, sizeof(prev));
+	    b = d;
+	    m = 1;
+	}
+	else
+	    m++;
+    }
+    if (L == 0 || L > _nroots / 2)
+	return -1;
+
+    // Chien search: the error in codeword[p] has locator X = alpha^(len-1-p) and lambda(1/X) == 0
+    uint8_t locations[RH_RS_MAX_ROOTS / 2];
+    uint8_t found = 0;
+    uint8_t p;
+    for (p = 0; p < len; p++)
+    {
+	uint8_t xinv = gfPow(255 - (len - 1 - p)); // 1/X
+	uint8_t v = 0;
+	for (i = L + 1; i > 0; i--)
+	    v = gfMul(v, xinv) ^ lambda[i - 1];
+	if (v == 0)
+	{
+	    if (found >= L)
+		return -1;
+	    locations[found++] = p;
+	}
+    }
+    if (found != L)
+	return -1; // Roots outside the (shortened) codeword: uncorrectable
+
+    // omega(x) = S(x) * lambda(x) mod x^nroots
+    uint8_t omega[RH_RS_MAX_ROOTS];
+    for (i = 0; i < _nroots; i++)
+    {
+	uint8_t v = 0;
+	for (j = 0; j <= i && j <= L; j++)
+	    v ^= gfMul(lambda[j], syndromes[i - j]);
+	omega[i] = v;
+    }
+
+    // Forney: error value = X * omega(1/X) / lambda'(1/X)
+    for (i = 0; i < found; i++)
+    {
+	p = locations[i];
+	uint8_t x = gfPow(len - 1 - p);
+	uint8_t xinv = gfPow(255 - (len - 1 - p));
+	uint8_t num = 0;
+	for (j = _nroots; j > 0; j--)
+	    num = gfMul(num, xinv) ^ omega[j - 1];
+	// Formal derivative of lambda: only the odd powers survive in GF(2^m)
+	uint8_t den = 0;
+	uint8_t xinv2 = gfMul(xinv, xinv);
+	for (j = (L & 1) ? L : L - 1; ; j -= 2)
+	{
+	    den = gfMul(den, xinv2) ^ lambda[j];
+	    if (j < 2)
+		break;
+	}
+	if (den == 0)
+	    return -1;
+	codeword[p] ^= gfMul(x, gfDiv(num, den));
+    }
+    return found;
+}
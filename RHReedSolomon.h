@@ -0,0 +1,86 @@
+// RHReedSolomon.h
+//
+// Reed-Solomon forward error correction codec for RadioHead
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHReedSolomon_h
+#define RHReedSolomon_h
+
+#include <RadioHead.h>
+
+/// The maximum number of parity octets (roots) per codeword supported by RHReedSolomon.
+/// Sets the size of the decoder working storage on the stack.
+#define RH_RS_MAX_ROOTS 32
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHReedSolomon RHReedSolomon.h <RHReedSolomon.h>
+/// \brief Table driven Reed-Solomon encoder and decoder over GF(256)
+///
+/// Implements systematic, shortened RS(n, n - nroots) codes over GF(256), with field generator
+/// polynomial 0x11d and first consecutive root alpha^0. A codeword of n octets (n <= 255) consists of 
+/// the n - nroots data octets followed by nroots parity octets, and the decoder can correct up to 
+/// nroots / 2 octets in error anywhere in the codeword.
+///
+/// The GF(256) log and antilog tables are in PROGMEM on processors that support it, so the only RAM used
+/// is the generator polynomial (nroots + 1 octets) and some stack during decoding. 
+/// Encoding costs nroots multiplications per data octet. Decoding an error-free codeword costs 
+/// nroots multiplications per octet to compute the syndromes, and correcting errors adds an 
+/// error locator search over the codeword.
+class RHReedSolomon
+{
+public:
+    /// Constructor.
+    /// \param[in] nroots The number of parity octets per codeword, from 1 to RH_RS_MAX_ROOTS. 
+    /// The number of correctable octets is nroots / 2.
+    RHReedSolomon(uint8_t nroots = 8);
+
+    /// Sets the number of parity octets per codeword, and computes the generator polynomial.
+    /// \param[in] nroots The number of parity octets per codeword, from 1 to RH_RS_MAX_ROOTS
+    /// \return true if nroots is valid
+    bool setRoots(uint8_t nroots);
+
+    /// Returns the number of parity octets per codeword
+    /// \return The number of parity octets
+    uint8_t roots() { return _nroots; }
+
+    /// Computes the parity octets for a block of data.
+    /// \param[in] data The data octets
+    /// \param[in] len The number of data octets. len + roots() must not exceed 255.
+    /// \param[out] parity Location to store the roots() parity octets
+    void encode(const uint8_t* data, uint8_t len, uint8_t* parity);
+
+    /// Checks a codeword, and corrects any errors in place if possible.
+    /// \param[in,out] codeword The data octets followed by the parity octets
+    /// \param[in] len The total length of the codeword, including the parity octets
+    /// \return The number of octets corrected (0 if there were no errors), 
+    /// or -1 if there were too many errors to correct. 
+    int16_t decode(uint8_t* codeword, uint8_t len);
+
+    /// Multiplies 2 elements of GF(256)
+    /// \param[in] a First element
+    /// \param[in] b Second element
+    /// \return a * b
+    static uint8_t gfMul(uint8_t a, uint8_t b);
+
+    /// Divides 2 elements of GF(256)
+    /// \param[in] a Dividend
+    /// \param[in] b Divisor, must not be 0
+    /// \return a / b
+    static uint8_t gfDiv(uint8_t a, uint8_t b);
+
+    /// Returns alpha raised to a power
+    /// \param[in] power The power. Reduced modulo 255
+    /// \return alpha^power
+    static uint8_t gfPow(uint16_t power);
+
+private:
+    /// Number of parity octets per codeword
+    uint8_t _nroots;
+
+    /// Generator polynomial, _genpoly[i] is the coefficient of x^i
+    uint8_t _genpoly[RH_RS_MAX_ROOTS + 1];
+};
+
+#endif
@@ -22,7 +22,14 @@ RHReliableDatagram::RHReliableDatagram(RHGenericDriver& driver, uint8_t thisAddr
     _lastSequenceNumber = 0;
     _timeout = RH_DEFAULT_TIMEOUT;
     _retries = RH_DEFAULT_RETRIES;
-    memset(_seenIds, 0, sizeof(_seenIds));
+    _multicastAckSpread = RH_DEFAULT_MULTICAST_ACK_SPREAD;
+    _numSeenPeers = 0;
+    _multicastAckPending = false;
+#if RH_ENABLE_ACK_COALESCING
+    _ackDelay = 0;
+    _held = false;
+    memset(_pendingAcks, 0, sizeof(_pendingAcks));
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -44,32 +51,95 @@ uint8_t RHReliableDatagram::retries()
     return _retries;
 }
 
+#if RH_ENABLE_ACK_COALESCING
+////////////////////////////////////////////////////////////////////
+void RHReliableDatagram::setAckDelay(uint16_t ackDelay)
+{
+    _ackDelay = ackDelay;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////
+void RHReliableDatagram::flushAcks()
+{
+    ScopedLock lock(*this);
+    sendPendingAcks(true);
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHReliableDatagram::available()
+{
+    ScopedLock lock(*this);
+    sendPendingAcks(false);
+#if RH_ENABLE_ACK_COALESCING
+    if (_held)
+	return true;
+#endif
+    return RHDatagram::available();
+}
+
+////////////////////////////////////////////////////////////////////
+void RHReliableDatagram::waitAvailable()
+{
+    while (!available())
+	YIELD;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHReliableDatagram::waitAvailableTimeout(uint16_t timeout)
+{
+#if RH_ENABLE_ACK_COALESCING
+    if (_held)
+	return true;
+#endif
+    return waitDriverTimeout(timeout);
+}
+
 ////////////////////////////////////////////////////////////////////
 bool RHReliableDatagram::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
 {
+    ScopedLock lock(*this);
     // Assemble the message
     uint8_t thisSequenceNumber = ++_lastSequenceNumber;
     uint8_t retries = 0;
+    uint8_t piggyback = RH_FLAGS_NONE;
+#if RH_ENABLE_ACK_COALESCING
+    // Piggyback any ACKs we owe the destination on this message if there is room, else send them first
+    PendingAck* pending = pendingAcksFor(address);
+    if (pending)
+    {
+	if (address != RH_BROADCAST_ADDRESS
+	    && (uint16_t)len + pending->count + 1 <= _driver.maxMessageLength())
+	{
+	    memcpy(_txBuf, buf, len);
+	    memcpy(_txBuf + len, pending->ids, pending->count);
+	    len += pending->count;
+	    _txBuf[len++] = pending->count;
+	    buf = _txBuf;
+	    piggyback = RH_FLAGS_PIGGYBACK_ACK;
+	}
+	else
+	    acknowledge(pending->ids, pending->count, pending->from);
+	pending->count = 0;
+    }
+#endif
+    sendPendingAcks(false);
     while (retries++ <= _retries)
     {
-	setHeaderId(thisSequenceNumber);
-
         // Set and clear header flags depending on if this is an
         // initial send or a retry.
-        uint8_t headerFlagsToSet = RH_FLAGS_NONE;
+        uint8_t headerFlagsToSet = piggyback;
         // Always clear the ACK flag
-        uint8_t headerFlagsToClear = RH_FLAGS_ACK;
+        uint8_t headerFlagsToClear = RH_FLAGS_ACK | RH_FLAGS_PIGGYBACK_ACK | RH_FLAGS_MULTICAST;
         if (retries == 1) {
             // On an initial send, clear the RETRY flag in case
             // it was previously set
             headerFlagsToClear |= RH_FLAGS_RETRY;
         } else {
             // Not an initial send, set the RETRY flag
-            headerFlagsToSet = RH_FLAGS_RETRY;
+            headerFlagsToSet |= RH_FLAGS_RETRY;
         }
-        setHeaderFlags(headerFlagsToSet, headerFlagsToClear);
-
-	sendto(buf, len, address);
+	sendto(buf, len, address, thisSequenceNumber, headerFlagsToSet, headerFlagsToClear);
 	waitPacketSent();
 
 	// Never wait for ACKS to broadcasts:
@@ -80,18 +150,46 @@ bool RHReliableDatagram::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
 	    _retransmissions++;
 	unsigned long thisSendTime = millis(); // Timeout does not include original transmit time
 
-	// Compute a new timeout, random between _timeout and _timeout*2
-	// This is to prevent collisions on every retransmit
-	// if 2 nodes try to transmit at the same time
-#if (RH_PLATFORM == RH_PLATFORM_RASPI) // use standard library random(), bugs in random(min, max)
-	uint16_t timeout = _timeout + (_timeout * (random() & 0xFF) / 256);
-#else
-	uint16_t timeout = _timeout + (_timeout * random(0, 256) / 256);
-#endif
+	uint16_t timeout = randomTimeout();
 	int32_t timeLeft;
         while ((timeLeft = timeout - (millis() - thisSendTime)) > 0)
 	{
-	    if (waitAvailableTimeout(timeLeft))
+#if RH_ENABLE_ACK_COALESCING
+	    if (waitDriverTimeout(timeLeft))
+	    {
+		uint8_t from, to, id, flags;
+		// Read the whole message unless we are already holding one, in which case only an ACK
+		// can be recognised, and any reply with a piggybacked ACK will be retransmitted to us later
+		uint8_t ackBuf[RH_ACK_COALESCE_MAX + 1];
+		uint8_t* rxBuf = _held ? ackBuf : _rxBuf;
+		uint8_t rxLen = _held ? sizeof(ackBuf) : sizeof(_rxBuf);
+		if (recvfrom(rxBuf, &rxLen, &from, &to, &id, &flags))
+		{
+		    bool acked = false;
+		    if (from == address && to == _thisAddress && (flags & RH_FLAGS_ACK))
+		    {
+			// A cumulative ACK lists further IDs after the '!'
+			acked = (id == thisSequenceNumber) 
+			    || (rxLen > 1 && memchr(rxBuf + 1, thisSequenceNumber, rxLen - 1));
+		    }
+		    else if (from == address && to == _thisAddress && !_held && (flags & RH_FLAGS_PIGGYBACK_ACK))
+		    {
+			uint8_t msgLen = stripAckTrailer(rxBuf, rxLen, thisSequenceNumber, &acked);
+			if (acked)
+			{
+			    // Its a reply that carries our ACK: keep it for recvfromAck()
+			    _held = true;
+			    _heldLen = msgLen;
+			    _heldFrom = from;
+			    _heldTo = to;
+			    _heldId = id;
+			    _heldFlags = flags & ~RH_FLAGS_PIGGYBACK_ACK;
+			}
+		    }
+		    if (acked)
+			return true;
+#else
+	    if (waitDriverTimeout(timeLeft))
 	    {
 		uint8_t from, to, id, flags;
 		if (recvfrom(0, 0, &from, &to, &id, &flags)) // Discards the message
@@ -105,8 +203,9 @@ bool RHReliableDatagram::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
 			// Its the ACK we are waiting for
 			return true;
 		    }
+#endif
 		    else if (   !(flags & RH_FLAGS_ACK)
-				&& (id == _seenIds[from]))
+				&& haveSeen(from, id, flags))
 		    {
 			// This is a request we have already received. ACK it again
 			acknowledge(id, from);
@@ -124,15 +223,86 @@ bool RHReliableDatagram::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
     return false;
 }
 
+////////////////////////////////////////////////////////////////////
+void RHReliableDatagram::setMulticastAckSpread(uint16_t spread)
+{
+    _multicastAckSpread = spread;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHReliableDatagram::sendtoGroupWait(uint8_t* buf, uint8_t len, const uint8_t* members, uint8_t count, uint32_t* acked)
+{
+    ScopedLock lock(*this);
+    if (count == 0 || count > RH_MULTICAST_MAX_MEMBERS)
+	return false;
+    uint32_t everyone = (count == 32) ? 0xffffffff : (((uint32_t)1 << count) - 1);
+    uint32_t ackedBy = 0;
+    sendPendingAcks(false);
+
+    uint8_t thisSequenceNumber = ++_lastSequenceNumber;
+    uint8_t retries = 0;
+    while (ackedBy != everyone && retries++ <= _retries)
+    {
+	sendto(buf, len, RH_BROADCAST_ADDRESS, thisSequenceNumber,
+	       RH_FLAGS_MULTICAST | (retries > 1 ? RH_FLAGS_RETRY : RH_FLAGS_NONE),
+	       RH_FLAGS_ACK | RH_FLAGS_RETRY | RH_FLAGS_PIGGYBACK_ACK);
+	waitPacketSent();
+
+	if (retries > 1)
+	    _retransmissions++;
+	unsigned long thisSendTime = millis(); // Timeout does not include original transmit time
+
+	// The group members spread their ACKs over the multicast ACK spread
+	uint16_t timeout = _multicastAckSpread + randomTimeout();
+	int32_t timeLeft;
+	while (ackedBy != everyone && (timeLeft = timeout - (millis() - thisSendTime)) > 0)
+	{
+	    if (waitDriverTimeout(timeLeft))
+	    {
+		uint8_t from, to, id, flags;
+		if (recvfrom(0, 0, &from, &to, &id, &flags)) // Discards the message
+		{
+		    if (   to == _thisAddress 
+			&& (flags & RH_FLAGS_ACK) 
+			&& (id == thisSequenceNumber))
+		    {
+			// An ACK for this message: which member is it from?
+			uint8_t i;
+			for (i = 0; i < count; i++)
+			    if (members[i] == from)
+				ackedBy |= (uint32_t)1 << i;
+		    }
+		    else if (   !(flags & RH_FLAGS_ACK)
+				&& haveSeen(from, id, flags))
+		    {
+			// This is a request we have already received. ACK it again
+			acknowledge(id, from);
+		    }
+		    // Else discard it
+		}
+	    }
+	    YIELD;
+	}
+	// Timeout exhausted, maybe retry
+	YIELD;
+    }
+    if (acked)
+	*acked = ackedBy;
+    return ackedBy == everyone;
+}
+
 ////////////////////////////////////////////////////////////////////
 bool RHReliableDatagram::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
 {  
+    ScopedLock lock(*this);
     uint8_t _from;
     uint8_t _to;
     uint8_t _id;
     uint8_t _flags;
+    // A message that is not returned must not shorten the space for the next one
+    uint8_t maxLen = len ? *len : 0;
     // Get the message before its clobbered by the ACK (shared rx and tx buffer in some drivers
-    if (available() && recvfrom(buf, len, &_from, &_to, &_id, &_flags))
+    if (nextMessage(buf, len, &_from, &_to, &_id, &_flags))
     {
 	// Never ACK an ACK
 	if (!(_flags & RH_FLAGS_ACK))
@@ -143,30 +313,79 @@ bool RHReliableDatagram::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* from,
 	        // Its for this node and
 		// Its not a broadcast, so ACK it
 		// Acknowledge message with ACK set in flags and ID set to received ID
+#if RH_ENABLE_ACK_COALESCING
+		// If delaying ACKs, a duplicate means the sender has already timed out, so ACK it now
+		if (_ackDelay)
+		    queueAck(_id, _from, haveSeen(_from, _id, _flags));
+		else
+#endif
 		acknowledge(_id, _from);
 	    }
+	    else if (_to == RH_BROADCAST_ADDRESS && (_flags & RH_FLAGS_MULTICAST))
+	    {
+		// A reliable multicast: stagger our ACK so the members of the group 
+		// do not all answer at the same time
+		queueMulticastAck(_id, _from);
+	    }
             // Filter out retried messages that we have seen before. This explicitly
             // only filters out messages that are marked as retries to protect against
             // the scenario where a transmitting device sends just one message and
             // shuts down between transmissions. Devices that do this will report the
             // the same ID each time since their internal sequence number will reset
             // to zero each time the device starts up.
-	    if ((RH_ENABLE_EXPLICIT_RETRY_DEDUP && !(_flags & RH_FLAGS_RETRY)) || _id != _seenIds[_from])
+	    if ((RH_ENABLE_EXPLICIT_RETRY_DEDUP && !(_flags & RH_FLAGS_RETRY)) || !haveSeen(_from, _id, _flags))
 	    {
 		if (from)  *from =  _from;
 		if (to)    *to =    _to;
 		if (id)    *id =    _id;
 		if (flags) *flags = _flags;
-		_seenIds[_from] = _id;
+		setSeen(_from, _id, _flags);
 		return true;
 	    }
 	    // Else just re-ack it and wait for a new one
 	}
     }
     // No message for us available
+    if (len)
+	*len = maxLen;
     return false;
 }
 
+bool RHReliableDatagram::nextMessage(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{
+    sendPendingAcks(false);
+#if RH_ENABLE_ACK_COALESCING
+    if (!_held)
+    {
+	// Read the whole message so we can find any piggyback trailer, which may ACK something
+	// we sent earlier, but which we are no longer waiting for
+	_heldLen = sizeof(_rxBuf);
+	if (!(RHDatagram::available() && recvfrom(_rxBuf, &_heldLen, &_heldFrom, &_heldTo, &_heldId, &_heldFlags)))
+	    return false;
+	if (_heldFlags & RH_FLAGS_PIGGYBACK_ACK)
+	{
+	    bool acked;
+	    _heldLen = stripAckTrailer(_rxBuf, _heldLen, 0, &acked);
+	    _heldFlags &= ~RH_FLAGS_PIGGYBACK_ACK;
+	}
+    }
+    _held = false;
+    if (buf && len)
+    {
+	if (*len > _heldLen)
+	    *len = _heldLen;
+	memcpy(buf, _rxBuf, *len);
+    }
+    *from = _heldFrom;
+    *to = _heldTo;
+    *id = _heldId;
+    *flags = _heldFlags;
+    return true;
+#else
+    return RHDatagram::available() && recvfrom(buf, len, from, to, id, flags);
+#endif
+}
+
 bool RHReliableDatagram::recvfromAckTimeout(uint8_t* buf, uint8_t* len, uint16_t timeout, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
 {
     unsigned long starttime = millis();
@@ -193,17 +412,243 @@ void RHReliableDatagram::resetRetransmissions()
     _retransmissions = 0;
 }
  
+void RHReliableDatagram::forgetPeer(uint8_t from)
+{
+    ScopedLock lock(*this);
+    if (from == RH_BROADCAST_ADDRESS)
+    {
+	_numSeenPeers = 0;
+	return;
+    }
+    uint8_t i;
+    for (i = 0; i < _numSeenPeers; i++)
+    {
+	if (_seenPeers[i].from == from)
+	{
+	    memmove(&_seenPeers[i], &_seenPeers[i + 1], sizeof(SeenPeer) * (_numSeenPeers - i - 1));
+	    _numSeenPeers--;
+	    return;
+	}
+    }
+}
+
 void RHReliableDatagram::acknowledge(uint8_t id, uint8_t from)
 {
-    setHeaderId(id);
-    setHeaderFlags(RH_FLAGS_ACK);
     // We would prefer to send a zero length ACK,
     // but if an RH_RF22 receives a 0 length message with a CRC error, it will never receive
     // a 0 length message again, until its reset, which makes everything hang :-(
     // So we send an ACK of 1 octet
     // REVISIT: should we send the RSSI for the information of the sender?
     uint8_t ack = '!';
-    sendto(&ack, sizeof(ack), from); 
+    sendto(&ack, sizeof(ack), from, id,
+	   RH_FLAGS_ACK, RH_FLAGS_APPLICATION_SPECIFIC | RH_FLAGS_PIGGYBACK_ACK | RH_FLAGS_MULTICAST);
+    waitPacketSent();
+}
+
+uint16_t RHReliableDatagram::randomTimeout()
+{
+    // Compute a new timeout, random between _timeout and _timeout*2
+    // This is to prevent collisions on every retransmit
+    // if 2 nodes try to transmit at the same time
+#if (RH_PLATFORM == RH_PLATFORM_RASPI) // use standard library random(), bugs in random(min, max)
+    return _timeout + (_timeout * (random() & 0xFF) / 256);
+#else
+    return _timeout + (_timeout * random(0, 256) / 256);
+#endif
+}
+
+bool RHReliableDatagram::waitDriverTimeout(uint16_t timeout)
+{
+    // Wait in slices that end when pending ACKs fall due, so they go out on time
+    unsigned long starttime = millis();
+    int32_t timeLeft;
+    while ((timeLeft = timeout - (millis() - starttime)) > 0)
+    {
+	uint16_t slice = timeLeft;
+#if RH_ENABLE_ACK_COALESCING
+	if (_ackDelay && slice > _ackDelay)
+	    slice = _ackDelay;
+#endif
+	if (_multicastAckPending)
+	{
+	    int32_t untilDue = _multicastAckDue - millis();
+	    if (untilDue < 1)
+		untilDue = 1;
+	    if (slice > untilDue)
+		slice = untilDue;
+	}
+	if (RHDatagram::waitAvailableTimeout(slice))
+	    return true;
+	sendPendingAcks(false);
+    }
+    return false;
+}
+
+void RHReliableDatagram::queueMulticastAck(uint8_t id, uint8_t from)
+{
+    // Only one can be pending: send any earlier one now
+    if (_multicastAckPending)
+	acknowledge(_multicastAckId, _multicastAckFrom);
+#if (RH_PLATFORM == RH_PLATFORM_RASPI) // use standard library random(), bugs in random(min, max)
+    _multicastAckDue = millis() + (uint32_t)_multicastAckSpread * (random() & 0xFF) / 256;
+#else
+    _multicastAckDue = millis() + (uint32_t)_multicastAckSpread * random(0, 256) / 256;
+#endif
+    _multicastAckId = id;
+    _multicastAckFrom = from;
+    _multicastAckPending = true;
+}
+
+void RHReliableDatagram::sendPendingAcks(bool all)
+{
+    ScopedLock lock(*this);
+    if (_multicastAckPending && (all || (long)(millis() - _multicastAckDue) >= 0))
+    {
+	_multicastAckPending = false;
+	acknowledge(_multicastAckId, _multicastAckFrom);
+    }
+#if RH_ENABLE_ACK_COALESCING
+    uint8_t i;
+    for (i = 0; i < RH_ACK_PENDING_PEERS; i++)
+    {
+	PendingAck* pending = &_pendingAcks[i];
+	if (pending->count && (all || (millis() - pending->since) >= _ackDelay))
+	{
+	    acknowledge(pending->ids, pending->count, pending->from);
+	    pending->count = 0;
+	}
+    }
+#endif
+}
+
+
+bool RHReliableDatagram::haveSeen(uint8_t from, uint8_t id, uint8_t flags)
+{
+    uint8_t i;
+    for (i = 0; i < _numSeenPeers; i++)
+    {
+	if (_seenPeers[i].from == from)
+	{
+	    uint8_t age = _seenPeers[i].lastId - id;
+	    // A first transmission behind the newest ID is from a peer that has restarted
+	    if (age != 0 && !(flags & RH_FLAGS_RETRY))
+		return false;
+	    return (age < RH_DEDUP_WINDOW) && (_seenPeers[i].seen & ((RHDedupWindow)1 << age));
+	}
+    }
+    return false;
+}
+
+void RHReliableDatagram::setSeen(uint8_t from, uint8_t id, uint8_t flags)
+{
+    // Find the peer, else make room for it by forgetting the least recently heard
+    uint8_t i;
+    for (i = 0; i < _numSeenPeers; i++)
+	if (_seenPeers[i].from == from)
+	    break;
+    SeenPeer peer;
+    if (i < _numSeenPeers)
+	peer = _seenPeers[i];
+    else
+    {
+	if (_numSeenPeers < RH_DEDUP_PEERS)
+	    _numSeenPeers++;
+	i = _numSeenPeers - 1;
+	peer.from = from;
+	peer.lastId = id;
+	peer.seen = 0;
+    }
+    // Move it to the front of the table
+    memmove(&_seenPeers[1], &_seenPeers[0], sizeof(SeenPeer) * i);
+
+    uint8_t ahead = id - peer.lastId;
+    uint8_t age = peer.lastId - id;
+    if (ahead < 128)
+    {
+	// Newer than anything seen so far (or the same): slide the window forward
+	peer.seen = (ahead < RH_DEDUP_WINDOW) ? (RHDedupWindow)(peer.seen << ahead) : 0;
+	peer.seen |= 1;
+	peer.lastId = id;
+    }
+    else if (age < RH_DEDUP_WINDOW && (flags & RH_FLAGS_RETRY))
+    {
+	// Late retransmission within the window
+	peer.seen |= (RHDedupWindow)1 << age;
+    }
+    else
+    {
+	// A first transmission behind the newest ID, or much older than the window: 
+	// the peer has restarted its sequence numbers
+	peer.seen = 1;
+	peer.lastId = id;
+    }
+    _seenPeers[0] = peer;
+}
+
+#if RH_ENABLE_ACK_COALESCING
+void RHReliableDatagram::acknowledge(const uint8_t* ids, uint8_t count, uint8_t from)
+{
+    // The first ID goes in the header, as for a single ACK, any others follow the '!'
+    uint8_t ack[RH_ACK_COALESCE_MAX];
+    ack[0] = '!';
+    memcpy(ack + 1, ids + 1, count - 1);
+    sendto(ack, count, from, ids[0],
+	   RH_FLAGS_ACK, RH_FLAGS_APPLICATION_SPECIFIC | RH_FLAGS_PIGGYBACK_ACK | RH_FLAGS_MULTICAST);
     waitPacketSent();
 }
 
+void RHReliableDatagram::queueAck(uint8_t id, uint8_t from, bool now)
+{
+    PendingAck* pending = pendingAcksFor(from);
+    if (!pending)
+    {
+	// Find a free entry, else send the longest delayed ACKs to make room
+	uint8_t i;
+	pending = &_pendingAcks[0];
+	for (i = 0; i < RH_ACK_PENDING_PEERS; i++)
+	{
+	    if (!_pendingAcks[i].count)
+	    {
+		pending = &_pendingAcks[i];
+		break;
+	    }
+	    if ((long)(_pendingAcks[i].since - pending->since) < 0)
+		pending = &_pendingAcks[i];
+	}
+	if (pending->count)
+	    acknowledge(pending->ids, pending->count, pending->from);
+	pending->from = from;
+	pending->count = 0;
+	pending->since = millis();
+    }
+    if (!memchr(pending->ids, id, pending->count))
+	pending->ids[pending->count++] = id;
+    if (now || pending->count == RH_ACK_COALESCE_MAX)
+    {
+	acknowledge(pending->ids, pending->count, pending->from);
+	pending->count = 0;
+    }
+}
+
+RHReliableDatagram::PendingAck* RHReliableDatagram::pendingAcksFor(uint8_t from)
+{
+    uint8_t i;
+    for (i = 0; i < RH_ACK_PENDING_PEERS; i++)
+	if (_pendingAcks[i].count && _pendingAcks[i].from == from)
+	    return &_pendingAcks[i];
+    return NULL;
+}
+
+uint8_t RHReliableDatagram::stripAckTrailer(const uint8_t* buf, uint8_t len, uint8_t id, bool* acked)
+{
+    *acked = false;
+    if (len < 1)
+	return len;
+    uint8_t count = buf[len - 1];
+    if (count < 1 || count > RH_ACK_COALESCE_MAX || count >= len)
+	return len; // Malformed, leave it alone
+    len -= count + 1;
+    *acked = memchr(buf + len, id, count) != NULL;
+    return len;
+}
+#endif
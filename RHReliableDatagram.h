@@ -15,6 +15,13 @@
 /// The retry bit in the header FLAGS. This indicates that the payload is a retry for a
 /// previously sent message.
 #define RH_FLAGS_RETRY 0x40
+/// The piggyback ACK bit in the header FLAGS. This indicates that the payload is followed by a trailer
+/// acknowledging one or more messages previously received from the destination
+/// (see RH_ENABLE_ACK_COALESCING).
+#define RH_FLAGS_PIGGYBACK_ACK 0x20
+/// The multicast bit in the header FLAGS. This indicates that the payload is a broadcast sent
+/// by sendtoGroupWait(), and that receivers should acknowledge it.
+#define RH_FLAGS_MULTICAST 0x10
 
 /// This macro enables enhanced message deduplication behavior. This currently defaults
 /// to 0 (off), but this may change to default to 1 (on) in future releases. Consumers who
@@ -29,12 +36,51 @@
 /// do not support the RETRY header. If you do, deduping of messages will be broken.
 #define RH_ENABLE_EXPLICIT_RETRY_DEDUP 0
 
+/// The number of peers for which duplicate detection state is kept. When a message arrives from a
+/// peer not in the table and the table is full, the least recently heard peer is forgotten.
+/// Each entry costs 2 octets plus RH_DEDUP_WINDOW / 8 octets of RAM, rounded up to the alignment of the
+/// window on 32 bit processors: with the default window of 32, 6 octets on AVR and 8 octets on ARM, ESP32 etc.
+/// You can override this in your code before including
+/// RHReliableDatagram.h
+#ifndef RH_DEDUP_PEERS
+#define RH_DEDUP_PEERS 8
+#endif
+
+/// The number of recent message IDs remembered per peer for duplicate detection.
+/// Must be one of 8, 16 or 32. You can override this in your code before including
+/// RHReliableDatagram.h
+#ifndef RH_DEDUP_WINDOW
+#define RH_DEDUP_WINDOW 32
+#endif
+
+/// This macro enables delayed, cumulative and piggybacked acknowledgements (see setAckDelay()).
+/// It defaults to 0 (off), since it costs about 2 * RH_MAX_MESSAGE_LEN octets of RAM for transmit and receive
+/// buffers. Override it in your code and set it to 1 to enable it. All the nodes in a network that uses 
+/// setAckDelay() must be built with it enabled.
+#ifndef RH_ENABLE_ACK_COALESCING
+#define RH_ENABLE_ACK_COALESCING 0
+#endif
+
+/// The maximum number of message IDs that can be acknowledged by a single ACK or piggyback trailer
+#define RH_ACK_COALESCE_MAX 4
+
+/// The number of peers for which delayed acknowledgements can be pending at the same time.
+/// If an ACK has to be delayed for another peer, the oldest pending ACK is sent first.
+#define RH_ACK_PENDING_PEERS 2
+
 /// the default retry timeout in milliseconds
 #define RH_DEFAULT_TIMEOUT 200
 
 /// The default number of retries
 #define RH_DEFAULT_RETRIES 3
 
+/// The default time in milliseconds over which the members of a group spread their 
+/// acknowledgements to a message from sendtoGroupWait()
+#define RH_DEFAULT_MULTICAST_ACK_SPREAD 100
+
+/// The maximum number of members in a group for sendtoGroupWait()
+#define RH_MULTICAST_MAX_MEMBERS 32
+
 /////////////////////////////////////////////////////////////////////
 /// \class RHReliableDatagram RHReliableDatagram.h <RHReliableDatagram.h>
 /// \brief RHDatagram subclass for sending addressed, acknowledged, retransmitted datagrams.
@@ -50,6 +96,16 @@
 ///
 /// You can use RHReliableDatagram to send broadcast messages, with a TO address of RH_BROADCAST_ADDRESS,
 /// however broadcasts are not acknowledged or retransmitted and are therefore NOT actually reliable.
+/// If you need to reliably deliver the same message to a group of nodes, use sendtoGroupWait(), 
+/// which broadcasts the message with the RH_FLAGS_MULTICAST flag set. Every RHReliableDatagram that receives 
+/// it with recvfromAck() acknowledges it after a random delay of up to the multicast ACK spread 
+/// (see setMulticastAckSpread()), so that the members of the group do not all answer at once.
+/// recvfromAck() does not wait for the delay: it returns the message straight away, and the ACK is sent
+/// when it falls due by the next call to available(), waitAvailable(), waitAvailableTimeout(), recvfromAck(), 
+/// recvfromAckTimeout(), sendtoWait() or sendtoGroupWait(), or explicitly by flushAcks(). So a member must keep 
+/// polling the manager for at least the ACK spread after receiving a multicast message.
+/// The sender keeps track of which members of the group have acknowledged, and retransmits the broadcast
+/// only while some are still missing. The multicast ACK spread must be the same on all nodes.
 ///
 /// The retransmit timeout is randomly varied between timeout and timeout*2 to prevent collisions on all
 /// retries when 2 nodes happen to start sending at the same time .
@@ -84,6 +140,43 @@
 /// retransmit strategy and configuration lest they hang for a long time
 /// trying to reply to clients that are unreachable.
 ///
+/// \par Delayed and Piggybacked Acknowledgements
+///
+/// If RH_ENABLE_ACK_COALESCING is set to 1, and setAckDelay() has been called with a non-zero delay,
+/// recvfromAck() does not send an ACK straight away. The ID is queued for up to the ACK delay, so that:
+/// - several messages received from the same sender within the delay are confirmed by a single ACK, 
+///   which carries the ID of the first message in the ID header and the IDs of the others after the '!' in its payload.
+/// - if the application replies to the sender with sendtoWait() within the delay, the pending IDs are 
+///   piggybacked on the reply instead of being sent as a separate ACK. The reply has the RH_FLAGS_PIGGYBACK_ACK flag
+///   set and its payload is followed by the acknowledged IDs and a count octet, which are removed by the receiver.
+///   A sendtoWait() that receives such a reply while waiting for its ACK treats it as the ACK, and holds
+///   the reply for the next call to recvfromAck().
+///
+/// Request/response traffic therefore needs no separate ACK frame for the request.
+/// Pending ACKs are sent when they fall due by available(), waitAvailable(), waitAvailableTimeout(), 
+/// recvfromAck(), recvfromAckTimeout() and sendtoWait(), or explicitly by flushAcks(). The ACK delay
+/// must be well below the sender's retransmit timeout (see setTimeout()), less the airtime of the ACK.
+/// simulator_ack_coalescing counts the frames sent by request/response traffic with and without an ACK delay.
+///
+/// \par Duplicate Detection
+///
+/// Each received message is checked against a window of the last RH_DEDUP_WINDOW
+/// message IDs received from its sender, so that a retransmission is discarded (but re-acknowledged)
+/// even if other messages from the same sender arrived in between, and a new message is never 
+/// mistaken for a duplicate just because its ID equals that of the last message from that sender.
+/// The window is kept for up to RH_DEDUP_PEERS recently heard peers.
+/// sendtoWait() sends each message with a new ID, and sets RH_FLAGS_RETRY when it retransmits it, so
+/// a message without RH_FLAGS_RETRY whose ID is behind the newest seen from that peer 
+/// is taken to come from a peer that has restarted its sequence numbers: it is accepted, and the
+/// peer's window starts afresh from it. So is a message with an ID more than RH_DEDUP_WINDOW older than the newest.
+/// A retransmission is only dropped if its ID is in the window, and a first transmission only if its ID is
+/// the newest seen (which is how retransmissions from older versions of this library, which do not set
+/// RH_FLAGS_RETRY, are recognised).
+/// A peer that restarts and happens to start again at exactly the newest ID seen before has that first message dropped 
+/// as a duplicate (although acknowledged). If your application can tell that a peer has restarted, 
+/// (for example from a hello message it sends at startup), call forgetPeer() for it. 
+/// Alternatively set RH_ENABLE_EXPLICIT_RETRY_DEDUP, so that only retransmissions are checked for duplicates.
+///
 /// Caution: if you have a radio network with a mixture of slow and fast
 /// processors and ReliableDatagrams, you may be affected by race conditions
 /// where the fast processor acknowledges a message before the sender is ready
@@ -134,6 +227,28 @@ public:
     /// \return true if the message was transmitted and an acknowledgement was received.
     bool sendtoWait(uint8_t* buf, uint8_t len, uint8_t address);
 
+    /// Sends the message as a broadcast to a group of nodes (with retries) and waits for each of them to
+    /// acknowledge it. Retransmits the message while any member of the group has not acknowledged it, 
+    /// until the retries are exhausted. Waits up to the multicast ACK spread plus the retransmit timeout 
+    /// after each transmission.
+    /// Synchronous: any message other than an ACK from the group received while waiting is discarded.
+    /// \param[in] buf Pointer to the binary message to send
+    /// \param[in] len Number of octets to send
+    /// \param[in] members Array of the addresses of the group members
+    /// \param[in] count Number of members in the group (up to RH_MULTICAST_MAX_MEMBERS)
+    /// \param[out] acked If not NULL, set to a bitmask of the members that acknowledged the message,
+    /// bit n being set if members[n] acknowledged
+    /// \return true if the message was acknowledged by every member of the group. false if it was not, 
+    /// or if count is 0 or more than RH_MULTICAST_MAX_MEMBERS, in which case nothing is sent
+    bool sendtoGroupWait(uint8_t* buf, uint8_t len, const uint8_t* members, uint8_t count, uint32_t* acked = NULL);
+
+    /// Sets the time over which receivers spread their acknowledgements of messages sent by 
+    /// sendtoGroupWait(). Each receiver waits a random time up to this before acknowledging. 
+    /// It should be long enough for all the members of the group to send their ACKs, and must be 
+    /// the same on all nodes. Defaults to RH_DEFAULT_MULTICAST_ACK_SPREAD.
+    /// \param[in] spread The ACK spread in milliseconds
+    void setMulticastAckSpread(uint16_t spread);
+
     /// If there is a valid message available for this node, send an acknowledgement to the SRC
     /// address (blocking until this is complete), then copy the message to buf and return true
     /// else return false. 
@@ -172,6 +287,32 @@ public:
     /// \return true if a valid message was copied to buf
     bool recvfromAckTimeout(uint8_t* buf, uint8_t* len,  uint16_t timeout, uint8_t* from = NULL, uint8_t* to = NULL, uint8_t* id = NULL, uint8_t* flags = NULL);
 
+#if RH_ENABLE_ACK_COALESCING
+    /// Sets the maximum time an acknowledgement may be delayed so that it can be combined with other
+    /// acknowledgements or piggybacked on a reply. See \ref RHReliableDatagram "Delayed and Piggybacked Acknowledgements".
+    /// Defaults to 0, which means acknowledge each message as soon as it is received.
+    /// \param[in] ackDelay The maximum ACK delay in milliseconds.
+    void setAckDelay(uint16_t ackDelay);
+#endif
+
+    /// Sends any pending delayed acknowledgements now, regardless of the ACK delay or multicast ACK spread.
+    /// Call this before putting the node or radio to sleep.
+    void flushAcks();
+
+    /// Tests whether a new message is available, either a reply held by sendtoWait() or from the driver.
+    /// Also sends any delayed or multicast acknowledgements that have fallen due.
+    /// \return true if a new message is available to be collected by recvfromAck().
+    bool available();
+
+    /// Blocks until a new message is available, sending delayed or multicast acknowledgements as they fall due.
+    void waitAvailable();
+
+    /// Blocks until a new message is available or a timeout, sending delayed or multicast acknowledgements 
+    /// as they fall due.
+    /// \param[in] timeout Maximum time to wait in milliseconds.
+    /// \return true if a message is available
+    bool waitAvailableTimeout(uint16_t timeout);
+
     /// Returns the number of retransmissions 
     /// we have had to send since starting or since the last call to resetRetransmissions().
     /// \return The number of retransmissions since initialisation.
@@ -181,11 +322,121 @@ public:
     /// to 0. 
     void resetRetransmissions(); 
 
+    /// Forgets the duplicate detection state for a peer, so that the next message from it is accepted
+    /// whatever its ID. Call this when you know the peer has restarted, so that its new messages 
+    /// are not mistaken for duplicates of those it sent before restarting. 
+    /// See \ref RHReliableDatagram "Duplicate Detection".
+    /// \param[in] from The node address of the peer, or RH_BROADCAST_ADDRESS to forget all peers
+    void forgetPeer(uint8_t from);
+
 protected:
     /// Send an ACK for the message id to the given from address
     /// Blocks until the ACK has been sent
     void acknowledge(uint8_t id, uint8_t from);
 
+    /// Gets the next message for this node, if one is available
+    /// \param[in] buf Location to copy the received message
+    /// \param[in,out] len Available space in buf. Set to the actual number of octets copied.
+    /// \param[out] from The FROM header of the message
+    /// \param[out] to The TO header of the message
+    /// \param[out] id The ID header of the message
+    /// \param[out] flags The FLAGS header of the message
+    /// \return true if a message was copied to buf
+    bool nextMessage(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags);
+
+    /// Waits for a message from the driver for up to timeout milliseconds, 
+    /// sending any delayed acknowledgements as they fall due.
+    /// \param[in] timeout Maximum time to wait in milliseconds.
+    /// \return true if a message is available from the driver
+    bool waitDriverTimeout(uint16_t timeout);
+
+    /// Returns a random retransmit timeout between the configured timeout and twice that.
+    /// \return The timeout in milliseconds
+    uint16_t randomTimeout();
+
+    /// Schedules the acknowledgement of a multicast message for a random time within the multicast ACK spread.
+    /// Only one can be pending: any earlier one is sent straight away.
+    /// \param[in] id The ID of the message to acknowledge
+    /// \param[in] from The address of the node that sent the message
+    void queueMulticastAck(uint8_t id, uint8_t from);
+
+    /// Sends the pending multicast ACK and delayed ACKs that have fallen due, or all of them
+    /// \param[in] all If true, send all pending ACKs, regardless of when they fall due
+    void sendPendingAcks(bool all);
+
+#if RH_ENABLE_ACK_COALESCING
+    /// \brief Acknowledgements waiting to be sent to a peer
+    typedef struct
+    {
+	uint8_t        from;                     ///< Node address of the peer to acknowledge
+	uint8_t        count;                    ///< Number of valid IDs. 0 if the entry is free
+	uint8_t        ids[RH_ACK_COALESCE_MAX]; ///< IDs of the messages to acknowledge
+	unsigned long  since;                    ///< millis() when the first ID was queued
+    } PendingAck;
+
+    /// Send a single ACK for several messages from the given address
+    /// Blocks until the ACK has been sent
+    /// \param[in] ids The IDs of the messages to acknowledge
+    /// \param[in] count The number of IDs (1 to RH_ACK_COALESCE_MAX)
+    /// \param[in] from The address of the node that sent the messages
+    void acknowledge(const uint8_t* ids, uint8_t count, uint8_t from);
+
+    /// Queues an acknowledgement for a message, to be sent within the ACK delay.
+    /// \param[in] id The ID of the message to acknowledge
+    /// \param[in] from The address of the node that sent the message
+    /// \param[in] now If true, send all the ACKs pending for this peer straight away
+    void queueAck(uint8_t id, uint8_t from, bool now);
+
+    /// Returns the pending ACKs for a peer
+    /// \param[in] from The address of the peer
+    /// \return Pointer to the entry, or NULL if there are no pending ACKs for the peer
+    PendingAck* pendingAcksFor(uint8_t from);
+
+    /// Removes a piggybacked ACK trailer from the end of a message and checks whether it acknowledges
+    /// the given ID. 
+    /// \param[in] buf The received message
+    /// \param[in] len The length of the received message, including the trailer
+    /// \param[in] id The message ID we are waiting to be acknowledged
+    /// \param[out] acked Set to true if the trailer acknowledges id
+    /// \return The length of the message without the trailer
+    static uint8_t stripAckTrailer(const uint8_t* buf, uint8_t len, uint8_t id, bool* acked);
+#endif
+
+#if RH_DEDUP_WINDOW == 8
+    typedef uint8_t  RHDedupWindow;
+#elif RH_DEDUP_WINDOW == 16
+    typedef uint16_t RHDedupWindow;
+#elif RH_DEDUP_WINDOW == 32
+    typedef uint32_t RHDedupWindow;
+#else
+#error RH_DEDUP_WINDOW must be 8, 16 or 32
+#endif
+
+    /// \brief Duplicate detection state kept for each recently heard peer
+    typedef struct
+    {
+	uint8_t        from;   ///< Node address of the peer
+	uint8_t        lastId; ///< Newest message ID seen from this peer
+	RHDedupWindow  seen;   ///< Bit n set if message ID (lastId - n) has been seen
+    } SeenPeer;
+
+    /// Tests whether a message with the given ID from the given node has already been received.
+    /// Does not change the duplicate detection state.
+    /// \param[in] from The node address of the sender
+    /// \param[in] id The message ID
+    /// \param[in] flags The FLAGS header of the message. A message without RH_FLAGS_RETRY whose ID is
+    /// behind the newest seen from the sender is never a duplicate: the sender has restarted
+    /// \return true if the message has already been received (and recorded with setSeen())
+    bool haveSeen(uint8_t from, uint8_t id, uint8_t flags);
+
+    /// Records that a message with the given ID from the given node has been received, 
+    /// making the peer the most recently heard one.
+    /// \param[in] from The node address of the sender
+    /// \param[in] id The message ID
+    /// \param[in] flags The FLAGS header of the message. A message without RH_FLAGS_RETRY whose ID is
+    /// behind the newest seen from the sender starts its window afresh
+    void setSeen(uint8_t from, uint8_t id, uint8_t flags);
+
     /// Checks whether the message currently in the Rx buffer is a new message, not previously received
     /// based on the from address and the sequence.  If it is new, it is acknowledged and returns true
     /// \return true if there is a message received and it is a new message
@@ -207,15 +458,55 @@ private:
     /// Defaults to 3
     uint8_t _retries;
 
-    /// Array of the last seen sequence number indexed by node address that sent it
+    /// Time over which multicast ACKs are spread (milliseconds)
+    uint16_t _multicastAckSpread;
+
+    /// Duplicate detection windows of the most recently heard peers, most recent first.
     /// It is used for duplicate detection. Duplicated messages are re-acknowledged when received 
     /// (this is generally due to lost ACKs, causing the sender to retransmit, even though we have already
     /// received that message)
-    uint8_t _seenIds[256];
+    SeenPeer _seenPeers[RH_DEDUP_PEERS];
+
+    /// Number of valid entries in _seenPeers
+    uint8_t _numSeenPeers;
+
+    /// true if a multicast message is waiting to be acknowledged
+    bool _multicastAckPending;
+
+    /// ID and sender of the multicast message waiting to be acknowledged
+    uint8_t _multicastAckId, _multicastAckFrom;
+
+    /// millis() when the pending multicast ACK falls due
+    unsigned long _multicastAckDue;
+
+#if RH_ENABLE_ACK_COALESCING
+    /// Maximum time an ACK may be delayed, in milliseconds. 0 means do not delay
+    uint16_t _ackDelay;
+
+    /// ACKs waiting to be sent
+    PendingAck _pendingAcks[RH_ACK_PENDING_PEERS];
+
+    /// Received messages are read here in full so any piggyback trailer can be found. 
+    uint8_t _rxBuf[RH_MAX_MESSAGE_LEN];
+
+    /// true if _rxBuf holds a message for the next recvfromAck()
+    bool _held;
+
+    /// Length of the held message
+    uint8_t _heldLen;
+
+    /// Headers of the held message
+    uint8_t _heldFrom, _heldTo, _heldId, _heldFlags;
+
+    /// Messages with a piggyback trailer are assembled here
+    uint8_t _txBuf[RH_MAX_MESSAGE_LEN];
+#endif
 };
 
 /// @example rf22_reliable_datagram_client.pde
 /// @example rf22_reliable_datagram_server.pde
+/// @example simulator_ack_coalescing.pde
+/// @example simulator_reliable_multicast.pde
 
 #endif
 
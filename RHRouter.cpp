@@ -13,7 +13,9 @@
 
 #include <RHRouter.h>
 
+#if !RH_THREAD_SAFE_MANAGERS
 RHRouter::RoutedMessage RHRouter::_tmpMessage;
+#endif
 
 ////////////////////////////////////////////////////////////////////
 // Constructors
@@ -22,6 +24,9 @@ RHRouter::RHRouter(RHGenericDriver& driver, uint8_t thisAddress)
 {
     _max_hops = RH_DEFAULT_MAX_HOPS;
     _isa_router = true;
+    _compressHeaders = false;
+    _decompressHeaders = false;
+    _compressTypeOctet = false;
     clearRoutingTable();
 }
 
@@ -46,9 +51,22 @@ void RHRouter::setIsaRouter(bool isa_router)
 {
     _isa_router = isa_router;
 }
+////////////////////////////////////////////////////////////////////
+void RHRouter::setHeaderCompression(bool compress)
+{
+    _compressHeaders = compress;
+}
+
+////////////////////////////////////////////////////////////////////
+void RHRouter::setHeaderDecompression(bool decompress)
+{
+    _decompressHeaders = decompress;
+}
+
 ////////////////////////////////////////////////////////////////////
 void RHRouter::addRouteTo(uint8_t dest, uint8_t next_hop, uint8_t state)
 {
+    ScopedLock lock(*this);
     uint8_t i;
 
     // First look for an existing entry we can update
@@ -111,6 +129,7 @@ void RHRouter::deleteRoute(uint8_t index)
 ////////////////////////////////////////////////////////////////////
 void RHRouter::printRoutingTable()
 {
+    ScopedLock lock(*this);
 #ifdef RH_HAVE_SERIAL
     uint8_t i;
     for (i = 0; i < RH_ROUTING_TABLE_SIZE; i++)
@@ -129,6 +148,7 @@ void RHRouter::printRoutingTable()
 ////////////////////////////////////////////////////////////////////
 bool RHRouter::deleteRouteTo(uint8_t dest)
 {
+    ScopedLock lock(*this);
     uint8_t i;
     for (i = 0; i < RH_ROUTING_TABLE_SIZE; i++)
     {
@@ -144,6 +164,7 @@ bool RHRouter::deleteRouteTo(uint8_t dest)
 ////////////////////////////////////////////////////////////////////
 void RHRouter::retireOldestRoute()
 {
+    ScopedLock lock(*this);
     // We just obliterate the first in the table and clear the last
     deleteRoute(0);
 }
@@ -151,6 +172,7 @@ void RHRouter::retireOldestRoute()
 ////////////////////////////////////////////////////////////////////
 void RHRouter::clearRoutingTable()
 {
+    ScopedLock lock(*this);
     uint8_t i;
     for (i = 0; i < RH_ROUTING_TABLE_SIZE; i++)
 	_routes[i].state = Invalid;
@@ -166,6 +188,7 @@ uint8_t RHRouter::sendtoWait(uint8_t* buf, uint8_t len, uint8_t dest, uint8_t fl
 // Waits for delivery to the next hop (but not for delivery to the final destination)
 uint8_t RHRouter::sendtoFromSourceWait(uint8_t* buf, uint8_t len, uint8_t dest, uint8_t source, uint8_t flags)
 {
+    ScopedLock lock(*this);
     if (((uint16_t)len + sizeof(RoutedMessageHeader)) > _driver.maxMessageLength())
 	return RH_ROUTER_ERROR_INVALID_LENGTH;
 
@@ -193,12 +216,104 @@ uint8_t RHRouter::route(RoutedMessage* message, uint8_t messageLen)
 	next_hop = route->next_hop;
     }
 
-    if (!RHReliableDatagram::sendtoWait((uint8_t*)message, messageLen, next_hop))
+    // Compress the header in place, and put it back afterwards for subclasses that look at it
+    uint8_t header[sizeof(RoutedMessageHeader) + 1];
+    memcpy(header, message, sizeof(header));
+    // Without compression, RH_ROUTER_FLAGS_COMPRESSED belongs to the application, so is left alone
+    uint8_t offset = 0;
+    if (_compressHeaders)
+    {
+	offset = compressHeader(message, messageLen, next_hop);
+	setHeaderFlags(offset ? RH_ROUTER_FLAGS_COMPRESSED : RH_FLAGS_NONE, RH_ROUTER_FLAGS_COMPRESSED);
+    }
+    bool delivered = RHReliableDatagram::sendtoWait((uint8_t*)message + offset, messageLen - offset, next_hop);
+    if (_compressHeaders)
+	setHeaderFlags(RH_FLAGS_NONE, RH_ROUTER_FLAGS_COMPRESSED);
+    if (offset)
+	memcpy(message, header, sizeof(header));
+    if (!delivered)
 	return RH_ROUTER_ERROR_UNABLE_TO_DELIVER;
 
     return RH_ROUTER_ERROR_NONE;
 }
 
+////////////////////////////////////////////////////////////////////
+uint8_t RHRouter::compressHeader(RoutedMessage* message, uint8_t messageLen, uint8_t next_hop)
+{
+    uint8_t fullLen = sizeof(RoutedMessageHeader) + (_compressTypeOctet ? 1 : 0);
+    if (messageLen < fullLen || (_compressTypeOctet && message->data[0] > (RH_ROUTER_COMPRESS_TYPE >> RH_ROUTER_COMPRESS_TYPE_SHIFT)))
+	return 0;
+
+    uint8_t compressed[sizeof(RoutedMessageHeader) + 1];
+    uint8_t len = 1;
+    uint8_t control = 0;
+    if (message->header.dest == next_hop)
+	control |= RH_ROUTER_COMPRESS_DEST_ELIDED;
+    else
+	compressed[len++] = message->header.dest;
+    if (message->header.source == _thisAddress)
+	control |= RH_ROUTER_COMPRESS_SOURCE_ELIDED;
+    else
+	compressed[len++] = message->header.source;
+    if (_compressTypeOctet)
+	control |= message->data[0] << RH_ROUTER_COMPRESS_TYPE_SHIFT;
+    if (message->header.hops < (RH_ROUTER_COMPRESS_HOPS >> RH_ROUTER_COMPRESS_HOPS_SHIFT))
+	control |= message->header.hops << RH_ROUTER_COMPRESS_HOPS_SHIFT;
+    else
+    {
+	control |= RH_ROUTER_COMPRESS_HOPS;
+	compressed[len++] = message->header.hops;
+    }
+    compressed[len++] = message->header.id;
+    if (message->header.flags)
+    {
+	control |= RH_ROUTER_COMPRESS_FLAGS_INLINE;
+	compressed[len++] = message->header.flags;
+    }
+    compressed[0] = control;
+    if (len >= fullLen)
+	return 0; // No smaller
+
+    memcpy((uint8_t*)message + fullLen - len, compressed, len);
+    return fullLen - len;
+}
+
+////////////////////////////////////////////////////////////////////
+bool RHRouter::decompressHeader(RoutedMessage* message, uint8_t* messageLen, uint8_t from, uint8_t to)
+{
+    uint8_t* p = (uint8_t*)message;
+    if (*messageLen < 2)
+	return false;
+    uint8_t control = p[0];
+    if (!_compressTypeOctet && (control & RH_ROUTER_COMPRESS_TYPE))
+	return false;
+    uint8_t len = 2
+	+ !(control & RH_ROUTER_COMPRESS_DEST_ELIDED)
+	+ !(control & RH_ROUTER_COMPRESS_SOURCE_ELIDED)
+	+ ((control & RH_ROUTER_COMPRESS_HOPS) == RH_ROUTER_COMPRESS_HOPS)
+	+ (control & RH_ROUTER_COMPRESS_FLAGS_INLINE);
+    uint8_t fullLen = sizeof(RoutedMessageHeader) + (_compressTypeOctet ? 1 : 0);
+    if (*messageLen < len || (uint16_t)(*messageLen - len + fullLen) > sizeof(RoutedMessage))
+	return false;
+
+    RoutedMessageHeader header;
+    uint8_t i = 1;
+    header.dest = (control & RH_ROUTER_COMPRESS_DEST_ELIDED) ? to : p[i++];
+    header.source = (control & RH_ROUTER_COMPRESS_SOURCE_ELIDED) ? from : p[i++];
+    header.hops = (control & RH_ROUTER_COMPRESS_HOPS) >> RH_ROUTER_COMPRESS_HOPS_SHIFT;
+    if ((control & RH_ROUTER_COMPRESS_HOPS) == RH_ROUTER_COMPRESS_HOPS)
+	header.hops = p[i++];
+    header.id = p[i++];
+    header.flags = (control & RH_ROUTER_COMPRESS_FLAGS_INLINE) ? p[i++] : 0;
+
+    memmove(p + fullLen, p + len, *messageLen - len);
+    *messageLen = *messageLen - len + fullLen;
+    message->header = header;
+    if (_compressTypeOctet)
+	message->data[0] = (control & RH_ROUTER_COMPRESS_TYPE) >> RH_ROUTER_COMPRESS_TYPE_SHIFT;
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Subclasses may want to override this to peek at messages going past
 void RHRouter::peekAtMessage(RoutedMessage* message, uint8_t messageLen)
@@ -211,6 +326,7 @@ void RHRouter::peekAtMessage(RoutedMessage* message, uint8_t messageLen)
 ////////////////////////////////////////////////////////////////////
 bool RHRouter::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* source, uint8_t* dest, uint8_t* id, uint8_t* flags, uint8_t* hops)
 {  
+    ScopedLock lock(*this);
     uint8_t tmpMessageLen = sizeof(_tmpMessage);
     uint8_t _from;
     uint8_t _to;
@@ -267,6 +383,10 @@ bool RHRouter::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* source, uint8_t*
 	}
 #endif
 
+	if ((_compressHeaders || _decompressHeaders) && (_flags & RH_ROUTER_FLAGS_COMPRESSED)
+	    && !decompressHeader(&_tmpMessage, &tmpMessageLen, _from, _to))
+	    return false;
+
 	peekAtMessage(&_tmpMessage, tmpMessageLen);
 	// See if its for us or has to be routed
 	if (_tmpMessage.header.dest == _thisAddress || _tmpMessage.header.dest == RH_BROADCAST_ADDRESS)
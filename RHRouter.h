@@ -28,6 +28,19 @@
 #define RH_ROUTER_MAX_MESSAGE_LEN (RH_MAX_MESSAGE_LEN - sizeof(RHRouter::RoutedMessageHeader))
 //#define RH_ROUTER_MAX_MESSAGE_LEN 50
 
+// Set in the hop-to-hop FLAGS header of messages whose RHRouter header is compressed.
+// See "Header Compression" below
+#define RH_ROUTER_FLAGS_COMPRESSED 0x08
+
+// The control octet at the start of a compressed RHRouter header
+#define RH_ROUTER_COMPRESS_DEST_ELIDED   0x80 // DEST is the hop-to-hop TO address
+#define RH_ROUTER_COMPRESS_SOURCE_ELIDED 0x40 // SOURCE is the hop-to-hop FROM address
+#define RH_ROUTER_COMPRESS_TYPE          0x30 // The message type of the subclass (RHMesh), if it has one
+#define RH_ROUTER_COMPRESS_TYPE_SHIFT    4
+#define RH_ROUTER_COMPRESS_HOPS          0x0e // HOPS, or RH_ROUTER_COMPRESS_HOPS if a HOPS octet follows
+#define RH_ROUTER_COMPRESS_HOPS_SHIFT    1
+#define RH_ROUTER_COMPRESS_FLAGS_INLINE  0x01 // A FLAGS octet follows, else FLAGS is 0
+
 // These allow us to define a simulated network topology for testing purposes
 // See RHRouter.cpp for details
 //#define RH_TEST_NETWORK 1
@@ -117,6 +130,35 @@
 /// message header too. These are used only for hop-to-hop, and in general will be different to 
 /// the ones at the RHRouter level.
 ///
+/// \par Header Compression
+///
+/// The 5 octet RHRouter header (6 with the RHMesh message type) often costs more airtime than a small
+/// message itself, and much of it repeats the hop-to-hop header. Call setHeaderCompression(true) to
+/// compress it, in the spirit of 6LoWPAN IPHC (RFC 6282), into a control octet and the fields that cannot be
+/// worked out from elsewhere:
+/// - 1 octet CONTROL:
+///   - bit 7 set if DEST is left out, because it is the hop-to-hop TO address (the last hop, or a broadcast)
+///   - bit 6 set if SOURCE is left out, because it is the hop-to-hop FROM address (the first hop)
+///   - bits 5 and 4, the RHMesh message type, which is left out of the data
+///   - bits 3 to 1, HOPS if it is 0 to 6, else 7 and HOPS follows
+///   - bit 0 set if FLAGS follows, else FLAGS is 0
+/// - 1 octet DEST, if not left out
+/// - 1 octet SOURCE, if not left out
+/// - 1 octet HOPS, if more than 6
+/// - 1 octet ID
+/// - 1 octet FLAGS, if not 0
+///
+/// So a message sent directly to its destination with no end-to-end FLAGS has a 2 octet header instead of
+/// 5 (or 6 with RHMesh), and one routed over several hops a 3 octet header. Each hop compresses the header again
+/// for the next one, and marks the message by setting RH_ROUTER_FLAGS_COMPRESSED (one of the
+/// application specific flags) in the hop-to-hop FLAGS header, so do not use that flag with setHeaderFlags()
+/// while compression is on. A header that would not get smaller is sent uncompressed.
+/// Only nodes with compression on, or with setHeaderDecompression(true), decompress messages marked with
+/// RH_ROUTER_FLAGS_COMPRESSED. To turn compression on without stopping the network, call
+/// setHeaderDecompression(true) on every node first, then setHeaderCompression(true) on them one at a time.
+/// With neither, RH_ROUTER_FLAGS_COMPRESSED is left to the application like the other application specific
+/// flags. The largest message is not changed by compression.
+///
 /// \par Testing
 ///
 /// Bench testing of such networks is notoriously difficult, especially simulating limited radio 
@@ -193,6 +235,17 @@ public:
     /// \param [in] max_hops The new value for max_hops
     void setMaxHops(uint8_t max_hops);
 
+    /// Turns compression of the RHRouter header of messages sent (and forwarded) by this node on or off.
+    /// See "Header Compression" above. Off by default. While it is on, compressed messages received
+    /// are decompressed too
+    /// \param[in] compress true to compress headers
+    void setHeaderCompression(bool compress);
+
+    /// Turns decompression of compressed messages received on or off, whether or not this node compresses
+    /// the messages it sends. See "Header Compression" above. Off by default
+    /// \param[in] decompress true to decompress messages marked with RH_ROUTER_FLAGS_COMPRESSED
+    void setHeaderDecompression(bool decompress);
+
     /// Adds a route to the local routing table, or updates it if already present.
     /// If there is not enough room the oldest (first) route will be deleted by calling retireOldestRoute().
     /// \param [in] dest The destination node address. RH_BROADCAST_ADDRESS is permitted.
@@ -310,6 +363,23 @@ protected:
     /// \param [in] messageLen Length of message in octets
     virtual uint8_t route(RoutedMessage* message, uint8_t messageLen);
 
+    /// Compresses the header of a message in place, for sending to the next hop. See "Header Compression" above.
+    /// The compressed header is placed just before the data, and the start of the message is overwritten
+    /// \param [in,out] message Pointer to the RHRouter message
+    /// \param [in] messageLen Length of message in octets
+    /// \param [in] next_hop The address of the next hop
+    /// \return The number of octets at the start of message before the compressed header, or 0 if the header
+    /// would not be smaller and has not been compressed
+    uint8_t compressHeader(RoutedMessage* message, uint8_t messageLen, uint8_t next_hop);
+
+    /// Expands a received compressed header in place
+    /// \param [in,out] message Pointer to the RHRouter message, starting with the compressed header
+    /// \param [in,out] messageLen Length of message in octets. Set to the length with the full header
+    /// \param [in] from The hop-to-hop FROM address of the message
+    /// \param [in] to The hop-to-hop TO address of the message
+    /// \return true if the header was valid and the expanded message fits in a RoutedMessage
+    bool decompressHeader(RoutedMessage* message, uint8_t* messageLen, uint8_t from, uint8_t to);
+
     /// Deletes a specific rout entry from therouting table
     /// \param [in] index The 0 based index of the routing table entry to delete
     void deleteRoute(uint8_t index);
@@ -325,10 +395,24 @@ protected:
     /// Flag to set if packets are forwarded or not
     bool _isa_router;
 
+    /// Whether headers of messages sent are compressed
+    bool _compressHeaders;
+
+    /// Whether compressed messages received are decompressed, even if _compressHeaders is not set
+    bool _decompressHeaders;
+
+    /// Set by subclasses whose messages start with a message type less than 4 (such as RHMesh), so it
+    /// is carried in the control octet of compressed headers
+    bool _compressTypeOctet;
+
 private:
 
-    /// Temporary mesage buffer
+    /// Temporary mesage buffer. One for each instance when they may be used by different threads
+#if RH_THREAD_SAFE_MANAGERS
+    RoutedMessage        _tmpMessage;
+#else
     static RoutedMessage _tmpMessage;
+#endif
 
     /// Local routing table
     RoutingTableEntry    _routes[RH_ROUTING_TABLE_SIZE];
@@ -0,0 +1,216 @@
+// RHSPIBus.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHSPIBus.h>
+
+RHSPIBus::RHSPIBus(RHGenericSPI& spi)
+    :
+    _spi(spi),
+    _begun(false),
+    _frequency(RHGenericSPI::Frequency1MHz),
+    _bitOrder(RHGenericSPI::BitOrderMSBFirst),
+    _dataMode(RHGenericSPI::DataMode0),
+    _settingsChanges(0),
+    _waits(0),
+    _refusals(0),
+    _busy(false)
+{
+#ifdef RH_SPI_BUS_USE_PTHREAD
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_released, NULL);
+    memset(_waiting, 0, sizeof(_waiting));
+    _highestWaiting = 0;
+#endif
+}
+
+bool RHSPIBus::lock(RHSPIBusDevice* device)
+{
+#ifdef RH_SPI_BUS_USE_PTHREAD
+    pthread_mutex_lock(&_mutex);
+    uint8_t priority = device->priority();
+    if (_busy || _highestWaiting > priority)
+    {
+	// Wait until the bus is free and no device with a higher priority is waiting for it
+	_waits++;
+	_waiting[priority]++;
+	if (priority > _highestWaiting)
+	    _highestWaiting = priority;
+	while (_busy || _highestWaiting > priority)
+	    pthread_cond_wait(&_released, &_mutex);
+	if (--_waiting[priority] == 0)
+	    while (_highestWaiting > 0 && _waiting[_highestWaiting] == 0)
+		_highestWaiting--;
+    }
+    _busy = true;
+    pthread_mutex_unlock(&_mutex);
+    applySettings(device);
+    _spi.beginTransaction();
+    return true;
+#else
+    // The flag is only ever held by the code that claimed it, as the devices here do their asynchronous
+    // transfers synchronously. So if it is held, we have interrupted its holder, and waiting would never end.
+    // The interrupts of the devices (see usingInterrupt()) are held off by beginTransaction() in the same
+    // atomic block as the flag is claimed, so their handlers can not be the ones to find it held
+    bool claimed;
+    ATOMIC_BLOCK_START;
+    claimed = !_busy;
+    if (claimed)
+    {
+	applySettings(device);
+	_spi.beginTransaction();
+	_busy = true;
+    }
+    else
+	_refusals++;
+    ATOMIC_BLOCK_END;
+    return claimed;
+#endif
+}
+
+void RHSPIBus::unlock()
+{
+#ifdef RH_SPI_BUS_USE_PTHREAD
+    _spi.endTransaction();
+    pthread_mutex_lock(&_mutex);
+    _busy = false;
+    pthread_cond_broadcast(&_released);
+    pthread_mutex_unlock(&_mutex);
+#else
+    // The flag is released before the interrupts of the devices are allowed again
+    ATOMIC_BLOCK_START;
+    _busy = false;
+    _spi.endTransaction();
+    ATOMIC_BLOCK_END;
+#endif
+}
+
+void RHSPIBus::begin(RHSPIBusDevice* device)
+{
+    if (!lock(device))
+	return;
+    if (!_begun)
+    {
+	_spi.begin();
+	_begun = true;
+    }
+    unlock();
+}
+
+void RHSPIBus::applySettings(RHSPIBusDevice* device)
+{
+    if (   _begun
+	&& device->frequency() == _frequency
+	&& device->bitOrder() == _bitOrder
+	&& device->dataMode() == _dataMode)
+	return;
+    _frequency = device->frequency();
+    _bitOrder = device->bitOrder();
+    _dataMode = device->dataMode();
+    _spi.setFrequency(_frequency);
+    _spi.setBitOrder(_bitOrder);
+    _spi.setDataMode(_dataMode);
+    if (_begun)
+    {
+	// Most interfaces only take up new settings in begin()
+	_spi.begin();
+	_settingsChanges++;
+    }
+}
+
+RHSPIBusDevice::RHSPIBusDevice(RHSPIBus& bus, Frequency frequency, BitOrder bitOrder,
+			       DataMode dataMode, uint8_t priority)
+    :
+    RHGenericSPI(frequency, bitOrder, dataMode),
+    _bus(bus),
+    _priority(priority),
+    _acquired(false),
+    _locked(false)
+{
+}
+
+uint8_t RHSPIBusDevice::transfer(uint8_t data)
+{
+    return _bus.spi().transfer(data);
+}
+
+#if (RH_PLATFORM == RH_PLATFORM_MONGOOSE_OS)
+uint8_t RHSPIBusDevice::transfer2B(uint8_t byte0, uint8_t byte1)
+{
+    return _bus.spi().transfer2B(byte0, byte1);
+}
+#endif
+
+uint8_t RHSPIBusDevice::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
+{
+    return _bus.spi().spiBurstRead(reg, dest, len);
+}
+
+uint8_t RHSPIBusDevice::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
+{
+    return _bus.spi().spiBurstWrite(reg, src, len);
+}
+
+bool RHSPIBusDevice::spiBatch(Transaction* transactions, uint8_t count)
+{
+    return _bus.spi().spiBatch(transactions, count);
+}
+
+#ifdef RH_SPI_BUS_USE_PTHREAD
+bool RHSPIBusDevice::spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, TransferCallback callback, void* context)
+{
+    return _bus.spi().spiBurstReadAsync(reg, dest, len, callback, context);
+}
+
+bool RHSPIBusDevice::spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, TransferCallback callback, void* context)
+{
+    return _bus.spi().spiBurstWriteAsync(reg, src, len, callback, context);
+}
+#endif
+
+void RHSPIBusDevice::begin()
+{
+    _bus.begin(this);
+}
+
+void RHSPIBusDevice::end()
+{
+}
+
+#ifndef RH_SPI_BUS_USE_PTHREAD
+// On Linux, waiting for the bus in beginTransaction() is enough, as nothing disables interrupts
+bool RHSPIBusDevice::acquire()
+{
+    _acquired = _bus.lock(this);
+    return _acquired;
+}
+
+void RHSPIBusDevice::release()
+{
+    if (!_acquired)
+	return;
+    _acquired = false;
+    _bus.unlock();
+}
+#endif
+
+void RHSPIBusDevice::beginTransaction()
+{
+    // Callers that did not acquire() the bus first get it here
+    if (!_acquired)
+	_locked = _bus.lock(this);
+}
+
+void RHSPIBusDevice::endTransaction()
+{
+    if (!_locked)
+	return;
+    _locked = false;
+    _bus.unlock();
+}
+
+void RHSPIBusDevice::usingInterrupt(uint8_t interruptNumber)
+{
+    _bus.spi().usingInterrupt(interruptNumber);
+}
@@ -0,0 +1,259 @@
+// RHSPIBus.h
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHSPIBus_h
+#define RHSPIBus_h
+
+#include <RHGenericSPI.h>
+
+// On Linux hosts, devices on the bus may be used from different threads (such as the
+// interrupt threads of several radios), so the bus is locked with a mutex. Elsewhere
+// a device that has the bus holds a flag
+#if (RH_PLATFORM == RH_PLATFORM_RASPI) || (RH_PLATFORM == RH_PLATFORM_UNIX)
+ #define RH_SPI_BUS_USE_PTHREAD
+ #include <pthread.h>
+#endif
+
+class RHSPIBusDevice;
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSPIBus RHSPIBus.h <RHSPIBus.h>
+/// \brief Shares one SPI interface between several devices, such as 2 radios on one SPI bus
+///
+/// RHSPIDriver disables interrupts around each SPI transaction with ATOMIC_BLOCK_START,
+/// which keeps the interrupt handler of one radio from using the bus in the middle of
+/// another radio's transaction on a microcontroller. On Linux (including Raspberry Pi),
+/// ATOMIC_BLOCK_START does nothing, and each radio's interrupt handler may run in its own
+/// thread, so 2 radios on one bus could select their slaves at the same time.
+///
+/// RHSPIBus owns the real SPI interface (such as an RHHardwareSPI or RHSpidevSPI), and
+/// each device on the bus gets an RHSPIBusDevice, which is the RHGenericSPI you give its driver.
+/// Each transaction (between RHGenericSPI::beginTransaction() and
+/// RHGenericSPI::endTransaction(), which RHSPIDriver calls around the slave select) holds the bus:
+/// - On Linux, a device that wants the bus while another has it waits (in a mutex and condition variable).
+///   When the bus is released, the waiting device with the highest priority gets it next,
+///   so you can give a radio whose receiver FIFO must be emptied quickly
+///   a higher priority than the others. See RHSPIBusDevice::setPriority().
+/// - Elsewhere, the device that has the bus holds a flag. RHSPIDriver claims it with
+///   RHGenericSPI::acquire() before it disables interrupts for a transaction, and releases it after.
+///   The interrupts of the devices on the bus, given with RHGenericSPI::usingInterrupt() as the RadioHead
+///   drivers do in init() (with SPI libraries that support transactions), are held off from before the
+///   flag is claimed until after it is released, so their handlers never find the bus taken.
+///   Asynchronous transfers (see RHSPIDriver::spiBurstReadAsync()) are done synchronously, so the bus is
+///   never held while other code runs. If some other interrupt handler does find the bus taken, it has interrupted
+///   the holder, which can not go on until it returns, so it does not wait: the transaction is not done (see
+///   RHSPIDriver::spiRead()), and it is counted by refusals().
+///
+/// Each RHSPIBusDevice has its own frequency, bit order and data mode. When a device gets the
+/// bus, and the previous transaction was for a device with other settings, the settings of the SPI
+/// interface are changed and it is restarted (with RHGenericSPI::begin()) before the transaction.
+///
+/// Each device needs its own slave select pin, for example:
+/// \code
+/// RHSpidevSPI spidev("/dev/spidev0.0");
+/// RHSPIBus bus(spidev);
+/// RHSPIBusDevice spi1(bus, RHGenericSPI::Frequency8MHz);
+/// RHSPIBusDevice spi2(bus, RHGenericSPI::Frequency1MHz, RHGenericSPI::BitOrderMSBFirst, RHGenericSPI::DataMode0, 1);
+/// RH_RF95 radio1(8, 25, spi1);
+/// RH_RF69 radio2(7, 24, spi2); // Higher priority
+/// \endcode
+/// With RHSpidevSPI, call RHSpidevSPI::setNoChipSelect(true) so that the kernel does not drive
+/// its chip select as well.
+///
+/// The spi_bus_stress example tests the locking with 2 simulated devices used from several threads.
+class RHSPIBus
+{
+public:
+    /// Constructor
+    /// \param[in] spi The SPI interface that the devices share
+    RHSPIBus(RHGenericSPI& spi);
+
+    /// Gives the bus to device, with its settings, and begins a transaction on the interface.
+    /// On Linux, waits until the bus is free. Elsewhere, fails if it is not.
+    /// Called by RHSPIBusDevice::acquire() or RHSPIBusDevice::beginTransaction(). Not reentrant: a device must not
+    /// lock the bus again before unlock()
+    /// \param[in] device The device that wants the bus
+    /// \return true if device has the bus, false if it is held by the code that was interrupted
+    bool            lock(RHSPIBusDevice* device);
+
+    /// Ends the transaction on the interface and releases the bus. On Linux, this can be called from a
+    /// different thread than lock(), such as the completion callback of an asynchronous transfer.
+    /// Called by RHSPIBusDevice::release() or RHSPIBusDevice::endTransaction()
+    void            unlock();
+
+    /// Starts the SPI interface with the settings of a device, if it has not been started yet.
+    /// Called by RHSPIBusDevice::begin()
+    /// \param[in] device The device
+    void            begin(RHSPIBusDevice* device);
+
+    /// Returns the shared SPI interface
+    /// \return The interface given to the constructor
+    RHGenericSPI&   spi() { return _spi;}
+
+    /// Returns the number of times the settings of the SPI interface were changed for a different device
+    /// \return The number of changes
+    uint32_t        settingsChanges() { return _settingsChanges;}
+
+    /// Returns the number of times a device had to wait for the bus
+    /// \return The number of waits
+    uint32_t        waits() { return _waits;}
+
+    /// Returns the number of times a device could not have the bus, because an interrupt handler
+    /// wanted it while the code it interrupted had it. Always 0 on Linux
+    /// \return The number of refusals
+    uint32_t        refusals() { return _refusals;}
+
+protected:
+    /// Sets the SPI interface to the settings of device, if they are different
+    void            applySettings(RHSPIBusDevice* device);
+
+    /// The shared interface
+    RHGenericSPI&   _spi;
+
+    /// True when the interface has been started
+    bool            _begun;
+
+    /// The settings the interface has
+    RHGenericSPI::Frequency _frequency;
+    RHGenericSPI::BitOrder  _bitOrder;
+    RHGenericSPI::DataMode  _dataMode;
+
+    /// Statistics
+    uint32_t        _settingsChanges;
+    uint32_t        _waits;
+    uint32_t        _refusals;
+
+    /// True while a device has the bus
+    volatile bool   _busy;
+
+#ifdef RH_SPI_BUS_USE_PTHREAD
+    /// Protects _busy and the following
+    pthread_mutex_t _mutex;
+
+    /// Signalled when the bus is released
+    pthread_cond_t  _released;
+
+    /// Number of waiting devices at each priority
+    uint16_t        _waiting[256];
+
+    /// Highest priority of any waiting device
+    uint8_t         _highestWaiting;
+#endif
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSPIBusDevice RHSPIBus.h <RHSPIBus.h>
+/// \brief One device on an RHSPIBus
+///
+/// This subclass of RHGenericSPI is the SPI interface to give a driver for a device on a shared
+/// bus. It holds the settings of the device, and passes transfers to the shared
+/// interface, with the bus locked from beginTransaction() to endTransaction(). See RHSPIBus.
+class RHSPIBusDevice : public RHGenericSPI
+{
+public:
+    /// Constructor
+    /// \param[in] bus The bus the device is on
+    /// \param[in] frequency One of RHGenericSPI::Frequency, the bus frequency for this device
+    /// \param[in] bitOrder The bit order for this device, one of RHGenericSPI::BitOrder
+    /// \param[in] dataMode The data mode for this device, one of RHGenericSPI::DataMode
+    /// \param[in] priority Priority for getting the bus (on Linux): when the bus is released,
+    /// the waiting device with the highest priority gets it next. 0 is the lowest
+    RHSPIBusDevice(RHSPIBus& bus, Frequency frequency = Frequency1MHz, BitOrder bitOrder = BitOrderMSBFirst,
+		   DataMode dataMode = DataMode0, uint8_t priority = 0);
+
+    /// Transfers an octet with the shared interface. Must be within a transaction
+    /// \param[in] data The octet to send
+    /// \return The octet read from SPI while the data octet was sent
+    uint8_t         transfer(uint8_t data);
+
+#if (RH_PLATFORM == RH_PLATFORM_MONGOOSE_OS)
+    /// Transfers 2 octets with the shared interface. Must be within a transaction
+    /// \param[in] byte0 The first byte to be sent on the SPI interface
+    /// \param[in] byte1 The second byte to be sent on the SPI interface
+    /// \return The second byte clocked in as the second byte is sent.
+    uint8_t         transfer2B(uint8_t byte0, uint8_t byte1);
+#endif
+
+    /// Burst read with the shared interface. Must be within a transaction
+    uint8_t         spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len);
+
+    /// Burst write with the shared interface. Must be within a transaction
+    uint8_t         spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len);
+
+    /// Batch of transactions with the shared interface. Must be within a transaction
+    bool            spiBatch(Transaction* transactions, uint8_t count);
+
+#ifdef RH_SPI_BUS_USE_PTHREAD
+    /// Asynchronous burst read with the shared interface. Must be within a transaction,
+    /// which the callback ends. Elsewhere than Linux, the transfer is done before returning
+    bool            spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, TransferCallback callback, void* context);
+
+    /// Asynchronous burst write with the shared interface. Must be within a transaction,
+    /// which the callback ends. Elsewhere than Linux, the transfer is done before returning
+    bool            spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, TransferCallback callback, void* context);
+#endif
+
+    /// Starts the shared interface if this is the first device to start it
+    void            begin();
+
+    /// Does nothing: the shared interface stays up for the other devices
+    void            end();
+
+#ifndef RH_SPI_BUS_USE_PTHREAD
+    /// Locks the bus for this device, switches the shared interface to the settings of this device,
+    /// and begins a transaction on it. Called by RHSPIDriver before it disables interrupts
+    /// \return false if the bus is held by the code that was interrupted
+    bool            acquire();
+
+    /// Ends the transaction on the shared interface and releases the bus, if acquire() locked it
+    void            release();
+#endif
+
+    /// Locks the bus for this device (on Linux waiting if necessary), switches the shared interface to
+    /// the settings of this device, and begins a transaction on it, unless acquire() did already
+    void            beginTransaction();
+
+    /// Ends the transaction on the shared interface and releases the bus, if beginTransaction() locked it
+    void            endTransaction();
+
+    /// Passes the interrupt number to the shared interface
+    /// \param[in] interruptNumber The number of the interrupt
+    void            usingInterrupt(uint8_t interruptNumber);
+
+    /// Sets the priority of this device for getting the bus. Can be changed at any time, for
+    /// example raised while a radio has received data waiting in its FIFO
+    /// \param[in] priority The new priority. 0 is the lowest
+    void            setPriority(uint8_t priority) { _priority = priority;}
+
+    /// Returns the priority of this device for getting the bus
+    /// \return The priority
+    uint8_t         priority() { return _priority;}
+
+    /// Returns the frequency of this device
+    Frequency       frequency() { return _frequency;}
+
+    /// Returns the bit order of this device
+    BitOrder        bitOrder() { return _bitOrder;}
+
+    /// Returns the data mode of this device
+    DataMode        dataMode() { return _dataMode;}
+
+protected:
+    /// The bus the device is on
+    RHSPIBus&       _bus;
+
+    /// Priority for getting the bus
+    volatile uint8_t _priority;
+
+    /// True while acquire() has locked the bus
+    bool            _acquired;
+
+    /// True while beginTransaction() has locked the bus
+    bool            _locked;
+};
+
+/// @example spi_bus_stress.pde
+
+#endif
@@ -12,6 +12,17 @@ RHSPIDriver::RHSPIDriver(uint8_t slaveSelectPin, RHGenericSPI& spi)
     _spi(spi),
     _slaveSelectPin(slaveSelectPin)
 {
+#if RH_SPI_ASYNC
+    _spiAsyncBusy = false;
+#endif
+#if RH_SPI_SHADOW_REGISTERS
+    _spiTransactionsSaved = 0;
+    _spiShadowMismatches = 0;
+    _spiShadowEnabled = false;
+    _spiShadowVerify = false;
+    memset(_spiShadowCacheable, 0, sizeof(_spiShadowCacheable));
+    memset(_spiShadowValid, 0, sizeof(_spiShadowValid));
+#endif
 }
 
 bool RHSPIDriver::init()
@@ -44,61 +55,340 @@ bool RHSPIDriver::init()
 uint8_t RHSPIDriver::spiRead(uint8_t reg)
 {
     uint8_t val = 0;
+    // An asynchronous transfer of this driver finishes first, and a shared interface (RHSPIBusDevice)
+    // gets the bus, before interrupts are disabled. The shadow is looked 
+    // up and updated in the same atomic block as the SPI access, so an interrupt handler using the driver 
+    // can not change the register in between
+    spiAsyncWait();
+    if (!_spi.acquire())
+	return val;
     ATOMIC_BLOCK_START;
     _spi.beginTransaction();
-    selectSlave();
-    _spi.transfer(reg & ~RH_SPI_WRITE_MASK); // Send the address with the write mask off
-    val = _spi.transfer(0); // The written value is ignored, reg value is read
-    deselectSlave();
+    if (!spiShadowRead(reg, &val, 1))
+    {
+	selectSlave();
+#if defined(__AVR__)
+	// Direct, without the virtual burst call, on the smallest processors
+	_spi.transfer(reg & ~RH_SPI_WRITE_MASK); // Send the address with the write mask off
+	val = _spi.transfer(0); // The written value is ignored, reg value is read
+#else
+	// The address with the write mask off, then the value is read as 0 is written
+	_spi.spiBurstRead(reg & ~RH_SPI_WRITE_MASK, &val, 1);
+#endif
+	deselectSlave();
+	spiShadowUpdate(reg, &val, 1, true);
+    }
     _spi.endTransaction();
     ATOMIC_BLOCK_END;
+    _spi.release();
     return val;
 }
 
 uint8_t RHSPIDriver::spiWrite(uint8_t reg, uint8_t val)
 {
     uint8_t status = 0;
+    spiAsyncWait();
+    if (!_spi.acquire())
+	return status;
     ATOMIC_BLOCK_START;
     _spi.beginTransaction();
     selectSlave();
+#if defined(__AVR__)
     status = _spi.transfer(reg | RH_SPI_WRITE_MASK); // Send the address with the write mask on
     _spi.transfer(val); // New value follows
+#else
+    // The address with the write mask on, then the new value
+    status = _spi.spiBurstWrite(reg | RH_SPI_WRITE_MASK, &val, 1);
+#endif
     deselectSlave();
+    spiShadowUpdate(reg, &val, 1, false);
     _spi.endTransaction();
     ATOMIC_BLOCK_END;
+    _spi.release();
     return status;
 }
 
 uint8_t RHSPIDriver::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
 {
     uint8_t status = 0;
+    spiAsyncWait();
+    if (!_spi.acquire())
+	return status;
     ATOMIC_BLOCK_START;
     _spi.beginTransaction();
-    selectSlave();
-    status = _spi.transfer(reg & ~RH_SPI_WRITE_MASK); // Send the start address with the write mask off
-    while (len--)
-	*dest++ = _spi.transfer(0);
-    deselectSlave();
+    if (!spiShadowRead(reg, dest, len))
+    {
+	selectSlave();
+	status = _spi.spiBurstRead(reg & ~RH_SPI_WRITE_MASK, dest, len); // Start address with the write mask off
+	deselectSlave();
+	spiShadowUpdate(reg, dest, len, true);
+    }
     _spi.endTransaction();
     ATOMIC_BLOCK_END;
+    _spi.release();
     return status;
 }
 
 uint8_t RHSPIDriver::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
 {
     uint8_t status = 0;
+    spiAsyncWait();
+    if (!_spi.acquire())
+	return status;
     ATOMIC_BLOCK_START;
     _spi.beginTransaction();
     selectSlave();
-    status = _spi.transfer(reg | RH_SPI_WRITE_MASK); // Send the start address with the write mask on
-    while (len--)
-	_spi.transfer(*src++);
+    status = _spi.spiBurstWrite(reg | RH_SPI_WRITE_MASK, src, len); // Start address with the write mask on
     deselectSlave();
+    spiShadowUpdate(reg, src, len, false);
     _spi.endTransaction();
     ATOMIC_BLOCK_END;
+    _spi.release();
     return status;
 }
 
+void RHSPIDriver::spiBatch(RHGenericSPI::Transaction* transactions, uint8_t count)
+{
+    uint8_t i;
+    for (i = 0; i < count; i++)
+    {
+	if (transactions[i].write)
+	    transactions[i].reg |= RH_SPI_WRITE_MASK;
+	else
+	    transactions[i].reg &= ~RH_SPI_WRITE_MASK;
+    }
+
+    spiAsyncWait();
+    if (!_spi.acquire())
+	return;
+    ATOMIC_BLOCK_START;
+    _spi.beginTransaction();
+    if (!_spi.spiBatch(transactions, count))
+    {
+	// One at a time, still under the one bus acquisition
+	for (i = 0; i < count; i++)
+	{
+	    selectSlave();
+	    if (transactions[i].write)
+		_spi.spiBurstWrite(transactions[i].reg, transactions[i].data, transactions[i].len);
+	    else
+		_spi.spiBurstRead(transactions[i].reg, transactions[i].data, transactions[i].len);
+	    deselectSlave();
+	}
+    }
+    for (i = 0; i < count; i++)
+	spiShadowUpdate(transactions[i].reg, transactions[i].data, transactions[i].len, !transactions[i].write);
+    _spi.endTransaction();
+    ATOMIC_BLOCK_END;
+    _spi.release();
+}
+
+bool RHSPIDriver::spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, 
+				    RHGenericSPI::TransferCallback callback, void* context)
+{
+    RHGenericSPI::Transaction transaction = { reg, false, dest, len };
+    return spiBatchAsync(&transaction, 1, callback, context);
+}
+
+bool RHSPIDriver::spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, 
+				     RHGenericSPI::TransferCallback callback, void* context)
+{
+    // The interface only reads from data when writing
+    RHGenericSPI::Transaction transaction = { reg, true, (uint8_t*)src, len };
+    return spiBatchAsync(&transaction, 1, callback, context);
+}
+
+bool RHSPIDriver::spiBatchAsync(RHGenericSPI::Transaction* transactions, uint8_t count,
+				RHGenericSPI::TransferCallback callback, void* context)
+{
+#if RH_SPI_ASYNC
+    uint8_t i;
+    bool started;
+    if (count == 0)
+	return false;
+    // Only the check and claim need to be atomic, not the transfers
+    ATOMIC_BLOCK_START;
+    started = !_spiAsyncBusy;
+    _spiAsyncBusy = true;
+    ATOMIC_BLOCK_END;
+    if (!started)
+	return false;
+    if (!_spi.acquire())
+    {
+	_spiAsyncBusy = false;
+	return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+	if (transactions[i].write)
+	    transactions[i].reg |= RH_SPI_WRITE_MASK;
+	else
+	    transactions[i].reg &= ~RH_SPI_WRITE_MASK;
+    }
+    RHGenericSPI::Transaction* last = &transactions[count - 1];
+    _spiAsyncReg = last->reg;
+    _spiAsyncData = last->data;
+    _spiAsyncLen = last->len;
+    _spiAsyncWrite = last->write;
+    _spiAsyncCallback = callback;
+    _spiAsyncContext = context;
+    _spi.beginTransaction();
+    // All but the last now, in the same transaction
+    if (count > 1 && !_spi.spiBatch(transactions, count - 1))
+    {
+	for (i = 0; i < count - 1; i++)
+	{
+	    selectSlave();
+	    if (transactions[i].write)
+		_spi.spiBurstWrite(transactions[i].reg, transactions[i].data, transactions[i].len);
+	    else
+		_spi.spiBurstRead(transactions[i].reg, transactions[i].data, transactions[i].len);
+	    deselectSlave();
+	}
+    }
+    for (i = 0; i < count - 1; i++)
+    {
+	ATOMIC_BLOCK_START;
+	spiShadowUpdate(transactions[i].reg, transactions[i].data, transactions[i].len, !transactions[i].write);
+	ATOMIC_BLOCK_END;
+    }
+    selectSlave();
+    if (last->write)
+	started = _spi.spiBurstWriteAsync(last->reg, last->data, last->len, spiAsyncComplete, this);
+    else
+	started = _spi.spiBurstReadAsync(last->reg, last->data, last->len, spiAsyncComplete, this);
+    if (!started)
+    {
+	// The interface is busy with another driver's transfer
+	deselectSlave();
+	_spi.endTransaction();
+	_spi.release();
+	_spiAsyncBusy = false;
+    }
+    return started;
+#else
+    (void)transactions;
+    (void)count;
+    (void)callback;
+    (void)context;
+    return false; // Not built: the caller does it synchronously
+#endif
+}
+
+#if RH_SPI_ASYNC
+void RHSPIDriver::spiAsyncComplete(void* driver, uint8_t status)
+{
+    RHSPIDriver* self = (RHSPIDriver*)driver;
+    self->deselectSlave();
+    self->_spi.endTransaction();
+    self->_spi.release();
+    ATOMIC_BLOCK_START;
+    self->spiShadowUpdate(self->_spiAsyncReg, self->_spiAsyncData, self->_spiAsyncLen, !self->_spiAsyncWrite);
+    ATOMIC_BLOCK_END;
+    // The callback may start another transfer
+    RHGenericSPI::TransferCallback callback = self->_spiAsyncCallback;
+    self->_spiAsyncBusy = false;
+    if (callback)
+	callback(self->_spiAsyncContext, status);
+}
+#endif
+
+void RHSPIDriver::spiSetShadowEnabled(bool enabled)
+{
+#if RH_SPI_SHADOW_REGISTERS
+    spiInvalidateShadow();
+    _spiShadowEnabled = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+void RHSPIDriver::spiSetShadowVerify(bool verify)
+{
+#if RH_SPI_SHADOW_REGISTERS
+    _spiShadowVerify = verify;
+#else
+    (void)verify;
+#endif
+}
+
+void RHSPIDriver::spiSetShadowCacheable(uint8_t reg, uint8_t count, bool cacheable)
+{
+#if RH_SPI_SHADOW_REGISTERS
+    for (uint16_t r = reg & ~RH_SPI_WRITE_MASK; count-- && r < RH_SPI_SHADOW_REGISTERS; r++)
+    {
+	if (cacheable)
+	    _spiShadowCacheable[r / 8] |= (1 << (r % 8));
+	else
+	    _spiShadowCacheable[r / 8] &= ~(1 << (r % 8));
+	_spiShadowValid[r / 8] &= ~(1 << (r % 8));
+    }
+#else
+    (void)reg;
+    (void)count;
+    (void)cacheable;
+#endif
+}
+
+void RHSPIDriver::spiInvalidateShadow()
+{
+#if RH_SPI_SHADOW_REGISTERS
+    memset(_spiShadowValid, 0, sizeof(_spiShadowValid));
+#endif
+}
+
+bool RHSPIDriver::spiShadowRead(uint8_t reg, uint8_t* dest, uint8_t len)
+{
+#if RH_SPI_SHADOW_REGISTERS
+    if (!_spiShadowEnabled || _spiShadowVerify)
+	return false;
+    uint16_t first = reg & ~RH_SPI_WRITE_MASK;
+    uint16_t r;
+    if (first + len > RH_SPI_SHADOW_REGISTERS)
+	return false;
+    // All of them must be cacheable and known
+    for (r = first; r < first + len; r++)
+	if (!(_spiShadowCacheable[r / 8] & _spiShadowValid[r / 8] & (1 << (r % 8))))
+	    return false;
+    memcpy(dest, _spiShadow + first, len);
+    _spiTransactionsSaved++;
+    return true;
+#else
+    (void)reg;
+    (void)dest;
+    (void)len;
+    return false;
+#endif
+}
+
+void RHSPIDriver::spiShadowUpdate(uint8_t reg, const uint8_t* data, uint8_t len, bool fromDevice)
+{
+#if RH_SPI_SHADOW_REGISTERS
+    if (!_spiShadowEnabled)
+	return;
+    uint16_t r = reg & ~RH_SPI_WRITE_MASK;
+    // A burst starting at a volatile register, such as a FIFO, may not be to consecutive registers
+    if (r >= RH_SPI_SHADOW_REGISTERS || !(_spiShadowCacheable[r / 8] & (1 << (r % 8))))
+	return;
+    for (; len-- && r < RH_SPI_SHADOW_REGISTERS; r++, data++)
+    {
+	uint8_t bit = 1 << (r % 8);
+	if (!(_spiShadowCacheable[r / 8] & bit))
+	    continue;
+	if (fromDevice && (_spiShadowValid[r / 8] & bit) && _spiShadow[r] != *data)
+	    _spiShadowMismatches++;
+	_spiShadow[r] = *data;
+	_spiShadowValid[r / 8] |= bit;
+    }
+#else
+    (void)reg;
+    (void)data;
+    (void)len;
+    (void)fromDevice;
+#endif
+}
+
 void RHSPIDriver::setSlaveSelectPin(uint8_t slaveSelectPin)
 {
     _slaveSelectPin = slaveSelectPin;
@@ -111,10 +401,13 @@ void RHSPIDriver::spiUsingInterrupt(uint8_t interruptNumber)
 
 void RHSPIDriver::selectSlave()
 {
-    digitalWrite(_slaveSelectPin, LOW);
+    // No pin if the SPI interface selects the device itself, such as RHSpidevSPI
+    if (_slaveSelectPin != 0xff)
+	digitalWrite(_slaveSelectPin, LOW);
 }
     
 void RHSPIDriver::deselectSlave()
 {
-    digitalWrite(_slaveSelectPin, HIGH);
+    if (_slaveSelectPin != 0xff)
+	digitalWrite(_slaveSelectPin, HIGH);
 }
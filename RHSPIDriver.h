@@ -12,6 +12,21 @@
 // This is the bit in the SPI address that marks it as a write
 #define RH_SPI_WRITE_MASK 0x80
 
+// Number of registers (from 0) that RHSPIDriver can keep shadow copies of, see
+// RHSPIDriver::spiSetShadowEnabled(). Costs this many octets of RAM per driver, plus 2 bits per register.
+// The default of 0 leaves out the shadow registers altogether. Define it (for example to 128 for RH_RF95)
+// when building the library to use them
+#ifndef RH_SPI_SHADOW_REGISTERS
+ #define RH_SPI_SHADOW_REGISTERS 0
+#endif
+
+// Set to 1 to build the asynchronous transfers of RHSPIDriver, see RHSPIDriver::spiBurstReadAsync().
+// Costs about 10 octets of RAM per driver. The default of 0 leaves them out: then they are never started,
+// and drivers do their FIFO transfers synchronously
+#ifndef RH_SPI_ASYNC
+ #define RH_SPI_ASYNC 0
+#endif
+
 class RHGenericSPI;
 
 /////////////////////////////////////////////////////////////////////
@@ -35,6 +50,38 @@ class RHGenericSPI;
 ///
 /// Application developers are not expected to instantiate this class directly: 
 /// it is for the use of Driver developers.
+///
+/// \par Shadow registers
+/// Drivers often read back configuration registers that they wrote themselves, for example to 
+/// change some bits of a register (read-modify-write). RHSPIDriver can keep a write-through shadow copy
+/// of such registers in RAM, and answer reads of them without using the SPI bus. 
+/// The driver declares which registers are not volatile (only ever changed by writes over SPI) with
+/// spiSetShadowCacheable(), usually in its init(). The application enables the shadow registers with
+/// spiSetShadowEnabled(true). Every write to a cacheable register, including burst writes and
+/// spiBatch() writes, updates its shadow, and the first read of a cacheable register that has not
+/// been written fills its shadow. If the device is reset or otherwise loses its configuration
+/// behind the driver's back, call spiInvalidateShadow(). spiTransactionsSaved() counts the reads
+/// answered from RAM. In verify mode (spiSetShadowVerify()), reads always go to the device, and
+/// spiShadowMismatches() counts the reads that differed from the shadow, which would indicate
+/// that a register was wrongly declared cacheable. RH_SPI_SHADOW_REGISTERS sets the number of registers 
+/// that can be shadowed. It is 0 by default, which leaves the shadow registers out, so define it when
+/// building the library to use them.
+///
+/// \par Asynchronous transfers
+/// spiRead(), spiWrite() and the burst transfers disable interrupts while they use the bus, which for a
+/// 255 octet FIFO transfer can be long enough to delay other interrupts noticeably. 
+/// spiBurstReadAsync() and spiBurstWriteAsync() do not: they only hold the SPI transaction open, 
+/// and call a completion callback when done. With an SPI interface that can use DMA (one that
+/// overrides RHGenericSPI::spiBurstReadAsync() and RHGenericSPI::spiBurstWriteAsync()), they return as soon as the
+/// transfer has started, and the CPU can carry on meanwhile. Other interfaces do the transfer before
+/// returning, so drivers can use them everywhere. spiBatchAsync() does some short transactions
+/// first, in the same SPI transaction. The other register transfers of the driver wait for an asynchronous
+/// transfer in progress to finish (see spiAsyncWait()), so they never disturb it.
+/// RH_RF95 uses spiBatchAsync() to load the FIFO address pointer, the headers and the message data in send(),
+/// and to read a received message from the FIFO in its interrupt handler. RH_RF69 reads the payload of a received
+/// message with spiBurstReadAsync(). Both do the transfer synchronously if it can not be started.
+/// The asynchronous transfers are only built if RH_SPI_ASYNC is defined to 1 when building the library
+/// (otherwise they always return false). The spi_async_dma example tests them with a simulated DMA controller.
 class RHSPIDriver : public RHGenericDriver
 {
 public:
@@ -49,7 +96,9 @@ public:
     /// \return true if initialisation succeeded.
     bool init();
 
-    /// Reads a single register from the SPI device
+    /// Reads a single register from the SPI device.
+    /// Like the other register transfers, does nothing (and returns 0) if the SPI interface can not be had,
+    /// see RHGenericSPI::acquire()
     /// \param[in] reg Register number
     /// \return The value of the register
     uint8_t        spiRead(uint8_t reg);
@@ -77,6 +126,132 @@ public:
     ///  it may or may not be meaningfule depending on the the type of device being accessed.
     uint8_t           spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len);
 
+    /// Performs a batch of register reads and writes (each a single register, or a burst of consecutive
+    /// registers) under a single acquisition of the bus: one ATOMIC_BLOCK and one SPI transaction,
+    /// with the slave selected separately for each register transaction. If the SPI interface can 
+    /// do the whole batch at once (see RHGenericSPI::spiBatch()), it does: RHSpidevSPI sends it as a single ioctl.
+    /// Reads are delivered to wherever their data points, typically the fields of a struct, for example:
+    /// \code
+    /// struct { uint8_t irqFlags; uint8_t rxBytes; } status;
+    /// uint8_t clear = 0xff;
+    /// RHGenericSPI::Transaction batch[] = {
+    ///     { RH_RF95_REG_12_IRQ_FLAGS, false, &status.irqFlags, 2 }, // Registers 0x12 and 0x13
+    ///     { RH_RF95_REG_12_IRQ_FLAGS, true,  &clear, 1 },
+    /// };
+    /// spiBatch(batch, 2);
+    /// \endcode
+    /// \param[in,out] transactions The transactions to perform, in order. The RH_SPI_WRITE_MASK bit of
+    /// each reg is set or cleared according to its write flag.
+    /// \param[in] count The number of transactions
+    void              spiBatch(RHGenericSPI::Transaction* transactions, uint8_t count);
+
+    /// Starts reading a number of consecutive registers (or a FIFO) using burst read mode, without 
+    /// disabling interrupts for the duration. With an SPI interface that supports DMA, returns 
+    /// as soon as the transfer has started; with others the transfer has finished when it returns
+    /// (see RHGenericSPI::spiBurstReadAsync()). Either way, callback is called when it has finished,
+    /// and spiAsyncBusy() is true until then. The slave stays selected, and the SPI transaction
+    /// (see RHGenericSPI::beginTransaction()) stays open, for the duration, so where the SPI library
+    /// supports it, interrupts that use SPI (see spiUsingInterrupt()) are held off, but others are not.
+    /// \param[in] reg Register number of the first register
+    /// \param[in] dest Array to write the register values to. Must be at least len bytes, and stay valid until the transfer has finished
+    /// \param[in] len Number of bytes to read
+    /// \param[in] callback Function to call when the transfer has finished, or NULL
+    /// \param[in] context Passed to callback
+    /// \return true if the transfer was started, false if not (see spiBatchAsync()). Then the caller can use spiBurstRead() instead
+    bool              spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, 
+					RHGenericSPI::TransferCallback callback = NULL, void* context = NULL);
+
+    /// Starts writing a number of consecutive registers (or a FIFO) using burst write mode, without 
+    /// disabling interrupts for the duration. See spiBurstReadAsync().
+    /// \param[in] reg Register number of the first register
+    /// \param[in] src Array of new register values to write. Must be at least len bytes, and stay valid until the transfer has finished
+    /// \param[in] len Number of bytes to write
+    /// \param[in] callback Function to call when the transfer has finished, or NULL
+    /// \param[in] context Passed to callback
+    /// \return true if the transfer was started, false if not (see spiBatchAsync()). Then the caller can use spiBurstWrite() instead
+    bool              spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, 
+					 RHGenericSPI::TransferCallback callback = NULL, void* context = NULL);
+
+    /// Performs a batch of register reads and writes like spiBatch(), but the last one (typically a long
+    /// FIFO transfer) asynchronously, like spiBurstReadAsync() or spiBurstWriteAsync(). They are all done in one
+    /// SPI transaction, so with RHSPIBus the bus is held from the first to the end of the last. None of them
+    /// disable interrupts. callback is called when the last has finished, and spiAsyncBusy() is true until then.
+    /// \param[in,out] transactions The transactions to perform, in order. The RH_SPI_WRITE_MASK bit of
+    /// each reg is set or cleared according to its write flag. The data of the last must stay valid until it has finished
+    /// \param[in] count The number of transactions
+    /// \param[in] callback Function to call when the last transaction has finished, or NULL
+    /// \param[in] context Passed to callback
+    /// \return true if the last transaction was started, false if another asynchronous transfer is still in progress,
+    /// or the SPI interface could not be had or could not start it, or RH_SPI_ASYNC is 0. Then the caller can do the batch with spiBatch() instead
+    bool              spiBatchAsync(RHGenericSPI::Transaction* transactions, uint8_t count,
+				    RHGenericSPI::TransferCallback callback = NULL, void* context = NULL);
+
+    /// Tells whether an asynchronous transfer started by spiBurstReadAsync(), spiBurstWriteAsync() or spiBatchAsync()
+    /// is still in progress. Dont do any other SPI transfers with this driver until it has finished.
+    /// \return true if a transfer is in progress
+    bool              spiAsyncBusy()
+    {
+#if RH_SPI_ASYNC
+	return _spiAsyncBusy;
+#else
+	return false;
+#endif
+    }
+
+    /// Waits until an asynchronous transfer started by this driver has finished.
+    /// spiRead(), spiWrite(), the burst transfers and spiBatch() call it first.
+    /// Dont call it from an interrupt handler that can interrupt the transfer's completion.
+    void              spiAsyncWait()
+    {
+#if RH_SPI_ASYNC
+	while (_spiAsyncBusy)
+	    YIELD;
+#endif
+    }
+
+    /// Enables or disables the shadow registers (see "Shadow registers" above). Enabling
+    /// starts with all shadows empty. Disabled by default. Does nothing if RH_SPI_SHADOW_REGISTERS is 0 (the default).
+    /// \param[in] enabled true to answer reads of cacheable registers from their shadows
+    void              spiSetShadowEnabled(bool enabled);
+
+    /// Sets verify mode, in which reads of cacheable registers still go to the device, and are 
+    /// compared with their shadows (see spiShadowMismatches()). For testing drivers.
+    /// \param[in] verify true to verify the shadows
+    void              spiSetShadowVerify(bool verify);
+
+    /// Declares registers to be cacheable (not volatile: their values only change when written over SPI) 
+    /// or volatile (the default). Registers numbered RH_SPI_SHADOW_REGISTERS or higher are always volatile.
+    /// Usually called by the driver's init().
+    /// \param[in] reg The first register
+    /// \param[in] count The number of consecutive registers
+    /// \param[in] cacheable true if the registers are cacheable
+    void              spiSetShadowCacheable(uint8_t reg, uint8_t count = 1, bool cacheable = true);
+
+    /// Forgets the values of all the shadow registers, for example after the device has been reset.
+    void              spiInvalidateShadow();
+
+    /// Returns the number of SPI transactions saved by answering reads from the shadow registers
+    /// \return The number of transactions saved
+    uint32_t          spiTransactionsSaved()
+    {
+#if RH_SPI_SHADOW_REGISTERS
+	return _spiTransactionsSaved;
+#else
+	return 0;
+#endif
+    }
+
+    /// Returns the number of reads in verify mode where the device and the shadow register differed
+    /// \return The number of mismatches
+    uint32_t          spiShadowMismatches()
+    {
+#if RH_SPI_SHADOW_REGISTERS
+	return _spiShadowMismatches;
+#else
+	return 0;
+#endif
+    }
+
     /// Set or change the pin to be used for SPI slave select.
     /// This can be called at any time to change the
     /// pin that will be used for slave select in subsquent SPI operations.
@@ -98,6 +273,60 @@ public:
     // Override this if you need an unusual way of selecting the slave before SPI transactions
     // The default uses digitalWrite(_slaveSelectPin, HIGH)
     virtual void deselectSlave();
+
+    /// Answers a read of len consecutive registers from their shadows, if they are all cacheable 
+    /// and known, and not in verify mode
+    /// \return true if the read was answered
+    bool              spiShadowRead(uint8_t reg, uint8_t* dest, uint8_t len);
+
+    /// Updates the shadows of len consecutive registers after they were written or read.
+    /// A burst that starts at a volatile register (such as a FIFO, whose address does not 
+    /// increment) leaves the shadows alone.
+    /// \param[in] fromDevice true if the values were read from the device, so can be verified
+    void              spiShadowUpdate(uint8_t reg, const uint8_t* data, uint8_t len, bool fromDevice);
+
+#if RH_SPI_ASYNC
+    /// Called by the SPI interface when an asynchronous transfer has finished
+    /// \param[in] driver The RHSPIDriver that started the transfer
+    /// \param[in] status The octet read while the register address was sent
+    static void       spiAsyncComplete(void* driver, uint8_t status);
+
+    /// True while an asynchronous transfer is in progress
+    volatile bool       _spiAsyncBusy;
+
+    /// The register, data, length and direction of the asynchronous transfer in progress
+    uint8_t             _spiAsyncReg;
+    uint8_t*            _spiAsyncData;
+    uint8_t             _spiAsyncLen;
+    bool                _spiAsyncWrite;
+
+    /// The function to call when the asynchronous transfer has finished, and its context
+    RHGenericSPI::TransferCallback _spiAsyncCallback;
+    void*               _spiAsyncContext;
+#endif
+
+#if RH_SPI_SHADOW_REGISTERS
+    /// Number of reads answered from the shadow registers
+    uint32_t            _spiTransactionsSaved;
+
+    /// Number of verify mode reads that did not match the shadow
+    uint32_t            _spiShadowMismatches;
+
+    /// Whether reads of cacheable registers may be answered from their shadows
+    bool                _spiShadowEnabled;
+
+    /// Whether to check the shadows against the device
+    bool                _spiShadowVerify;
+
+    /// Bit mask of the cacheable registers
+    uint8_t             _spiShadowCacheable[(RH_SPI_SHADOW_REGISTERS + 7) / 8];
+
+    /// Bit mask of the registers whose shadows hold known values
+    uint8_t             _spiShadowValid[(RH_SPI_SHADOW_REGISTERS + 7) / 8];
+
+    /// The shadow copies of the registers
+    uint8_t             _spiShadow[RH_SPI_SHADOW_REGISTERS];
+#endif
     
     /// Reference to the RHGenericSPI instance to use to transfer data with the SPI device
     RHGenericSPI&       _spi;
@@ -106,4 +335,6 @@ public:
     uint8_t             _slaveSelectPin;
 };
 
+/// @example spi_async_dma.pde
+
 #endif
@@ -0,0 +1,152 @@
+// RHSpidevSPI.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHSpidevSPI.h>
+
+#ifdef RH_HAVE_SPIDEV
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+RHSpidevSPI::RHSpidevSPI(const char* device, Frequency frequency, BitOrder bitOrder, DataMode dataMode)
+    :
+    RHGenericSPI(frequency, bitOrder, dataMode),
+    _device(device),
+    _fd(-1),
+    _speedHz(1000000),
+    _noChipSelect(false),
+    _messages(0)
+{
+}
+
+void RHSpidevSPI::begin()
+{
+    // Frequency1MHz to Frequency16MHz
+    _speedHz = 1000000UL << _frequency;
+    _messages = 0;
+
+    if (_fd < 0)
+	_fd = open(_device, O_RDWR);
+    if (_fd < 0)
+    {
+	perror(_device);
+	return;
+    }
+
+    uint8_t mode = _dataMode; // DataMode0 to DataMode3 are SPI_MODE_0 to SPI_MODE_3
+    if (_noChipSelect)
+	mode |= SPI_NO_CS;
+    uint8_t lsbFirst = (_bitOrder == BitOrderLSBFirst);
+    uint8_t bits = 8;
+    if (   ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0
+	|| ioctl(_fd, SPI_IOC_WR_LSB_FIRST, &lsbFirst) < 0
+	|| ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+	|| ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &_speedHz) < 0)
+	perror(_device);
+}
+
+void RHSpidevSPI::end()
+{
+    if (_fd >= 0)
+	close(_fd);
+    _fd = -1;
+}
+
+bool RHSpidevSPI::message(struct spi_ioc_transfer* segments, uint8_t count)
+{
+    if (_fd < 0)
+	return false;
+    // SPI_IOC_MESSAGE(count), without requiring count to be a constant
+    return ioctl(_fd, _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, SPI_MSGSIZE(count)), segments) >= 0;
+}
+
+bool RHSpidevSPI::sendSegments(const uint8_t* tx0, uint8_t* rx0, uint16_t len0, 
+			       const uint8_t* tx1, uint8_t* rx1, uint16_t len1)
+{
+    struct spi_ioc_transfer segments[RH_SPIDEV_MAX_SEGMENTS];
+    memset(segments, 0, sizeof(segments));
+    // The kernel sends zeros when there is no tx_buf, and discards input when there is no rx_buf
+    segments[0].tx_buf = (unsigned long)tx0;
+    segments[0].rx_buf = (unsigned long)rx0;
+    segments[0].len = len0;
+    segments[1].tx_buf = (unsigned long)tx1;
+    segments[1].rx_buf = (unsigned long)rx1;
+    segments[1].len = len1;
+    uint8_t count = len1 ? 2 : 1;
+    for (uint8_t i = 0; i < count; i++)
+    {
+	segments[i].speed_hz = _speedHz;
+	segments[i].bits_per_word = 8;
+    }
+    _messages++;
+    return message(segments, count);
+}
+
+bool RHSpidevSPI::spiBatch(Transaction* transactions, uint8_t count)
+{
+    if (_noChipSelect || count == 0 || count > RH_SPIDEV_MAX_SEGMENTS / 2)
+	return false;
+
+    struct spi_ioc_transfer segments[RH_SPIDEV_MAX_SEGMENTS];
+    memset(segments, 0, sizeof(segments));
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+	// The address octet, then the data
+	segments[n].tx_buf = (unsigned long)&transactions[i].reg;
+	segments[n].len = 1;
+	segments[n].speed_hz = _speedHz;
+	segments[n].bits_per_word = 8;
+	n++;
+	if (transactions[i].len)
+	{
+	    if (transactions[i].write)
+		segments[n].tx_buf = (unsigned long)transactions[i].data;
+	    else
+		segments[n].rx_buf = (unsigned long)transactions[i].data;
+	    segments[n].len = transactions[i].len;
+	    segments[n].speed_hz = _speedHz;
+	    segments[n].bits_per_word = 8;
+	    n++;
+	}
+	// Release the chip select between transactions
+	if (i < count - 1)
+	    segments[n - 1].cs_change = 1;
+    }
+    _messages++;
+    if (!message(segments, n))
+    {
+	for (uint8_t i = 0; i < count; i++)
+	    if (!transactions[i].write)
+		memset(transactions[i].data, 0, transactions[i].len);
+    }
+    return true;
+}
+
+uint8_t RHSpidevSPI::transfer(uint8_t data)
+{
+    uint8_t in = 0;
+    sendSegments(&data, &in, 1, NULL, NULL, 0);
+    return in;
+}
+
+uint8_t RHSpidevSPI::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
+{
+    uint8_t status = 0;
+    if (!sendSegments(&reg, &status, 1, NULL, dest, len))
+	memset(dest, 0, len);
+    return status;
+}
+
+uint8_t RHSpidevSPI::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
+{
+    uint8_t status = 0;
+    sendSegments(&reg, &status, 1, src, NULL, len);
+    return status;
+}
+
+#endif
@@ -0,0 +1,137 @@
+// RHSpidevSPI.h
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHSpidevSPI_h
+#define RHSpidevSPI_h
+
+#include <RHGenericSPI.h>
+
+// The spidev interface is available on Linux hosts, including Raspberry Pi
+#if ((RH_PLATFORM == RH_PLATFORM_RASPI) || (RH_PLATFORM == RH_PLATFORM_UNIX)) && defined(__linux__)
+ #define RH_HAVE_SPIDEV
+#endif
+
+#ifdef RH_HAVE_SPIDEV
+#include <linux/spi/spidev.h>
+
+// Largest number of segments in one SPI message. Each register transaction is 2 segments
+#ifndef RH_SPIDEV_MAX_SEGMENTS
+ #define RH_SPIDEV_MAX_SEGMENTS 16
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSpidevSPI RHSpidevSPI.h <RHSpidevSPI.h>
+/// \brief Encapsulate a Linux spidev SPI bus interface, such as /dev/spidev0.0
+///
+/// This concrete subclass of RHGenericSPI uses the Linux kernel's spidev driver, so it works on
+/// any Linux board with an SPI controller, including Raspberry Pi (without the bcm2835 library).
+///
+/// Each spiBurstRead() and spiBurstWrite() (and so each RHSPIDriver::spiRead(), spiWrite(), 
+/// spiBurstRead() and spiBurstWrite()) is sent as a single SPI_IOC_MESSAGE ioctl, of 2 segments: 
+/// the register address octet and the data. The data goes straight to or from the callers
+/// buffer, so reading a 255 octet RH_RF95 FIFO is one system call instead of 256.
+/// RHSPIDriver::spiBatch() sends several register transactions in one ioctl.
+///
+/// The kernel drives the chip select of the spidev device for the duration of each message.
+/// Give the driver a slaveSelectPin of 0xff (RH_INVALID_PIN) so that it does not try to drive one 
+/// as well, for example:
+/// \code
+/// RHSpidevSPI spidev("/dev/spidev0.0", RHGenericSPI::Frequency8MHz);
+/// RH_RF95 driver(RH_INVALID_PIN, 25, spidev);
+/// \endcode
+/// Drivers that build multi-octet transactions from individual transfer() calls (such as RH_RF69,
+/// RH_RF24 and RH_MRF89 FIFO access) need the chip select to stay active between calls: for those, give
+/// the driver a GPIO slaveSelectPin, and call setNoChipSelect(true) before begin() so that the kernel
+/// leaves the chip select alone.
+///
+/// The ioctls are made by message(), which you can override to simulate a device without hardware.
+/// See the spidev_mock example.
+class RHSpidevSPI : public RHGenericSPI
+{
+public:
+    /// Constructor
+    /// \param[in] device Name of the spidev device to use
+    /// \param[in] frequency One of RHGenericSPI::Frequency to select the SPI bus frequency. 
+    /// The kernel uses the closest frequency the controller supports that is not faster.
+    /// \param[in] bitOrder Select the SPI bus bit order, one of RHGenericSPI::BitOrderMSBFirst or 
+    /// RHGenericSPI::BitOrderLSBFirst.
+    /// \param[in] dataMode Selects the SPI bus data mode. One of RHGenericSPI::DataMode
+    RHSpidevSPI(const char* device = "/dev/spidev0.0", Frequency frequency = Frequency1MHz, BitOrder bitOrder = BitOrderMSBFirst, DataMode dataMode = DataMode0);
+
+    /// Transfer a single octet to and from the SPI interface, as a message of its own
+    /// \param[in] data The octet to send
+    /// \return The octet read from SPI while the data octet was sent
+    uint8_t transfer(uint8_t data);
+
+    /// Sends reg then reads len octets into dest, as one SPI_IOC_MESSAGE ioctl
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[out] dest The buffer to hold the octets read
+    /// \param[in] len The number of octets to read
+    /// \return The octet read while reg was sent
+    uint8_t spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len);
+
+    /// Sends reg then writes len octets from src, as one SPI_IOC_MESSAGE ioctl
+    /// \param[in] reg The register address octet to send, including any read/write flag
+    /// \param[in] src The octets to write
+    /// \param[in] len The number of octets to write
+    /// \return The octet read while reg was sent
+    uint8_t spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len);
+
+    /// Sends a batch of register transactions as one SPI_IOC_MESSAGE ioctl, with the chip select
+    /// released between transactions (cs_change). Not possible if setNoChipSelect(true) has been called,
+    /// or if there are more than RH_SPIDEV_MAX_SEGMENTS / 2 transactions.
+    /// \param[in,out] transactions The transactions to perform, in order
+    /// \param[in] count The number of transactions
+    /// \return true if the transactions were done, false if the caller must do them one at a time
+    bool    spiBatch(Transaction* transactions, uint8_t count);
+
+    /// Opens the spidev device and sets its mode, bit order and frequency.
+    /// Failure to open the device is reported on stderr, and subsequent transfers read 0.
+    void begin();
+
+    /// Closes the spidev device
+    void end();
+
+    /// Sets whether the kernel should leave the chip select alone (SPI_NO_CS),
+    /// because the driver drives its own slave select pin. Call before begin()
+    /// \param[in] noChipSelect true to leave the chip select alone
+    void setNoChipSelect(bool noChipSelect) { _noChipSelect = noChipSelect;}
+
+    /// Returns the number of SPI messages (ioctls) sent since begin()
+    /// \return The number of messages
+    uint32_t messages() { return _messages;}
+
+protected:
+    /// Sends one SPI message of count segments to the device. The segments have been filled in
+    /// with the buffers, lengths, speed and word size. Override this to simulate a device.
+    /// \param[in] segments The segments of the message
+    /// \param[in] count The number of segments, at most RH_SPIDEV_MAX_SEGMENTS
+    /// \return true if the message was sent
+    virtual bool message(struct spi_ioc_transfer* segments, uint8_t count);
+
+    /// Sends a message of 1 or 2 segments, filling in the common fields
+    bool            sendSegments(const uint8_t* tx0, uint8_t* rx0, uint16_t len0, 
+				 const uint8_t* tx1, uint8_t* rx1, uint16_t len1);
+
+    /// The name of the spidev device
+    const char*     _device;
+
+    /// File descriptor of the open device, or -1
+    int             _fd;
+
+    /// Bus frequency in Hz
+    uint32_t        _speedHz;
+
+    /// Whether the kernel should leave the chip select alone
+    bool            _noChipSelect;
+
+    /// Number of messages sent
+    uint32_t        _messages;
+};
+
+/// @example spidev_mock.pde
+
+#endif
+#endif
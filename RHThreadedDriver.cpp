@@ -0,0 +1,333 @@
+// RHThreadedDriver.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RHThreadedDriver.h>
+
+#ifdef RH_HAVE_THREADED_DRIVER
+#include <errno.h>
+#include <time.h>
+
+RHThreadedDriver::RHThreadedDriver(RHGenericDriver& driver)
+    :
+    RHGenericDriver(),
+    _driver(driver),
+    _running(false),
+    _wakeRequested(false),
+    _interruptPending(false),
+    _configChanged(false),
+    _transmitting(false),
+    _maxMessageLength(0),
+    _lastSNR(0),
+    _lastRxTime(0),
+    _priority(RH_REALTIME_PRIORITY),
+    _cpu(RH_REALTIME_CPU),
+    _lockMemory(RH_REALTIME_LOCK_MEMORY),
+    _realtimeApplied(true),
+    _interruptTime(0),
+    _rxDropped(0),
+    _interrupts(0)
+{
+    _rxQueue.head = _rxQueue.tail = 0;
+    _txQueue.head = _txQueue.tail = 0;
+    pthread_mutex_init(&_wakeMutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#if defined(__linux__)
+    // So that poll timeouts are not upset by changes to the system time
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&_wakeCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+RHThreadedDriver::~RHThreadedDriver()
+{
+    stop();
+}
+
+bool RHThreadedDriver::init()
+{
+    if (_running)
+	return true;
+    if (!_driver.init())
+	return false;
+    _driver.setThisAddress(_thisAddress);
+    _driver.setPromiscuous(_promiscuous);
+    _maxMessageLength = _driver.maxMessageLength();
+#if RH_THREADED_MAX_MESSAGE_LEN < 255
+    if (_maxMessageLength > RH_THREADED_MAX_MESSAGE_LEN)
+	_maxMessageLength = RH_THREADED_MAX_MESSAGE_LEN;
+#endif
+    _mode = RHModeRx;
+    return start();
+}
+
+bool RHThreadedDriver::start()
+{
+    if (_running)
+	return true;
+    _running = true;
+    if (pthread_create(&_thread, NULL, run, this) != 0)
+	_running = false;
+    else
+	_realtimeApplied = applyRealtime();
+    return _running;
+}
+
+bool RHThreadedDriver::setRealtime(int priority, int cpu, bool lockMemory)
+{
+    _priority = priority;
+    _cpu = cpu;
+    _lockMemory = lockMemory;
+    if (_running)
+	_realtimeApplied = applyRealtime();
+    return _realtimeApplied;
+}
+
+bool RHThreadedDriver::applyRealtime()
+{
+    bool ok = true;
+    if (_lockMemory && !RHRealtime::lockMemory())
+	ok = false;
+    if (_cpu >= 0 && !RHRealtime::setCpu(_cpu, _thread))
+	ok = false;
+    if (_priority > 0 && !RHRealtime::setPriority(_priority, _thread))
+	ok = false;
+    return ok;
+}
+
+void RHThreadedDriver::stop()
+{
+    if (!_running)
+	return;
+    _running = false;
+    wake();
+    pthread_join(_thread, NULL);
+}
+
+void RHThreadedDriver::interrupt()
+{
+    __atomic_fetch_add(&_interrupts, 1, __ATOMIC_RELAXED);
+    // Only the first interrupt since the last was serviced is timed
+    uint64_t none = 0;
+    __atomic_compare_exchange_n(&_interruptTime, &none, RHClock::clock()->nanos() + 1,
+				false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __atomic_store_n(&_interruptPending, true, __ATOMIC_RELEASE);
+    wake();
+}
+
+bool RHThreadedDriver::available()
+{
+    return queueFront(_rxQueue) != NULL;
+}
+
+bool RHThreadedDriver::recv(uint8_t* buf, uint8_t* len)
+{
+    return recvWithInfo(buf, len, NULL);
+}
+
+bool RHThreadedDriver::recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info)
+{
+    Message* message = queueFront(_rxQueue);
+    if (!message)
+	return false;
+    _rxHeaderTo = message->info.header.to;
+    _rxHeaderFrom = message->info.header.from;
+    _rxHeaderId = message->info.header.id;
+    _rxHeaderFlags = message->info.header.flags;
+    _lastRssi = message->info.rssi;
+    _lastSNR = message->info.snr;
+    _lastRxTime = message->info.timestamp;
+    if (info)
+	*info = message->info;
+    if (buf && len)
+    {
+	if (*len > message->len)
+	    *len = message->len;
+	memcpy(buf, message->data, *len);
+    }
+    queuePop(_rxQueue);
+    _rxGood++;
+    return true;
+}
+
+bool RHThreadedDriver::send(const uint8_t* data, uint8_t len)
+{
+    MessageHeader header = { _txHeaderTo, _txHeaderFrom, _txHeaderId, _txHeaderFlags };
+    return sendWithHeader(data, len, header);
+}
+
+bool RHThreadedDriver::sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header)
+{
+    if (len > maxMessageLength())
+	return false;
+    Message* message = queueBack(_txQueue);
+    if (!message)
+	return false;
+    message->len = len;
+    message->info.header = header;
+    memcpy(message->data, data, len);
+    queuePush(_txQueue);
+    wake();
+    return true;
+}
+
+uint8_t RHThreadedDriver::maxMessageLength()
+{
+    return _maxMessageLength;
+}
+
+bool RHThreadedDriver::waitPacketSent()
+{
+    while (queueFront(_txQueue) || __atomic_load_n(&_transmitting, __ATOMIC_ACQUIRE))
+	RHPollWait(millis() + 1);
+    return true;
+}
+
+bool RHThreadedDriver::waitPacketSent(uint16_t timeout)
+{
+    unsigned long starttime = millis();
+    while ((millis() - starttime) < timeout)
+    {
+	if (!queueFront(_txQueue) && !__atomic_load_n(&_transmitting, __ATOMIC_ACQUIRE))
+	    return true;
+	RHPollWait(starttime + timeout);
+    }
+    return false;
+}
+
+void RHThreadedDriver::setThisAddress(uint8_t thisAddress)
+{
+    RHGenericDriver::setThisAddress(thisAddress);
+    __atomic_store_n(&_configChanged, true, __ATOMIC_RELEASE);
+    wake();
+}
+
+void RHThreadedDriver::setPromiscuous(bool promiscuous)
+{
+    RHGenericDriver::setPromiscuous(promiscuous);
+    __atomic_store_n(&_configChanged, true, __ATOMIC_RELEASE);
+    wake();
+}
+
+RHThreadedDriver::Message* RHThreadedDriver::queueBack(Queue& queue)
+{
+    uint32_t tail = __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+    if (queue.head - tail >= RH_THREADED_QUEUE_LEN)
+	return NULL; // Full
+    return &queue.messages[queue.head % RH_THREADED_QUEUE_LEN];
+}
+
+void RHThreadedDriver::queuePush(Queue& queue)
+{
+    // Release: the message is written before the consumer can see it
+    __atomic_store_n(&queue.head, queue.head + 1, __ATOMIC_RELEASE);
+}
+
+RHThreadedDriver::Message* RHThreadedDriver::queueFront(Queue& queue)
+{
+    uint32_t head = __atomic_load_n(&queue.head, __ATOMIC_ACQUIRE);
+    if (head == queue.tail)
+	return NULL; // Empty
+    return &queue.messages[queue.tail % RH_THREADED_QUEUE_LEN];
+}
+
+void RHThreadedDriver::queuePop(Queue& queue)
+{
+    // Release: the message has been read before the producer can reuse it
+    __atomic_store_n(&queue.tail, queue.tail + 1, __ATOMIC_RELEASE);
+}
+
+void RHThreadedDriver::wake()
+{
+    pthread_mutex_lock(&_wakeMutex);
+    _wakeRequested = true;
+    pthread_cond_signal(&_wakeCond);
+    pthread_mutex_unlock(&_wakeMutex);
+}
+
+void* RHThreadedDriver::run(void* driver)
+{
+    ((RHThreadedDriver*)driver)->service();
+    return NULL;
+}
+
+void RHThreadedDriver::service()
+{
+    while (_running)
+    {
+	if (__atomic_exchange_n(&_interruptPending, false, __ATOMIC_ACQUIRE))
+	{
+	    uint64_t interruptTime = __atomic_exchange_n(&_interruptTime, 0, __ATOMIC_RELAXED);
+	    _driver.serviceInterrupt();
+	    if (interruptTime)
+		_interruptLatency.record(RHClock::clock()->nanos() + 1 - interruptTime);
+	}
+
+	if (__atomic_exchange_n(&_configChanged, false, __ATOMIC_ACQUIRE))
+	{
+	    _driver.setThisAddress(_thisAddress);
+	    _driver.setPromiscuous(_promiscuous);
+	}
+
+	// Collect a received message. This also keeps the receiver on when not transmitting
+	if (_driver.available())
+	{
+	    Message* message = queueBack(_rxQueue);
+	    if (message)
+	    {
+		message->len = sizeof(message->data);
+		if (_driver.recvWithInfo(message->data, &message->len, &message->info))
+		    queuePush(_rxQueue);
+	    }
+	    else
+	    {
+		// No room: drop it, so the driver can receive the next one
+		uint8_t discard[RH_THREADED_MAX_MESSAGE_LEN];
+		uint8_t len = sizeof(discard);
+		if (_driver.recv(discard, &len))
+		    __atomic_fetch_add(&_rxDropped, 1, __ATOMIC_RELAXED);
+	    }
+	    continue; // There may be more to do at once
+	}
+
+	// Send the next queued message when the driver has finished the last
+	if (_driver.mode() != RHModeTx)
+	{
+	    Message* message = queueFront(_txQueue);
+	    if (message)
+	    {
+		__atomic_store_n(&_transmitting, true, __ATOMIC_RELEASE);
+		if (_driver.sendWithHeader(message->data, message->len, message->info.header))
+		    _txGood++;
+		queuePop(_txQueue);
+		continue;
+	    }
+	    __atomic_store_n(&_transmitting, false, __ATOMIC_RELEASE);
+	}
+
+	// Nothing to do: sleep until woken, or until it is time to poll the driver again
+	struct timespec ts;
+#if defined(__linux__)
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+	ts.tv_nsec += RH_POLL_INTERVAL_US * 1000L;
+	if (ts.tv_nsec >= 1000000000L)
+	{
+	    ts.tv_sec++;
+	    ts.tv_nsec -= 1000000000L;
+	}
+	pthread_mutex_lock(&_wakeMutex);
+	while (!_wakeRequested && _running)
+	    if (pthread_cond_timedwait(&_wakeCond, &_wakeMutex, &ts) == ETIMEDOUT)
+		break;
+	_wakeRequested = false;
+	pthread_mutex_unlock(&_wakeMutex);
+    }
+}
+
+#endif
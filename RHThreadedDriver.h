@@ -0,0 +1,290 @@
+// RHThreadedDriver.h
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHThreadedDriver_h
+#define RHThreadedDriver_h
+
+#include <RHGenericDriver.h>
+
+#if (RH_PLATFORM == RH_PLATFORM_RASPI) || (RH_PLATFORM == RH_PLATFORM_UNIX)
+ #define RH_HAVE_THREADED_DRIVER
+#endif
+
+#ifdef RH_HAVE_THREADED_DRIVER
+#include <pthread.h>
+#include <RHutil/RHRealtime.h>
+
+// Number of messages in each of the receive and transmit queues
+#ifndef RH_THREADED_QUEUE_LEN
+ #define RH_THREADED_QUEUE_LEN 16
+#endif
+
+// Largest message that can be queued
+#ifndef RH_THREADED_MAX_MESSAGE_LEN
+ #define RH_THREADED_MAX_MESSAGE_LEN 255
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHThreadedDriver RHThreadedDriver.h <RHThreadedDriver.h>
+/// \brief Runs another driver in a service thread of its own, on Linux and other Unix hosts
+///
+/// On Linux, interrupt handlers registered with attachInterrupt() (on Raspberry Pi with pigpio,
+/// for example) run in a different thread than the application, so the state of the driver
+/// (its mode, receive buffer etc) is changed by 2 threads at once, unprotected unless RH_USE_MUTEX
+/// is defined (and then only in RH_RF95).
+///
+/// RHThreadedDriver wraps another driver, like RHEncryptedDriver does, and gives it a service thread
+/// of its own. Only the service thread ever calls the wrapped driver after init(): it handles
+/// the interrupts, reads received messages from the driver and sends queued messages.
+/// Received messages (with their headers and RSSI) are passed to the application through a
+/// lock-free single-producer single-consumer queue, and messages to send are passed back
+/// the same way, so the application never waits for the radio or the SPI bus, and the radio is
+/// serviced promptly however busy the application is.
+///
+/// Give the wrapped driver RH_INVALID_PIN as its interrupt pin, so that it does not attach an interrupt
+/// handler of its own, and instead arrange for interrupt() to be called when the radio interrupts.
+/// The service thread then calls the driver's RHGenericDriver::serviceInterrupt()
+/// (which RH_RF95 supports). For example on Raspberry Pi:
+/// \code
+/// RH_RF95 rf95(8, RH_INVALID_PIN);
+/// RHThreadedDriver driver(rf95);
+/// RHReliableDatagram manager(driver, 1);
+/// void radioInterrupt() { driver.interrupt(); }
+/// ...
+/// manager.init(); // Also starts the service thread
+/// attachInterrupt(25, radioInterrupt, RISING);
+/// \endcode
+/// Without interrupts the service thread polls the driver every RH_POLL_INTERVAL_US, which suits drivers
+/// such as RH_TCP and RH_Serial.
+///
+/// send() queues a message (up to RH_THREADED_QUEUE_LEN), and returns at once. When the receive queue
+/// is full, further received messages are dropped and counted by rxDropped().
+/// The wrapper has its own header settings and received headers, so use its setHeaderTo() etc, or
+/// put a manager on top of it as usual. setThisAddress() and setPromiscuous() are passed on to
+/// the wrapped driver by the service thread. Configure anything else in the driver before init().
+///
+/// Each queue has a single producer and single consumer: call the RHThreadedDriver (or the manager
+/// using it) from one application thread only.
+///
+/// On a busy host, use setRealtime() (or define RH_REALTIME_PRIORITY etc, see RHutil/RHRealtime.h)
+/// to give the service thread SCHED_FIFO priority, pin it to a CPU and lock memory, so it services the radio
+/// as soon as it interrupts. interruptLatency() measures the time from each interrupt() until the
+/// driver's serviceInterrupt() (which reads the FIFO) has finished.
+///
+/// The threaded_driver example tests it with a simulated radio.
+class RHThreadedDriver : public RHGenericDriver
+{
+public:
+    /// Constructor
+    /// \param[in] driver The driver to run in the service thread
+    RHThreadedDriver(RHGenericDriver& driver);
+
+    /// Destructor. Stops the service thread
+    ~RHThreadedDriver();
+
+    /// Initialises the wrapped driver (in the calling thread), then starts the service thread
+    /// \return true if both succeeded
+    bool            init();
+
+    /// Starts the service thread, if it is not running. init() calls this
+    /// \return true if the thread is running
+    bool            start();
+
+    /// Stops the service thread, and waits for it to finish.
+    /// Then it is safe to use the wrapped driver directly again.
+    void            stop();
+
+    /// Tells the service thread that the radio has interrupted, so it calls the driver's
+    /// serviceInterrupt(). Call this from the interrupt handler. Safe to call from any thread
+    void            interrupt();
+
+    /// Tells whether a received message is waiting in the receive queue
+    /// \return true if recv() will return a message
+    bool            available();
+
+    /// Takes the next message from the receive queue, and makes its headers, RSSI, SNR and time available with
+    /// headerTo(), headerFrom(), headerId(), headerFlags(), lastRssi(), lastSNR() and lastRxTime()
+    /// \param[in] buf Location to copy the received message. May be NULL
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \return true if a message was copied to buf
+    bool            recv(uint8_t* buf, uint8_t* len);
+
+    /// Takes the next message from the receive queue, with its headers, RSSI, SNR and time as the
+    /// service thread collected them from the wrapped driver
+    /// \param[in] buf Location to copy the received message. May be NULL
+    /// \param[in,out] len Pointer to available space in buf. Set to the actual number of octets copied.
+    /// \param[out] info Set to the headers etc of the message. May be NULL
+    /// \return true if a message was copied to buf
+    bool            recvWithInfo(uint8_t* buf, uint8_t* len, RxMessageInfo* info);
+
+    /// Queues a message to be sent, with the current header settings, and returns at once.
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \return true if the message was queued, false if it is too long or the transmit queue is full
+    bool            send(const uint8_t* data, uint8_t len);
+
+    /// Queues a message to be sent with the headers given, and returns at once. The header settings
+    /// are not changed, so several threads may queue messages with different headers (one at a time)
+    /// \param[in] data Array of data to be sent
+    /// \param[in] len Number of bytes of data to send
+    /// \param[in] header The headers to send with the message
+    /// \return true if the message was queued, false if it is too long or the transmit queue is full
+    bool            sendWithHeader(const uint8_t* data, uint8_t len, const MessageHeader& header);
+
+    /// Returns the SNR of the last message taken by recv()
+    /// \return The SNR in dB, or 0 if the wrapped driver does not measure it
+    int             lastSNR() { return _lastSNR;}
+
+    /// Returns when the wrapped driver received the last message taken by recv()
+    /// \return The time as returned by millis()
+    uint32_t        lastRxTime() { return _lastRxTime;}
+
+    /// Returns the maximum message length of the wrapped driver, limited to RH_THREADED_MAX_MESSAGE_LEN
+    /// \return The maximum legal message length
+    uint8_t         maxMessageLength();
+
+    /// Waits until all queued messages have been sent
+    /// \return true
+    bool            waitPacketSent();
+
+    /// Waits until all queued messages have been sent, or the timeout
+    /// \param[in] timeout Maximum time to wait in milliseconds.
+    /// \return true if all messages were sent within the timeout
+    bool            waitPacketSent(uint16_t timeout);
+
+    /// Sets the address of this node, which the service thread passes to the wrapped driver
+    /// \param[in] thisAddress The address of this node.
+    void            setThisAddress(uint8_t thisAddress);
+
+    /// Sets promiscuous mode, which the service thread passes to the wrapped driver
+    /// \param[in] promiscuous true if you wish to receive messages with any TO address
+    void            setPromiscuous(bool promiscuous);
+
+    /// Returns the number of received messages dropped because the receive queue was full
+    /// \return The number of messages
+    uint32_t        rxDropped() { return __atomic_load_n(&_rxDropped, __ATOMIC_RELAXED);}
+
+    /// Returns the number of calls to interrupt()
+    /// \return The number of interrupts
+    uint32_t        interrupts() { return __atomic_load_n(&_interrupts, __ATOMIC_RELAXED);}
+
+    /// Sets the real time options of the service thread. When it is running they are applied at once,
+    /// otherwise when start() (or init()) starts it. The defaults come from RH_REALTIME_PRIORITY,
+    /// RH_REALTIME_CPU and RH_REALTIME_LOCK_MEMORY.
+    /// \param[in] priority SCHED_FIFO priority, 1 to 99, or 0 to leave the scheduling alone
+    /// \param[in] cpu The CPU to pin the thread to, or -1 to leave the affinity alone
+    /// \param[in] lockMemory true to lock all the memory of the process with mlockall
+    /// \return true if the options were applied, or will be when the thread starts
+    bool            setRealtime(int priority, int cpu = -1, bool lockMemory = false);
+
+    /// Tells whether the real time options were applied when the service thread last started
+    /// \return false if any of them were refused (usually for lack of privileges)
+    bool            realtimeApplied() { return _realtimeApplied;}
+
+    /// Returns the histogram of latencies from interrupt() to the end of the driver's
+    /// serviceInterrupt(), recorded by the service thread. When more interrupts arrive before the first
+    /// is serviced, the latency is measured from the first
+    /// \return The histogram. Call reset() on it to start again
+    RHLatencyHistogram& interruptLatency() { return _interruptLatency;}
+
+protected:
+    /// A queued message and its headers. Messages to send only use info.header
+    typedef struct
+    {
+	uint8_t        len;
+	RxMessageInfo  info;
+	uint8_t        data[RH_THREADED_MAX_MESSAGE_LEN];
+    } Message;
+
+    /// Lock-free single-producer single-consumer queue of messages. The producer only writes
+    /// head, and the consumer only writes tail
+    typedef struct
+    {
+	Message     messages[RH_THREADED_QUEUE_LEN];
+	uint32_t    head;
+	uint32_t    tail;
+    } Queue;
+
+    /// Returns the free message at the back of a queue for the producer to fill, or NULL if the queue is full
+    static Message* queueBack(Queue& queue);
+
+    /// Adds the message returned by queueBack() to the queue
+    static void     queuePush(Queue& queue);
+
+    /// Returns the message at the front of a queue for the consumer, or NULL if the queue is empty
+    static Message* queueFront(Queue& queue);
+
+    /// Removes the message returned by queueFront() from the queue
+    static void     queuePop(Queue& queue);
+
+    /// Wakes the service thread
+    void            wake();
+
+    /// Start routine of the service thread
+    static void*    run(void* driver);
+
+    /// The service thread's loop
+    void            service();
+
+    /// Applies the real time options to the service thread
+    /// \return true if successful
+    bool            applyRealtime();
+
+    /// The wrapped driver
+    RHGenericDriver& _driver;
+
+    /// Received messages, from the service thread to the application
+    Queue           _rxQueue;
+
+    /// Messages to send, from the application to the service thread
+    Queue           _txQueue;
+
+    /// The service thread
+    pthread_t       _thread;
+
+    /// True while the service thread should run
+    volatile bool   _running;
+
+    /// The service thread sleeps on this when there is nothing to do
+    pthread_mutex_t _wakeMutex;
+    pthread_cond_t  _wakeCond;
+    bool            _wakeRequested;
+
+    /// Set by interrupt(), cleared by the service thread
+    bool            _interruptPending;
+
+    /// Set when the address or promiscuous mode have changed
+    bool            _configChanged;
+
+    /// True from when the service thread takes a message from the transmit queue until the driver has sent it
+    bool            _transmitting;
+
+    /// Maximum message length, from the driver
+    uint8_t         _maxMessageLength;
+
+    /// SNR and time of the last message taken by recv()
+    int16_t         _lastSNR;
+    uint32_t        _lastRxTime;
+
+    /// Real time options for the service thread
+    int             _priority;
+    int             _cpu;
+    bool            _lockMemory;
+    bool            _realtimeApplied;
+
+    /// Time of the first unserviced interrupt() by RHClock, plus 1 so that 0 means none
+    uint64_t        _interruptTime;
+
+    /// Statistics
+    uint32_t        _rxDropped;
+    uint32_t        _interrupts;
+    RHLatencyHistogram _interruptLatency;
+};
+
+/// @example threaded_driver.pde
+/// @example threaded_latency.pde
+
+#endif
+#endif
@@ -46,6 +46,33 @@ static uint8_t symbols[] =
     0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34
 };
 
+// 6 bit to 4 bit symbol converter table, the reverse of symbols[]
+// Indexed by the received 6 bit symbol. Gives the 4 bit value, or
+// RH_ASK_INVALID_SYMBOL if the 6 bit symbol is not one of symbols[].
+// On AVR it lives in flash to save 64 bytes of precious RAM. Elsewhere
+// keep it in RAM, since some processors cant read flash in interrupt handlers
+#define RH_ASK_INVALID_SYMBOL 0x10
+#if defined(__AVR__)
+PROGMEM static const uint8_t symbols_6to4[64] =
+#else
+static uint8_t symbols_6to4[64] =
+#endif
+{
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x01, 0x10,
+    0x10, 0x10, 0x10, 0x02, 0x10, 0x03, 0x04, 0x10,
+    0x10, 0x05, 0x06, 0x10, 0x07, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x08, 0x10, 0x09, 0x0a, 0x10,
+    0x10, 0x0b, 0x0c, 0x10, 0x0d, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x0e, 0x10, 0x0f, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+};
+#if defined(__AVR__)
+ #define RH_ASK_SYMBOL_6TO4(s) pgm_read_byte(&symbols_6to4[(s)])
+#else
+ #define RH_ASK_SYMBOL_6TO4(s) (symbols_6to4[(s)])
+#endif
+
 // This is the value of the start symbol after 6-bit conversion and nybble swapping
 #define RH_ASK_START_SYMBOL 0xb38
 
@@ -56,20 +83,52 @@ RH_ASK::RH_ASK(uint16_t speed, uint8_t rxPin, uint8_t txPin, uint8_t pttPin, boo
     _txPin(txPin),
     _pttPin(pttPin),
     _rxInverted(false),
-    _pttInverted(pttInverted)
+    _pttInverted(pttInverted),
+    _rxBadSymbols(0),
+    _rxRepairedSymbols(0)
 {
     // Initialise the first 8 nibbles of the tx buffer to be the standard
     // preamble. We will append messages after that. 0x38, 0x2c is the start symbol before
     // 6-bit conversion to RH_ASK_START_SYMBOL
     uint8_t preamble[RH_ASK_PREAMBLE_LEN] = {0x2a, 0x2a, 0x2a, 0x2a, 0x2a, 0x2a, 0x38, 0x2c};
     memcpy(_txBuf, preamble, sizeof(preamble));
+
+    setSamplesPerBit(RH_ASK_RX_SAMPLES_PER_BIT);
+    _useTimer = true;
+    _txLevel = false;
+
+    // Receiver starts out hunting for a start symbol
+    _rxBufFull = false;
+    _rxBufValid = false;
+    _rxActive = false;
+    _rxBits = 0;
+}
+
+bool RH_ASK::setSamplesPerBit(uint8_t samplesPerBit)
+{
+    if (samplesPerBit != 4 && samplesPerBit != 8 && samplesPerBit != 16)
+	return false;
+
+    _samplesPerBit = samplesPerBit;
+    rampIncrements(samplesPerBit, &_rampInc, &_rampIncRetard, &_rampIncAdvance);
+    return true;
+}
+
+void RH_ASK::rampIncrements(uint8_t samplesPerBit, uint8_t* inc, uint8_t* incRetard, uint8_t* incAdvance)
+{
+    // Scale the ramp increments for the number of samples per bit. The adjustment
+    // is the same fraction of the standard increment as RH_ASK_RAMP_ADJUST 
+    // is of RH_ASK_RAMP_INC with 8 samples per bit
+    *inc = RH_ASK_RX_RAMP_LEN / samplesPerBit;
+    uint8_t adjust = (*inc * RH_ASK_RAMP_ADJUST + (RH_ASK_RX_RAMP_LEN / 16)) / (RH_ASK_RX_RAMP_LEN / 8);
+    *incRetard = *inc - adjust;
+    *incAdvance = *inc + adjust;
 }
 
 bool RH_ASK::init()
 {
     if (!RHGenericDriver::init())
 	return false;
-    thisASKDriver = this;
 
 #if (RH_PLATFORM == RH_PLATFORM_GENERIC_AVR8)
  #ifdef RH_ASK_PTT_PIN 				
@@ -80,16 +139,26 @@ bool RH_ASK::init()
     RH_ASK_TX_DDR   |=  (1<<RH_ASK_TX_PIN);
     RH_ASK_RX_DDR   &= ~(1<<RH_ASK_RX_PIN);
  #endif
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+    // No IO pins on the host: use modulate() and demodulate()
 #else
     // Set up digital IO pins for arduino
-    pinMode(_txPin, OUTPUT);
-    pinMode(_rxPin, INPUT);
-    pinMode(_pttPin, OUTPUT);
+    if (_txPin != RH_INVALID_PIN)
+	pinMode(_txPin, OUTPUT);
+    if (_rxPin != RH_INVALID_PIN)
+	pinMode(_rxPin, INPUT);
+    if (_pttPin != RH_INVALID_PIN)
+	pinMode(_pttPin, OUTPUT);
 #endif
 
     // Ready to go
     setModeIdle();
-    timerSetup();
+    if (_useTimer)
+    {
+	// The timer interrupt handlers find this instance through thisASKDriver
+	thisASKDriver = this;
+	timerSetup();
+    }
 
     return true;
 }
@@ -160,12 +229,13 @@ uint8_t RH_ASK::timerCalc(uint16_t speed, uint16_t max_ticks, uint16_t *nticks)
 #endif
 }
 
-// The idea here is to get 8 timer interrupts per bit period
+// The idea here is to get samplesPerBit() timer interrupts per bit period
+// The calculations below all give 8 interrupts per bit at timerSpeed()
 void RH_ASK::timerSetup()
 {
 #if (RH_PLATFORM == RH_PLATFORM_GENERIC_AVR8)
     uint16_t nticks;
-    uint8_t prescaler = timerCalc(_speed, (uint16_t)-1, &nticks);
+    uint8_t prescaler = timerCalc(timerSpeed(), (uint16_t)-1, &nticks);
     if (!prescaler) return;
     _COMB(TCCR,RH_ASK_TIMER_INDEX,A)= 0;					
     _COMB(TCCR,RH_ASK_TIMER_INDEX,B)= _BV(WGM12);				
@@ -176,7 +246,7 @@ void RH_ASK::timerSetup()
 #elif (RH_PLATFORM == RH_PLATFORM_MSP430) // LaunchPad specific
     // Calculate the counter overflow count based on the required bit speed
     // and CPU clock rate
-    uint16_t ocr1a = (F_CPU / 8UL) / _speed;
+    uint16_t ocr1a = (F_CPU / 8UL) / timerSpeed();
     
     // This code is for Energia/MSP430
     TA0CCR0 = ocr1a;				// Ticks for 62,5 us
@@ -196,7 +266,7 @@ void RH_ASK::timerSetup()
 #ifdef BOARD_NAME
     void interrupt(HardwareTimer*); // defined below
     // ST's Arduino Core STM32, https://github.com/stm32duino/Arduino_Core_STM32
-    uint16_t us=(1000000/8)/_speed;
+    uint16_t us=(1000000/8)/timerSpeed();
     timer.setMode(1, TIMER_OUTPUT_COMPARE);
     timer.setOverflow(us, MICROSEC_FORMAT);
     timer.setCaptureCompare(1, us - 1, MICROSEC_COMPARE_FORMAT);
@@ -205,7 +275,7 @@ void RH_ASK::timerSetup()
 #else
     void interrupt(); // defined below
     // Roger Clark Arduino STM32, https://github.com/rogerclarkmelbourne/Arduino_STM32
-    timer.setPeriod((1000000/8)/_speed);
+    timer.setPeriod((1000000/8)/timerSpeed());
     // Set up an interrupt on channel 1
     timer.setChannel1Mode(TIMER_OUTPUT_COMPARE);
     timer.setCompare(TIMER_CH1, 1);  // Interrupt 1 count after each update
@@ -223,7 +293,7 @@ void RH_ASK::timerSetup()
     // REVISIT: does not correctly handle 1MHz clock speeds, only works with 8MHz clocks
     // At 1MHz clock, get 1/8 of the expected baud rate
     uint16_t nticks;
-    uint8_t prescaler = timerCalc(_speed, (uint8_t)-1, &nticks);
+    uint8_t prescaler = timerCalc(timerSpeed(), (uint8_t)-1, &nticks);
     if (!prescaler)
         return; // fault
 
@@ -252,12 +322,12 @@ void RH_ASK::timerSetup()
     volatile TCB_t* timer = &RH_ATTINY_MEGA_ASK_TIMER;
 
     // Calculate compare value
-    uint32_t compare_val = F_CPU / _speed / 8 - 1;
+    uint32_t compare_val = F_CPU / timerSpeed() / 8 - 1;
     // If compare larger than 16bits, need to prescale (will be DIV64)
     if (compare_val > 0xFFFF)
     {
         // recalculate with new prescaler
-        compare_val = F_CPU / _speed / 8 / 64 - 1;
+        compare_val = F_CPU / timerSpeed() / 8 / 64 - 1;
 	// Prescaler needed
         timer->CTRLA = TCB_CLKSEL_CLKTCA_gc;
     }
@@ -288,7 +358,7 @@ void RH_ASK::timerSetup()
     // on Teensy 3.0 (32 bit ARM), use an interval timer
     IntervalTimer *t = new IntervalTimer();
     void TIMER1_COMPA_vect(void);
-    t->begin(TIMER1_COMPA_vect, 125000 / _speed);
+    t->begin(TIMER1_COMPA_vect, 125000 / timerSpeed());
 
  #elif defined (__arm__) && defined(ARDUINO_ARCH_SAMD)
     // Arduino Zero
@@ -313,7 +383,7 @@ void RH_ASK::timerSetup()
     while (TC->STATUS.bit.SYNCBUSY == 1); // wait for sync
 
     // Compute the count required to achieve the requested baud (with 8 interrupts per bit)
-    uint32_t rc = (VARIANT_MCK / _speed) / RH_ASK_ZERO_PRESCALER / 8;
+    uint32_t rc = (VARIANT_MCK / timerSpeed()) / RH_ASK_ZERO_PRESCALER / 8;
     
     TC->CTRLA.reg |= TC_CTRLA_PRESCALER_DIV64;   // Set prescaler to agree with RH_ASK_ZERO_PRESCALER
     while (TC->STATUS.bit.SYNCBUSY == 1); // wait for sync
@@ -346,7 +416,7 @@ void RH_ASK::timerSetup()
     
     // Clock speed 4 can handle all reasonable _speeds we might ask for. Its divisor is 128
     // and we want 8 interrupts per bit
-    uint32_t rc = (VARIANT_MCK / _speed) / 128 / 8;
+    uint32_t rc = (VARIANT_MCK / timerSpeed()) / 128 / 8;
     TC_Configure(RH_ASK_DUE_TIMER, RH_ASK_DUE_TIMER_CHANNEL, 
 		 TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_TCCLKS_TIMER_CLOCK4);
     TC_SetRC(RH_ASK_DUE_TIMER, RH_ASK_DUE_TIMER_CHANNEL, rc);
@@ -360,7 +430,7 @@ void RH_ASK::timerSetup()
     // This is the path for most Arduinos
     // figure out prescaler value and counter match value
   #if defined(RH_ASK_ARDUINO_USE_TIMER2)
-    prescaler = timerCalc(_speed, (uint8_t)-1, &nticks);
+    prescaler = timerCalc(timerSpeed(), (uint8_t)-1, &nticks);
     if (!prescaler)
         return; // fault
     // Use timer 2
@@ -381,7 +451,7 @@ void RH_ASK::timerSetup()
    #endif // TIMSK2
   #else
     // Use timer 1
-    prescaler = timerCalc(_speed, (uint16_t)-1, &nticks);    
+    prescaler = timerCalc(timerSpeed(), (uint16_t)-1, &nticks);    
     if (!prescaler)
         return; // fault
     TCCR1A = 0; // Output Compare pins disconnected
@@ -412,7 +482,7 @@ void RH_ASK::timerSetup()
     TIM_TimeBaseInitTypeDef timerInitStructure;
     NVIC_InitTypeDef nvicStructure;
     TIM_TypeDef* TIMx;
-    uint32_t period = (1000000 / 8) / _speed; // In microseconds
+    uint32_t period = (1000000 / 8) / timerSpeed(); // In microseconds
     uint16_t prescaler = (uint16_t)(SYSCORECLOCK / 1000000UL) - 1; //To get TIM counter clock = 1MHz
 
     attachSystemInterrupt(SysInterrupt_TIM6_Update, TimerInterruptHandler);
@@ -441,13 +511,13 @@ void RH_ASK::timerSetup()
 #elif (RH_PLATFORM == RH_PLATFORM_UNO32)
     // Under old MPIDE, which has been discontinued:
     // ON Uno32 we use timer1
-    OpenTimer1(T1_ON | T1_PS_1_1 | T1_SOURCE_INT, (F_CPU / 8) / _speed);
+    OpenTimer1(T1_ON | T1_PS_1_1 | T1_SOURCE_INT, (F_CPU / 8) / timerSpeed());
     ConfigIntTimer1(T1_INT_ON | T1_INT_PRIOR_1);
 
 #elif (RH_PLATFORM == RH_PLATFORM_ESP8266)
     void RH_INTERRUPT_ATTR esp8266_timer_interrupt_handler(); // Forward declaration
     // The - 120 is a heuristic to correct for interrupt handling overheads
-    _timerIncrement = (clockCyclesPerMicrosecond() * 1000000 / 8 / _speed) - 120;
+    _timerIncrement = (clockCyclesPerMicrosecond() * 1000000 / 8 / timerSpeed()) - 120;
     timer0_isr_init();
     timer0_attachInterrupt(esp8266_timer_interrupt_handler);
     timer0_write(ESP.getCycleCount() + _timerIncrement);
@@ -456,7 +526,7 @@ void RH_ASK::timerSetup()
     void RH_INTERRUPT_ATTR esp32_timer_interrupt_handler(); // Forward declaration
     timer = timerBegin(0, 80, true); // Alarm value will be in in us
     timerAttachInterrupt(timer, &esp32_timer_interrupt_handler, true);
-    timerAlarmWrite(timer, 1000000 / _speed / 8, true);
+    timerAlarmWrite(timer, 1000000 / timerSpeed() / 8, true);
     timerAlarmEnable(timer);
 #endif
 
@@ -533,24 +603,14 @@ bool RH_INTERRUPT_ATTR RH_ASK::recv(uint8_t* buf, uint8_t* len)
     return true;
 }
 
-// Caution: this may block
-bool RH_ASK::send(const uint8_t* data, uint8_t len)
+// Encode the message into 6 bit symbols at p, and return the number of symbols
+uint8_t RH_ASK::encodeMessage(const uint8_t* data, uint8_t len, uint8_t* p)
 {
     uint8_t i;
     uint16_t index = 0;
     uint16_t crc = 0xffff;
-    uint8_t *p = _txBuf + RH_ASK_PREAMBLE_LEN; // start of the message area
     uint8_t count = len + 3 + RH_ASK_HEADER_LEN; // Added byte count and FCS and headers to get total number of bytes
 
-    if (len > RH_ASK_MAX_MESSAGE_LEN)
-	return false;
-
-    // Wait for transmitter to become available
-    waitPacketSent();
-
-    if (!waitCAD()) 
-	return false;  // Check channel activity
-
     // Encode the message length
     crc = RHcrc_ccitt_update(crc, count);
     p[index++] = symbols[count >> 4];
@@ -588,8 +648,23 @@ bool RH_ASK::send(const uint8_t* data, uint8_t len)
     p[index++] = symbols[(crc >> 12) & 0xf];
     p[index++] = symbols[(crc >> 8)  & 0xf];
 
-    // Total number of 6-bit symbols to send
-    _txBufLen = index + RH_ASK_PREAMBLE_LEN;
+    return index;
+}
+
+// Caution: this may block
+bool RH_ASK::send(const uint8_t* data, uint8_t len)
+{
+    if (len > RH_ASK_MAX_MESSAGE_LEN)
+	return false;
+
+    // Wait for transmitter to become available
+    waitPacketSent();
+
+    if (!waitCAD()) 
+	return false;  // Check channel activity
+
+    // Total number of 6-bit symbols to send, after the preamble
+    _txBufLen = RH_ASK_PREAMBLE_LEN + encodeMessage(data, len, _txBuf + RH_ASK_PREAMBLE_LEN);
 
     // Start the low level interrupt handler sending symbols
     setModeTx();
@@ -603,8 +678,10 @@ bool RH_INTERRUPT_ATTR RH_ASK::readRx()
     bool value;
 #if (RH_PLATFORM == RH_PLATFORM_GENERIC_AVR8)
     value = ((RH_ASK_RX_PORT & (1<<RH_ASK_RX_PIN)) ? 1 : 0);
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+    value = 0; // No rx pin on the host
 #else
-    value = digitalRead(_rxPin);
+    value = (_rxPin != RH_INVALID_PIN) ? digitalRead(_rxPin) : 0;
 #endif
     return value ^ _rxInverted;
 }
@@ -617,8 +694,11 @@ void RH_INTERRUPT_ATTR RH_ASK::writeTx(bool value)
 // No longer relevant: PinStatus onlty used in old versions
 //#elif (RH_PLATFORM == RH_PLATFORM_ATTINY_MEGA)
 //    digitalWrite(_txPin, (PinStatus)value);
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+    (void)value; // No tx pin on the host
 #else
-    digitalWrite(_txPin, value);
+    if (_txPin != RH_INVALID_PIN)
+	digitalWrite(_txPin, value);
 #endif
 }
 
@@ -634,8 +714,11 @@ void RH_INTERRUPT_ATTR RH_ASK::writePtt(bool value)
 // This no longer relevant: ater version use uint8_t
 //#elif (RH_PLATFORM == RH_PLATFORM_ATTINY_MEGA)
 //    digitalWrite(_txPin, (PinStatus)(value ^ _pttInverted));
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+    (void)value; // No ptt pin on the host
 #else
-    digitalWrite(_pttPin, value ^ _pttInverted);
+    if (_pttPin != RH_INVALID_PIN)
+	digitalWrite(_pttPin, value ^ _pttInverted);
 #endif
 }
 
@@ -728,7 +811,7 @@ interrupt(TIMER0_A0_VECTOR) Timer_A_int(void)
 uint32_t chipkit_timer_interrupt_handler(uint32_t currentTime) 
 {
     thisASKDriver->handleTimerInterrupt();
-    return (currentTime + ((CORE_TICK_RATE * 1000)/8)/thisASKDriver->speed());
+    return (currentTime + ((CORE_TICK_RATE * 1000)/8)/thisASKDriver->timerSpeed());
 }
 
 #elif (RH_PLATFORM == RH_PLATFORM_UNO32)
@@ -766,20 +849,66 @@ ISR(RH_ATTINY_MEGA_ASK_TIMER_VECTOR)
 #endif
 
 // Convert a 6 bit encoded symbol into its 4 bit decoded equivalent
+// Returns 0 if the symbol is not valid
 uint8_t RH_INTERRUPT_ATTR RH_ASK::symbol_6to4(uint8_t symbol)
 {
+    return RH_ASK_SYMBOL_6TO4(symbol & 0x3f) & 0xf;
+}
+
+// Convert 12 received bits (2 6 bit symbols, the 6 lsbits are the high nybble)
+// into the decoded byte. Returns a value > 0xff if either symbol is not valid
+uint16_t RH_INTERRUPT_ATTR RH_ASK::symbol_12to8(uint16_t bits)
+{
+    uint8_t hi = RH_ASK_SYMBOL_6TO4(bits & 0x3f);
+    uint8_t lo = RH_ASK_SYMBOL_6TO4((bits >> 6) & 0x3f);
+    if ((hi | lo) & RH_ASK_INVALID_SYMBOL)
+	return 0x100;
+    return (hi << 4) | lo;
+}
+
+// Try to repair a single 6 bit symbol with one bad bit, by flipping its least 
+// confident bit. Symbols are received as bits first to first+5 of the current byte
+uint8_t RH_INTERRUPT_ATTR RH_ASK::repairSymbol(uint8_t symbol, uint8_t first)
+{
+    uint8_t value = RH_ASK_SYMBOL_6TO4(symbol);
+    if (value != RH_ASK_INVALID_SYMBOL)
+	return value; // Nothing to repair
+
+    // Every valid symbol has 3 ones. With a single bit error there are 2 or 4, and
+    // the bad bit is one of the 0s or one of the 1s respectively
+    uint8_t ones = 0;
     uint8_t i;
-    uint8_t count;
-    
-    // Linear search :-( Could have a 64 byte reverse lookup table?
-    // There is a little speedup here courtesy Ralph Doncaster:
-    // The shortcut works because bit 5 of the symbol is 1 for the last 8
-    // symbols, and it is 0 for the first 8.
-    // So we only have to search half the table
-    for (i = (symbol>>2) & 8, count=8; count-- ; i++)
-	if (symbol == symbols[i]) return i;
+    for (i = 0; i < 6; i++)
+	ones += (symbol >> i) & 1;
+    if (ones != 2 && ones != 4)
+	return RH_ASK_INVALID_SYMBOL;
+    uint8_t badValue = (ones == 4);
+
+    uint8_t weakest = 0;
+    uint8_t weakestConfidence = 0xff;
+    for (i = 0; i < 6; i++)
+    {
+	if (((symbol >> i) & 1) == badValue && _rxConfidence[first + i] < weakestConfidence)
+	{
+	    weakest = i;
+	    weakestConfidence = _rxConfidence[first + i];
+	}
+    }
+    // Only repair marginal bits. The FCS will catch any bad repairs
+    if (weakestConfidence > _samplesPerBit / 2)
+	return RH_ASK_INVALID_SYMBOL;
+    return RH_ASK_SYMBOL_6TO4(symbol ^ (1 << weakest));
+}
 
-    return 0; // Not found
+// Try to repair an invalid pair of symbols. Returns a value > 0xff if it cant
+uint16_t RH_INTERRUPT_ATTR RH_ASK::repairSymbols(uint16_t bits)
+{
+    uint8_t hi = repairSymbol(bits & 0x3f, 0);
+    uint8_t lo = repairSymbol((bits >> 6) & 0x3f, 6);
+    if ((hi | lo) & RH_ASK_INVALID_SYMBOL)
+	return 0x100;
+    _rxRepairedSymbols++;
+    return (hi << 4) | lo;
 }
 
 // Check whether the latest received message is complete and uncorrupted
@@ -815,119 +944,255 @@ void RH_ASK::validateRxBuf()
 
 void RH_INTERRUPT_ATTR RH_ASK::receiveTimer()
 {
-    bool rxSample = readRx();
+    receiveSample(readRx());
+}
 
-    // Integrate each sample
+void RH_INTERRUPT_ATTR RH_ASK::receiveSample(bool rxSample)
+{
+    // Integrate each sample: up for high, down for low
     if (rxSample)
 	_rxIntegrator++;
+    else
+	_rxIntegrator--;
 
     if (rxSample != _rxLastSample)
     {
 	// Transition, advance if ramp > 80, retard if < 80
 	_rxPllRamp += ((_rxPllRamp < RH_ASK_RAMP_TRANSITION) 
-			   ? RH_ASK_RAMP_INC_RETARD 
-			   : RH_ASK_RAMP_INC_ADVANCE);
+			   ? _rampIncRetard 
+			   : _rampIncAdvance);
 	_rxLastSample = rxSample;
     }
     else
     {
 	// No transition
-	// Advance ramp by standard 20 (== 160/8 samples)
-	_rxPllRamp += RH_ASK_RAMP_INC;
+	// Advance ramp by standard 20 (== 160/8 samples per bit)
+	_rxPllRamp += _rampInc;
     }
     if (_rxPllRamp >= RH_ASK_RX_RAMP_LEN)
     {
-	// Add this to the 12th bit of _rxBits, LSB first
-	// The last 12 bits are kept
-	_rxBits >>= 1;
-
-	// Check the integrator to see how many samples in this cycle were high.
-	// If < 5 out of 8, then its declared a 0 bit, else a 1;
-	if (_rxIntegrator >= 5)
-	    _rxBits |= 0x800;
-
+	// The integrator says how many more samples in this cycle were high than low
+	int8_t integrator = _rxIntegrator;
 	_rxPllRamp -= RH_ASK_RX_RAMP_LEN;
 	_rxIntegrator = 0; // Clear the integral for the next cycle
+	receiveIntegral(integrator);
+    }
+}
+
+// Decide the bit from the integral of one bit period, and how confident we are in it
+bool RH_INTERRUPT_ATTR RH_ASK::receiveIntegral(int8_t integrator)
+{
+    // More high samples than low is a 1, so with 8 samples per bit 5 or more
+    // high samples is a 1. The PLL makes some bit periods a sample or more longer or 
+    // shorter than samplesPerBit(), so count both rather than just the highs.
+    // Confidence is how far the integral is from a tie
+    if (integrator > 0)
+	return receiveBit(true, integrator);
+    else
+	return receiveBit(false, -integrator);
+}
+
+bool RH_INTERRUPT_ATTR RH_ASK::receiveBit(bool bit, uint8_t confidence)
+{
+    // Previous message not yet checked
+    if (_rxBufFull)
+	return false;
 
-	if (_rxActive)
+    // Add this to the 12th bit of _rxBits, LSB first
+    // The last 12 bits are kept
+    _rxBits >>= 1;
+    if (bit)
+	_rxBits |= 0x800;
+
+    if (_rxActive)
+    {
+	// We have the start symbol and now we are collecting message bits,
+	// 6 per symbol, each which has to be decoded to 4 bits
+	_rxConfidence[_rxBitCount] = confidence;
+	if (++_rxBitCount >= 12)
 	{
-	    // We have the start symbol and now we are collecting message bits,
-	    // 6 per symbol, each which has to be decoded to 4 bits
-	    if (++_rxBitCount >= 12)
+	    // Have 12 bits of encoded message == 1 byte encoded
+	    // Decode as 2 lots of 6 bits into 2 lots of 4 bits
+	    uint16_t decoded = symbol_12to8(_rxBits);
+	    if (decoded > 0xff)
+		decoded = repairSymbols(_rxBits);
+	    if (decoded > 0xff)
 	    {
-		// Have 12 bits of encoded message == 1 byte encoded
-		// Decode as 2 lots of 6 bits into 2 lots of 4 bits
-		// The 6 lsbits are the high nybble
-		uint8_t this_byte = 
-		    (symbol_6to4(_rxBits & 0x3f)) << 4 
-		    | symbol_6to4(_rxBits >> 6);
-
-		// The first decoded byte is the byte count of the following message
-		// the count includes the byte count and the 2 trailing FCS bytes
-		// REVISIT: may also include the ACK flag at 0x40
-		if (_rxBufLen == 0)
-		{
-		    // The first byte is the byte count
-		    // Check it for sensibility. It cant be less than 7, since it
-		    // includes the byte count itself, the 4 byte header and the 2 byte FCS
-		    _rxCount = this_byte;
-		    if (_rxCount < 7 || _rxCount > RH_ASK_MAX_PAYLOAD_LEN)
-		    {
-			// Stupid message length, drop the whole thing
-			_rxActive = false;
-			_rxBad++;
-                        return;
-		    }
-		}
-		_rxBuf[_rxBufLen++] = this_byte;
+		// Not a valid symbol: the message cant pass the FCS, so drop it now
+		// and start looking for the next start symbol
+		_rxActive = false;
+		_rxBadSymbols++;
+		_rxBad++;
+		return false;
+	    }
+	    uint8_t this_byte = decoded;
 
-		if (_rxBufLen >= _rxCount)
+	    // The first decoded byte is the byte count of the following message
+	    // the count includes the byte count and the 2 trailing FCS bytes
+	    // REVISIT: may also include the ACK flag at 0x40
+	    if (_rxBufLen == 0)
+	    {
+		// The first byte is the byte count
+		// Check it for sensibility. It cant be less than 7, since it
+		// includes the byte count itself, the 4 byte header and the 2 byte FCS
+		_rxCount = this_byte;
+		if (_rxCount < 7 || _rxCount > RH_ASK_MAX_PAYLOAD_LEN)
 		{
-		    // Got all the bytes now
+		    // Stupid message length, drop the whole thing
 		    _rxActive = false;
-		    _rxBufFull = true;
-		    setModeIdle();
+		    _rxBad++;
+		    return false;
 		}
-		_rxBitCount = 0;
 	    }
-	}
-	// Not in a message, see if we have a start symbol
-	else if (_rxBits == RH_ASK_START_SYMBOL)
-	{
-	    // Have start symbol, start collecting message
-	    _rxActive = true;
+	    _rxBuf[_rxBufLen++] = this_byte;
 	    _rxBitCount = 0;
-	    _rxBufLen = 0;
+
+	    if (_rxBufLen >= _rxCount)
+	    {
+		// Got all the bytes now
+		_rxActive = false;
+		_rxBufFull = true;
+		setModeIdle();
+		return true;
+	    }
 	}
     }
+    // Not in a message, see if we have a start symbol
+    else if (_rxBits == RH_ASK_START_SYMBOL)
+    {
+	// Have start symbol, start collecting message
+	_rxActive = true;
+	_rxBitCount = 0;
+	_rxBufLen = 0;
+    }
+    return false;
 }
 
 void RH_INTERRUPT_ATTR RH_ASK::transmitTimer()
 {
     if (_txSample++ == 0)
     {
-	// Send next bit
-	// Symbols are sent LSB first
-	// Finished sending the whole message? (after waiting one bit period 
-	// since the last bit)
-	if (_txIndex >= _txBufLen)
+	// Send next bit, if any
+	int8_t bit = nextTxBit();
+	if (bit >= 0)
+	    writeTx(bit);
+    }
+	
+    if (_txSample >= _samplesPerBit)
+	_txSample = 0;
+}
+
+int8_t RH_INTERRUPT_ATTR RH_ASK::nextTxBit()
+{
+    if (_mode != RHModeTx)
+	return -1;
+
+    // Finished sending the whole message? (after waiting one bit period 
+    // since the last bit)
+    if (_txIndex >= _txBufLen)
+    {
+	setModeIdle();
+	_txGood++;
+	return -1;
+    }
+
+    // Symbols are sent LSB first
+    int8_t bit = (_txBuf[_txIndex] >> _txBit++) & 1;
+    if (_txBit >= 6)
+    {
+	_txBit = 0;
+	_txIndex++;
+    }
+    return bit;
+}
+
+bool RH_INTERRUPT_ATTR RH_ASK::tick(bool rxSample)
+{
+    if (_mode == RHModeRx)
+	receiveSample(rxSample ^ _rxInverted);
+    else if (_mode == RHModeTx)
+    {
+	// Same timing as transmitTimer(), but return the level instead of writing it
+	if (_txSample++ == 0)
+	    _txLevel = (nextTxBit() > 0);
+	if (_txSample >= _samplesPerBit)
+	    _txSample = 0;
+	return _txLevel;
+    }
+    return false;
+}
+
+uint16_t RH_ASK::modulate(const uint8_t* data, uint8_t len, uint8_t* samples, uint16_t maxSamples)
+{
+    if (len > RH_ASK_MAX_MESSAGE_LEN
+	|| maxSamples < (uint32_t)RH_ASK_MODULATED_LEN(len) * _samplesPerBit / RH_ASK_RX_SAMPLES_PER_BIT)
+	return 0;
+
+    // The symbols are encoded at the end of samples, as _txBuf may still be being sent. Each symbol
+    // becomes 6 * _samplesPerBit samples from the start, which never reach a symbol not yet expanded
+    uint8_t count = RH_ASK_PREAMBLE_LEN + (len + RH_ASK_HEADER_LEN + 3) * 2;
+    uint8_t* p = samples + (uint16_t)count * 6 * _samplesPerBit - count;
+    memcpy(p, _txBuf, RH_ASK_PREAMBLE_LEN);
+    encodeMessage(data, len, p + RH_ASK_PREAMBLE_LEN);
+
+    // Same bit order as transmitTimer(): symbols are sent LSB first
+    uint16_t n = 0;
+    for (uint8_t index = 0; index < count; index++)
+    {
+	uint8_t symbol = p[index];
+	for (uint8_t bit = 0; bit < 6; bit++)
 	{
-	    setModeIdle();
-	    _txGood++;
+	    memset(samples + n, (symbol >> bit) & 1, _samplesPerBit);
+	    n += _samplesPerBit;
+	}
+    }
+    return n;
+}
+
+uint16_t RH_ASK::demodulate(const uint8_t* samples, uint16_t len)
+{
+    // Previous message has not been collected yet
+    if (_rxBufFull)
+	return 0;
+
+    // Run the PLL and integrator over the buffer in local (non-volatile) copies
+    // of the receiver state, same as receiveTimer() does one sample at a time
+    bool     lastSample = _rxLastSample;
+    int8_t   integrator = _rxIntegrator;
+    uint8_t  ramp       = _rxPllRamp;
+    uint16_t i = 0;
+    while (i < len)
+    {
+	bool rxSample = (samples[i++] != 0) ^ _rxInverted;
+
+	if (rxSample)
+	    integrator++;
+	else
+	    integrator--;
+
+	if (rxSample != lastSample)
+	{
+	    ramp += ((ramp < RH_ASK_RAMP_TRANSITION) 
+		     ? _rampIncRetard 
+		     : _rampIncAdvance);
+	    lastSample = rxSample;
 	}
 	else
+	    ramp += _rampInc;
+
+	if (ramp >= RH_ASK_RX_RAMP_LEN)
 	{
-	    writeTx(_txBuf[_txIndex] & (1 << _txBit++));
-	    if (_txBit >= 6)
-	    {
-		_txBit = 0;
-		_txIndex++;
-	    }
+	    int8_t integral = integrator;
+	    ramp -= RH_ASK_RX_RAMP_LEN;
+	    integrator = 0;
+	    if (receiveIntegral(integral))
+		break; // Got a complete message
 	}
     }
-	
-    if (_txSample > 7)
-	_txSample = 0;
+    _rxLastSample = lastSample;
+    _rxIntegrator = integrator;
+    _rxPllRamp    = ramp;
+    return i;
 }
 
 void RH_INTERRUPT_ATTR RH_ASK::handleTimerInterrupt()
@@ -24,9 +24,12 @@
 #endif
 
 #if !defined(RH_ASK_RX_SAMPLES_PER_BIT)
-/// Number of samples per bit
+/// Number of samples per bit. This is the default, see RH_ASK::setSamplesPerBit()
  #define RH_ASK_RX_SAMPLES_PER_BIT 8
 #endif //RH_ASK_RX_SAMPLES_PER_BIT  
+#if (RH_ASK_RX_SAMPLES_PER_BIT != 4) && (RH_ASK_RX_SAMPLES_PER_BIT != 8) && (RH_ASK_RX_SAMPLES_PER_BIT != 16)
+ #error RH_ASK_RX_SAMPLES_PER_BIT must be 4, 8 or 16
+#endif
 
 /// The size of the receiver ramp. Ramp wraps modulo this number
 #define RH_ASK_RX_RAMP_LEN 160
@@ -40,7 +43,8 @@
 #define RH_ASK_RAMP_INC (RH_ASK_RX_RAMP_LEN/RH_ASK_RX_SAMPLES_PER_BIT)
 /// Internal ramp adjustment parameter
 #define RH_ASK_RAMP_TRANSITION RH_ASK_RX_RAMP_LEN/2
-/// Internal ramp adjustment parameter
+/// Internal ramp adjustment parameter, for RH_ASK_RX_SAMPLES_PER_BIT (8) samples per bit.
+/// Scaled for other numbers of samples per bit
 #define RH_ASK_RAMP_ADJUST 9
 /// Internal ramp adjustment parameter
 #define RH_ASK_RAMP_INC_RETARD (RH_ASK_RAMP_INC-RH_ASK_RAMP_ADJUST)
@@ -57,6 +61,12 @@
 /// This is the number of 6 bit nibbles in the preamble
 #define RH_ASK_PREAMBLE_LEN 8
 
+/// Number of samples RH_ASK::modulate() produces for a message of len octets of user data:
+/// the preamble, then byte count, headers, data and FCS as 2 6-bit symbols per octet,
+/// at RH_ASK_RX_SAMPLES_PER_BIT samples per bit. Use this to size sample buffers.
+/// Scale by RH_ASK::samplesPerBit() / RH_ASK_RX_SAMPLES_PER_BIT if you change the samples per bit.
+#define RH_ASK_MODULATED_LEN(len) ((RH_ASK_PREAMBLE_LEN + ((len) + RH_ASK_HEADER_LEN + 3) * 2) * 6 * RH_ASK_RX_SAMPLES_PER_BIT)
+
 /////////////////////////////////////////////////////////////////////
 /// \class RH_ASK RH_ASK.h <RH_ASK.h>
 /// \brief Driver to send and receive unaddressed, unreliable datagrams via inexpensive ASK (Amplitude Shift Keying) or 
@@ -247,11 +257,13 @@
 /// Caution: on the tronixlabs breakout board, pins 4 and 5 may be labelled vice-versa.
 ///
 /// \par Timers
-/// The RH_ASK driver uses a timer-driven interrupt to generate 8 interrupts per bit period. RH_ASK
+/// The RH_ASK driver uses a timer-driven interrupt to generate 8 interrupts per bit period
+/// (or 4 or 16, see setSamplesPerBit()). RH_ASK
 /// takes over a timer on Arduino-like platforms. By default it takes over Timer 1. You can force it
 /// to use Timer 2 instead by enabling the define RH_ASK_ARDUINO_USE_TIMER2 near the top of RH_ASK.cpp
 /// On Arduino Zero it takes over timer TC3. On Arduino Due it takes over timer
 /// TC0. On ESP8266, takes over timer0 (which conflicts with ServoTimer0).
+/// It takes over no timer at all if you call setUseTimer(false): see "Driving the modem yourself" below.
 ///
 /// Caution: ATTiny85 has only 2 timers, one (timer 0) usually used for
 /// millis() and one (timer 1) for PWM analog outputs. The RH_ASK Driver
@@ -265,11 +277,38 @@
 /// RH_ASK driver(2000, PA3, PA4);
 /// \endcode
 /// and connect the serial to pins PA3 and PA4
+///
+/// \par Software modem on sample buffers
+/// modulate() and demodulate() run the transmitter and the receiver PLL over buffers 
+/// of samples instead of the timer interrupt and IO pins. RH_ASK builds on Linux 
+/// (RH_PLATFORM_UNIX), where these are the only way to send and receive, so you can decode
+/// captures from a logic analyser or SDR offline, much faster than real time, or
+/// synthesise test signals. See the ask_sample_modem example.
+///
+/// \par Driving the modem yourself
+/// The modem is a state machine that is advanced one sample period at a time. Normally
+/// init() takes over a hardware timer, whose interrupt reads the receiver pin, advances the
+/// state machine and writes the transmitter pin, through a single global pointer to the
+/// RH_ASK instance, so there can only be one instance driven that way.
+/// If you call setUseTimer(false) before init(), init() does not touch any timer, and you 
+/// advance the state machine yourself, so you can have any number of instances:
+/// - From a timer interrupt you already have (perhaps shared with other code), running at
+/// samplesPerBit() times the bit rate: call handleTimerInterrupt() for each instance, 
+/// which reads and writes each instance's own pins.
+/// - With no pins at all: call tick() once per sample period with the received sample. It
+/// returns the level to send to the transmitter. A host test harness can connect the
+/// tick() of one instance to another at full CPU speed. See the ask_tick_harness example.
+/// - From blocks of samples captured by DMA (or a logic analyser, or an SDR): call demodulate().
+/// - From a peripheral that shifts out bits at the bit rate (a UART, SPI or DMA, say): call
+/// nextTxBit() once per bit period.
+///
+/// Pins you dont need can be RH_INVALID_PIN (not on RH_PLATFORM_GENERIC_AVR8, where the 
+/// pins are fixed at compile time).
 class RH_ASK : public RHGenericDriver
 {
 public:
     /// Constructor.
-    /// At present only one instance of RH_ASK per sketch is supported.
+    /// Only one instance of RH_ASK per sketch can use the timer (see setUseTimer()). 
     /// \param[in] speed The desired bit rate in bits per second
     /// \param[in] rxPin The pin that is used to get data from the receiver
     /// \param[in] txPin The pin that is used to send data to the transmitter
@@ -326,13 +365,126 @@ public:
     /// Starts the transmitter in the RF69.
     void           setModeTx();
 
-    /// dont call this it used by the interrupt handler
+    /// Advances the modem by one sample period, reading the rxPin and writing the txPin.
+    /// Called by the timer interrupt handler set up by init(). If you have called setUseTimer(false),
+    /// call this from your own timer interrupt at samplesPerBit() times the bit rate.
     RH_INTERRUPT_ATTR void            handleTimerInterrupt();
 
+    /// Sets whether init() takes over a hardware timer to drive the modem (the default),
+    /// or leaves it to you to call handleTimerInterrupt(), tick(), demodulate() or nextTxBit().
+    /// Only one instance can use the timer, but any number can be driven without it.
+    /// Must be called before init().
+    /// \param[in] useTimer false to drive the modem yourself
+    void            setUseTimer(bool useTimer) { _useTimer = useTimer;}
+
+    /// Advances the modem state machine by one sample period, without using any IO pins or
+    /// the timer. In RHModeRx, feeds rxSample to the receiver (call available() to start the receiver
+    /// and to collect messages). In RHModeTx, advances the transmitter.
+    /// Call samplesPerBit() times per bit period.
+    /// \param[in] rxSample The level of the received signal in this sample period 
+    /// (subject to the rx pin inversion)
+    /// \return The level the transmitter should have for this sample period. Always false 
+    /// unless transmitting.
+    RH_INTERRUPT_ATTR bool            tick(bool rxSample);
+
+    /// Gets the next bit of the message being transmitted, for transmitters that are
+    /// driven at the bit rate rather than at samplesPerBit() times the bit rate.
+    /// After the last bit, the next call ends the transmission, returning to RHModeIdle.
+    /// \return 0 or 1 to send for the next bit period, or -1 if there is nothing (more) to send
+    RH_INTERRUPT_ATTR int8_t          nextTxBit();
+
     /// Returns the current speed in bits per second
     /// \return The current speed in bits per second
     uint16_t        speed() { return _speed;}
 
+    /// Sets the number of times the receiver samples each bit, and hence the timer
+    /// interrupt rate (samplesPerBit times the bit rate). The default is 
+    /// RH_ASK_RX_SAMPLES_PER_BIT (8). 4 samples per bit halves the interrupt rate, so allows twice 
+    /// the bit rate on a given processor, at the cost of less noise immunity and coarser
+    /// clock recovery. 16 samples per bit gives better noise immunity, since each bit decision
+    /// integrates more samples, but doubles the interrupt rate.
+    /// Over the air only the bit rate matters, so the transmitter and receiver need not use 
+    /// the same samples per bit. Buffers for demodulate() must have samplesPerBit() samples per bit.
+    /// Must be called before init(), which sets up the timer. Caution: at 4 samples per bit,
+    /// odd speeds are rounded down to an even number on most platforms.
+    /// \param[in] samplesPerBit 4, 8 or 16
+    /// \return true if samplesPerBit is valid
+    bool            setSamplesPerBit(uint8_t samplesPerBit);
+
+    /// Returns the number of samples per bit
+    /// \return The number of samples per bit
+    uint8_t         samplesPerBit() { return _samplesPerBit;}
+
+    /// Computes the receiver PLL ramp increments for a number of samples per bit. The adjustment
+    /// for a transition is the same fraction of a bit as RH_ASK_RAMP_ADJUST is with 8 samples per bit.
+    /// Used by setSamplesPerBit() and by external demodulators such as RH_ASKMultiDemod.
+    /// \param[in] samplesPerBit 4, 8 or 16
+    /// \param[out] inc The increment when there is no transition
+    /// \param[out] incRetard The increment for a transition early in the ramp
+    /// \param[out] incAdvance The increment for a transition late in the ramp
+    static void     rampIncrements(uint8_t samplesPerBit, uint8_t* inc, uint8_t* incRetard, uint8_t* incAdvance);
+
+    /// Returns the speed that gives the timer interrupt rate (samplesPerBit() times the bit rate), 
+    /// when used in the calculations for 8 interrupts per bit in timerSetup() and the timer
+    /// interrupt handlers
+    /// \return The scaled speed
+    uint16_t        timerSpeed() { return ((uint32_t)_speed * _samplesPerBit) / 8;}
+
+    /// Returns the number of received symbols that were invalid but were repaired
+    /// by flipping their least confident bit (soft decision). The receiver keeps the
+    /// confidence of each bit: how far the number of high samples in the bit was
+    /// from a tie. When a received 6 bit symbol is invalid because of a single bad bit and
+    /// the least confident bit that could have caused it was marginal, that bit
+    /// is flipped. The message FCS still has to pass, so bad repairs are caught.
+    /// \return The number of repaired symbols
+    uint16_t        rxRepairedSymbols() { return _rxRepairedSymbols;}
+
+    /// Returns the number of invalid 6 bit symbols received
+    /// (symbols that are not one of the 16 4-to-6 bit codes), each of which caused the 
+    /// message being received to be dropped (and counted in rxBad()).
+    /// A high count relative to rxGood() suggests noise or a speed mismatch.
+    /// \return The number of invalid symbols received
+    uint16_t        rxBadSymbols() { return _rxBadSymbols;}
+
+    /// Encodes a message with the current transmit headers (see setHeaderTo() etc)
+    /// exactly as send() would, but instead of transmitting it, writes the bit
+    /// samples that the transmitter would produce into samples, one octet per sample
+    /// (0 or 1), RH_ASK_RX_SAMPLES_PER_BIT samples per bit. Does not touch the
+    /// transmitter hardware, the timer, the current mode or a message still being sent, so it can be used
+    /// on any platform, including Linux, at any time, to synthesise sample streams for testing, or for
+    /// demodulate().
+    /// \param[in] data Array of data to be encoded
+    /// \param[in] len Number of bytes of data to encode (<= RH_ASK_MAX_MESSAGE_LEN)
+    /// \param[out] samples Buffer to hold the resulting samples
+    /// \param[in] maxSamples The size of samples. Must be at least RH_ASK_MODULATED_LEN(len)
+    /// \return The number of samples written, or 0 if the message is too long or samples is too small
+    uint16_t        modulate(const uint8_t* data, uint8_t len, uint8_t* samples, uint16_t maxSamples);
+
+    /// Runs the receiver PLL, integrator and symbol decoder over a buffer of received
+    /// samples, one octet per sample (non-zero is high, subject to the rx pin inversion), 
+    /// taken at RH_ASK_RX_SAMPLES_PER_BIT samples per bit, such as a capture from a
+    /// logic analyser or SDR, or the output of modulate(). The receiver state is
+    /// kept between calls, so a long capture can be fed in pieces of any size.
+    /// Stops as soon as a complete message has been received, 
+    /// which can then be collected with available() and recv() as usual. Call again with
+    /// the remaining samples to continue. Does not use the timer or the receiver hardware.
+    /// \param[in] samples Array of samples
+    /// \param[in] len Number of samples in samples
+    /// \return The number of samples consumed. If less than len, a message is ready (or
+    /// an earlier message has not yet been collected with available())
+    uint16_t        demodulate(const uint8_t* samples, uint16_t len);
+
+    /// Shifts a newly demodulated bit into the receiver, looking for the start symbol
+    /// and decoding message octets. Called once per bit period by 
+    /// receiveTimer() and demodulate(), and by external demodulators such as RH_ASKMultiDemod.
+    /// Bits are ignored while a complete message is waiting to be checked by available().
+    /// \param[in] bit The value of the bit
+    /// \param[in] confidence How confident the demodulator is in the value of the bit,
+    /// from 0 (a tie) to about samplesPerBit(). Marginal bits may be flipped to repair invalid symbols.
+    /// The default never repairs.
+    /// \return true if this bit completed a message
+    RH_INTERRUPT_ATTR bool receiveBit(bool bit, uint8_t confidence = 0xff);
+
 #if (RH_PLATFORM == RH_PLATFORM_ESP8266)
     /// ESP8266 timer0 increment value
     uint32_t _timerIncrement;
@@ -355,18 +507,44 @@ protected:
     void            writePtt(bool value);
 
     /// Translates a 6 bit symbol to its 4 bit plaintext equivalent
+    /// \return the 4 bit value, or 0 if symbol is not a valid symbol
     RH_INTERRUPT_ATTR uint8_t         symbol_6to4(uint8_t symbol);
+    /// Translates 12 received bits (2 6 bit symbols, high nybble in the 6 lsbits)
+    /// to the octet they encode, with a single lookup per symbol
+    /// \return the octet, or a value > 0xff if either symbol is invalid
+    RH_INTERRUPT_ATTR uint16_t        symbol_12to8(uint16_t bits);
 
     /// The receiver handler function, called a 8 times the bit rate
     void            receiveTimer();
 
+    /// Runs the receiver PLL and integrator for one sample, already corrected for rx pin inversion
+    RH_INTERRUPT_ATTR void receiveSample(bool rxSample);
+
     /// The transmitter handler function, called a 8 times the bit rate 
     void            transmitTimer();
 
+    /// Decides the value of a bit and its confidence from the number of high samples
+    /// in its bit period, and passes it to receiveBit()
+    /// \return true if this bit completed a message
+    RH_INTERRUPT_ATTR bool receiveIntegral(int8_t integrator);
+    /// Tries to repair a 6 bit symbol with a single bad bit, using the confidence of its bits
+    /// \param[in] symbol The received symbol
+    /// \param[in] first Index in _rxConfidence of the first bit of the symbol
+    /// \return the 4 bit value, or a value > 0xf if it cant be repaired
+    RH_INTERRUPT_ATTR uint8_t repairSymbol(uint8_t symbol, uint8_t first);
+    /// Tries to repair 12 received bits that symbol_12to8() found invalid
+    /// \return the octet, or a value > 0xff if it cant be repaired
+    RH_INTERRUPT_ATTR uint16_t repairSymbols(uint16_t bits);
     /// Check whether the latest received message is complete and uncorrupted
     /// We should always check the FCS at user level, not interrupt level
     /// since it is slow
     void            validateRxBuf();
+    /// Encodes the byte count, current transmit headers, message and FCS into 6 bit symbols
+    /// \param[in] data The message
+    /// \param[in] len Number of octets in data
+    /// \param[out] p Where to put the symbols, (len + RH_ASK_HEADER_LEN + 3) * 2 of them
+    /// \return The number of symbols
+    uint8_t         encodeMessage(const uint8_t* data, uint8_t len, uint8_t* p);
 
     /// Configure bit rate in bits per second
     uint16_t        _speed;
@@ -385,6 +563,24 @@ protected:
 
     /// True of the sense of the pttPin is to be inverted
     bool            _pttInverted;
+    /// Number of invalid 6 bit symbols received
+    volatile uint16_t _rxBadSymbols;
+    /// Number of invalid 6 bit symbols repaired
+    volatile uint16_t _rxRepairedSymbols;
+    /// Samples per bit
+    uint8_t         _samplesPerBit;
+    /// PLL ramp increment when there is no transition, RH_ASK_RX_RAMP_LEN / _samplesPerBit
+    uint8_t         _rampInc;
+    /// PLL ramp increment for a transition early in the ramp
+    uint8_t         _rampIncRetard;
+    /// PLL ramp increment for a transition late in the ramp
+    uint8_t         _rampIncAdvance;
+    /// Confidence of each of the bits of the octet being received
+    uint8_t         _rxConfidence[12];
+    /// Whether init() takes over the timer
+    bool            _useTimer;
+    /// Transmitter level for the current bit period, returned by tick()
+    bool            _txLevel;
 
     // Used in the interrupt handlers
     /// Buf is filled but not validated
@@ -396,9 +592,9 @@ protected:
     /// Last digital input from the rx data pin
     volatile bool   _rxLastSample;
 
-    /// This is the integrate and dump integral. If there are <5 0 samples in the PLL cycle
-    /// the bit is declared a 0, else a 1
-    volatile uint8_t _rxIntegrator;
+    /// This is the integrate and dump integral: the number of 1 samples less the number of
+    /// 0 samples in the PLL cycle. If it is > 0 the bit is declared a 1, else a 0
+    volatile int8_t _rxIntegrator;
 
     /// PLL ramp, varies between 0 and RH_ASK_RX_RAMP_LEN-1 (159) over 
     /// RH_ASK_RX_SAMPLES_PER_BIT (8) samples per nominal bit time. 
@@ -431,7 +627,7 @@ protected:
     /// Bit number of next bit to send
     uint8_t _txBit;
 
-    /// Sample number for the transmitter. Runs 0 to 7 during one bit interval
+    /// Sample number for the transmitter. Runs 0 to samplesPerBit()-1 during one bit interval
     uint8_t _txSample;
 
     /// The transmitter buffer in _symbols_ not data octets
@@ -446,4 +642,8 @@ protected:
 /// @example ask_reliable_datagram_server.pde
 /// @example ask_transmitter.pde
 /// @example ask_receiver.pde
+/// @example ask_sample_modem.pde
+/// @example ask_decode_benchmark.pde
+/// @example ask_snr_simulation.pde
+/// @example ask_tick_harness.pde
 #endif
@@ -0,0 +1,279 @@
+// RH_ASKMultiDemod.cpp
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#include <RH_ASKMultiDemod.h>
+
+#if defined(RH_ASK_MULTI_AVX2)
+ #include <immintrin.h>
+#elif defined(RH_ASK_MULTI_SSE2)
+ #include <emmintrin.h>
+#elif defined(RH_ASK_MULTI_NEON)
+ #include <arm_neon.h>
+#endif
+
+// The PLL and integrator are exactly as in RH_ASK::receiveSample(). In the SIMD versions each
+// octet lane of a register holds the state of one channel, and the
+// conditional ramp adjustments are done with compare masks instead of branches.
+// The ramp never exceeds RH_ASK_RX_RAMP_LEN plus the advance increment (218 at 4 samples per bit),
+// so it fits in an unsigned octet, but not a signed one, hence the unsigned min/max compares.
+// The integrator counts up for high samples and down for low ones, so is signed.
+
+RH_ASKMultiDemod::RH_ASKMultiDemod()
+    :
+    _numChannels(0)
+{
+    RH_ASK::rampIncrements(RH_ASK_RX_SAMPLES_PER_BIT, &_rampInc, &_rampIncRetard, &_rampIncAdvance);
+}
+
+bool RH_ASKMultiDemod::addChannel(RH_ASK* channel)
+{
+    if (_numChannels >= RH_ASK_MULTI_MAX_CHANNELS)
+	return false;
+    // All the channels share the ramp increments
+    if (_numChannels && channel->samplesPerBit() != _channels[0]->samplesPerBit())
+	return false;
+    if (!_numChannels)
+	RH_ASK::rampIncrements(channel->samplesPerBit(), &_rampInc, &_rampIncRetard, &_rampIncAdvance);
+
+    _channels[_numChannels] = channel;
+    _lastSample[_numChannels] = 0;
+    _integrator[_numChannels] = 0;
+    _pllRamp[_numChannels] = 0;
+    _numChannels++;
+    return true;
+}
+
+const char* RH_ASKMultiDemod::simdName()
+{
+#if defined(RH_ASK_MULTI_AVX2)
+    return "AVX2";
+#elif defined(RH_ASK_MULTI_SSE2)
+    return "SSE2";
+#elif defined(RH_ASK_MULTI_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+uint16_t RH_ASKMultiDemod::demodulate(const uint8_t* samples, uint16_t len)
+{
+    uint16_t i = 0;
+    while (i < len)
+    {
+	bool complete = false;
+	uint8_t first = 0;
+#if defined(RH_ASK_MULTI_AVX2)
+	for (; first + 32 <= _numChannels; first += 32)
+	    complete |= step32(samples, first);
+#endif
+#if defined(RH_ASK_MULTI_SSE2) || defined(RH_ASK_MULTI_NEON)
+	for (; first + 16 <= _numChannels; first += 16)
+	    complete |= step16(samples, first);
+#endif
+	// Any channels left over
+	if (first < _numChannels)
+	    complete |= stepScalar(samples, first, _numChannels - first);
+
+	samples += _numChannels;
+	i++;
+	if (complete)
+	    break; // Let the caller collect the message(s)
+    }
+    return i;
+}
+
+bool RH_ASKMultiDemod::stepScalar(const uint8_t* samples, uint8_t first, uint8_t count)
+{
+    bool complete = false;
+    uint8_t c;
+    for (c = first; c < first + count; c++)
+    {
+	bool rxSample = samples[c] != 0;
+
+	if (rxSample)
+	    _integrator[c]++;
+	else
+	    _integrator[c]--;
+
+	if (rxSample != (_lastSample[c] != 0))
+	{
+	    _pllRamp[c] += ((_pllRamp[c] < RH_ASK_RAMP_TRANSITION)
+			    ? _rampIncRetard
+			    : _rampIncAdvance);
+	    _lastSample[c] = rxSample ? 0xff : 0;
+	}
+	else
+	    _pllRamp[c] += _rampInc;
+
+	if (_pllRamp[c] >= RH_ASK_RX_RAMP_LEN)
+	{
+	    int8_t integral = _integrator[c];
+	    _pllRamp[c] -= RH_ASK_RX_RAMP_LEN;
+	    _integrator[c] = 0;
+	    complete |= deliverBits(c, 1, &integral);
+	}
+    }
+    return complete;
+}
+
+bool RH_ASKMultiDemod::deliverBits(uint8_t first, uint32_t lanes, const int8_t* integrals)
+{
+    bool complete = false;
+    while (lanes)
+    {
+#if defined(__GNUC__)
+	uint8_t lane = __builtin_ctz(lanes);
+#else
+	uint8_t lane = 0;
+	while (!(lanes & (1UL << lane)))
+	    lane++;
+#endif
+	// As RH_ASK::receiveIntegral(): more high samples than low is a 1, and the
+	// confidence is how far the integral is from a tie
+	int8_t integral = integrals[lane];
+	if (integral > 0)
+	    complete |= _channels[first + lane]->receiveBit(true, integral);
+	else
+	    complete |= _channels[first + lane]->receiveBit(false, -integral);
+	lanes &= lanes - 1; // Clear the lowest set bit
+    }
+    return complete;
+}
+
+#if defined(RH_ASK_MULTI_SSE2)
+bool RH_ASKMultiDemod::step16(const uint8_t* samples, uint8_t first)
+{
+    const __m128i zero       = _mm_setzero_si128();
+    const __m128i ones       = _mm_cmpeq_epi8(zero, zero);
+    const __m128i rampLen    = _mm_set1_epi8((char)RH_ASK_RX_RAMP_LEN);
+    const __m128i early      = _mm_set1_epi8((char)((RH_ASK_RAMP_TRANSITION) - 1));
+    const __m128i one        = _mm_set1_epi8(1);
+    const __m128i incNone    = _mm_set1_epi8((char)_rampInc);
+    const __m128i incRetard  = _mm_set1_epi8((char)_rampIncRetard);
+    const __m128i incAdvance = _mm_set1_epi8((char)_rampIncAdvance);
+
+    __m128i last       = _mm_loadu_si128((const __m128i*)(_lastSample + first));
+    __m128i integrator = _mm_loadu_si128((const __m128i*)(_integrator + first));
+    __m128i ramp       = _mm_loadu_si128((const __m128i*)(_pllRamp + first));
+
+    // 0xff in each lane that is high. high | 1 is -1 for high lanes and 1 for low ones
+    __m128i high = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(samples + first)), zero), ones);
+    integrator = _mm_sub_epi8(integrator, _mm_or_si128(high, one));
+
+    // Transition lanes: retard if ramp < RH_ASK_RAMP_TRANSITION, else advance.
+    // Other lanes: standard increment
+    __m128i transition = _mm_xor_si128(high, last);
+    __m128i isEarly = _mm_cmpeq_epi8(_mm_min_epu8(ramp, early), ramp);
+    __m128i adjust = _mm_or_si128(_mm_and_si128(isEarly, incRetard), _mm_andnot_si128(isEarly, incAdvance));
+    ramp = _mm_add_epi8(ramp, _mm_or_si128(_mm_and_si128(transition, adjust), _mm_andnot_si128(transition, incNone)));
+
+    // Lanes at the end of a bit period
+    bool complete = false;
+    __m128i done = _mm_cmpeq_epi8(_mm_max_epu8(ramp, rampLen), ramp);
+    uint32_t lanes = _mm_movemask_epi8(done);
+    if (lanes)
+    {
+	int8_t integrals[16];
+	_mm_storeu_si128((__m128i*)integrals, integrator);
+	ramp = _mm_sub_epi8(ramp, _mm_and_si128(done, rampLen));
+	integrator = _mm_andnot_si128(done, integrator);
+	complete = deliverBits(first, lanes, integrals);
+    }
+    _mm_storeu_si128((__m128i*)(_lastSample + first), high);
+    _mm_storeu_si128((__m128i*)(_integrator + first), integrator);
+    _mm_storeu_si128((__m128i*)(_pllRamp + first), ramp);
+    return complete;
+}
+
+#elif defined(RH_ASK_MULTI_NEON)
+bool RH_ASKMultiDemod::step16(const uint8_t* samples, uint8_t first)
+{
+    const uint8x16_t rampLen    = vdupq_n_u8(RH_ASK_RX_RAMP_LEN);
+    const uint8x16_t early      = vdupq_n_u8(RH_ASK_RAMP_TRANSITION);
+    const uint8x16_t one        = vdupq_n_u8(1);
+    const uint8x16_t incNone    = vdupq_n_u8(_rampInc);
+    const uint8x16_t incRetard  = vdupq_n_u8(_rampIncRetard);
+    const uint8x16_t incAdvance = vdupq_n_u8(_rampIncAdvance);
+
+    uint8x16_t last       = vld1q_u8(_lastSample + first);
+    uint8x16_t integrator = vld1q_u8((uint8_t*)_integrator + first);
+    uint8x16_t ramp       = vld1q_u8(_pllRamp + first);
+
+    // 0xff in each lane that is high. high | 1 is -1 for high lanes and 1 for low ones
+    uint8x16_t sample = vld1q_u8(samples + first);
+    uint8x16_t high = vtstq_u8(sample, sample);
+    integrator = vsubq_u8(integrator, vorrq_u8(high, one));
+
+    uint8x16_t transition = veorq_u8(high, last);
+    uint8x16_t adjust = vbslq_u8(vcltq_u8(ramp, early), incRetard, incAdvance);
+    ramp = vaddq_u8(ramp, vbslq_u8(transition, adjust, incNone));
+
+    // Lanes at the end of a bit period
+    bool complete = false;
+    uint8x16_t done = vcgeq_u8(ramp, rampLen);
+    uint64x2_t any = vreinterpretq_u64_u8(done);
+    if (vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1))
+    {
+	// NEON has no movemask, so build the lane masks the slow way
+	uint8_t doneLanes[16];
+	int8_t integrals[16];
+	vst1q_u8(doneLanes, done);
+	vst1q_u8((uint8_t*)integrals, integrator);
+	uint32_t lanes = 0;
+	uint8_t lane;
+	for (lane = 0; lane < 16; lane++)
+	    lanes |= (uint32_t)(doneLanes[lane] & 1) << lane;
+	ramp = vsubq_u8(ramp, vandq_u8(done, rampLen));
+	integrator = vbicq_u8(integrator, done);
+	complete = deliverBits(first, lanes, integrals);
+    }
+    vst1q_u8(_lastSample + first, high);
+    vst1q_u8((uint8_t*)_integrator + first, integrator);
+    vst1q_u8(_pllRamp + first, ramp);
+    return complete;
+}
+#endif
+
+#if defined(RH_ASK_MULTI_AVX2)
+bool RH_ASKMultiDemod::step32(const uint8_t* samples, uint8_t first)
+{
+    const __m256i zero       = _mm256_setzero_si256();
+    const __m256i ones       = _mm256_cmpeq_epi8(zero, zero);
+    const __m256i rampLen    = _mm256_set1_epi8((char)RH_ASK_RX_RAMP_LEN);
+    const __m256i early      = _mm256_set1_epi8((char)((RH_ASK_RAMP_TRANSITION) - 1));
+    const __m256i one        = _mm256_set1_epi8(1);
+    const __m256i incNone    = _mm256_set1_epi8((char)_rampInc);
+    const __m256i incRetard  = _mm256_set1_epi8((char)_rampIncRetard);
+    const __m256i incAdvance = _mm256_set1_epi8((char)_rampIncAdvance);
+
+    __m256i last       = _mm256_loadu_si256((const __m256i*)(_lastSample + first));
+    __m256i integrator = _mm256_loadu_si256((const __m256i*)(_integrator + first));
+    __m256i ramp       = _mm256_loadu_si256((const __m256i*)(_pllRamp + first));
+
+    __m256i high = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(samples + first)), zero), ones);
+    integrator = _mm256_sub_epi8(integrator, _mm256_or_si256(high, one));
+
+    __m256i transition = _mm256_xor_si256(high, last);
+    __m256i adjust = _mm256_blendv_epi8(incAdvance, incRetard, _mm256_cmpeq_epi8(_mm256_min_epu8(ramp, early), ramp));
+    ramp = _mm256_add_epi8(ramp, _mm256_blendv_epi8(incNone, adjust, transition));
+
+    bool complete = false;
+    __m256i done = _mm256_cmpeq_epi8(_mm256_max_epu8(ramp, rampLen), ramp);
+    uint32_t lanes = (uint32_t)_mm256_movemask_epi8(done);
+    if (lanes)
+    {
+	int8_t integrals[32];
+	_mm256_storeu_si256((__m256i*)integrals, integrator);
+	ramp = _mm256_sub_epi8(ramp, _mm256_and_si256(done, rampLen));
+	integrator = _mm256_andnot_si256(done, integrator);
+	complete = deliverBits(first, lanes, integrals);
+    }
+    _mm256_storeu_si256((__m256i*)(_lastSample + first), high);
+    _mm256_storeu_si256((__m256i*)(_integrator + first), integrator);
+    _mm256_storeu_si256((__m256i*)(_pllRamp + first), ramp);
+    return complete;
+}
+#endif
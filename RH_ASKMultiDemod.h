@@ -0,0 +1,148 @@
+// RH_ASKMultiDemod.h
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RH_ASKMultiDemod_h
+#define RH_ASKMultiDemod_h
+
+#include <RH_ASK.h>
+
+// Maximum number of channels that one RH_ASKMultiDemod can demodulate
+#ifndef RH_ASK_MULTI_MAX_CHANNELS
+ #define RH_ASK_MULTI_MAX_CHANNELS 32
+#endif
+
+// Choose the widest SIMD instruction set the compiler has been told it can use.
+// Define RH_ASK_MULTI_NO_SIMD to force the portable scalar code
+#if !defined(RH_ASK_MULTI_NO_SIMD)
+ #if defined(__AVX2__)
+  #define RH_ASK_MULTI_AVX2
+  #define RH_ASK_MULTI_SSE2
+ #elif defined(__SSE2__)
+  #define RH_ASK_MULTI_SSE2
+ #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define RH_ASK_MULTI_NEON
+ #endif
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RH_ASKMultiDemod RH_ASKMultiDemod.h <RH_ASKMultiDemod.h>
+/// \brief Demodulates many RH_ASK channels at once from interleaved sample buffers,
+/// using SIMD instructions where available
+///
+/// Runs the same receiver PLL, integrator and bit decision as RH_ASK (see RH_ASK_RX_RAMP_LEN and
+/// RH_ASK::rampIncrements()) over a number of independent channels
+/// in parallel, such as many 433MHz ASK channels captured by an SDR, or the channels of a logic
+/// analyser. Each channel is an ordinary RH_ASK instance, added with addChannel(). The
+/// RH_ASK instances need not be initialised and never use their timer or IO pins:
+/// RH_ASKMultiDemod does the sampling and feeds each decoded bit to its channel.
+/// Messages are collected from each channel with its available() and recv() as usual,
+/// which check the FCS with the normal RH_ASK validation, and apply the channels address
+/// filtering.
+///
+/// The state of the PLL of each channel is kept in one octet per channel, so that
+/// one SIMD register holds the state of many channels: 32 channels per instruction with AVX2, 16
+/// with SSE2 or ARM NEON. The instruction set is chosen at compile time from the compiler's
+/// target options (eg -mavx2 or -march=native for AVX2; SSE2 is always available on x86-64). Channels
+/// that do not fill a SIMD register, and all channels on other processors or if
+/// RH_ASK_MULTI_NO_SIMD is defined, are demodulated with portable scalar code.
+/// simdName() tells you what was used.
+///
+/// Samples are interleaved: for each sample time there is one octet for each channel, in the
+/// order the channels were added. An octet of 0 is low, anything else is high. All channels
+/// must be sampled at the same number of samples per bit, that of the RH_ASK instances
+/// (see RH_ASK::setSamplesPerBit()), which must all be the same.
+///
+/// As in RH_ASK, the integrator of each channel counts high samples up and low samples down, a bit 
+/// is 1 if the integral over the bit period is positive, and the magnitude of the integral is passed to
+/// the channel as the confidence of the bit, so that the channel can repair invalid symbols 
+/// (see RH_ASK::rxRepairedSymbols()). So each channel receives exactly the bits, and repairs exactly
+/// the symbols, that RH_ASK::demodulate() would from the same samples.
+///
+/// Like RH_ASK, each channel can hold one received message at a time, so demodulate()
+/// returns as soon as any channel has a complete message, and you should then collect 
+/// messages from all the channels before continuing. While a channel holds a complete message
+/// that has not been checked with available(), its PLL keeps running but new messages on
+/// that channel are ignored.
+///
+/// The ask_multi_demod_benchmark example measures the speed in channel-samples per second.
+class RH_ASKMultiDemod
+{
+public:
+    /// Constructor. There are no channels until added with addChannel()
+    RH_ASKMultiDemod();
+
+    /// Adds a channel to be demodulated. Channels are numbered in the order they are added,
+    /// which is the order of their samples in the buffers passed to demodulate().
+    /// \param[in] channel The RH_ASK instance that will receive messages from this channel
+    /// \return true if the channel was added, false if there are already RH_ASK_MULTI_MAX_CHANNELS channels,
+    /// or its samplesPerBit() differs from that of the channels already added
+    bool            addChannel(RH_ASK* channel);
+
+    /// Returns the number of channels added
+    /// \return The number of channels
+    uint8_t         channels() { return _numChannels;}
+
+    /// Demodulates a buffer of interleaved samples from all channels.
+    /// Stops after the sample time in which any channel completes a message, so
+    /// the message can be collected with that channel's available() and recv() before
+    /// the next one arrives: when fewer than len sample times were consumed, check all the
+    /// channels, then call again with the rest of the buffer.
+    /// The PLL state of each channel is kept between calls, so captures can be fed in
+    /// pieces of any length.
+    /// \param[in] samples Interleaved samples, channels() octets for each sample time
+    /// \param[in] len The number of sample times in samples (ie the size of samples is len * channels())
+    /// \return The number of sample times consumed
+    uint16_t        demodulate(const uint8_t* samples, uint16_t len);
+
+    /// Returns the name of the SIMD instruction set in use
+    /// \return "AVX2", "SSE2", "NEON" or "scalar"
+    static const char* simdName();
+
+protected:
+    /// Runs the scalar PLL for one sample time of channels first to first+count-1
+    /// \return true if any of the channels completed a message
+    bool            stepScalar(const uint8_t* samples, uint8_t first, uint8_t count);
+
+    /// Decides the bits of the channels whose bit periods have ended, and passes them with their 
+    /// confidence to the channels, as RH_ASK does
+    /// \param[in] first The channel corresponding to bit 0 of lanes and to integrals[0]
+    /// \param[in] lanes Bit mask of the channels with a new bit
+    /// \param[in] integrals The integrals over the bit period of the channels from first
+    /// \return true if any of the channels completed a message
+    bool            deliverBits(uint8_t first, uint32_t lanes, const int8_t* integrals);
+
+#if defined(RH_ASK_MULTI_SSE2) || defined(RH_ASK_MULTI_NEON)
+    /// Runs the PLL for one sample time of 16 channels starting at first with SSE2 or NEON
+    /// \return true if any of the channels completed a message
+    bool            step16(const uint8_t* samples, uint8_t first);
+#endif
+#if defined(RH_ASK_MULTI_AVX2)
+    /// Runs the PLL for one sample time of 32 channels starting at first with AVX2
+    /// \return true if any of the channels completed a message
+    bool            step32(const uint8_t* samples, uint8_t first);
+#endif
+
+    /// The channels
+    RH_ASK*         _channels[RH_ASK_MULTI_MAX_CHANNELS];
+
+    /// Number of channels added
+    uint8_t         _numChannels;
+
+    /// PLL ramp increments for the samples per bit of the channels (see RH_ASK::rampIncrements())
+    uint8_t         _rampInc, _rampIncRetard, _rampIncAdvance;
+
+    // PLL state for each channel, as in RH_ASK, one octet per channel so they can be
+    // loaded into SIMD registers
+    /// Last sample of each channel, 0xff for high, 0 for low
+    uint8_t         _lastSample[RH_ASK_MULTI_MAX_CHANNELS];
+    /// The integrate and dump integral of each channel: high samples less low samples
+    int8_t          _integrator[RH_ASK_MULTI_MAX_CHANNELS];
+    /// PLL ramp of each channel
+    uint8_t         _pllRamp[RH_ASK_MULTI_MAX_CHANNELS];
+};
+
+/// @example ask_multi_demod_benchmark.pde
+
+#endif
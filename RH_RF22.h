@@ -1259,6 +1259,10 @@ public:
     /// RSSI measurement was made.
     uint32_t getLastPreambleTime();
 
+    /// Returns when the last message was received, which is when its preamble was detected
+    /// \return The time as returned by millis()
+    uint32_t lastRxTime() { return _lastPreambleTime;}
+
     /// The maximum message length supported by this driver
     /// \return The maximum message length supported by this driver
     uint8_t maxMessageLength();
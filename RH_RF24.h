@@ -1058,6 +1058,10 @@ public:
     /// \return The integer device type
     uint16_t deviceType() {return _deviceType;};
 
+    /// Returns when the last message was received, which is when its preamble was detected
+    /// \return The time as returned by millis()
+    uint32_t lastRxTime() { return _lastPreambleTime;}
+
 protected:
     /// This is a low level function to handle the interrupts for one instance of RF24.
     /// Called automatically by isr*()
@@ -229,37 +229,47 @@ void RH_RF69::handleInterrupt()
 // Performance issue?
 void RH_RF69::readFifo()
 {
-    ATOMIC_BLOCK_START;
-    digitalWrite(_slaveSelectPin, LOW);
-    _spi.beginTransaction();
-    _spi.transfer(RH_RF69_REG_00_FIFO); // Send the start address with the write mask off
-    uint8_t payloadlen = _spi.transfer(0); // First byte is payload len (counting the headers)
+    // The payload len (counting the headers), then the headers. If the payload is shorter, or the message is
+    // not for us, the extra octets read are junk, which will be cleared next time we go to receive mode
+    uint8_t headers[1 + RH_RF69_HEADER_LEN];
+    spiBurstRead(RH_RF69_REG_00_FIFO, headers, sizeof(headers));
+    uint8_t payloadlen = headers[0];
     if (payloadlen <= RH_RF69_MAX_ENCRYPTABLE_PAYLOAD_LEN &&
 	payloadlen >= RH_RF69_HEADER_LEN)
     {
-	_rxHeaderTo = _spi.transfer(0);
+	_rxHeaderTo = headers[1];
 	// Check addressing
 	if (_promiscuous ||
 	    _rxHeaderTo == _thisAddress ||
 	    _rxHeaderTo == RH_BROADCAST_ADDRESS)
 	{
-	    // Get the rest of the headers
-	    _rxHeaderFrom  = _spi.transfer(0);
-	    _rxHeaderId    = _spi.transfer(0);
-	    _rxHeaderFlags = _spi.transfer(0);
-	    // And now the real payload
-	    for (_bufLen = 0; _bufLen < (payloadlen - RH_RF69_HEADER_LEN); _bufLen++)
-		_buf[_bufLen] = _spi.transfer(0);
-	    _rxGood++;
-	    _rxBufValid = true;
+	    _rxHeaderFrom  = headers[2];
+	    _rxHeaderId    = headers[3];
+	    _rxHeaderFlags = headers[4];
+	    // And now the real payload, without holding off interrupts while it is transferred.
+	    // rxFifoRead() finishes up when it has been read
+	    _bufLen = payloadlen - RH_RF69_HEADER_LEN;
+	    if (_bufLen == 0 || !spiBurstReadAsync(RH_RF69_REG_00_FIFO, _buf, _bufLen, rxFifoRead, this))
+	    {
+		if (_bufLen)
+		    spiBurstRead(RH_RF69_REG_00_FIFO, _buf, _bufLen); // Could not start it: do it the synchronous way
+		rxFifoRead(this, 0);
+	    }
 	}
     }
-    digitalWrite(_slaveSelectPin, HIGH);
-    _spi.endTransaction();
-    ATOMIC_BLOCK_END;
     // Any junk remaining in the FIFO will be cleared next time we go to receive mode.
 }
 
+// Called when the payload of a received message has been read from the FIFO, maybe by DMA after
+// handleInterrupt() has returned
+void RH_RF69::rxFifoRead(void* driver, uint8_t status)
+{
+    (void)status;
+    RH_RF69* self = (RH_RF69*)driver;
+    self->_rxGood++;
+    self->_rxBufValid = true;
+}
+
 // These are low level functions that call the interrupt handler for the correct
 // instance of RH_RF69.
 // 3 interrupts allows us to have 3 different devices
@@ -949,6 +949,10 @@ public:
     /// RSSI measurement was made.
     uint32_t getLastPreambleTime();
 
+    /// Returns when the last message was received, which is when its preamble was detected
+    /// \return The time as returned by millis()
+    uint32_t lastRxTime() { return _lastPreambleTime;}
+
     /// The maximum message length supported by this driver
     /// \return The maximum message length supported by this driver
     uint8_t maxMessageLength();
@@ -998,6 +1002,12 @@ protected:
     /// Should not need to be called by user code.
     void           readFifo();
 
+    /// Called when readFifo() has read the payload of a received message from the FIFO,
+    /// maybe later, by an SPI interface with DMA (see RHSPIDriver::spiBurstReadAsync())
+    /// \param[in] driver The RH_RF69 that received the message
+    /// \param[in] status Not used
+    static void    rxFifoRead(void* driver, uint8_t status);
+
 protected:
     /// Low level interrupt service routine for RF69 connected to interrupt 0
     static void         isr0();
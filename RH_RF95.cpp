@@ -38,6 +38,7 @@ RH_RF95::RH_RF95(uint8_t slaveSelectPin, uint8_t interruptPin, RHGenericSPI& spi
     _myInterruptIndex = 0xff; // Not allocated yet
     _enableCRC = true;
     _useRFO = false;
+    _lastRxTime = 0;
 }
 
 bool RH_RF95::init()
@@ -69,6 +70,16 @@ bool RH_RF95::init()
     }
 
     // No way to check the device type :-(
+
+    // Configuration registers that only change when we write them, so can be shadowed
+    // if the application enables shadow registers with spiSetShadowEnabled()
+    spiSetShadowCacheable(RH_RF95_REG_06_FRF_MSB, 4);              // 0x06 to 0x09
+    spiSetShadowCacheable(RH_RF95_REG_0E_FIFO_TX_BASE_ADDR, 2);    // 0x0e and 0x0f
+    spiSetShadowCacheable(RH_RF95_REG_1D_MODEM_CONFIG1, 2);        // 0x1d and 0x1e
+    spiSetShadowCacheable(RH_RF95_REG_20_PREAMBLE_MSB, 4);         // 0x20 to 0x23
+    spiSetShadowCacheable(RH_RF95_REG_26_MODEM_CONFIG3);
+    spiSetShadowCacheable(RH_RF95_REG_40_DIO_MAPPING1);
+    spiSetShadowCacheable(RH_RF95_REG_4D_PA_DAC);
     
     // Set sleep mode, so we can also set LORA mode:
     spiWrite(RH_RF95_REG_01_OP_MODE, RH_RF95_MODE_SLEEP | RH_RF95_LONG_RANGE_MODE);
@@ -153,11 +164,35 @@ void RH_RF95::handleInterrupt()
     // we need the RF95 IRQ to be level triggered, or we ……have slim chance of missing events
     // https://github.com/geeksville/Meshtastic-esp32/commit/78470ed3f59f5c84fbd1325bcff1fd95b2b20183
 
-    // Read the interrupt register
-    uint8_t irq_flags = spiRead(RH_RF95_REG_12_IRQ_FLAGS);
-    // Read the RegHopChannel register to check if CRC presence is signalled
-    // in the header. If not it might be a stray (noise) packet.*
-    uint8_t hop_channel = spiRead(RH_RF95_REG_1C_HOP_CHANNEL);
+    // Read the interrupt register, and everything else we might need to receive a packet,
+    // and ack all interrupts (see below), in one batch of SPI transactions.
+    // Registers 0x10 to 0x13 and 0x19 to 0x1c are each read in a single burst
+    struct
+    {
+	uint8_t fifoRxCurrentAddr; // RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR
+	uint8_t irqFlagsMask;      // RH_RF95_REG_11_IRQ_FLAGS_MASK
+	uint8_t irqFlags;          // RH_RF95_REG_12_IRQ_FLAGS
+	uint8_t rxNbBytes;         // RH_RF95_REG_13_RX_NB_BYTES
+    } rx;
+    struct
+    {
+	uint8_t pktSnrValue;       // RH_RF95_REG_19_PKT_SNR_VALUE
+	uint8_t pktRssiValue;      // RH_RF95_REG_1A_PKT_RSSI_VALUE
+	uint8_t rssiValue;         // RH_RF95_REG_1B_RSSI_VALUE
+	uint8_t hopChannel;        // RH_RF95_REG_1C_HOP_CHANNEL
+    } pkt;
+    uint8_t clear = 0xff;
+    RHGenericSPI::Transaction status[] =
+    {
+	{ RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR, false, &rx.fifoRxCurrentAddr, sizeof(rx) },
+	// The RegHopChannel register says if CRC presence is signalled
+	// in the header. If not it might be a stray (noise) packet.
+	{ RH_RF95_REG_19_PKT_SNR_VALUE,        false, &pkt.pktSnrValue,      sizeof(pkt) },
+	{ RH_RF95_REG_12_IRQ_FLAGS,            true,  &clear,                1 },
+    };
+    spiBatch(status, sizeof(status) / sizeof(status[0]));
+    uint8_t irq_flags = rx.irqFlags;
+    uint8_t hop_channel = pkt.hopChannel;
 //    Serial.println(irq_flags, HEX);
 //    Serial.println(_mode, HEX);
 //    Serial.println(hop_channel, HEX);
@@ -172,7 +207,7 @@ void RH_RF95::handleInterrupt()
     // our ISR will be reinvoked to handle that case)
     // kevinh: turn this off until root cause is known, because it can cause missed interrupts!
     // spiWrite(RH_RF95_REG_12_IRQ_FLAGS, 0xff); // Clear all IRQ flags
-    spiWrite(RH_RF95_REG_12_IRQ_FLAGS, 0xff); // Clear all IRQ flags
+    // (Cleared in the batch above)
 
     // error if:
     // timeout
@@ -194,21 +229,18 @@ void RH_RF95::handleInterrupt()
 	// Packet received, no CRC error
 //	Serial.println("R");
 	// Have received a packet
-	uint8_t len = spiRead(RH_RF95_REG_13_RX_NB_BYTES);
+	uint8_t len = rx.rxNbBytes;
 
-	// Reset the fifo read ptr to the beginning of the packet
-	spiWrite(RH_RF95_REG_0D_FIFO_ADDR_PTR, spiRead(RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR));
-	spiBurstRead(RH_RF95_REG_00_FIFO, _buf, len);
-	_bufLen = len;
+	_lastRxTime = millis();
 
 	// Remember the last signal to noise ratio, LORA mode
 	// Per page 111, SX1276/77/78/79 datasheet
-	_lastSNR = (int8_t)spiRead(RH_RF95_REG_19_PKT_SNR_VALUE) / 4;
+	_lastSNR = (int8_t)pkt.pktSnrValue / 4;
 
 	// Remember the RSSI of this packet, LORA mode
 	// this is according to the doc, but is it really correct?
 	// weakest receiveable signals are reported RSSI at about -66
-	_lastRssi = spiRead(RH_RF95_REG_1A_PKT_RSSI_VALUE);
+	_lastRssi = pkt.pktRssiValue;
 	// Adjust the RSSI, datasheet page 87
 	if (_lastSNR < 0)
 	    _lastRssi = _lastRssi + _lastSNR;
@@ -219,10 +251,20 @@ void RH_RF95::handleInterrupt()
 	else
 	    _lastRssi -= 164;
 	    
-	// We have received a message.
-	validateRxBuf(); 
-	if (_rxBufValid)
-	    setModeIdle(); // Got one 
+	// Reset the fifo read ptr to the beginning of the packet, and read it. The packet can be long,
+	// so dont hold off interrupts while it is transferred, and let an SPI interface with DMA do it
+	// after we return. rxFifoRead() finishes up when it has been read
+	RHGenericSPI::Transaction fifo[] =
+	{
+	    { RH_RF95_REG_0D_FIFO_ADDR_PTR, true,  &rx.fifoRxCurrentAddr, 1 },
+	    { RH_RF95_REG_00_FIFO,          false, _buf,                  len },
+	};
+	_bufLen = len;
+	if (!spiBatchAsync(fifo, 2, rxFifoRead, this))
+	{
+	    spiBatch(fifo, 2); // Could not start it: do it the synchronous way
+	    rxFifoRead(this, 0);
+	}
     }
     else if (_mode == RHModeTx && irq_flags & RH_RF95_TX_DONE)
     {
@@ -248,6 +290,18 @@ void RH_RF95::handleInterrupt()
     RH_MUTEX_UNLOCK(lock); 
 }
 
+// Called when a received packet has been read from the FIFO, maybe by DMA after handleInterrupt()
+// has returned
+void RH_RF95::rxFifoRead(void* driver, uint8_t status)
+{
+    (void)status;
+    RH_RF95* self = (RH_RF95*)driver;
+    // We have received a message.
+    self->validateRxBuf(); 
+    if (self->_rxBufValid)
+	self->setModeIdle(); // Got one 
+}
+
 // These are low level functions that call the interrupt handler for the correct
 // instance of RH_RF95.
 // 3 interrupts allows us to have 3 different devices
@@ -337,15 +391,22 @@ bool RH_RF95::send(const uint8_t* data, uint8_t len)
     if (!waitCAD()) 
 	return false;  // Check channel activity
 
-    // Position at the beginning of the FIFO
-    spiWrite(RH_RF95_REG_0D_FIFO_ADDR_PTR, 0);
-    // The headers
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderTo);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderFrom);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderId);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderFlags);
-    // The message data
-    spiBurstWrite(RH_RF95_REG_00_FIFO, data, len);
+    // Load the FIFO in one SPI transaction, so nothing else can move its address pointer in between:
+    // position at the beginning of the FIFO, then the headers, then the message data
+    uint8_t fifoAddr = 0;
+    uint8_t headers[RH_RF95_HEADER_LEN] = { _txHeaderTo, _txHeaderFrom, _txHeaderId, _txHeaderFlags };
+    RHGenericSPI::Transaction load[] =
+    {
+	{ RH_RF95_REG_0D_FIFO_ADDR_PTR, true, &fifoAddr, 1 },
+	{ RH_RF95_REG_00_FIFO, true, headers, sizeof(headers) },
+	{ RH_RF95_REG_00_FIFO, true, (uint8_t*)data, len },
+    };
+    // The message data can be long, so dont hold off interrupts while it is transferred,
+    // and let an SPI interface with DMA do it while we wait
+    if (spiBatchAsync(load, 3))
+	spiAsyncWait();
+    else
+	spiBatch(load, 3); // Could not start it: do it the synchronous way
     spiWrite(RH_RF95_REG_22_PAYLOAD_LENGTH, len + RH_RF95_HEADER_LEN);
     
     RH_MUTEX_LOCK(lock); // Multithreading support
@@ -481,6 +481,11 @@
 /// - Hanging
 /// - Output from Serial.print() not appearing
 ///
+/// If the library is built with RH_SPI_SHADOW_REGISTERS defined to 128, RHSPIDriver can keep shadow copies
+/// of registers in RAM. RH_RF95 declares its modem, frequency, power, preamble and DIO mapping configuration registers 
+/// cacheable, so if you call spiSetShadowEnabled(true) after init(), the read-modify-write of 
+/// those registers by functions like setSignalBandwidth() and setCodingRate4() no longer read the radio.
+///
 /// \par Range
 ///
 /// We have made some simple range tests under the following conditions:
@@ -784,6 +789,10 @@ public:
     /// \return SNR of the last received message in dB
     int lastSNR();
 
+    /// Returns when the last message was received (when its RxDone interrupt was handled)
+    /// \return The time as returned by millis()
+    uint32_t lastRxTime() { return _lastRxTime;}
+
     /// brian.n.norman@gmail.com 9th Nov 2018
     /// Sets the radio spreading factor.
     /// valid values are 6 through 12.
@@ -846,6 +855,11 @@ public:
     /// \param none
     /// \return uint8_t deviceID
     uint8_t getDeviceVersion();
+
+    /// Handles an interrupt from the radio, as the interrupt handler would. For use when the driver was given
+    /// RH_INVALID_PIN as its interrupt pin, and something else (such as the service thread of
+    /// RHThreadedDriver) detects the interrupts
+    void           serviceInterrupt() { handleInterrupt();}
     
 protected:
     /// This is a low level function to handle the interrupts for one instance of RH_RF95.
@@ -856,6 +870,12 @@ protected:
     /// Examine the revceive buffer to determine whether the message is for this node
     void validateRxBuf();
 
+    /// Called when the interrupt handler has read a received packet from the FIFO,
+    /// maybe later, by an SPI interface with DMA (see RHSPIDriver::spiBatchAsync())
+    /// \param[in] driver The RH_RF95 that received the packet
+    /// \param[in] status Not used
+    static void    rxFifoRead(void* driver, uint8_t status);
+
     /// Clear our local receive buffer
     void clearRxBuf();
 
@@ -907,6 +927,9 @@ private:
     /// Last measured SNR, dB
     int8_t              _lastSNR;
 
+    /// millis() when the last message was received
+    uint32_t            _lastRxTime;
+
     /// If true, sends CRCs in every packet and requires a valid CRC in every received packet
     bool                _enableCRC;
 
@@ -0,0 +1,219 @@
+// RHClock.h
+//
+// Time for RadioHead on Linux and other Unix hosts, including Raspberry Pi: millis(), micros(),
+// delay() and delayUntil() are based on whichever RHClock is in use. By default that is an
+// RHMonotonicClock, which does not jump when the system (wall clock) time is changed by NTP or the user.
+// Tests can install an RHVirtualClock instead, so that time only passes when they say so.
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHClock_h
+#define RHClock_h
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHClock RHClock.h <RHutil/RHClock.h>
+/// \brief Abstract source of time for Linux and other Unix hosts
+///
+/// Gives the time in nanoseconds since the clock started, and sleeps until an absolute
+/// time. millis(), micros(), delay() and delayUntil() use the clock returned by RHClock::clock(),
+/// and so do all the timeouts in the drivers and managers. Replace it with setClock().
+class RHClock
+{
+public:
+    /// Destructor
+    virtual ~RHClock() {}
+
+    /// Returns the time since the clock started
+    /// \return The time in nanoseconds
+    virtual uint64_t nanos() = 0;
+
+    /// Sleeps until the clock reaches an absolute time. Returns at once if it
+    /// is already later than that. Sleeping until an absolute time does not accumulate errors
+    /// the way repeated relative sleeps do, and is not cut short by signals
+    /// \param[in] deadline The time to wake up, in nanoseconds, as returned by nanos()
+    virtual void     sleepUntil(uint64_t deadline) = 0;
+
+    /// Returns the clock in use
+    /// \return The clock given to setClock(), or the RHMonotonicClock if none has been
+    static RHClock*  clock() { return instance();}
+
+    /// Sets the clock to use
+    /// \param[in] clock The new clock. NULL to go back to the RHMonotonicClock
+    static void      setClock(RHClock* clock);
+
+protected:
+    /// The clock in use
+    static RHClock*& instance();
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHMonotonicClock RHClock.h <RHutil/RHClock.h>
+/// \brief Clock from CLOCK_MONOTONIC, the default RHClock
+///
+/// Counts from when it was created, which for the default clock is the first time it is
+/// used (by simMain.cpp, that is at the start of the process).
+class RHMonotonicClock : public RHClock
+{
+public:
+    /// Constructor. Starts counting from now
+    RHMonotonicClock() : _start(0) { _start = now();}
+
+    /// Returns the time since the clock was created
+    /// \return The time in nanoseconds
+    uint64_t nanos() { return now() - _start;}
+
+    /// Sleeps until an absolute time with clock_nanosleep(TIMER_ABSTIME), where it is available
+    /// \param[in] deadline The time to wake up, in nanoseconds since the clock was created
+    void     sleepUntil(uint64_t deadline)
+    {
+	uint64_t when = _start + deadline;
+#if defined(TIMER_ABSTIME) && !defined(__APPLE__)
+	struct timespec ts;
+	ts.tv_sec = when / 1000000000ULL;
+	ts.tv_nsec = when % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+	    ;
+#else
+	// OSX has no clock_nanosleep: sleep for the time left, until there is none
+	uint64_t t;
+	while ((t = now()) < when)
+	{
+	    struct timespec ts;
+	    ts.tv_sec = (when - t) / 1000000000ULL;
+	    ts.tv_nsec = (when - t) % 1000000000ULL;
+	    nanosleep(&ts, NULL);
+	}
+#endif
+    }
+
+protected:
+    /// Reads CLOCK_MONOTONIC
+    /// \return The time in nanoseconds since some unspecified time
+    static uint64_t now()
+    {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /// CLOCK_MONOTONIC when the clock was created
+    uint64_t _start;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHVirtualClock RHClock.h <RHutil/RHClock.h>
+/// \brief Clock for tests, where time only passes when the test says so
+///
+/// Starts at 0. Time moves on only when advance() or set() is called,
+/// or when something sleeps: sleepUntil() (and so delay(), delayUntil() and the
+/// waiting loops of drivers and managers) moves the time on to the deadline at once, instead of waiting.
+/// So a test of timeouts and retries that would take minutes runs in milliseconds, and
+/// gives the same result every time. Intended for single threaded tests.
+class RHVirtualClock : public RHClock
+{
+public:
+    /// Constructor. The time starts at 0
+    RHVirtualClock() : _now(0) {}
+
+    /// Returns the virtual time
+    /// \return The time in nanoseconds
+    uint64_t nanos() { return _now;}
+
+    /// Moves the virtual time on to deadline, if it is later
+    /// \param[in] deadline The time to wake up, in nanoseconds
+    void     sleepUntil(uint64_t deadline) { if (deadline > _now) _now = deadline;}
+
+    /// Moves the virtual time on
+    /// \param[in] nanoseconds How far to move it
+    void     advance(uint64_t nanoseconds) { _now += nanoseconds;}
+
+    /// Sets the virtual time
+    /// \param[in] nanoseconds The new time
+    void     set(uint64_t nanoseconds) { _now = nanoseconds;}
+
+protected:
+    /// The virtual time
+    volatile uint64_t _now;
+};
+
+inline RHClock*& RHClock::instance()
+{
+    static RHMonotonicClock monotonic;
+    static RHClock* clock = &monotonic;
+    return clock;
+}
+
+inline void RHClock::setClock(RHClock* clock)
+{
+    static RHMonotonicClock* monotonic = (RHMonotonicClock*)instance();
+    instance() = clock ? clock : monotonic;
+}
+
+// Arduino style functions based on RHClock::clock(), for the simulator and Raspberry Pi alike
+
+/// Returns milliseconds since the start of the process
+inline unsigned long millis()
+{
+    return RHClock::clock()->nanos() / 1000000;
+}
+
+/// Returns microseconds since the start of the process
+inline unsigned long micros()
+{
+    return RHClock::clock()->nanos() / 1000;
+}
+
+/// Waits for a number of milliseconds. Sleeps until an absolute time, so signals do not cut it short
+inline void delay(unsigned long ms)
+{
+    RHClock* clock = RHClock::clock();
+    clock->sleepUntil(clock->nanos() + ms * 1000000ULL);
+}
+
+/// Waits for a number of microseconds
+inline void delayMicroseconds(unsigned int us)
+{
+    RHClock* clock = RHClock::clock();
+    clock->sleepUntil(clock->nanos() + us * 1000ULL);
+}
+
+/// Sleeps until millis() reaches deadline. Returns at once if it already has
+/// (allowing for millis() wrapping around).
+inline void delayUntil(unsigned long deadline)
+{
+    RHClock* clock = RHClock::clock();
+    uint64_t now = clock->nanos();
+    long left = (long)(deadline - (unsigned long)(now / 1000000));
+    if (left > 0)
+	clock->sleepUntil((now / 1000000 + left) * 1000000);
+}
+
+// How long the waiting loops in RHGenericDriver and the managers sleep between polls of the
+// driver on Linux and other Unix hosts, in microseconds, when their deadline is further off.
+// Drivers whose messages arrive in another thread
+// (such as interrupt handlers on Raspberry Pi) may be noticed up to this much later
+#ifndef RH_POLL_INTERVAL_US
+ #define RH_POLL_INTERVAL_US 1000
+#endif
+
+/// Sleeps until the next time a waiting loop should poll its driver, or until deadline if that is sooner.
+/// \param[in] deadline The end of the wait, in milliseconds as returned by millis()
+inline void RHPollWait(unsigned long deadline)
+{
+    RHClock* clock = RHClock::clock();
+    uint64_t now = clock->nanos();
+    uint64_t wake = now + RH_POLL_INTERVAL_US * 1000ULL;
+    // Work out the deadline in nanoseconds, near now, allowing for millis() wrapping around
+    long left = (long)(deadline - (unsigned long)(now / 1000000));
+    if (left <= 0)
+	return;
+    uint64_t end = (now / 1000000 + left) * 1000000;
+    clock->sleepUntil(end < wake ? end : wake);
+}
+
+#endif
@@ -0,0 +1,221 @@
+// RHRealtime.h
+//
+// Real time options for the threads that service radios on Linux and other Unix hosts, including
+// Raspberry Pi: SCHED_FIFO priority, CPU pinning and locking memory, and a histogram
+// to measure the latency from an interrupt to when it is serviced.
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHRealtime_h
+#define RHRealtime_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+// SCHED_FIFO priority (1 to 99) for the threads that service radios: the service thread of
+// RHThreadedDriver, and the pigpio interrupt thread on Raspberry Pi. 0 leaves them with
+// the normal time sharing scheduler
+#ifndef RH_REALTIME_PRIORITY
+ #define RH_REALTIME_PRIORITY 0
+#endif
+
+// CPU to pin those threads to (Linux only). -1 lets them run on any CPU
+#ifndef RH_REALTIME_CPU
+ #define RH_REALTIME_CPU -1
+#endif
+
+// Define to non-zero to lock all the memory of the process (mlockall) when they start,
+// so that servicing an interrupt never waits for a page to be read in
+#ifndef RH_REALTIME_LOCK_MEMORY
+ #define RH_REALTIME_LOCK_MEMORY 0
+#endif
+
+// Number of buckets in an RHLatencyHistogram
+#ifndef RH_LATENCY_BUCKETS
+ #define RH_LATENCY_BUCKETS 24
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHRealtime RHRealtime.h <RHutil/RHRealtime.h>
+/// \brief Real time scheduling options for radio service threads on Linux and other Unix hosts
+///
+/// On a busy host, the thread that services a radio competes for the CPU with everything else,
+/// and when it is late to read the FIFO, the radio misses preambles and loses messages.
+/// These functions give a thread SCHED_FIFO priority (so it runs as soon as it is woken,
+/// ahead of all normal threads), pin it to one CPU (which you might keep free of other work with
+/// the isolcpus kernel parameter) and lock the memory of the process.
+///
+/// SCHED_FIFO and mlockall need root, or the CAP_SYS_NICE and CAP_IPC_LOCK capabilities
+/// (or suitable limits in /etc/security/limits.conf). The functions return false when refused,
+/// and the thread carries on as before.
+class RHRealtime
+{
+public:
+    /// Sets the scheduling of a thread
+    /// \param[in] priority SCHED_FIFO priority, 1 to 99. 0 sets the normal time sharing scheduler
+    /// \param[in] thread The thread. Defaults to the calling thread
+    /// \return true if successful
+    static bool setPriority(int priority, pthread_t thread = pthread_self())
+    {
+	struct sched_param param;
+	param.sched_priority = priority;
+	return pthread_setschedparam(thread, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+    }
+
+    /// Pins a thread to a CPU (Linux only)
+    /// \param[in] cpu The CPU number, from 0. -1 lets it run on any CPU
+    /// \param[in] thread The thread. Defaults to the calling thread
+    /// \return true if successful
+    static bool setCpu(int cpu, pthread_t thread = pthread_self())
+    {
+#if defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if (cpu < 0)
+	{
+	    for (int i = 0; i < CPU_SETSIZE; i++)
+		CPU_SET(i, &cpus);
+	}
+	else
+	    CPU_SET(cpu, &cpus);
+	return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+#else
+	(void)thread;
+	return cpu < 0;
+#endif
+    }
+
+    /// Locks all the memory of the process, now and in future, so that it is never paged out
+    /// \return true if successful
+    static bool lockMemory()
+    {
+	return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    }
+
+    /// Applies priority, CPU and memory locking to the calling thread, where they are asked for
+    /// \param[in] priority SCHED_FIFO priority, or 0 to leave the scheduling alone
+    /// \param[in] cpu The CPU to pin to, or -1 to leave the affinity alone
+    /// \param[in] lock true to lock the memory of the process
+    /// \return true if everything asked for was done
+    static bool apply(int priority = RH_REALTIME_PRIORITY, int cpu = RH_REALTIME_CPU, bool lock = RH_REALTIME_LOCK_MEMORY)
+    {
+	bool ok = true;
+	if (lock && !lockMemory())
+	    ok = false;
+	if (cpu >= 0 && !setCpu(cpu))
+	    ok = false;
+	if (priority > 0 && !setPriority(priority))
+	    ok = false;
+	return ok;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHLatencyHistogram RHRealtime.h <RHutil/RHRealtime.h>
+/// \brief Histogram of latencies, in power of 2 microsecond buckets
+///
+/// Bucket 0 counts latencies under 1 microsecond, bucket 1 from 1 to 2 microseconds,
+/// bucket n from 2^(n-1) to 2^n microseconds, and the last bucket everything longer.
+/// record() is cheap enough to call from the thread being measured. It is meant to be written by
+/// one thread; other threads may read it at any time, and see counts that are at most a recording behind.
+class RHLatencyHistogram
+{
+public:
+    /// Constructor. Starts empty
+    RHLatencyHistogram() { reset();}
+
+    /// Empties the histogram
+    void     reset()
+    {
+	for (uint8_t i = 0; i < RH_LATENCY_BUCKETS; i++)
+	    _buckets[i] = 0;
+	_count = 0;
+	_max = 0;
+	_total = 0;
+    }
+
+    /// Records a latency
+    /// \param[in] nanoseconds The latency in nanoseconds
+    void     record(uint64_t nanoseconds)
+    {
+	uint64_t us = nanoseconds / 1000;
+	uint8_t bucket = 0;
+	while (us && bucket < RH_LATENCY_BUCKETS - 1)
+	{
+	    us >>= 1;
+	    bucket++;
+	}
+	_buckets[bucket]++;
+	_count++;
+	_total += nanoseconds;
+	if (nanoseconds > _max)
+	    _max = nanoseconds;
+    }
+
+    /// Returns the number of latencies in a bucket
+    /// \param[in] bucket The bucket number, 0 to RH_LATENCY_BUCKETS - 1
+    /// \return The count
+    uint32_t bucket(uint8_t bucket) { return bucket < RH_LATENCY_BUCKETS ? _buckets[bucket] : 0;}
+
+    /// \return The number of latencies recorded
+    uint32_t count() { return _count;}
+
+    /// \return The longest latency recorded, in nanoseconds
+    uint64_t max() { return _max;}
+
+    /// \return The mean latency, in nanoseconds
+    uint64_t mean() { return _count ? _total / _count : 0;}
+
+    /// Returns an upper bound for a percentile of the latencies, from the bucket it falls in
+    /// \param[in] percent The percentile, such as 99 or 99.9
+    /// \return The upper end of the bucket, in microseconds. The maximum for the last bucket
+    uint64_t percentile(float percent)
+    {
+	uint64_t wanted = (uint64_t)(_count * percent / 100.0f + 0.5f);
+	uint64_t seen = 0;
+	for (uint8_t i = 0; i < RH_LATENCY_BUCKETS - 1; i++)
+	{
+	    seen += _buckets[i];
+	    if (seen >= wanted)
+		return 1ULL << i;
+	}
+	return _max / 1000;
+    }
+
+    /// Prints the histogram to stdout, one line per bucket that has any latencies in it
+    /// \param[in] title Printed first
+    void     print(const char* title)
+    {
+	printf("%s: %lu samples, mean %lu us, 99%% under %lu us, 99.9%% under %lu us, max %lu us\n",
+	       title, (unsigned long)_count, (unsigned long)(mean() / 1000),
+	       (unsigned long)percentile(99), (unsigned long)percentile(99.9f), (unsigned long)(_max / 1000));
+	for (uint8_t i = 0; i < RH_LATENCY_BUCKETS; i++)
+	{
+	    if (!_buckets[i])
+		continue;
+	    if (i == RH_LATENCY_BUCKETS - 1)
+		printf("  >= %7lu us: %lu\n", 1UL << (i - 1), (unsigned long)_buckets[i]);
+	    else
+		printf("  < %8lu us: %lu\n", 1UL << i, (unsigned long)_buckets[i]);
+	}
+    }
+
+protected:
+    /// Counts of latencies in each bucket
+    volatile uint32_t _buckets[RH_LATENCY_BUCKETS];
+
+    /// Number of latencies recorded
+    volatile uint32_t _count;
+
+    /// Longest latency, in nanoseconds
+    volatile uint64_t _max;
+
+    /// Sum of all the latencies, in nanoseconds
+    volatile uint64_t _total;
+};
+
+#endif
@@ -0,0 +1,39 @@
+// RHSelfTest.h
+//
+// Checks for the example sketches that test themselves on Linux and other Unix hosts:
+// each check() prints "ok:" or "FAILED:" and what was checked, and checkExit() prints PASSED or FAILED
+// and exits with a status that scripts can test.
+//
+// Author: agent (agent@local)
+// Copyright (C) 2026 agent
+
+#ifndef RHSelfTest_h
+#define RHSelfTest_h
+
+#include <RadioHead.h>
+#include <stdlib.h>
+
+// Whether every check so far has passed
+inline bool& checksPassed()
+{
+    static bool passed = true;
+    return passed;
+}
+
+// Prints the outcome of one check, and remembers a failure
+inline void check(bool ok, const char* what)
+{
+    Serial.print(ok ? "ok:     " : "FAILED: ");
+    Serial.println(what);
+    if (!ok)
+	checksPassed() = false;
+}
+
+// Prints PASSED or FAILED, and exits with status 0 if every check passed, else 1
+inline void checkExit()
+{
+    Serial.println(checksPassed() ? "PASSED" : "FAILED");
+    exit(checksPassed() ? 0 : 1);
+}
+
+#endif
@@ -13,8 +13,6 @@
 #include <time.h>
 #include "RasPi.h"
 
-//Initialize the values for sanity
-timeval RHStartTime;
 
 void SPIClass::begin()
 {
@@ -37,8 +35,8 @@ void SPIClass::begin(uint16_t divider, uint8_t bitOrder, uint8_t dataMode)
 
   bcm2835_spi_begin();
 
-  //Initialize a timestamp for millis calculation
-  gettimeofday(&RHStartTime, NULL);
+  //Start the clock for millis calculation
+  RHClock::clock();
 }
 
 void SPIClass::end()
@@ -92,27 +90,8 @@ void digitalWrite(unsigned char pin, unsigned char value)
   bcm2835_gpio_write(pin,value);
 }
 
-unsigned long millis()
-{
-  //Declare a variable to store current time
-  struct timeval RHCurrentTime;
-  //Get current time
-  gettimeofday(&RHCurrentTime,NULL);
-  //Calculate the difference between our start time and the end time
-  unsigned long difference = ((RHCurrentTime.tv_sec - RHStartTime.tv_sec) * 1000);
-  difference += ((RHCurrentTime.tv_usec - RHStartTime.tv_usec)/1000);
-  //Return the calculated value
-  return difference;
-}
-
-void delay (unsigned long ms)
-{
-  //Implement Delay function
-  struct timespec ts;
-  ts.tv_sec=0;
-  ts.tv_nsec=(ms * 1000);
-  nanosleep(&ts,&ts);
-}
+//millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h,
+//based on the monotonic clock, which does not jump when the system time is set
 
 long random(long min, long max)
 {
@@ -125,9 +104,9 @@ void SerialSimulator::begin(int baud)
 {
   //No implementation neccesary - Serial emulation on Linux = standard console
   //
-  //Initialize a timestamp for millis calculation - we do this here as well in case SPI
+  //Start the clock for millis calculation - we do this here as well in case SPI
   //isn't used for some reason
-  gettimeofday(&RHStartTime, NULL);
+  RHClock::clock();
 }
 
 size_t SerialSimulator::println(const char* s)
@@ -13,6 +13,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <RHutil/RHClock.h>
 
 typedef unsigned char byte;
 
@@ -66,9 +67,7 @@ void pinMode(unsigned char pin, unsigned char mode);
 
 void digitalWrite(unsigned char pin, unsigned char value);
 
-unsigned long millis();
-
-void delay (unsigned long delay);
+// millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h
 
 long random(long min, long max);
 
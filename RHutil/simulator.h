@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <RHutil/RHClock.h>
 
 // Equivalent types for common Arduino types like uint8_t are in stdint.h
 
@@ -18,9 +19,17 @@
 extern int    _simulator_argc;
 extern char** _simulator_argv;
 
+// Digital pin levels, as in Arduino. There are no pins in the simulator
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT  0x0
+#define OUTPUT 0x1
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int  digitalRead(uint8_t) { return LOW; }
+
 // Definitions for various Arduino functions
-extern void delay(unsigned long ms);
-extern unsigned long millis();
+// millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h
 extern long random(long to);
 extern long random(long from, long to);
 
@@ -54,10 +63,64 @@ public:
 	    return printf("%02x", n);
 	else if (base == OCT)
 	    return printf("%o", n);
-	// TODO: BIN
+	else
+	    return print((unsigned long)n, base);
+    }
+    size_t print(int n, int base = DEC)
+    {
+	return print((long)n, base);
+    }
+    size_t print(long n, int base = DEC)
+    {
+	if (base == DEC)
+	    return printf("%ld", n);
+	else
+	    return print((unsigned long)n, base);
+    }
+    size_t print(unsigned long n, int base = DEC)
+    {
+	if (base == DEC)
+	    return printf("%lu", n);
+	else if (base == HEX)
+	    return printf("%02lx", n);
+	else if (base == OCT)
+	    return printf("%lo", n);
+	else if (base == BIN)
+	{
+	    // printf has no binary conversion: most significant 1 first, like Arduino
+	    char buf[sizeof(n) * 8 + 1];
+	    char* p = &buf[sizeof(buf) - 1];
+	    *p = '\0';
+	    do
+	    {
+		*--p = '0' + (n & 1);
+		n >>= 1;
+	    } while (n);
+	    return print(p);
+	}
 	else
 	    return 0;
     }
+    size_t println(int n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t println(unsigned int n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t println(long n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t println(unsigned long n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
     size_t print(char ch)
     {
         return printf("%c", ch);
@@ -16,12 +16,11 @@
 #include <sys/time.h>
 #include <time.h>
 #include "RasPi.h"
+#include <RHutil/RHRealtime.h>
 #include <stdio.h>
 
 int spiHandle;
 
-//Initialize the values for sanity
-timeval RHStartTime;
 
 void SPIClass::begin()
 {
@@ -59,8 +58,8 @@ void SPIClass::begin(uint16_t divider, uint8_t bitOrder, uint8_t dataMode)
   printf("\nSPI Settings:\nBaud rate=%d\nFlags=%d\n\n", spiBaud, spiFlags);
   spiHandle = spiOpen(0, spiBaud, spiFlags); //spiChannel assumed to be zero.
 
-  //Initialize a timestamp for millis calculation
-  gettimeofday(&RHStartTime, NULL);
+  //Start the clock for millis calculation
+  RHClock::clock();
 }
 
 void SPIClass::end()
@@ -151,27 +150,8 @@ void digitalWrite(unsigned char pin, unsigned char value)
   }
 }
 
-unsigned long millis()
-{
-  //Declare a variable to store current time
-  struct timeval RHCurrentTime;
-  //Get current time
-  gettimeofday(&RHCurrentTime,NULL);
-  //Calculate the difference between our start time and the end time
-  unsigned long difference = ((RHCurrentTime.tv_sec - RHStartTime.tv_sec) * 1000);
-  difference += ((RHCurrentTime.tv_usec - RHStartTime.tv_usec)/1000);
-  //Return the calculated value
-  return difference;
-}
-
-void delay (unsigned long ms)
-{
-  //Implement Delay function
-  struct timespec ts;
-  ts.tv_sec=0;
-  ts.tv_nsec=(ms * 1000);
-  nanosleep(&ts,&ts);
-}
+//millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h,
+//based on the monotonic clock, which does not jump when the system time is set
 
 long random(long min, long max)
 {
@@ -185,18 +165,34 @@ long random(long min, long max)
 //* Emulate Arduino Function
 //******************************
 
+// pigpio calls interrupt handlers from a thread of its own for each pin. The first time that thread
+// calls one, give it the real time options from RHutil/RHRealtime.h (RH_REALTIME_PRIORITY etc),
+// so that it services the radio ahead of the other threads on a busy host
+static void interruptHandler(int gpio, int level, uint32_t tick, void* handler)
+{
+    (void)gpio; (void)level; (void)tick;
+    static __thread bool realtime = false;
+    if (!realtime)
+    {
+      realtime = true;
+      if (!RHRealtime::apply())
+        printf("attachInterrupt: could not apply the real time options\n");
+    }
+    ((void (*)(void))handler)();
+}
+
 void attachInterrupt(unsigned char pin, void (*handler)(void), int mode)
 {
     switch(mode)
     {
         case CHANGE:
-            gpioSetISRFunc(pin, EITHER_EDGE, 0, (void (*)(int,int,unsigned int))handler);
+            gpioSetISRFuncEx(pin, EITHER_EDGE, 0, interruptHandler, (void*)handler);
             break;
         case RISING:
-            gpioSetISRFunc(pin, RISING_EDGE, 0, (void (*)(int,int,unsigned int))handler);
+            gpioSetISRFuncEx(pin, RISING_EDGE, 0, interruptHandler, (void*)handler);
             break;
         case FALLING:
-            gpioSetISRFunc(pin, FALLING_EDGE, 0, (void (*)(int,int,unsigned int))handler);
+            gpioSetISRFuncEx(pin, FALLING_EDGE, 0, interruptHandler, (void*)handler);
             break;
         default:
             break;
@@ -207,9 +203,9 @@ void SerialSimulator::begin(int baud)
 {
   //No implementation neccesary - Serial emulation on Linux = standard console
   //
-  //Initialize a timestamp for millis calculation - we do this here as well in case SPI
+  //Start the clock for millis calculation - we do this here as well in case SPI
   //isn't used for some reason
-  gettimeofday(&RHStartTime, NULL);
+  RHClock::clock();
 }
 
 size_t SerialSimulator::println(const char* s)
@@ -20,6 +20,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <RHutil/RHClock.h>
 
 typedef unsigned char byte;
 
@@ -151,9 +152,7 @@ void pinMode(uint8_t pin, WiringPinMode mode);
 
 void digitalWrite(unsigned char pin, unsigned char value);
 
-unsigned long millis();
-
-void delay (unsigned long delay);
+// millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h
 
 long random(long min, long max);
 
@@ -120,7 +120,8 @@ Works with EBYTE E32-TTL-1W serial radio transceivers (and possibly other transc
 - RH_ASK
 Works with a range of inexpensive ASK (amplitude shift keying) RF transceivers such as RX-B1 
 (also known as ST-RX04-ASK) receiver; TX-C1 transmitter and DR3100 transceiver; FS1000A/XY-MK-5V transceiver;
-HopeRF RFM83C / RFM85. Supports ASK (OOK).
+HopeRF RFM83C / RFM85. Supports ASK (OOK). Also builds on Linux as a software modem that works on
+buffers of samples. RH_ASKMultiDemod demodulates many RH_ASK channels at once on Linux, using SIMD instructions.
 
 - RH_ABZ Works with EcoNode SmartTrap, Tlera Grasshopper and family. Almost any board equipped with a muRata cmwx1zzabz module
 should work. Tested with EcoNode SmartTrap, Arduino 1.8.9, GrumpyOldPizza Arduino Core for STM32L0.
@@ -142,6 +143,11 @@ testing of Manager classes on Linux and without need for real radios or other tr
 Adds encryption and decryption to any RadioHead transport driver, using any encrpytion cipher
 supported by ArduinoLibs Cryptographic Library http://rweather.github.io/arduinolibs/crypto.html
 
+- RHFECDriver
+Adds Reed-Solomon forward error correction to any RadioHead transport driver, so that messages with a 
+few octets in error can be corrected instead of being dropped. Only useful with transports that can deliver
+messages with errors, such as radios with their CRC checking disabled.
+
 Drivers can be used on their own to provide unaddressed, unreliable datagrams. 
 All drivers have the same identical API.
 Or you can use any Driver with any of the Managers described below.
@@ -165,6 +171,10 @@ Addressed, unreliable variable length messages, with optional broadcast faciliti
 - RHReliableDatagram
   Addressed, reliable, retransmitted, acknowledged variable length messages.
 
+- RHAggregatingDatagram
+  Reliable datagrams that pack several small messages to the same destination into each frame, 
+  to reduce the header, preamble and acknowledgement overhead of frequent short messages.
+
 - RHRouter
   Multi-hop delivery of RHReliableDatagrams from source node to destination node via 0 or more
   intermediate nodes, with manual, pre-programmed routing.
@@ -259,6 +269,16 @@ Including Diecimila, Uno, Mega, Leonardo, Yun, Due, Zero etc. http://arduino.cc/
   Uses BCM2835 library for GPIO http://www.airspayce.com/mikem/bcm2835/
   Currently works only with RH_NRF24 driver or other drivers that do not require interrupt support.
   Contributed by Mike Poublon.
+  SPI drivers can also use the Linux kernel spidev driver through RHSpidevSPI, on Raspberry Pi and other 
+  Linux boards.
+  Several radios can share one SPI bus safely from different threads with RHSPIBus.
+  millis() and delay() use the monotonic clock (see RHutil/RHClock.h), so timeouts are not upset by
+  changes to the system time.
+  RHThreadedDriver runs a driver (RH_RF95 with RH_INVALID_PIN, for example) in a service thread of
+  its own, which handles its interrupts, so the application never touches the radio directly.
+  That thread, and the pigpio interrupt thread, can be given SCHED_FIFO priority, pinned to a CPU and
+  have memory locked (see RHutil/RHRealtime.h).
+  The managers may be used by several threads at once (see "Threads" in RHDatagram).
 
 - Linux and OSX
   Using the RHutil/HardwareSerial class, the RH_Serial driver and any manager will
@@ -1557,6 +1577,7 @@ these examples and explanations and extend them to suit your needs.
  // Simulate the sketch on Linux and OSX
  #include <RHutil/simulator.h>
  #define RH_HAVE_SERIAL
+ #define PROGMEM
 #include <netinet/in.h> // For htons and friends
 
 #else
@@ -1721,6 +1742,12 @@ these examples and explanations and extend them to suit your needs.
  #endif
 #endif
 
+// Read a byte from a table declared PROGMEM. Platforms without separate program memory
+// do not define pgm_read_byte, and their PROGMEM tables are ordinary constants
+#ifndef pgm_read_byte
+ #define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#endif
+
 // Some platforms need a mutex for multihreaded case
 #ifdef RH_USE_MUTEX
  #include <pthread.h>
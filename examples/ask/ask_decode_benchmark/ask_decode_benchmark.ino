@@ -0,0 +1,206 @@
+// ask_decode_benchmark.pde
+// -*- mode: C++ -*-
+// Example sketch that measures the cost of decoding received RH_ASK symbols in the
+// receiver interrupt handler: the original linear search of the symbol table
+// compared with the 64 entry reverse lookup table used by RH_ASK::symbol_12to8().
+// On AVR Arduinos, counts CPU cycles with Timer 1 (so dont call init(), which would
+// take it over). On Linux, counts instructions with the perf_event interface if the kernel
+// allows it, else measures nanoseconds.
+// Also measures the average cost per sample of the whole receive path with
+// RH_ASK::demodulate().
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/ask/ask_decode_benchmark/ask_decode_benchmark.ino tools/simMain.cpp RH_ASK.cpp RHGenericDriver.cpp RHCRC.cpp -o ask_decode_benchmark
+// Run with ./ask_decode_benchmark
+
+#include <RH_ASK.h>
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+ #include <time.h>
+ #if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+ #endif
+#endif
+
+// Same as the table in RH_ASK.cpp
+static uint8_t symbols[] =
+{
+    0xd,  0xe,  0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
+    0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34
+};
+
+// Gives access to the protected decoders in RH_ASK
+class BenchmarkASK : public RH_ASK
+{
+public:
+    // The linear search formerly used by RH_ASK::symbol_6to4
+    uint8_t linear_6to4(uint8_t symbol)
+    {
+	uint8_t i;
+	uint8_t count;
+	for (i = (symbol>>2) & 8, count=8; count-- ; i++)
+	    if (symbol == symbols[i]) return i;
+	return 0;
+    }
+    uint16_t decodeLinear(uint16_t bits)
+    {
+	return (linear_6to4(bits & 0x3f) << 4) | linear_6to4(bits >> 6);
+    }
+    uint16_t decodeTable(uint16_t bits)
+    {
+	return symbol_12to8(bits);
+    }
+};
+
+BenchmarkASK driver;
+
+// All 256 valid pairs of encoded symbols, as received
+uint16_t encoded[256];
+
+// Results go here so the compiler cant optimise the decodes away
+volatile uint16_t sink;
+
+#if defined(__AVR__)
+// Cycles taken by a single call, timed with Timer 1 at the CPU clock
+#define MEASURE(result, expr) \
+  { \
+    uint8_t sreg = SREG; \
+    cli(); \
+    uint16_t t0 = TCNT1; \
+    sink = (expr); \
+    result = TCNT1 - t0; \
+    SREG = sreg; \
+  }
+#define UNITS "cycles"
+
+void startCounter()
+{
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // No prescaling
+}
+
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+// Host: average over many calls, since single calls are too quick to time
+#define REPEAT 10000
+int perf_fd = -1;
+
+void startCounter()
+{
+#if defined(__linux__)
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+unsigned long long counter()
+{
+  unsigned long long count = 0;
+  if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) == sizeof(count))
+    return count;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define MEASURE(result, expr) \
+  { \
+    unsigned long long t0 = counter(); \
+    for (unsigned int r = 0; r < REPEAT; r++) \
+      sink = (expr); \
+    result = (counter() - t0) / REPEAT; \
+  }
+#define UNITS (perf_fd >= 0 ? "instructions" : "ns")
+
+#else
+ #error This benchmark runs on AVR Arduinos and Linux
+#endif
+
+// Measure min and max cost of decoding every valid pair
+void measure(const char* name, bool table)
+{
+  unsigned long min = 0xffffffff, max = 0, overhead = 0xffffffff, cost;
+  uint16_t i;
+  // Cost of the measurement itself
+  for (i = 0; i < 256; i++)
+  {
+    MEASURE(cost, encoded[i]);
+    if (cost < overhead)
+      overhead = cost;
+  }
+  for (i = 0; i < 256; i++)
+  {
+    if (table)
+      MEASURE(cost, driver.decodeTable(encoded[i]))
+    else
+      MEASURE(cost, driver.decodeLinear(encoded[i]))
+    cost = cost > overhead ? cost - overhead : 0;
+    if (cost < min)
+      min = cost;
+    if (cost > max)
+      max = cost;
+  }
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(min, DEC);
+  Serial.print(" to ");
+  Serial.print(max, DEC);
+  Serial.print(" ");
+  Serial.print(UNITS);
+  Serial.println(" per received byte");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  uint16_t i;
+  for (i = 0; i < 256; i++)
+  {
+    encoded[i] = symbols[i >> 4] | (symbols[i & 0xf] << 6);
+    if (driver.decodeLinear(encoded[i]) != i || driver.decodeTable(encoded[i]) != i)
+      Serial.println("decode mismatch");
+  }
+  // Every other pattern must be rejected
+  uint16_t invalid = 0;
+  for (i = 0; i < 4096; i++)
+    if (driver.decodeTable(i) > 0xff)
+      invalid++;
+  if (invalid != 4096 - 256)
+    Serial.println("invalid symbols not detected");
+
+  startCounter();
+  measure("linear search (before)", false);
+  measure("reverse table (after)", true);
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+  // Whole receive path, per sample
+  static uint8_t samples[RH_ASK_MODULATED_LEN(RH_ASK_MAX_MESSAGE_LEN)];
+  uint8_t data[RH_ASK_MAX_MESSAGE_LEN];
+  memset(data, 0x55, sizeof(data));
+  uint16_t n = driver.modulate(data, sizeof(data), samples, sizeof(samples));
+  unsigned long long t0 = counter();
+  for (i = 0; i < 100; i++)
+  {
+    driver.demodulate(samples, n);
+    driver.available(); // Collect the message
+  }
+  Serial.print("demodulate: ");
+  Serial.print((unsigned long)((counter() - t0) / (100ULL * n)), DEC);
+  Serial.print(" ");
+  Serial.print(UNITS);
+  Serial.println(" per sample");
+  exit(0);
+#endif
+}
+
+void loop()
+{
+}
@@ -0,0 +1,105 @@
+// ask_multi_demod_benchmark.pde
+// -*- mode: C++ -*-
+// Example sketch that measures the speed of RH_ASKMultiDemod demodulating
+// many RH_ASK channels at once, in channel-samples per second on one CPU core.
+// Synthesises messages on each channel with RH_ASK::modulate(), at different times
+// and bit phases on each channel, interleaves them and demodulates them all, checking
+// that every message is received.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/ask/ask_multi_demod_benchmark/ask_multi_demod_benchmark.ino tools/simMain.cpp RH_ASKMultiDemod.cpp RH_ASK.cpp RHGenericDriver.cpp RHCRC.cpp -o ask_multi_demod_benchmark
+// That uses SSE2 on x86-64. Add -mavx2 (or -march=native) to use AVX2, or -DRH_ASK_MULTI_NO_SIMD
+// to compare with the scalar code.
+// Run with ./ask_multi_demod_benchmark [numchannels]
+
+#include <RH_ASKMultiDemod.h>
+
+// Messages per channel
+#define NUM_MESSAGES 20
+
+// Length of the user data in each message
+#define MESSAGE_LEN 20
+
+// Number of times to demodulate the whole buffer
+#define REPEATS 20
+
+RH_ASK channels[RH_ASK_MULTI_MAX_CHANNELS];
+RH_ASKMultiDemod demod;
+
+// Samples for one message, then idle time, for one channel
+#define SLOT (RH_ASK_MODULATED_LEN(MESSAGE_LEN) + 200)
+uint8_t message[RH_ASK_MODULATED_LEN(MESSAGE_LEN)];
+
+// Interleaved samples for all channels
+uint8_t samples[SLOT * NUM_MESSAGES * RH_ASK_MULTI_MAX_CHANNELS];
+
+void setup()
+{
+  Serial.begin(9600);
+  uint8_t numChannels = RH_ASK_MULTI_MAX_CHANNELS;
+  if (_simulator_argc > 1)
+    numChannels = atoi(_simulator_argv[1]);
+  if (numChannels < 1 || numChannels > RH_ASK_MULTI_MAX_CHANNELS)
+    numChannels = RH_ASK_MULTI_MAX_CHANNELS;
+
+  uint8_t c;
+  for (c = 0; c < numChannels; c++)
+    demod.addChannel(&channels[c]);
+
+  // Each channel sends its messages with a different offset into each slot
+  uint8_t data[MESSAGE_LEN];
+  uint32_t len = (uint32_t)SLOT * NUM_MESSAGES;
+  memset(samples, 0, len * numChannels);
+  for (c = 0; c < numChannels; c++)
+  {
+    channels[c].setHeaderFrom(c);
+    uint16_t n = channels[c].modulate(data, sizeof(data), message, sizeof(message));
+    uint8_t m;
+    for (m = 0; m < NUM_MESSAGES; m++)
+    {
+      uint32_t start = (uint32_t)m * SLOT + random(0, 200);
+      uint16_t i;
+      for (i = 0; i < n; i++)
+        samples[(start + i) * numChannels + c] = message[i];
+    }
+  }
+
+  // Demodulate it all
+  unsigned long received = 0;
+  unsigned long start = millis();
+  uint8_t r;
+  for (r = 0; r < REPEATS; r++)
+  {
+    const uint8_t* p = samples;
+    uint32_t remaining = len;
+    while (remaining)
+    {
+      uint16_t used = demod.demodulate(p, remaining > 0xffff ? 0xffff : remaining);
+      p += (uint32_t)used * numChannels;
+      remaining -= used;
+      // One or more channels may have a message ready
+      for (c = 0; c < numChannels; c++)
+        if (channels[c].recv(NULL, NULL) && channels[c].headerFrom() == c)
+          received++;
+    }
+  }
+  unsigned long elapsed = millis() - start;
+  if (elapsed == 0)
+    elapsed = 1;
+
+  Serial.print(RH_ASKMultiDemod::simdName());
+  Serial.print(": ");
+  Serial.print(numChannels, DEC);
+  Serial.print(" channels, ");
+  Serial.print(received, DEC);
+  Serial.print(" of ");
+  Serial.print((unsigned long)numChannels * NUM_MESSAGES * REPEATS, DEC);
+  Serial.print(" messages received, ");
+  Serial.print((unsigned long)((double)len * numChannels * REPEATS * 1000 / elapsed), DEC);
+  Serial.println(" channel-samples/s");
+  exit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,161 @@
+// ask_sample_modem.pde
+// -*- mode: C++ -*-
+// Example sketch showing how to use RH_ASK as a software modem on Linux,
+// with RH_ASK::modulate() and RH_ASK::demodulate() working on sample buffers
+// instead of the hardware timer and pins.
+// With a file name argument, decodes a capture file containing one octet per sample
+// (0 for low, anything else for high) taken at 8 samples per bit, such as
+// a logic analyser or SDR capture, and prints the messages found.
+// Without arguments, synthesises messages with timing jitter and sample errors,
+// decodes them and reports the decoding speed, then feeds random samples to
+// the receiver to exercise the PLL.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/ask/ask_sample_modem/ask_sample_modem.ino tools/simMain.cpp RH_ASK.cpp RHGenericDriver.cpp RHCRC.cpp -o ask_sample_modem
+// Run with ./ask_sample_modem [capturefile]
+
+#include <RH_ASK.h>
+
+RH_ASK driver;
+
+// Number of messages to synthesise
+#define NUM_MESSAGES 1000
+
+// Sample errors to add, per million samples
+#define SAMPLE_ERRORS 5000
+
+// Large enough for a number of maximum length messages
+uint8_t samples[RH_ASK_MODULATED_LEN(RH_ASK_MAX_MESSAGE_LEN) * 4];
+
+// The samples after passing through the simulated channel
+uint8_t received[sizeof(samples)];
+
+// Print all the messages that can be decoded from a buffer of samples
+// Returns the number of messages found
+unsigned long decode(const uint8_t* buf, uint16_t len, bool print)
+{
+  unsigned long found = 0;
+  while (len)
+  {
+    uint16_t used = driver.demodulate(buf, len);
+    buf += used;
+    len -= used;
+    uint8_t msg[RH_ASK_MAX_MESSAGE_LEN];
+    uint8_t msglen = sizeof(msg);
+    if (driver.recv(msg, &msglen))
+    {
+      found++;
+      if (print)
+      {
+        Serial.print("from ");
+        Serial.print(driver.headerFrom(), DEC);
+        Serial.print(" to ");
+        Serial.print(driver.headerTo(), DEC);
+        Serial.print(": ");
+        driver.printBuffer("", msg, msglen);
+      }
+    }
+  }
+  return found;
+}
+
+void decodeFile(const char* filename)
+{
+  FILE* f = fopen(filename, "rb");
+  if (!f)
+  {
+    Serial.println("could not open capture file");
+    return;
+  }
+  size_t n;
+  unsigned long found = 0;
+  while ((n = fread(samples, 1, sizeof(samples), f)) > 0)
+    found += decode(samples, n, true);
+  fclose(f);
+  Serial.print(found, DEC);
+  Serial.println(" messages");
+}
+
+void synthesise()
+{
+  uint8_t data[RH_ASK_MAX_MESSAGE_LEN];
+  unsigned long totalSamples = 0;
+  unsigned long decoded = 0;
+  unsigned long elapsed = 0;
+  unsigned int m;
+
+  for (m = 0; m < NUM_MESSAGES; m++)
+  {
+    uint8_t len = random(1, RH_ASK_MAX_MESSAGE_LEN + 1);
+    uint8_t i;
+    for (i = 0; i < len; i++)
+      data[i] = random(0, 256);
+    driver.setHeaderId(m);
+    uint16_t n = driver.modulate(data, len, samples, sizeof(samples));
+
+    // Stretch or shrink some bits by one sample to simulate clock error,
+    // and flip random samples
+    uint16_t j, out = 0;
+    for (j = 0; j < n; j++)
+    {
+      long r = random(0, 1000000);
+      if (r < 2000 && j % 8 == 0)
+        continue; // Drop a sample
+      uint8_t s = samples[j];
+      if (random(0, 1000000) < SAMPLE_ERRORS)
+        s = !s;
+      received[out++] = s;
+      if (r > 998000 && j % 8 == 0)
+        received[out++] = s; // Repeat a sample
+    }
+    // Trailing idle samples
+    memset(received + out, 0, 16);
+    out += 16;
+
+    unsigned long start = millis();
+    decoded += decode(received, out, false);
+    elapsed += millis() - start;
+    totalSamples += out;
+  }
+  Serial.print(decoded, DEC);
+  Serial.print(" of ");
+  Serial.print(NUM_MESSAGES, DEC);
+  Serial.println(" synthesised messages decoded");
+  if (elapsed == 0)
+    elapsed = 1;
+  Serial.print(totalSamples * 1000 / elapsed, DEC);
+  Serial.print(" samples/s, ");
+  Serial.print(totalSamples * 1000 / elapsed / (driver.speed() * RH_ASK_RX_SAMPLES_PER_BIT), DEC);
+  Serial.println(" times real time");
+
+  // Random samples must never crash or hang the receiver
+  unsigned long falseMessages = 0;
+  for (m = 0; m < 100; m++)
+  {
+    uint16_t j;
+    for (j = 0; j < sizeof(samples); j++)
+      samples[j] = random(0, 2);
+    falseMessages += decode(samples, sizeof(samples), false);
+  }
+  Serial.print(falseMessages, DEC);
+  Serial.println(" messages accepted from random samples");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  if (!driver.init())
+    Serial.println("init failed");
+  // Accept messages to any address
+  driver.setPromiscuous(true);
+
+  if (_simulator_argc > 1)
+    decodeFile(_simulator_argv[1]);
+  else
+    synthesise();
+  exit(0);
+}
+
+void loop()
+{
+}
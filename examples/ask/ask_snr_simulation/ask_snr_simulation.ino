@@ -0,0 +1,155 @@
+// ask_snr_simulation.pde
+// -*- mode: C++ -*-
+// Example sketch that simulates RH_ASK over a noisy channel on Linux, and
+// prints the packet error rate versus signal to noise ratio, and the maximum
+// bit rate the receiver could sustain on this CPU, at 4, 8 and 16 samples per bit.
+// Messages are generated with RH_ASK::modulate(), sent over a simulated channel
+// and decoded with RH_ASK::demodulate().
+// The channel adds Gaussian noise to each sample before the receivers data
+// slicer (threshold halfway between the low and high levels), and the transmitter clock
+// runs slightly fast. The SNR is the mean signal power over the noise power, per
+// sample. Noise is independent from sample to sample, which flatters the higher
+// sampling rates somewhat, since a real receiver has a fixed bandwidth.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/ask/ask_snr_simulation/ask_snr_simulation.ino tools/simMain.cpp RH_ASK.cpp RHGenericDriver.cpp RHCRC.cpp -o ask_snr_simulation -lm
+// Run with ./ask_snr_simulation
+
+#include <RH_ASK.h>
+#include <math.h>
+
+// Messages to send for each SNR
+#define NUM_MESSAGES 500
+
+// Length of the user data in each message
+#define MESSAGE_LEN 20
+
+// Transmitter clock error in parts per million
+#define CLOCK_ERROR 5000
+
+RH_ASK driver;
+
+uint8_t samplesPerBit[] = { 4, 8, 16 };
+int     snrs[] = { 0, 2, 4, 6, 8, 10, 12, 14 };
+
+uint8_t transmitted[RH_ASK_MODULATED_LEN(MESSAGE_LEN) * 2];
+uint8_t received[sizeof(transmitted) + 200];
+
+// Gaussian noise with standard deviation 1, Box-Muller method
+float gaussian()
+{
+  float u1 = (random(0, 1000000) + 1) / 1000001.0;
+  float u2 = random(0, 1000000) / 1000000.0;
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// Sends one message through the channel and returns the number of received samples
+uint16_t channel(float sigma, uint16_t n)
+{
+  uint16_t i = 0, out = 0;
+  // Some idle noise before the message
+  for (i = 0; i < 100; i++)
+    received[out++] = (gaussian() * sigma) > 0.5;
+  // The transmitter clock is fast, so we see fewer samples than it sent
+  unsigned long t;
+  for (t = 0; (i = t * (1000000 + CLOCK_ERROR) / 1000000) < n; t++)
+    received[out++] = (transmitted[i] + gaussian() * sigma) > 0.5;
+  for (i = 0; i < 50; i++)
+    received[out++] = (gaussian() * sigma) > 0.5;
+  return out;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  driver.init();
+
+  uint8_t data[MESSAGE_LEN];
+  uint8_t i, s;
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = random(0, 256);
+
+  Serial.println("Packet error rate in percent");
+  Serial.print("SNR dB");
+  for (s = 0; s < sizeof(samplesPerBit); s++)
+  {
+    Serial.print("\t");
+    Serial.print(samplesPerBit[s], DEC);
+    Serial.print(" spb");
+  }
+  Serial.println("");
+
+  unsigned long repaired[sizeof(samplesPerBit)] = { 0 };
+  uint8_t r;
+  for (r = 0; r < sizeof(snrs) / sizeof(snrs[0]); r++)
+  {
+    float sigma = sqrt(0.5 / pow(10, snrs[r] / 10.0));
+    Serial.print(snrs[r], DEC);
+    for (s = 0; s < sizeof(samplesPerBit); s++)
+    {
+      driver.setSamplesPerBit(samplesPerBit[s]);
+      uint16_t n = driver.modulate(data, sizeof(data), transmitted, sizeof(transmitted));
+      uint16_t repairedBefore = driver.rxRepairedSymbols();
+      unsigned int errors = 0;
+      unsigned int m;
+      for (m = 0; m < NUM_MESSAGES; m++)
+      {
+        uint16_t len = channel(sigma, n);
+        uint8_t buf[MESSAGE_LEN];
+        uint8_t buflen = sizeof(buf);
+        bool ok = false;
+        uint16_t used = 0;
+        while (used < len)
+        {
+          used += driver.demodulate(received + used, len - used);
+          if (driver.recv(buf, &buflen))
+            ok = (buflen == sizeof(data) && memcmp(buf, data, buflen) == 0);
+        }
+        if (!ok)
+          errors++;
+      }
+      repaired[s] += (uint16_t)(driver.rxRepairedSymbols() - repairedBefore);
+      Serial.print("\t");
+      Serial.print(errors * 100 / NUM_MESSAGES, DEC);
+    }
+    Serial.println("");
+  }
+  Serial.print("Repaired");
+  for (s = 0; s < sizeof(samplesPerBit); s++)
+  {
+    Serial.print("\t");
+    Serial.print(repaired[s], DEC);
+  }
+  Serial.println("");
+
+  // How fast can this CPU run the receiver?
+  Serial.println("");
+  Serial.println("spb\tsamples/s\tmax bit rate");
+  for (s = 0; s < sizeof(samplesPerBit); s++)
+  {
+    driver.setSamplesPerBit(samplesPerBit[s]);
+    uint16_t n = driver.modulate(data, sizeof(data), transmitted, sizeof(transmitted));
+    unsigned long samples = 0;
+    unsigned long start = millis();
+    while (millis() - start < 1000)
+    {
+      uint16_t used = 0;
+      while (used < n)
+      {
+        used += driver.demodulate(transmitted + used, n - used);
+        driver.available();
+      }
+      samples += n;
+    }
+    Serial.print(samplesPerBit[s], DEC);
+    Serial.print("\t");
+    Serial.print(samples, DEC);
+    Serial.print("\t");
+    Serial.println(samples / samplesPerBit[s], DEC);
+  }
+  exit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,133 @@
+// ask_tick_harness.pde
+// -*- mode: C++ -*-
+// Example sketch showing how to drive several RH_ASK instances without the timer
+// or any IO pins, as a host test harness does, at full CPU speed.
+// Two pairs of transmitters and receivers are connected by simulated wires:
+// each transmitters RH_ASK::tick() returns its output level, which is fed to the 
+// tick() of its receiver. A third transmitter is driven at the bit rate with 
+// RH_ASK::nextTxBit(), as a UART, SPI or DMA peripheral would be, and its bits are 
+// expanded to samples and decoded by a receiver with RH_ASK::demodulate().
+// Wire A's transmitter also modulate()s another message halfway through sending each one,
+// which must not disturb the message being sent.
+// Exits with 1 if any message is lost.
+// On a microcontroller you would call tick() or handleTimerInterrupt() for each instance 
+// from a timer interrupt you already have, instead of the loop here.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/ask/ask_tick_harness/ask_tick_harness.ino tools/simMain.cpp RH_ASK.cpp RHGenericDriver.cpp RHCRC.cpp -o ask_tick_harness
+// Run with ./ask_tick_harness
+
+#include <RH_ASK.h>
+
+// Messages to send on each wire
+#define NUM_MESSAGES 1000
+
+// No pins: these are never used
+RH_ASK txA(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+RH_ASK rxA(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+RH_ASK txB(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+RH_ASK rxB(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+RH_ASK txC(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+RH_ASK rxC(2000, RH_INVALID_PIN, RH_INVALID_PIN, RH_INVALID_PIN);
+
+// Checks a received message against what was sent
+bool check(RH_ASK& rx, const char* expected)
+{
+  uint8_t buf[RH_ASK_MAX_MESSAGE_LEN];
+  uint8_t len = sizeof(buf);
+  if (!rx.recv(buf, &len))
+    return false;
+  return len == strlen(expected) && memcmp(buf, expected, len) == 0;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  RH_ASK* drivers[] = { &txA, &rxA, &txB, &rxB, &txC, &rxC };
+  uint8_t i;
+  for (i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++)
+  {
+    drivers[i]->setUseTimer(false);
+    if (!drivers[i]->init())
+      Serial.println("init failed");
+  }
+  // Wire B runs at 4 samples per bit at both ends
+  txB.setSamplesPerBit(4);
+  rxB.setSamplesPerBit(4);
+
+  static uint8_t samples[RH_ASK_MODULATED_LEN(RH_ASK_MAX_MESSAGE_LEN) + RH_ASK_RX_SAMPLES_PER_BIT];
+  const char* messageA = "Hello on wire A";
+  const char* messageB = "And on wire B";
+  const char* modulated = "Not sent on any wire, but modulated meanwhile";
+  unsigned long receivedA = 0, receivedB = 0, ticks = 0;
+  unsigned long start = millis();
+  unsigned int m;
+  for (m = 0; m < NUM_MESSAGES; m++)
+  {
+    txA.send((uint8_t*)messageA, strlen(messageA));
+    txB.send((uint8_t*)messageB, strlen(messageB));
+    unsigned long sendStart = ticks;
+    // Tick everything until both transmitters have finished. Wire B 
+    // has half the samples per bit, so gets ticked half as often
+    while (txA.mode() == RHGenericDriver::RHModeTx || txB.mode() == RHGenericDriver::RHModeTx)
+    {
+      if (ticks - sendStart == RH_ASK_MODULATED_LEN(strlen(messageA)) / 2)
+	txA.modulate((uint8_t*)modulated, strlen(modulated), samples, sizeof(samples));
+      rxA.tick(txA.tick(false));
+      if (ticks & 1)
+        rxB.tick(txB.tick(false));
+      ticks++;
+      // Puts the receivers in RHModeRx, and notices complete messages
+      if (rxA.available())
+        receivedA += check(rxA, messageA);
+      if (rxB.available())
+        receivedB += check(rxB, messageB);
+    }
+  }
+  unsigned long elapsed = millis() - start;
+  if (elapsed == 0)
+    elapsed = 1;
+
+  Serial.print("tick(): wire A received ");
+  Serial.print(receivedA, DEC);
+  Serial.print(", wire B received ");
+  Serial.print(receivedB, DEC);
+  Serial.print(" of ");
+  Serial.print(NUM_MESSAGES, DEC);
+  Serial.print(" messages, ");
+  Serial.print(ticks * 1000 / elapsed, DEC);
+  Serial.println(" sample periods/s");
+
+  // Bit rate transmitter: collect the bits as a DMA buffer would, then 
+  // expand them to the receivers samples per bit
+  const char* messageC = "Bit by bit on wire C";
+  unsigned long receivedC = 0;
+  for (m = 0; m < NUM_MESSAGES; m++)
+  {
+    txC.send((uint8_t*)messageC, strlen(messageC));
+    uint16_t n = 0;
+    int8_t bit;
+    while ((bit = txC.nextTxBit()) >= 0)
+    {
+      memset(samples + n, bit, rxC.samplesPerBit());
+      n += rxC.samplesPerBit();
+    }
+    uint16_t used = 0;
+    while (used < n)
+    {
+      used += rxC.demodulate(samples + used, n - used);
+      if (rxC.available())
+        receivedC += check(rxC, messageC);
+    }
+  }
+  Serial.print("nextTxBit(): wire C received ");
+  Serial.print(receivedC, DEC);
+  Serial.print(" of ");
+  Serial.print(NUM_MESSAGES, DEC);
+  Serial.println(" messages");
+  exit(receivedA == NUM_MESSAGES && receivedB == NUM_MESSAGES && receivedC == NUM_MESSAGES ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,232 @@
+// encrypted_aes_benchmark.pde
+// -*- mode: C++ -*-
+// Example sketch that checks and measures RHAES128 on a Linux (or other Unix) host, with each backend
+// this CPU supports: software, and AES-NI or ARMv8 crypto extensions.
+// For each backend, checks the FIPS-197 test vector and that all backends agree, then measures
+// the throughput of single blocks, batches of blocks and counter mode, and the number of frames per
+// second one core can decrypt through RHEncryptedDriver, as a gateway does for traffic from many nodes.
+// Needs BlockCipher from the Crypto directory of arduinolibs:
+// http://rweather.github.io/arduinolibs/index.html
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_ENABLE_ENCRYPTION_MODULE -I . -I RHutil -I whatever/arduinolibs/libraries/Crypto -x c++ examples/encrypted/encrypted_aes_benchmark/encrypted_aes_benchmark.ino -x none tools/simMain.cpp RHAES128.cpp RHEncryptedDriver.cpp RHGenericDriver.cpp whatever/arduinolibs/libraries/Crypto/{BlockCipher,Crypto}.cpp -o encrypted_aes_benchmark
+// Run with ./encrypted_aes_benchmark
+
+#include <RHAES128.h>
+#include <RHEncryptedDriver.h>
+#include <RHutil/RHClock.h>
+#include <RHutil/RHSelfTest.h>
+
+// Frames decrypted in each round of the measurement
+#define NUM_FRAMES 2000
+
+// Length of the messages in the frames
+#define FRAME_MESSAGE_LEN 48
+
+// Octets encrypted in each round of the throughput measurements
+#define THROUGHPUT_LEN 4096
+
+// Rounds of each measurement. The fastest is reported, as the others have been interrupted more
+#define NUM_ROUNDS 5
+
+// Largest message of the drivers
+#define MAX_MESSAGE_LEN 251
+
+// A driver that records the frames sent, and receives them again in turn
+class ReplayDriver : public RHGenericDriver
+{
+public:
+  ReplayDriver() : numFrames(0), next(0) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return MAX_MESSAGE_LEN; }
+  bool available() { return next < numFrames; }
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (next >= numFrames)
+      return false;
+    Frame& frame = frames[next++];
+    _rxHeaderTo = frame.to;
+    _rxHeaderFrom = frame.from;
+    _rxHeaderId = frame.id;
+    _rxHeaderFlags = frame.flags;
+    if (buf && len)
+    {
+      if (*len > frame.len)
+	*len = frame.len;
+      memcpy(buf, frame.data, *len);
+    }
+    return true;
+  }
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    if (numFrames >= NUM_FRAMES)
+      return false;
+    Frame& frame = frames[numFrames++];
+    frame.to = _txHeaderTo;
+    frame.from = _txHeaderFrom;
+    frame.id = _txHeaderId;
+    frame.flags = _txHeaderFlags;
+    frame.len = len;
+    memcpy(frame.data, data, len);
+    return true;
+  }
+
+  typedef struct
+  {
+    uint8_t to, from, id, flags;
+    uint8_t len;
+    uint8_t data[FRAME_MESSAGE_LEN + 16];
+  } Frame;
+  Frame    frames[NUM_FRAMES];
+  unsigned numFrames, next;
+};
+
+uint8_t key[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+// Encryptions of a test pattern by the software backend, that the others must match
+uint8_t reference[THROUGHPUT_LEN];
+
+// Checks a backend against FIPS-197 and the software backend
+void checkBackend(RHAES128& aes)
+{
+  // FIPS-197 appendix C.1
+  uint8_t fipsKey[16], plaintext[16], block[16];
+  const uint8_t ciphertext[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+				   0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    fipsKey[i] = i;
+    plaintext[i] = i * 0x11;
+  }
+  aes.setKey(fipsKey, sizeof(fipsKey));
+  aes.encryptBlock(block, plaintext);
+  check(memcmp(block, ciphertext, 16) == 0, "FIPS-197 encrypt");
+  aes.decryptBlock(block, block);
+  check(memcmp(block, plaintext, 16) == 0, "FIPS-197 decrypt");
+
+  // Batches and counter mode against the software backend
+  static uint8_t data[THROUGHPUT_LEN];
+  aes.setKey(key, sizeof(key));
+  for (unsigned i = 0; i < sizeof(data); i++)
+    data[i] = i;
+  aes.encryptBlocks(data, data, sizeof(data) / 16 - 1);
+  uint8_t counter[16] = { 0 };
+  aes.encryptCTR(data, sizeof(data), counter);
+  if (aes.backend() == RHAES128::BackendSoftware)
+    memcpy(reference, data, sizeof(reference));
+  else
+    check(memcmp(data, reference, sizeof(data)) == 0, "batches and counter mode match software");
+  memset(counter, 0, sizeof(counter));
+  aes.encryptCTR(data, sizeof(data), counter);
+  aes.decryptBlocks(data, data, sizeof(data) / 16 - 1);
+  bool same = true;
+  for (unsigned i = 0; i < sizeof(data); i++)
+    if (data[i] != (uint8_t)i)
+      same = false;
+  check(same, "batches and counter mode decrypt");
+}
+
+// Prints the throughput of one way of encrypting
+void printThroughput(const char* what, uint64_t nanos)
+{
+  printf("  %-24s %8.1f MB/s\n", what, THROUGHPUT_LEN * 1000.0 / nanos);
+}
+
+void measureThroughput(RHAES128& aes)
+{
+  static uint8_t data[THROUGHPUT_LEN];
+  uint64_t best[3] = { ~0ULL, ~0ULL, ~0ULL };
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    uint64_t start = RHClock::clock()->nanos();
+    for (unsigned i = 0; i < sizeof(data); i += 16)
+      aes.encryptBlock(data + i, data + i);
+    uint64_t blocks = RHClock::clock()->nanos();
+    aes.encryptBlocks(data, data, sizeof(data) / 16);
+    uint64_t batches = RHClock::clock()->nanos();
+    uint8_t counter[16] = { 0 };
+    aes.encryptCTR(data, sizeof(data), counter);
+    uint64_t end = RHClock::clock()->nanos();
+    uint64_t times[3] = { blocks - start, batches - blocks, end - batches };
+    for (uint8_t i = 0; i < 3; i++)
+      if (times[i] < best[i])
+	best[i] = times[i];
+  }
+  printThroughput("encryptBlock()", best[0]);
+  printThroughput("encryptBlocks()", best[1]);
+  printThroughput("encryptCTR()", best[2]);
+}
+
+// Frames from several nodes, encrypted by their RHEncryptedDrivers
+ReplayDriver air;
+
+// Decrypts the frames on air through RHEncryptedDriver, and prints the rate
+void measureFrames(RHAES128& aes, RHEncryptedDriver::CipherMode mode, const char* title)
+{
+  // The nodes
+  aes.setKey(key, sizeof(key));
+  air.numFrames = 0;
+  RHEncryptedDriver node(air, aes);
+  node.setCipherMode(mode);
+  uint8_t msg[FRAME_MESSAGE_LEN];
+  for (unsigned i = 0; i < NUM_FRAMES; i++)
+  {
+    memset(msg, i, sizeof(msg));
+    node.setHeaderFrom(1 + i % 50);
+    node.setTxCounter(i);
+    node.send(msg, sizeof(msg));
+  }
+
+  // The gateway
+  uint64_t best = ~0ULL;
+  unsigned long errors = 0;
+  static uint8_t buffer[MAX_MESSAGE_LEN];
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    // A new gateway each time, as it would reject the frames as replays
+    RHEncryptedDriver gateway(air, aes, buffer, sizeof(buffer));
+    gateway.setCipherMode(mode);
+    air.next = 0;
+    uint64_t start = RHClock::clock()->nanos();
+    for (unsigned i = 0; i < NUM_FRAMES; i++)
+    {
+      uint8_t buf[MAX_MESSAGE_LEN];
+      uint8_t len = sizeof(buf);
+      if (!gateway.recv(buf, &len) || len != FRAME_MESSAGE_LEN || buf[0] != (uint8_t)i || buf[len - 1] != (uint8_t)i)
+	errors++;
+    }
+    uint64_t nanos = RHClock::clock()->nanos() - start;
+    if (nanos < best)
+      best = nanos;
+  }
+  printf("  %-24s %8.0f frames/s\n", title, NUM_FRAMES * 1e9 / best);
+  check(errors == 0, "frames decrypted intact");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  printf("Best backend for this CPU: %s\n", RHAES128::backendName(RHAES128::bestBackend()));
+
+  RHAES128::Backend backends[] = { RHAES128::BackendSoftware, RHAES128::BackendAESNI, RHAES128::BackendARMv8 };
+  for (uint8_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+  {
+    RHAES128 aes;
+    if (!aes.setBackend(backends[i]))
+      continue;
+    printf("%s:\n", RHAES128::backendName(backends[i]));
+    checkBackend(aes);
+    measureThroughput(aes);
+    char title[64];
+    snprintf(title, sizeof(title), "%d octet frames, ECB", FRAME_MESSAGE_LEN);
+    measureFrames(aes, RHEncryptedDriver::CipherModeECB, title);
+    snprintf(title, sizeof(title), "%d octet frames, CCM", FRAME_MESSAGE_LEN);
+    measureFrames(aes, RHEncryptedDriver::CipherModeCCM, title);
+  }
+
+  checkExit();
+}
+
+void loop()
+{
+}
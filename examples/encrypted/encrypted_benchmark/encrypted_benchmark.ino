@@ -0,0 +1,181 @@
+// encrypted_benchmark.pde
+// -*- mode: C++ -*-
+// Example sketch that measures the cost of RHEncryptedDriver on a Linux (or other Unix) host, in
+// CPU cycles per octet of message (or nanoseconds per octet where the cycle counter is not available).
+// Messages are sent and received through a loopback driver, so only the encryption and copying is measured,
+// for the ECB and CCM modes, with the buffer allocated on the heap and with a static buffer.
+// The cost of the cipher alone, encrypting whole blocks, is shown for comparison: the difference is the
+// overhead of the driver.
+// Needs the Crypto directory from arduinolibs:
+// http://rweather.github.io/arduinolibs/index.html
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_ENABLE_ENCRYPTION_MODULE -I . -I RHutil -I whatever/arduinolibs/libraries/Crypto -x c++ examples/encrypted/encrypted_benchmark/encrypted_benchmark.ino -x none tools/simMain.cpp RHEncryptedDriver.cpp RHGenericDriver.cpp whatever/arduinolibs/libraries/Crypto/{AES128,AESCommon,BlockCipher,Crypto}.cpp -o encrypted_benchmark
+// Run with ./encrypted_benchmark
+
+#include <RHEncryptedDriver.h>
+#include <RHutil/RHClock.h>
+#include <AES.h>
+#include <RHutil/RHSelfTest.h>
+#if defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+#endif
+
+// Messages sent and received in each round of a measurement
+#define NUM_MESSAGES 5000
+
+// Rounds of each measurement. The fastest is reported, as the others have been interrupted more
+#define NUM_ROUNDS 5
+
+// Largest message of the loopback driver
+#define LOOPBACK_MAX_MESSAGE_LEN 251
+
+// A driver that receives whatever it last sent
+class LoopbackDriver : public RHGenericDriver
+{
+public:
+  LoopbackDriver() : frameLen(0), full(false) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return LOOPBACK_MAX_MESSAGE_LEN; }
+  bool available() { return full; }
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!full)
+      return false;
+    full = false;
+    _rxHeaderTo = _txHeaderTo;
+    _rxHeaderFrom = _txHeaderFrom;
+    _rxHeaderId = _txHeaderId;
+    _rxHeaderFlags = _txHeaderFlags;
+    if (buf && len)
+    {
+      if (*len > frameLen)
+	*len = frameLen;
+      memcpy(buf, frame, *len);
+    }
+    return true;
+  }
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    memcpy(frame, data, len);
+    frameLen = len;
+    full = true;
+    return true;
+  }
+
+  uint8_t frame[LOOPBACK_MAX_MESSAGE_LEN];
+  uint8_t frameLen;
+  bool    full;
+};
+
+AES128 cipher;
+uint8_t key[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+LoopbackDriver heapLoopback, staticLoopback;
+RHEncryptedDriver heapDriver(heapLoopback, cipher);
+uint8_t staticBuffer[LOOPBACK_MAX_MESSAGE_LEN];
+RHEncryptedDriver staticDriver(staticLoopback, cipher, staticBuffer, sizeof(staticBuffer));
+
+// CPU cycles where there is a cycle counter, otherwise nanoseconds
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return RHClock::clock()->nanos();
+#endif
+}
+
+// Prints a cost per octet
+void printCost(const char* what, uint64_t total, unsigned long octets)
+{
+  printf("  %-28s %7.1f\n", what, (double)total / octets);
+}
+
+// The cipher alone, over whole blocks of len octets
+void measureCipher(uint8_t len)
+{
+  uint8_t block[16];
+  memset(block, 0x55, sizeof(block));
+  uint8_t blocks = (len + 15) / 16;
+  uint64_t best = ~0ULL;
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    uint64_t start = cycles();
+    for (unsigned long i = 0; i < NUM_MESSAGES; i++)
+      for (uint8_t b = 0; b < blocks; b++)
+	cipher.encryptBlock(block, block);
+    uint64_t total = cycles() - start;
+    if (total < best)
+      best = total;
+  }
+  printCost("AES128 encryptBlock only", best, (unsigned long)NUM_MESSAGES * len);
+}
+
+// Sends and receives messages of len octets, and checks they come back intact
+void measure(const char* title, RHEncryptedDriver& driver, RHEncryptedDriver::CipherMode mode, uint8_t len)
+{
+  driver.setCipherMode(mode);
+  uint8_t msg[LOOPBACK_MAX_MESSAGE_LEN], buf[LOOPBACK_MAX_MESSAGE_LEN];
+  for (uint8_t i = 0; i < len; i++)
+    msg[i] = i * 7;
+  uint64_t bestSend = ~0ULL, bestRecv = ~0ULL;
+  unsigned long errors = 0;
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    uint64_t sendCycles = 0, recvCycles = 0;
+    for (unsigned long i = 0; i < NUM_MESSAGES; i++)
+    {
+      msg[0] = i;
+      uint64_t start = cycles();
+      driver.send(msg, len);
+      uint64_t sent = cycles();
+      uint8_t bufLen = sizeof(buf);
+      bool ok = driver.recv(buf, &bufLen);
+      recvCycles += cycles() - sent;
+      sendCycles += sent - start;
+      if (!ok || bufLen != len || memcmp(buf, msg, len))
+	errors++;
+    }
+    if (sendCycles < bestSend)
+      bestSend = sendCycles;
+    if (recvCycles < bestRecv)
+      bestRecv = recvCycles;
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "%s send", title);
+  printCost(what, bestSend, (unsigned long)NUM_MESSAGES * len);
+  snprintf(what, sizeof(what), "%s recv", title);
+  printCost(what, bestRecv, (unsigned long)NUM_MESSAGES * len);
+  snprintf(what, sizeof(what), "%s messages intact", title);
+  check(errors == 0, what);
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  cipher.setKey(key, sizeof(key));
+  check(heapDriver.init() && staticDriver.init(), "init");
+
+  uint8_t lens[] = { 16, 48, 200 };
+  for (uint8_t i = 0; i < sizeof(lens); i++)
+  {
+    printf("%d octet messages, %s per octet:\n", lens[i],
+#if defined(__x86_64__) || defined(__i386__)
+	   "cycles"
+#else
+	   "nanoseconds"
+#endif
+	   );
+    measureCipher(lens[i]);
+    measure("ECB, heap buffer", heapDriver, RHEncryptedDriver::CipherModeECB, lens[i]);
+    measure("ECB, static buffer", staticDriver, RHEncryptedDriver::CipherModeECB, lens[i]);
+    measure("CCM, static buffer", staticDriver, RHEncryptedDriver::CipherModeCCM, lens[i]);
+  }
+
+  checkExit();
+}
+
+void loop()
+{
+}
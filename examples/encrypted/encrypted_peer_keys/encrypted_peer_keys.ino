@@ -0,0 +1,428 @@
+// encrypted_peer_keys.pde
+// -*- mode: C++ -*-
+// Example sketch that shows and checks per peer keys in RHEncryptedDriver (see "Peer keys" in
+// RHEncryptedDriver.h) on a Linux (or other Unix) host. A gateway shares a different key with each of 2 nodes
+// over a simulated ether inside this process. Checks that each node can only read its own messages, that no
+// node can forge another's, even with the network key, that broadcasts with the network key reach every node, that replays are rejected, and that keys can be changed
+// with rekey() while messages are in flight, even when a rekey message is lost or both ends start at once.
+// Then measures the time a gateway takes to receive and decrypt a frame with a key table of 254 peers (a peer for
+// every unicast address), compared with one network key, and with expanding the key of the peer for each frame.
+// Needs BlockCipher from the Crypto directory of arduinolibs:
+// http://rweather.github.io/arduinolibs/index.html
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_ENABLE_ENCRYPTION_MODULE -I . -I RHutil -I whatever/arduinolibs/libraries/Crypto -x c++ examples/encrypted/encrypted_peer_keys/encrypted_peer_keys.ino -x none tools/simMain.cpp RHAES128.cpp RHEncryptedDriver.cpp RHGenericDriver.cpp whatever/arduinolibs/libraries/Crypto/{BlockCipher,Crypto}.cpp -o encrypted_peer_keys
+// Run with ./encrypted_peer_keys
+
+#include <RHEncryptedDriver.h>
+#include <RHAES128.h>
+#include <RHutil/RHClock.h>
+#include <RHutil/RHSelfTest.h>
+
+#define GATEWAY_ADDRESS 1
+#define NODE_A_ADDRESS  2
+#define NODE_B_ADDRESS  3
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// Largest message of the drivers
+#define MAX_MESSAGE_LEN 60
+
+// Frames decrypted in each round of the measurement
+#define NUM_FRAMES 5000
+
+// Rounds of each measurement. The fastest is reported, as the others have been interrupted more
+#define NUM_ROUNDS 5
+
+// Length of the messages in the measurement
+#define BENCHMARK_MESSAGE_LEN 16
+
+// Peers of the gateway in the measurement: every address but the gateway's and broadcast
+#define NUM_PEERS 254
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+EtherDriver* nodes[3];
+
+// A radio driver on the simulated ether: every frame sent is put in the inbox of every other node
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return MAX_MESSAGE_LEN; }
+  bool available()
+  {
+    // Discard frames not for us, as a radio would
+    while (head != tail && !_promiscuous && inbox[tail % INBOX_LEN].to != _thisAddress
+	   && inbox[tail % INBOX_LEN].to != RH_BROADCAST_ADDRESS)
+      tail++;
+    return head != tail;
+  }
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    last = inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = last.to;
+    _rxHeaderFrom = last.from;
+    _rxHeaderId = last.id;
+    _rxHeaderFlags = last.flags;
+    if (buf && len)
+    {
+      if (*len > last.len)
+	*len = last.len;
+      memcpy(buf, last.data, *len);
+    }
+    return true;
+  }
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    Frame frame;
+    frame.to = _txHeaderTo;
+    frame.from = _txHeaderFrom;
+    frame.id = _txHeaderId;
+    frame.flags = _txHeaderFlags;
+    frame.len = len;
+    memcpy(frame.data, data, len);
+    for (uint8_t i = 0; i < 3; i++)
+      if (nodes[i] != this)
+	nodes[i]->deliver(frame);
+    return true;
+  }
+  void deliver(const Frame& frame)
+  {
+    if (head - tail < INBOX_LEN)
+      inbox[head++ % INBOX_LEN] = frame;
+  }
+  // Loses any frames waiting
+  void drop() { tail = head; }
+
+  Frame    inbox[INBOX_LEN];
+  Frame    last;  // The last frame received, to replay
+  uint32_t head, tail;
+};
+
+uint8_t networkKey[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+uint8_t keyA[16] = { 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf };
+uint8_t keyB[16] = { 0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf };
+
+// Each node has its own ciphers, as it would on its own processor
+EtherDriver gatewayEther, nodeAEther, nodeBEther;
+RHAES128 gatewayNetwork, gatewayA, gatewayASpare, gatewayB, gatewayBSpare;
+RHAES128 nodeANetwork, nodeAGateway, nodeAGatewaySpare;
+RHAES128 nodeBNetwork, nodeBGateway, nodeBGatewaySpare;
+RHEncryptedDriver gateway(gatewayEther, gatewayNetwork);
+RHEncryptedDriver nodeA(nodeAEther, nodeANetwork);
+RHEncryptedDriver nodeB(nodeBEther, nodeBNetwork);
+RHEncryptedDriver::PeerKey gatewayKeys[2], nodeAKeys[1], nodeBKeys[1];
+
+// Sends a message from one node to another, and returns whether it was received intact
+bool deliver(RHEncryptedDriver& from, uint8_t fromAddress, RHEncryptedDriver& to, uint8_t toAddress, const char* msg)
+{
+  from.setHeaderFrom(fromAddress);
+  from.setHeaderTo(toAddress);
+  from.send((const uint8_t*)msg, strlen(msg));
+  uint8_t buf[MAX_MESSAGE_LEN];
+  uint8_t len = sizeof(buf);
+  return to.recv(buf, &len) && len == strlen(msg) && memcmp(buf, msg, len) == 0 && to.headerFrom() == fromAddress;
+}
+
+// Lets a driver handle every frame waiting for it, and returns how many messages it returned
+uint8_t handleAll(RHEncryptedDriver& driver)
+{
+  uint8_t messages = 0;
+  while (driver.available())
+    if (driver.recv(NULL, NULL))
+      messages++;
+  return messages;
+}
+
+void testPeerKeys()
+{
+  nodes[0] = &gatewayEther;
+  nodes[1] = &nodeAEther;
+  nodes[2] = &nodeBEther;
+  gatewayNetwork.setKey(networkKey, 16);
+  nodeANetwork.setKey(networkKey, 16);
+  nodeBNetwork.setKey(networkKey, 16);
+  gatewayA.setKey(keyA, 16);
+  nodeAGateway.setKey(keyA, 16);
+  gatewayB.setKey(keyB, 16);
+  nodeBGateway.setKey(keyB, 16);
+
+  RHEncryptedDriver* drivers[3] = { &gateway, &nodeA, &nodeB };
+  uint8_t addresses[3] = { GATEWAY_ADDRESS, NODE_A_ADDRESS, NODE_B_ADDRESS };
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    drivers[i]->init();
+    drivers[i]->setThisAddress(addresses[i]);
+    drivers[i]->setCipherMode(RHEncryptedDriver::CipherModeCCM);
+  }
+  gateway.setKeyTable(gatewayKeys, 2);
+  nodeA.setKeyTable(nodeAKeys, 1);
+  nodeB.setKeyTable(nodeBKeys, 1);
+  check(gateway.addPeerKey(NODE_B_ADDRESS, 1, gatewayB, &gatewayBSpare)
+	&& gateway.addPeerKey(NODE_A_ADDRESS, 1, gatewayA, &gatewayASpare)
+	&& nodeA.addPeerKey(GATEWAY_ADDRESS, 1, nodeAGateway, &nodeAGatewaySpare)
+	&& nodeB.addPeerKey(GATEWAY_ADDRESS, 1, nodeBGateway, &nodeBGatewaySpare), "add peer keys");
+  check(!gateway.addPeerKey(4, 1, gatewayA), "full key table rejected");
+  check(!nodeA.addPeerKey(GATEWAY_ADDRESS, 0, nodeAGateway) && !nodeA.addPeerKey(GATEWAY_ADDRESS, 0x80, nodeAGateway),
+	"invalid key IDs rejected");
+
+  // Each node talks to the gateway with its own key
+  check(deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "from A"), "node A to gateway");
+  check(deliver(gateway, GATEWAY_ADDRESS, nodeA, NODE_A_ADDRESS, "to A"), "gateway to node A");
+  check(deliver(nodeB, NODE_B_ADDRESS, gateway, GATEWAY_ADDRESS, "from B"), "node B to gateway");
+  check(deliver(gateway, GATEWAY_ADDRESS, nodeB, NODE_B_ADDRESS, "to B"), "gateway to node B");
+
+  // Node B overhears node A, but does not have its key
+  nodeB.setPromiscuous(true);
+  uint16_t failures = nodeB.rxAuthFailures();
+  check(!deliver(nodeA, NODE_A_ADDRESS, nodeB, GATEWAY_ADDRESS, "secret from A") && nodeB.rxAuthFailures() == failures + 1,
+	"node B cannot read node A's messages");
+  nodeB.setPromiscuous(false);
+  gatewayEther.drop();
+
+  // Node B pretends to be node A
+  failures = gateway.rxAuthFailures();
+  check(!deliver(nodeB, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "forged") && gateway.rxAuthFailures() == failures + 1,
+	"node B cannot forge node A's messages");
+
+  // ... even with the network key, which node A may only use for broadcasts
+  nodeB.removePeerKey(GATEWAY_ADDRESS);
+  failures = gateway.rxAuthFailures();
+  check(!deliver(nodeB, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "forged") && gateway.rxAuthFailures() == failures + 1,
+	"node B cannot forge node A's messages with the network key");
+  nodeB.addPeerKey(GATEWAY_ADDRESS, 1, nodeBGateway, &nodeBGatewaySpare);
+
+  // Broadcasts use the network key
+  gateway.setHeaderTo(RH_BROADCAST_ADDRESS);
+  gateway.send((const uint8_t*)"all", 3);
+  check(handleAll(nodeA) == 1 && handleAll(nodeB) == 1, "broadcast with the network key");
+  nodeA.setHeaderTo(RH_BROADCAST_ADDRESS);
+  nodeA.send((const uint8_t*)"all", 3);
+  check(handleAll(gateway) == 1 && handleAll(nodeB) == 1, "broadcast from a peer with the network key");
+
+  // Replays
+  check(deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "once"), "message before replay");
+  uint16_t replays = gateway.rxReplays();
+  gatewayEther.deliver(gatewayEther.last);
+  check(handleAll(gateway) == 0 && gateway.rxReplays() == replays + 1, "replay rejected");
+
+  // The gateway changes node A's key, while node A has a message in flight with the old one
+  check(gateway.rekey(NODE_A_ADDRESS), "rekey request sent");
+  nodeA.setHeaderTo(GATEWAY_ADDRESS);
+  nodeA.send((const uint8_t*)"old key", 7);
+  check(handleAll(nodeA) == 0 && nodeA.peerKeyId(GATEWAY_ADDRESS) == 1, "node A responds, still sending with key 1");
+  check(handleAll(gateway) == 1, "message with the old key received during the change");
+  check(gateway.peerKeyId(NODE_A_ADDRESS) == 2, "gateway sends with key 2");
+  check(deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "still old"), "old key still accepted");
+  check(deliver(gateway, GATEWAY_ADDRESS, nodeA, NODE_A_ADDRESS, "new key"), "node A receives with key 2");
+  check(nodeA.peerKeyId(GATEWAY_ADDRESS) == 2, "node A sends with key 2");
+  check(deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "new key"), "gateway receives with key 2");
+  check(deliver(nodeB, NODE_B_ADDRESS, gateway, GATEWAY_ADDRESS, "from B") && gateway.peerKeyId(NODE_B_ADDRESS) == 1,
+	"node B not affected");
+
+  // The response is lost, so the gateway asks again
+  check(gateway.rekey(NODE_A_ADDRESS), "second rekey request sent");
+  handleAll(nodeA);
+  gatewayEther.drop();
+  check(gateway.peerKeyId(NODE_A_ADDRESS) == 2, "no change without the response");
+  check(gateway.rekey(NODE_A_ADDRESS) && handleAll(nodeA) == 0 && handleAll(gateway) == 0, "request repeated");
+  check(deliver(gateway, GATEWAY_ADDRESS, nodeA, NODE_A_ADDRESS, "key 3") && deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "key 3")
+	&& gateway.peerKeyId(NODE_A_ADDRESS) == 3 && nodeA.peerKeyId(GATEWAY_ADDRESS) == 3, "changed to key 3");
+
+  // Both ends start a change at once: the request from the lower address wins
+  check(gateway.rekey(NODE_A_ADDRESS) && nodeA.rekey(GATEWAY_ADDRESS), "both send rekey requests");
+  handleAll(nodeA);
+  handleAll(gateway);
+  handleAll(nodeA);
+  check(deliver(gateway, GATEWAY_ADDRESS, nodeA, NODE_A_ADDRESS, "key 4") && deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "key 4")
+	&& gateway.peerKeyId(NODE_A_ADDRESS) == 4 && nodeA.peerKeyId(GATEWAY_ADDRESS) == 4, "changed to key 4");
+
+  // Without its key, the gateway falls back to the network key, and so must node A
+  check(gateway.removePeerKey(NODE_A_ADDRESS) && !gateway.removePeerKey(NODE_A_ADDRESS), "peer key removed");
+  nodeA.removePeerKey(GATEWAY_ADDRESS);
+  check(deliver(nodeA, NODE_A_ADDRESS, gateway, GATEWAY_ADDRESS, "network key") && gateway.peerKeyId(NODE_A_ADDRESS) == 0,
+	"network key after removing the peer key");
+  check(deliver(nodeB, NODE_B_ADDRESS, gateway, GATEWAY_ADDRESS, "from B"), "node B still uses its key");
+}
+
+// A driver that records the frames sent, and receives them again in turn
+class ReplayDriver : public RHGenericDriver
+{
+public:
+  ReplayDriver() : numFrames(0), next(0) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return MAX_MESSAGE_LEN; }
+  bool available() { return next < numFrames; }
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (next >= numFrames)
+      return false;
+    Frame& frame = frames[next++];
+    _rxHeaderTo = frame.to;
+    _rxHeaderFrom = frame.from;
+    _rxHeaderId = frame.id;
+    _rxHeaderFlags = frame.flags;
+    if (buf && len)
+    {
+      if (*len > frame.len)
+	*len = frame.len;
+      memcpy(buf, frame.data, *len);
+    }
+    return true;
+  }
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    if (numFrames >= NUM_FRAMES)
+      return false;
+    Frame& frame = frames[numFrames++];
+    frame.to = _txHeaderTo;
+    frame.from = _txHeaderFrom;
+    frame.id = _txHeaderId;
+    frame.flags = _txHeaderFlags;
+    frame.len = len;
+    memcpy(frame.data, data, len);
+    return true;
+  }
+
+  Frame    frames[NUM_FRAMES];
+  unsigned numFrames, next;
+};
+
+// Frames from the peers, with the network key and with their own keys
+ReplayDriver networkAir, peerAir;
+RHAES128 networkCipher;
+RHAES128 peerCiphers[NUM_PEERS];
+RHEncryptedDriver::PeerKey peerKeys[NUM_PEERS];
+
+// The address of the peer that sends frame i. Spread out, as it would be at a busy gateway
+uint8_t peerAddress(unsigned i)
+{
+  return 1 + (i * 97) % NUM_PEERS;
+}
+
+// Receives the frames on air with a gateway, and returns the best time per frame in nanoseconds.
+// If expandKeys, sets the key of the peer before each frame, as it would be without cached key schedules
+double measureGateway(ReplayDriver& air, bool keyTable, bool expandKeys)
+{
+  uint64_t best = ~0ULL;
+  unsigned long errors = 0;
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    // A new gateway each time, as it would reject the frames as replays
+    RHEncryptedDriver gateway(air, networkCipher);
+    gateway.setCipherMode(RHEncryptedDriver::CipherModeCCM);
+    if (keyTable)
+    {
+      gateway.setKeyTable(peerKeys, NUM_PEERS);
+      for (uint16_t p = 0; p < NUM_PEERS; p++)
+	gateway.addPeerKey(p + 1, 1, peerCiphers[p]);
+    }
+    air.next = 0;
+    uint64_t start = RHClock::clock()->nanos();
+    for (unsigned i = 0; i < NUM_FRAMES; i++)
+    {
+      if (expandKeys)
+      {
+	uint8_t key[16] = { peerAddress(i) };
+	peerCiphers[peerAddress(i) - 1].setKey(key, sizeof(key));
+      }
+      uint8_t buf[MAX_MESSAGE_LEN];
+      uint8_t len = sizeof(buf);
+      if (!gateway.recv(buf, &len) || len != BENCHMARK_MESSAGE_LEN || buf[0] != (uint8_t)i)
+	errors++;
+    }
+    uint64_t nanos = RHClock::clock()->nanos() - start;
+    if (nanos < best)
+      best = nanos;
+  }
+  check(errors == 0, "frames decrypted intact");
+  return (double)best / NUM_FRAMES;
+}
+
+// Measures the time to find a peer in a full table, and returns the best time per lookup in nanoseconds
+double measureLookup()
+{
+  RHEncryptedDriver gateway(networkAir, networkCipher);
+  gateway.setKeyTable(peerKeys, NUM_PEERS);
+  for (uint16_t p = 0; p < NUM_PEERS; p++)
+    gateway.addPeerKey(p + 1, 1, peerCiphers[p]);
+  uint64_t best = ~0ULL;
+  unsigned long found = 0;
+  for (uint8_t round = 0; round < NUM_ROUNDS; round++)
+  {
+    uint64_t start = RHClock::clock()->nanos();
+    for (unsigned i = 0; i < NUM_FRAMES; i++)
+      found += gateway.peerKeyId(peerAddress(i));
+    uint64_t nanos = RHClock::clock()->nanos() - start;
+    if (nanos < best)
+      best = nanos;
+  }
+  check(found == (unsigned long)NUM_ROUNDS * NUM_FRAMES, "every peer found");
+  return (double)best / NUM_FRAMES;
+}
+
+void benchmark()
+{
+  networkCipher.setKey(networkKey, 16);
+  for (uint16_t p = 0; p < NUM_PEERS; p++)
+  {
+    uint8_t key[16] = { (uint8_t)(p + 1) };
+    peerCiphers[p].setKey(key, sizeof(key));
+  }
+
+  // The peers, sending with the network key and with their own keys
+  RHEncryptedDriver networkSender(networkAir, networkCipher);
+  networkSender.setCipherMode(RHEncryptedDriver::CipherModeCCM);
+  RHEncryptedDriver::PeerKey senderKeys[1];
+  RHEncryptedDriver peerSender(peerAir, networkCipher);
+  peerSender.setCipherMode(RHEncryptedDriver::CipherModeCCM);
+  peerSender.setKeyTable(senderKeys, 1);
+  uint8_t msg[BENCHMARK_MESSAGE_LEN];
+  for (unsigned i = 0; i < NUM_FRAMES; i++)
+  {
+    uint8_t from = peerAddress(i);
+    memset(msg, i, sizeof(msg));
+    networkSender.setHeaderFrom(from);
+    networkSender.setTxCounter(i);
+    networkSender.send(msg, sizeof(msg));
+    peerSender.addPeerKey(0, 1, peerCiphers[from - 1]);
+    peerSender.setHeaderFrom(from);
+    peerSender.setTxCounter(i);
+    peerSender.send(msg, sizeof(msg));
+  }
+
+  printf("Gateway receiving %d octet messages from %d peers with %s, nanoseconds per frame:\n",
+	 BENCHMARK_MESSAGE_LEN, NUM_PEERS, RHAES128::backendName(networkCipher.backend()));
+  double network = measureGateway(networkAir, false, false);
+  double peer = measureGateway(peerAir, true, false);
+  double expand = measureGateway(peerAir, true, true);
+  double lookup = measureLookup();
+  printf("  %-40s %8.1f\n", "network key", network);
+  printf("  %-40s %8.1f\n", "peer keys, cached key schedules", peer);
+  printf("  %-40s %8.1f\n", "peer keys, key expanded for each frame", expand);
+  printf("  %-40s %8.1f\n", "finding the peer alone", lookup);
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  testPeerKeys();
+  benchmark();
+  checkExit();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,132 @@
+// fec_benchmark.pde
+// -*- mode: C++ -*-
+// Example sketch that measures the speed of the RHReedSolomon codec used by RHFECDriver,
+// and the residual message loss with and without FEC over a simulated channel with 
+// random bit errors.
+// Runs on any Arduino with enough RAM (about 1kbyte), or on Linux.
+// Build on Linux with
+// cd whatever/RadioHead 
+// g++ -O2 -I . -I RHutil -x c++ examples/fec/fec_benchmark/fec_benchmark.ino tools/simMain.cpp RHReedSolomon.cpp -o fec_benchmark
+// Run with ./fec_benchmark
+
+#include <RHReedSolomon.h>
+
+// Payload length of the simulated messages
+#define PAYLOAD_LEN 64
+
+// Number of messages to send over the simulated channel for each test
+#define NUM_MESSAGES 1000
+
+// Dont put these on the stack:
+uint8_t sent[PAYLOAD_LEN + RH_RS_MAX_ROOTS];
+uint8_t codeword[PAYLOAD_LEN + RH_RS_MAX_ROOTS];
+
+// Bit error rates to test, in errors per million bits
+long bers[] = { 100, 1000, 3000, 10000, 20000 };
+
+// Numbers of parity octets to test. 0 means no FEC: any error loses the message
+uint8_t redundancies[] = { 0, 4, 8, 16 };
+
+void setup() 
+{
+  Serial.begin(9600);
+
+  uint8_t i;
+  for (i = 0; i < PAYLOAD_LEN; i++)
+    sent[i] = random(0, 256);
+
+  // Codec speed
+  Serial.println("roots  encode octets/s  decode octets/s (no errors)  decode octets/s (roots/2 errors)");
+  for (i = 1; i < sizeof(redundancies); i++)
+  {
+    RHReedSolomon rs(redundancies[i]);
+    unsigned long iterations = 0;
+    unsigned long start = millis();
+    while (millis() - start < 1000)
+    {
+      rs.encode(sent, PAYLOAD_LEN, sent + PAYLOAD_LEN);
+      iterations++;
+    }
+    unsigned long encodeRate = iterations * PAYLOAD_LEN * 1000 / (millis() - start);
+
+    iterations = 0;
+    start = millis();
+    while (millis() - start < 1000)
+    {
+      memcpy(codeword, sent, PAYLOAD_LEN + rs.roots());
+      rs.decode(codeword, PAYLOAD_LEN + rs.roots());
+      iterations++;
+    }
+    unsigned long cleanRate = iterations * PAYLOAD_LEN * 1000 / (millis() - start);
+
+    iterations = 0;
+    start = millis();
+    while (millis() - start < 1000)
+    {
+      memcpy(codeword, sent, PAYLOAD_LEN + rs.roots());
+      uint8_t e;
+      for (e = 0; e < rs.roots() / 2; e++)
+	codeword[e * 7] ^= 0x55;
+      rs.decode(codeword, PAYLOAD_LEN + rs.roots());
+      iterations++;
+    }
+    unsigned long errorRate = iterations * PAYLOAD_LEN * 1000 / (millis() - start);
+
+    Serial.print(rs.roots(), DEC);
+    Serial.print("      ");
+    Serial.print(encodeRate, DEC);
+    Serial.print("          ");
+    Serial.print(cleanRate, DEC);
+    Serial.print("                      ");
+    Serial.println(errorRate, DEC);
+  }
+
+  // Residual message loss
+  Serial.println("");
+  Serial.println("bit errors per million  roots  messages lost per thousand");
+  uint8_t b, r;
+  for (b = 0; b < sizeof(bers) / sizeof(bers[0]); b++)
+  {
+    for (r = 0; r < sizeof(redundancies); r++)
+    {
+      uint8_t roots = redundancies[r];
+      RHReedSolomon rs(roots ? roots : 1);
+      uint8_t len = PAYLOAD_LEN + roots;
+      if (roots)
+	rs.encode(sent, PAYLOAD_LEN, sent + PAYLOAD_LEN);
+      unsigned int lost = 0;
+      unsigned int m;
+      for (m = 0; m < NUM_MESSAGES; m++)
+      {
+	// Binary symmetric channel
+	memcpy(codeword, sent, len);
+	bool errors = false;
+	uint16_t bit;
+	for (bit = 0; bit < len * 8; bit++)
+	{
+	  if (random(0, 1000000) < bers[b])
+	  {
+	    codeword[bit / 8] ^= 1 << (bit % 8);
+	    errors = true;
+	  }
+	}
+	if (roots)
+	{
+	  if (rs.decode(codeword, len) < 0 || memcmp(codeword, sent, PAYLOAD_LEN))
+	    lost++;
+	}
+	else if (errors)
+	  lost++; // Would be dropped by the CRC
+      }
+      Serial.print(bers[b], DEC);
+      Serial.print("                    ");
+      Serial.print(roots, DEC);
+      Serial.print("      ");
+      Serial.println(lost * 1000 / NUM_MESSAGES, DEC);
+    }
+  }
+}
+
+void loop()
+{
+}
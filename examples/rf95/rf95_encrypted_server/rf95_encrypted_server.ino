@@ -27,6 +27,15 @@ void setup() {
   // Setup Power,dBm
   rf95.setTxPower(13);
   myCipher.setKey(encryptkey, 16);
+  // Uncomment for authenticated encryption, which detects forged and replayed messages.
+  // The other node must do the same.
+  // Warning: the message counter starts again from 0 at each reset. Sending 2 messages with the same key
+  // and counter reveals them and lets others forge messages, and the other node discards the repeated
+  // counters as replays. So change the key, or keep the counter across resets: save myDriver.txCounter()
+  // from time to time (say in EEPROM every 1000 messages) and restore it, plus that margin, at startup:
+  //myDriver.setTxCounter(savedCounter + 1000);
+  // See "Authenticated encryption" in RHEncryptedDriver.h
+  //myDriver.setCipherMode(RHEncryptedDriver::CipherModeCCM);
   delay(4000);
   Serial.println("Setup completed");
 }
@@ -0,0 +1,215 @@
+// simulator_ack_coalescing.pde
+// -*- mode: C++ -*-
+// Example sketch that counts the frames sent by RHReliableDatagram request/response traffic with and
+// without delayed and piggybacked acknowledgements (see "Delayed and Piggybacked Acknowledgements" in
+// RHReliableDatagram.h). A client sends requests to a server, which replies to each, over a simulated
+// ether inside this process, the server in its own thread. First with ACKs sent straight away, then with
+// an ACK delay, so that the ACK of each request rides on its reply, and the ACK of each reply on the next
+// request. Checks every request and reply arrives intact, and that fewer frames are sent.
+// Needs RH_ENABLE_ACK_COALESCING, which must be set for the library as well as this sketch.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_ENABLE_ACK_COALESCING=1 -I . -I RHutil -x c++ examples/simulator/simulator_ack_coalescing/simulator_ack_coalescing.ino tools/simMain.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_ack_coalescing -lpthread
+// Run with ./simulator_ack_coalescing
+
+#include <RHReliableDatagram.h>
+#include <pthread.h>
+#include <RHutil/RHSelfTest.h>
+
+#define CLIENT_ADDRESS 1
+#define SERVER_ADDRESS 2
+
+// Request/response exchanges in each run
+#define NUM_EXCHANGES 20
+
+// Length of requests and replies
+#define MESSAGE_LEN 8
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// The ACK delay, in milliseconds. Well below the retransmit timeout
+#define ACK_DELAY 50
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[RH_MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+
+// Connects the nodes: every frame sent is delivered to the other node
+pthread_mutex_t ether = PTHREAD_MUTEX_INITIALIZER;
+EtherDriver* nodes[2];
+
+// What has been sent
+unsigned long framesSent = 0, ackFrames = 0;
+
+// A radio driver on the simulated ether
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0) {}
+
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return RH_MAX_MESSAGE_LEN; }
+
+  bool available()
+  {
+    pthread_mutex_lock(&ether);
+    bool ret = head != tail;
+    pthread_mutex_unlock(&ether);
+    return ret;
+  }
+
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    pthread_mutex_lock(&ether);
+    Frame* frame = &inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = frame->to;
+    _rxHeaderFrom = frame->from;
+    _rxHeaderId = frame->id;
+    _rxHeaderFlags = frame->flags;
+    if (buf && len)
+    {
+      if (*len > frame->len)
+	*len = frame->len;
+      memcpy(buf, frame->data, *len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    pthread_mutex_lock(&ether);
+    framesSent++;
+    if (_txHeaderFlags & RH_FLAGS_ACK)
+      ackFrames++;
+    EtherDriver* other = nodes[0] == this ? nodes[1] : nodes[0];
+    if (other->head - other->tail < INBOX_LEN)
+    {
+      Frame* frame = &other->inbox[other->head++ % INBOX_LEN];
+      frame->to = _txHeaderTo;
+      frame->from = _txHeaderFrom;
+      frame->id = _txHeaderId;
+      frame->flags = _txHeaderFlags;
+      frame->len = len;
+      memcpy(frame->data, data, len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  Frame    inbox[INBOX_LEN];
+  uint32_t head, tail;
+};
+
+EtherDriver clientDriver, serverDriver;
+RHReliableDatagram client(clientDriver, CLIENT_ADDRESS);
+RHReliableDatagram server(serverDriver, SERVER_ADDRESS);
+
+volatile bool done = false;
+volatile unsigned badRequests;
+
+// Runs the server: replies to each request with its octets inverted
+void* runServer(void*)
+{
+  while (!done)
+  {
+    uint8_t buf[RH_MAX_MESSAGE_LEN];
+    uint8_t len = sizeof(buf);
+    uint8_t from;
+    if (!server.recvfromAckTimeout(buf, &len, 10, &from))
+      continue;
+    if (len != MESSAGE_LEN || from != CLIENT_ADDRESS)
+      badRequests++;
+    for (uint8_t i = 0; i < len; i++)
+      buf[i] = ~buf[i];
+    server.sendtoWait(buf, len, from);
+  }
+  return NULL;
+}
+
+#if RH_ENABLE_ACK_COALESCING
+// Runs the exchanges, and returns the number of frames sent
+unsigned long run(uint16_t ackDelay)
+{
+  client.setAckDelay(ackDelay);
+  server.setAckDelay(ackDelay);
+  pthread_mutex_lock(&ether);
+  framesSent = ackFrames = 0;
+  pthread_mutex_unlock(&ether);
+  badRequests = 0;
+
+  unsigned failures = 0, badReplies = 0;
+  for (uint8_t n = 0; n < NUM_EXCHANGES; n++)
+  {
+    uint8_t request[MESSAGE_LEN];
+    for (uint8_t i = 0; i < sizeof(request); i++)
+      request[i] = n + i;
+    if (!client.sendtoWait(request, sizeof(request), SERVER_ADDRESS))
+    {
+      failures++;
+      continue;
+    }
+    uint8_t reply[RH_MAX_MESSAGE_LEN];
+    uint8_t len = sizeof(reply);
+    if (!client.recvfromAckTimeout(reply, &len, 1000))
+    {
+      failures++;
+      continue;
+    }
+    for (uint8_t i = 0; i < len; i++)
+      if (len != MESSAGE_LEN || reply[i] != (uint8_t)~request[i])
+	badReplies++;
+  }
+  // Send the ACK of the last reply
+  client.flushAcks();
+  // Let the server finish
+  delay(100);
+
+  pthread_mutex_lock(&ether);
+  printf("ACK delay %u ms: %lu frames sent for %u exchanges, of which %lu ACKs\n",
+	 ackDelay, framesSent, NUM_EXCHANGES, ackFrames);
+  unsigned long frames = framesSent;
+  pthread_mutex_unlock(&ether);
+  check(failures == 0, "every request acknowledged and replied to");
+  check(badRequests == 0 && badReplies == 0, "requests and replies intact");
+  return frames;
+}
+#endif
+
+void setup()
+{
+  Serial.begin(9600);
+#if RH_ENABLE_ACK_COALESCING
+  nodes[0] = &clientDriver;
+  nodes[1] = &serverDriver;
+  client.init();
+  server.init();
+  client.setTimeout(200);
+  server.setTimeout(200);
+  pthread_t thread;
+  pthread_create(&thread, NULL, runServer, NULL);
+
+  unsigned long immediate = run(0);
+  unsigned long delayed = run(ACK_DELAY);
+  check(delayed < immediate, "fewer frames with delayed ACKs");
+
+  done = true;
+  pthread_join(thread, NULL);
+#else
+  Serial.println("Build the library and this sketch with -DRH_ENABLE_ACK_COALESCING=1");
+#endif
+  checkExit();
+}
+
+void loop()
+{
+}
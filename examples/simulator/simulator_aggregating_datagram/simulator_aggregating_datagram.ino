@@ -0,0 +1,234 @@
+// simulator_aggregating_datagram.pde
+// -*- mode: C++ -*-
+// Example sketch that measures RHAggregatingDatagram. A sensor queues short readings for a gateway
+// with queueto() at a steady rate, and they are batched into frames. The gateway also receives ordinary
+// messages from a node using plain RHReliableDatagram. The nodes talk over a simulated ether inside this process,
+// the gateway in its own thread. Prints the frames sent, the aggregation ratio and the latency added by
+// holding messages, and checks every reading and message arrives once, in order and intact, with its
+// application flags and without RH_AGGREGATE_FLAGS_AGGREGATED. Also checks that RHGenericDriver::sendWithHeader()
+// and recvWithInfo(), which the managers use, can be called on a driver class that overrides send() and recv().
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/simulator/simulator_aggregating_datagram/simulator_aggregating_datagram.ino tools/simMain.cpp RHAggregatingDatagram.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_aggregating_datagram -lpthread
+// Run with ./simulator_aggregating_datagram
+
+#include <RHAggregatingDatagram.h>
+#include <pthread.h>
+#include <RHutil/RHSelfTest.h>
+
+#define SENSOR_ADDRESS  1
+#define GATEWAY_ADDRESS 2
+#define PLAIN_ADDRESS   3
+
+// Readings queued by the sensor
+#define NUM_READINGS 100
+
+// Length of a reading
+#define READING_LEN 10
+
+// Time between readings, in milliseconds
+#define READING_INTERVAL 5
+
+// Messages sent by the plain node
+#define NUM_PLAIN 10
+
+// An application flag set on all the readings
+#define READING_FLAG 0x01
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[RH_MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+
+// Connects the nodes: every frame sent is delivered to every other node
+pthread_mutex_t ether = PTHREAD_MUTEX_INITIALIZER;
+EtherDriver* nodes[3];
+
+// Frames sent by the sensor, other than ACKs
+unsigned long sensorFrames = 0;
+
+// A radio driver on the simulated ether
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0) {}
+
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return RH_MAX_MESSAGE_LEN; }
+
+  bool available()
+  {
+    pthread_mutex_lock(&ether);
+    // Discard frames not for us, as a radio would
+    while (head != tail && inbox[tail % INBOX_LEN].to != _thisAddress
+	   && inbox[tail % INBOX_LEN].to != RH_BROADCAST_ADDRESS)
+      tail++;
+    bool ret = head != tail;
+    pthread_mutex_unlock(&ether);
+    return ret;
+  }
+
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    pthread_mutex_lock(&ether);
+    Frame* frame = &inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = frame->to;
+    _rxHeaderFrom = frame->from;
+    _rxHeaderId = frame->id;
+    _rxHeaderFlags = frame->flags;
+    if (buf && len)
+    {
+      if (*len > frame->len)
+	*len = frame->len;
+      memcpy(buf, frame->data, *len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    pthread_mutex_lock(&ether);
+    if (_txHeaderFrom == SENSOR_ADDRESS && !(_txHeaderFlags & RH_FLAGS_ACK))
+      sensorFrames++;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      EtherDriver* node = nodes[i];
+      if (node == this || node->head - node->tail >= INBOX_LEN)
+	continue;
+      Frame* frame = &node->inbox[node->head++ % INBOX_LEN];
+      frame->to = _txHeaderTo;
+      frame->from = _txHeaderFrom;
+      frame->id = _txHeaderId;
+      frame->flags = _txHeaderFlags;
+      frame->len = len;
+      memcpy(frame->data, data, len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  Frame    inbox[INBOX_LEN];
+  uint32_t head, tail;
+};
+
+EtherDriver sensorDriver, gatewayDriver, plainDriver;
+RHAggregatingDatagram sensor(sensorDriver, SENSOR_ADDRESS);
+RHAggregatingDatagram gateway(gatewayDriver, GATEWAY_ADDRESS);
+RHReliableDatagram plain(plainDriver, PLAIN_ADDRESS);
+
+volatile bool done = false;
+volatile unsigned readings, plainMessages;
+unsigned badReadings, badPlain;
+
+// Runs the gateway: receives the readings and the plain messages, and checks them
+void* runGateway(void*)
+{
+  while (!done)
+  {
+    uint8_t buf[RH_MAX_MESSAGE_LEN];
+    uint8_t len = sizeof(buf);
+    uint8_t from, flags;
+    if (!gateway.recvfromAckTimeout(buf, &len, 10, &from, NULL, NULL, &flags))
+      continue;
+    if (from == SENSOR_ADDRESS)
+    {
+      // Readings must arrive in the order they were queued
+      bool ok = len == READING_LEN && flags == READING_FLAG;
+      for (uint8_t i = 0; i < len; i++)
+	if (buf[i] != (uint8_t)(readings + i))
+	  ok = false;
+      if (!ok)
+	badReadings++;
+      readings++;
+    }
+    else if (from == PLAIN_ADDRESS)
+    {
+      if (len != 20 || buf[0] != plainMessages || buf[19] != plainMessages || flags != RH_FLAGS_NONE)
+	badPlain++;
+      plainMessages++;
+    }
+  }
+  return NULL;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  nodes[0] = &sensorDriver;
+  nodes[1] = &gatewayDriver;
+  nodes[2] = &plainDriver;
+  sensor.init();
+  gateway.init();
+  plain.init();
+
+  // The driver calls the managers use, on the drivers directly
+  RHGenericDriver::MessageHeader header = { GATEWAY_ADDRESS, PLAIN_ADDRESS, 0x55, 0x02 };
+  RHGenericDriver::RxMessageInfo info;
+  uint8_t buf[4] = { 1, 2, 3, 4 };
+  uint8_t len = sizeof(buf);
+  memset(&info, 0, sizeof(info));
+  bool sent = plainDriver.sendWithHeader(buf, sizeof(buf), header);
+  bool received = gatewayDriver.recvWithInfo(buf, &len, &info);
+  check(sent && received && len == sizeof(buf) && info.header.to == GATEWAY_ADDRESS && info.header.from == PLAIN_ADDRESS
+	&& info.header.id == 0x55 && info.header.flags == 0x02, "sendWithHeader() and recvWithInfo() on a driver");
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, runGateway, NULL);
+
+  // Readings from the sensor
+  unsigned failures = 0;
+  sensor.setHeaderFlags(READING_FLAG);
+  for (uint8_t n = 0; n < NUM_READINGS; n++)
+  {
+    uint8_t buf[READING_LEN];
+    for (uint8_t i = 0; i < sizeof(buf); i++)
+      buf[i] = n + i;
+    if (!sensor.queueto(buf, sizeof(buf), GATEWAY_ADDRESS))
+      failures++;
+    delay(READING_INTERVAL);
+  }
+  if (!sensor.flushAll())
+    failures++;
+
+  // Ordinary messages from a node that does not aggregate
+  for (uint8_t n = 0; n < NUM_PLAIN; n++)
+  {
+    uint8_t buf[20];
+    memset(buf, n, sizeof(buf));
+    if (!plain.sendtoWait(buf, sizeof(buf), GATEWAY_ADDRESS))
+      failures++;
+  }
+  delay(100);
+  done = true;
+  pthread_join(thread, NULL);
+
+  printf("%u readings of %u octets, queued %u ms apart, in frames of up to %u octets:\n",
+	 NUM_READINGS, READING_LEN, READING_INTERVAL, RH_AGGREGATE_MAX_FRAME_LEN);
+  printf("  %-28s %8lu\n", "frames sent", sensorFrames);
+  printf("  %-28s %8.1f\n", "messages per frame", (double)sensor.aggregatedMessages() / sensor.aggregatedFrames());
+  printf("  %-28s %8u\n", "average added latency, ms", sensor.averageAddedLatency());
+  printf("  %-28s %8u\n", "maximum added latency, ms", sensor.maxAddedLatency());
+  check(failures == 0, "every frame acknowledged");
+  check(readings == NUM_READINGS && badReadings == 0, "every reading received in order, intact, with its flags");
+  check(plainMessages == NUM_PLAIN && badPlain == 0, "every plain message received intact");
+  check(sensor.aggregatedMessages() == NUM_READINGS && sensorFrames == sensor.aggregatedFrames(),
+	"statistics count every reading and frame");
+  check(sensorFrames < NUM_READINGS / 2, "readings aggregated");
+
+  checkExit();
+}
+
+void loop()
+{
+}
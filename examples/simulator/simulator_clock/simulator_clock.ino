@@ -0,0 +1,114 @@
+// simulator_clock.pde
+// -*- mode: C++ -*-
+// Example sketch that tests the time functions on Linux (RHutil/RHClock.h):
+// millis(), micros(), delay() and delayUntil() from the monotonic clock, that
+// waitAvailableTimeout() sleeps instead of spinning, and that an RHVirtualClock
+// lets the timeouts and retries of RHReliableDatagram run in virtual time, taking no real time at all.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/simulator/simulator_clock/simulator_clock.ino tools/simMain.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_clock
+// Run with ./simulator_clock
+
+#include <RHReliableDatagram.h>
+#include <RHutil/RHSelfTest.h>
+
+// A driver that sends into the void and never receives anything
+class NullDriver : public RHGenericDriver
+{
+public:
+  NullDriver() : sent(0) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  bool available() { return false; }
+  bool recv(uint8_t* buf, uint8_t* len) { (void)buf; (void)len; return false; }
+  bool send(const uint8_t* data, uint8_t len) { (void)data; (void)len; sent++; return true; }
+  uint8_t maxMessageLength() { return 60; }
+  unsigned int sent;
+};
+
+NullDriver driver;
+RHReliableDatagram manager(driver, 1);
+RHVirtualClock virtualClock;
+
+// Process CPU time in microseconds
+unsigned long cpuMicros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  manager.init();
+
+  // The monotonic clock
+  unsigned long t0 = micros();
+  delay(50);
+  unsigned long elapsed = micros() - t0;
+  Serial.print("        delay(50) took ");
+  Serial.print(elapsed, DEC);
+  Serial.println(" us");
+  check(elapsed >= 50000 && elapsed < 70000, "delay() sleeps for milliseconds");
+
+  // Periodic wakeups with absolute deadlines do not drift
+  unsigned long deadline = millis();
+  unsigned long worst = 0;
+  uint8_t i;
+  for (i = 0; i < 20; i++)
+  {
+    deadline += 5;
+    delayUntil(deadline);
+    unsigned long late = micros() - deadline * 1000;
+    if (late > worst)
+      worst = late;
+  }
+  Serial.print("        delayUntil() worst lateness over 20 periods: ");
+  Serial.print(worst, DEC);
+  Serial.println(" us");
+  check(millis() - deadline < 5, "delayUntil() does not accumulate drift");
+
+  // Waiting for a message sleeps instead of spinning
+  unsigned long cpu0 = cpuMicros();
+  t0 = millis();
+  driver.waitAvailableTimeout(200);
+  elapsed = millis() - t0;
+  unsigned long cpu = cpuMicros() - cpu0;
+  Serial.print("        waitAvailableTimeout(200) took ");
+  Serial.print(elapsed, DEC);
+  Serial.print(" ms and ");
+  Serial.print(cpu / 1000, DEC);
+  Serial.println(" ms of CPU");
+  check(elapsed >= 200 && elapsed < 220, "waitAvailableTimeout() timeout");
+  check(cpu < 100000, "waitAvailableTimeout() sleeps");
+
+  // Virtual time: the retries of sendtoWait take no real time
+  RHClock::setClock(&virtualClock);
+  uint8_t data[] = "hello";
+  driver.sent = 0;
+  manager.setTimeout(1000);
+  manager.setRetries(5);
+  unsigned long cpuStart = cpuMicros();
+  unsigned long v0 = millis();
+  bool acked = manager.sendtoWait(data, sizeof(data), 2);
+  unsigned long virtualElapsed = millis() - v0;
+  unsigned long real = cpuMicros() - cpuStart;
+  Serial.print("        sendtoWait with 5 retries took ");
+  Serial.print(virtualElapsed, DEC);
+  Serial.print(" virtual ms and ");
+  Serial.print(real, DEC);
+  Serial.println(" us of CPU");
+  check(!acked && driver.sent == 6, "6 transmissions without an ACK");
+  check(virtualElapsed >= 6000 && virtualElapsed < 12000, "retry timeouts in virtual time");
+  check(real < 1000000, "virtual time takes no real time");
+  virtualClock.advance(1000000000ULL);
+  check(millis() == v0 + virtualElapsed + 1000, "RHVirtualClock::advance()");
+  RHClock::setClock(NULL);
+  check(millis() < 10000, "back to the monotonic clock");
+
+  checkExit();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,281 @@
+// simulator_mesh_compression.pde
+// -*- mode: C++ -*-
+// Example sketch that compares the airtime and throughput of RHMesh with and without header compression
+// (see "Header Compression" in RHRouter.h). 4 nodes in a line, 1-2-3-4, each hearing only its neighbours,
+// talk over a simulated ether inside this process, each node in its own thread. Nodes 2 (1 hop away) and 4 (3 hops
+// away) send 10 octet sensor readings to node 1, first with uncompressed headers, then with compressed ones.
+// Checks every reading arrives intact with its SOURCE, HOPS and FLAGS, counts every frame sent (including
+// route discovery and ACKs) and works out its airtime with LoRa at SF7, 125 kHz and coding rate 4/5, as with
+// the RH_RF95 defaults. Then, with compression off, checks that an application can use
+// RH_ROUTER_FLAGS_COMPRESSED as one of its own flags: it is sent as set, and not taken as a compressed header.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/simulator/simulator_mesh_compression/simulator_mesh_compression.ino tools/simMain.cpp RHMesh.cpp RHRouter.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_mesh_compression -lpthread -lm
+// Run with ./simulator_mesh_compression
+
+#include <RHMesh.h>
+#include <pthread.h>
+#include <math.h>
+#include <RHutil/RHSelfTest.h>
+
+#define NUM_NODES 4
+
+// Readings from each sensor in each run
+#define NUM_READINGS 50
+
+// Length of a reading
+#define READING_LEN 10
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// Octets of the hop-to-hop header added by the radio drivers
+#define DRIVER_HEADER_LEN 4
+
+// LoRa settings, as used by the RH_RF95 default modem config Bw125Cr45Sf128
+#define LORA_SF 7
+#define LORA_BANDWIDTH 125000.0
+#define LORA_CODING_RATE 1 // 4/5
+#define LORA_PREAMBLE 8
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[RH_MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+
+// Connects the nodes: every frame sent is delivered to the neighbours of the sender
+pthread_mutex_t ether = PTHREAD_MUTEX_INITIALIZER;
+EtherDriver* nodes[NUM_NODES];
+
+// What has been sent
+unsigned long framesSent = 0, octetsSent = 0;
+// Frames other than ACKs sent with and without RH_ROUTER_FLAGS_COMPRESSED
+unsigned long compressedFlagFrames = 0, otherFrames = 0;
+double airtime = 0;
+
+// Time on air of a LoRa frame with len octets of payload, in milliseconds (Semtech AN1200.13)
+double loraAirtime(uint8_t len)
+{
+  double symbol = (1 << LORA_SF) / LORA_BANDWIDTH * 1000.0;
+  double payloadSymbols = ceil((8.0 * len - 4 * LORA_SF + 28 + 16) / (4 * LORA_SF)) * (LORA_CODING_RATE + 4);
+  if (payloadSymbols < 0)
+    payloadSymbols = 0;
+  return (LORA_PREAMBLE + 4.25 + 8 + payloadSymbols) * symbol;
+}
+
+// A radio driver on the simulated ether
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0) {}
+
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return RH_MAX_MESSAGE_LEN; }
+
+  bool available()
+  {
+    pthread_mutex_lock(&ether);
+    // Discard frames not for us, as a radio would
+    while (head != tail && inbox[tail % INBOX_LEN].to != _thisAddress
+	   && inbox[tail % INBOX_LEN].to != RH_BROADCAST_ADDRESS)
+      tail++;
+    bool ret = head != tail;
+    pthread_mutex_unlock(&ether);
+    return ret;
+  }
+
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    pthread_mutex_lock(&ether);
+    Frame* frame = &inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = frame->to;
+    _rxHeaderFrom = frame->from;
+    _rxHeaderId = frame->id;
+    _rxHeaderFlags = frame->flags;
+    if (buf && len)
+    {
+      if (*len > frame->len)
+	*len = frame->len;
+      memcpy(buf, frame->data, *len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    pthread_mutex_lock(&ether);
+    framesSent++;
+    octetsSent += DRIVER_HEADER_LEN + len;
+    airtime += loraAirtime(DRIVER_HEADER_LEN + len);
+    if (!(_txHeaderFlags & RH_FLAGS_ACK))
+    {
+      if (_txHeaderFlags & RH_ROUTER_FLAGS_COMPRESSED)
+	compressedFlagFrames++;
+      else
+	otherFrames++;
+    }
+    for (uint8_t i = 0; i < NUM_NODES; i++)
+    {
+      // Nodes hear only their neighbours in the line
+      EtherDriver* node = nodes[i];
+      if (abs(node->_thisAddress - _thisAddress) != 1 || node->head - node->tail >= INBOX_LEN)
+	continue;
+      Frame* frame = &node->inbox[node->head++ % INBOX_LEN];
+      frame->to = _txHeaderTo;
+      frame->from = _txHeaderFrom;
+      frame->id = _txHeaderId;
+      frame->flags = _txHeaderFlags;
+      frame->len = len;
+      memcpy(frame->data, data, len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  Frame    inbox[INBOX_LEN];
+  uint32_t head, tail;
+};
+
+EtherDriver drivers[NUM_NODES];
+RHMesh* managers[NUM_NODES];
+
+// Fills a reading with a pattern that shows whether it is intact
+void makeReading(uint8_t* buf, uint8_t sensor, uint8_t seq)
+{
+  for (uint8_t i = 0; i < READING_LEN; i++)
+    buf[i] = sensor * 16 + seq + i;
+}
+
+// Some readings have end-to-end flags
+uint8_t readingFlags(uint8_t seq)
+{
+  return (seq % 10 == 0) ? 0x5a : 0;
+}
+
+volatile bool done = false;
+volatile unsigned received;
+unsigned corrupt, wrongHeaders;
+
+// Runs a node: receives readings (on node 1) and forwards messages for other nodes
+void* runNode(void* arg)
+{
+  uint8_t n = (uint8_t)(long)arg;
+  while (!done)
+  {
+    uint8_t buf[RH_MESH_MAX_MESSAGE_LEN], expected[READING_LEN];
+    uint8_t len = sizeof(buf);
+    uint8_t source, dest, id, flags, hops;
+    if (!managers[n]->recvfromAckTimeout(buf, &len, 10, &source, &dest, &id, &flags, &hops) || n != 0)
+      continue;
+    received++;
+    makeReading(expected, source, buf[0] - source * 16);
+    if (len != READING_LEN || memcmp(buf, expected, len))
+      corrupt++;
+    else if (dest != 1 || hops != source - 2 || flags != readingFlags(buf[0] - source * 16))
+      wrongHeaders++;
+  }
+  return NULL;
+}
+
+// Sends the readings from nodes 2 and 4, and prints what it took.
+// hopFlags are the application flags set in the hop-to-hop headers
+void run(bool compress, uint8_t hopFlags = RH_FLAGS_NONE)
+{
+  for (uint8_t n = 0; n < NUM_NODES; n++)
+  {
+    managers[n]->setHeaderCompression(compress);
+    managers[n]->setHeaderFlags(hopFlags);
+    managers[n]->clearRoutingTable(); // So route discovery is included
+    managers[n]->resetRetransmissions();
+  }
+  pthread_mutex_lock(&ether);
+  framesSent = 0;
+  octetsSent = 0;
+  compressedFlagFrames = otherFrames = 0;
+  airtime = 0;
+  pthread_mutex_unlock(&ether);
+  received = corrupt = wrongHeaders = 0;
+
+  unsigned failures = 0;
+  uint8_t sensors[2] = { 2, 4 };
+  for (uint8_t seq = 0; seq < NUM_READINGS; seq++)
+  {
+    for (uint8_t s = 0; s < 2; s++)
+    {
+      uint8_t buf[READING_LEN];
+      makeReading(buf, sensors[s], seq);
+      unsigned before = received;
+      if (managers[sensors[s] - 1]->sendtoWait(buf, sizeof(buf), 1, readingFlags(seq)) != RH_ROUTER_ERROR_NONE)
+	failures++;
+      // Wait for it to arrive before sending the next, as RHMesh discards messages that arrive while
+      // it waits for an ACK, and the retransmissions would hide the difference
+      unsigned long start = millis();
+      while (received == before && millis() - start < 1000)
+	delay(1);
+    }
+  }
+
+  pthread_mutex_lock(&ether);
+  unsigned readings = 2 * NUM_READINGS;
+  unsigned long retransmissions = 0;
+  for (uint8_t n = 0; n < NUM_NODES; n++)
+    retransmissions += managers[n]->retransmissions();
+  printf("Headers %s%s:\n", compress ? "compressed" : "not compressed",
+	 hopFlags ? ", with application flags" : "");
+  printf("  %-32s %10lu\n", "frames sent", framesSent);
+  printf("  %-32s %10lu\n", "of which retransmissions", retransmissions);
+  printf("  %-32s %10lu\n", "octets sent", octetsSent);
+  printf("  %-32s %10.1f\n", "airtime, ms", airtime);
+  printf("  %-32s %10.2f\n", "airtime per reading, ms", airtime / readings);
+  printf("  %-32s %10.1f\n", "readings per second of airtime", readings * 1000.0 / airtime);
+  pthread_mutex_unlock(&ether);
+  check(failures == 0, "every reading sent");
+  check(received == readings, "every reading received");
+  check(corrupt == 0, "readings intact");
+  check(wrongHeaders == 0, "readings with their DEST, HOPS and FLAGS");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  pthread_t threads[NUM_NODES - 1];
+  for (uint8_t n = 0; n < NUM_NODES; n++)
+  {
+    nodes[n] = &drivers[n];
+    managers[n] = new RHMesh(drivers[n], n + 1);
+    managers[n]->init();
+    managers[n]->setTimeout(100);
+    managers[n]->setRetries(3);
+  }
+  // Nodes 1 to 3 receive and forward in their own threads. Node 4 only sends, so it needs none
+  for (uint8_t n = 0; n < NUM_NODES - 1; n++)
+    pthread_create(&threads[n], NULL, runNode, (void*)(long)n);
+
+  run(false);
+  double uncompressed = airtime;
+  run(true);
+  printf("Compression saves %.1f%% of the airtime\n", 100.0 * (uncompressed - airtime) / uncompressed);
+  check(airtime < uncompressed, "compressed headers take less airtime");
+  check(compressedFlagFrames > 0, "compressed headers marked");
+
+  // The application uses RH_ROUTER_FLAGS_COMPRESSED itself, so it must reach the ether on every frame
+  run(false, RH_ROUTER_FLAGS_COMPRESSED);
+  check(compressedFlagFrames > 0 && otherFrames == 0, "application use of RH_ROUTER_FLAGS_COMPRESSED sent as set");
+
+  done = true;
+  for (uint8_t n = 0; n < NUM_NODES - 1; n++)
+    pthread_join(threads[n], NULL);
+  checkExit();
+}
+
+void loop()
+{
+}
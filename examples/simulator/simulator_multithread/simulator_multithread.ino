@@ -0,0 +1,273 @@
+// simulator_multithread.pde
+// -*- mode: C++ -*-
+// Example sketch that stress tests the thread safety of the managers on Linux (see "Threads" in
+// RHDatagram.h). A gateway node has several producer threads calling sendtoWait() on the same
+// RHReliableDatagram at once, each setting its own application header flags, while another thread
+// receives with recvfromAckTimeout(). They talk to a server node over a simulated ether inside this process
+// that loses some of the frames. Checks that every message is delivered exactly once, intact, in the order
+// each producer sent it and with that producer's headers, and that no driver is ever called
+// by 2 threads at once.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/simulator/simulator_multithread/simulator_multithread.ino tools/simMain.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_multithread -lpthread
+// Run with ./simulator_multithread
+
+#include <RHReliableDatagram.h>
+#include <pthread.h>
+#include <RHutil/RHSelfTest.h>
+
+#define GATEWAY_ADDRESS 1
+#define SERVER_ADDRESS  2
+
+// Producer threads on the gateway
+#define NUM_PRODUCERS 4
+
+// Messages from each producer
+#define NUM_MESSAGES 100
+
+// Percentage of frames lost
+#define LOSS_PERCENT 5
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[RH_MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+
+// Connects the nodes: every frame sent is delivered to every other node, unless lost
+pthread_mutex_t ether = PTHREAD_MUTEX_INITIALIZER;
+EtherDriver* nodes[2];
+unsigned int seed = 1;
+
+// A radio driver on the simulated ether
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0), active(0), overlaps(0) {}
+
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return 60; }
+
+  bool available()
+  {
+    Watch watch(*this);
+    pthread_mutex_lock(&ether);
+    // Discard frames not for us, as a radio would
+    while (head != tail && !_promiscuous && inbox[tail % INBOX_LEN].to != _thisAddress
+	   && inbox[tail % INBOX_LEN].to != RH_BROADCAST_ADDRESS)
+      tail++;
+    bool ret = head != tail;
+    pthread_mutex_unlock(&ether);
+    return ret;
+  }
+
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    Watch watch(*this);
+    pthread_mutex_lock(&ether);
+    Frame* frame = &inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = frame->to;
+    _rxHeaderFrom = frame->from;
+    _rxHeaderId = frame->id;
+    _rxHeaderFlags = frame->flags;
+    if (buf && len)
+    {
+      if (*len > frame->len)
+	*len = frame->len;
+      memcpy(buf, frame->data, *len);
+    }
+    pthread_mutex_unlock(&ether);
+    _rxGood++;
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    Watch watch(*this);
+    pthread_mutex_lock(&ether);
+    for (uint8_t i = 0; i < 2; i++)
+    {
+      EtherDriver* node = nodes[i];
+      if (node == this || node->head - node->tail >= INBOX_LEN || (rand_r(&seed) % 100) < LOSS_PERCENT)
+	continue;
+      Frame* frame = &node->inbox[node->head++ % INBOX_LEN];
+      frame->to = _txHeaderTo;
+      frame->from = _txHeaderFrom;
+      frame->id = _txHeaderId;
+      frame->flags = _txHeaderFlags;
+      frame->len = len;
+      memcpy(frame->data, data, len);
+    }
+    pthread_mutex_unlock(&ether);
+    _txGood++;
+    return true;
+  }
+
+  // Counts calls that overlap calls from other threads
+  class Watch
+  {
+  public:
+    Watch(EtherDriver& driver) : _driver(driver)
+    {
+      if (__atomic_add_fetch(&_driver.active, 1, __ATOMIC_SEQ_CST) > 1)
+	__atomic_add_fetch(&_driver.overlaps, 1, __ATOMIC_SEQ_CST);
+    }
+    ~Watch() { __atomic_sub_fetch(&_driver.active, 1, __ATOMIC_SEQ_CST);}
+  private:
+    EtherDriver& _driver;
+  };
+
+  Frame    inbox[INBOX_LEN];
+  uint32_t head, tail;
+  int      active;
+  unsigned overlaps;
+};
+
+EtherDriver gatewayDriver, serverDriver;
+RHReliableDatagram gateway(gatewayDriver, GATEWAY_ADDRESS);
+RHReliableDatagram server(serverDriver, SERVER_ADDRESS);
+
+// Fills a message with a pattern that shows whether it is intact
+uint8_t makeMessage(uint8_t* buf, uint8_t producer, uint16_t seq)
+{
+  uint8_t len = 4 + (producer * 7 + seq) % 40;
+  buf[0] = producer;
+  buf[1] = seq;
+  buf[2] = seq >> 8;
+  buf[3] = len;
+  for (uint8_t i = 4; i < len; i++)
+    buf[i] = producer ^ seq ^ i;
+  return len;
+}
+
+volatile unsigned sendFailures = 0;
+volatile bool producersDone = false;
+
+// Sends NUM_MESSAGES to the server, with the producer number in the application header flags
+void* producer(void* arg)
+{
+  uint8_t p = (uint8_t)(long)arg;
+  uint8_t buf[60];
+  for (uint16_t seq = 0; seq < NUM_MESSAGES; seq++)
+  {
+    uint8_t len = makeMessage(buf, p, seq);
+    // Hold the lock so the flags go with this message, not another producer's
+    RHDatagram::ScopedLock lock(gateway);
+    gateway.setHeaderFlags(p, RH_FLAGS_APPLICATION_SPECIFIC);
+    if (!gateway.sendtoWait(buf, len, SERVER_ADDRESS))
+      __atomic_add_fetch(&sendFailures, 1, __ATOMIC_SEQ_CST);
+  }
+  return NULL;
+}
+
+// Receives progress reports broadcast by the server, while the producers send
+unsigned reports = 0, badReports = 0;
+void* receiver(void*)
+{
+  while (!producersDone)
+  {
+    uint8_t buf[60];
+    uint8_t len = sizeof(buf);
+    uint8_t from;
+    if (gateway.recvfromAckTimeout(buf, &len, 10, &from))
+    {
+      if (from != SERVER_ADDRESS || len != 2)
+	badReports++;
+      reports++;
+    }
+  }
+  return NULL;
+}
+
+// Receives and checks the messages, and broadcasts a progress report every 10
+unsigned received = 0, corrupt = 0, outOfOrder = 0, wrongHeaders = 0;
+uint16_t nextSeq[NUM_PRODUCERS];
+void* serve(void*)
+{
+  unsigned long lastHeard = millis();
+  while (!producersDone || millis() - lastHeard < 500)
+  {
+    uint8_t buf[60], expected[60];
+    uint8_t len = sizeof(buf);
+    uint8_t from, to, id, flags;
+    if (!server.recvfromAckTimeout(buf, &len, 10, &from, &to, &id, &flags))
+      continue;
+    lastHeard = millis();
+    received++;
+    uint8_t p = buf[0];
+    uint16_t seq = buf[1] | (buf[2] << 8);
+    if (p >= NUM_PRODUCERS || len != makeMessage(expected, p, seq) || memcmp(buf, expected, len))
+    {
+      corrupt++;
+      continue;
+    }
+    if (seq != nextSeq[p])
+      outOfOrder++;
+    nextSeq[p] = seq + 1;
+    if (from != GATEWAY_ADDRESS || to != SERVER_ADDRESS || (flags & RH_FLAGS_APPLICATION_SPECIFIC) != p)
+      wrongHeaders++;
+    if (received % 10 == 0)
+    {
+      uint8_t report[2] = { (uint8_t)received, (uint8_t)(received >> 8) };
+      server.sendtoWait(report, sizeof(report), RH_BROADCAST_ADDRESS);
+    }
+  }
+  return NULL;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  nodes[0] = &gatewayDriver;
+  nodes[1] = &serverDriver;
+  check(gateway.init() && server.init(), "init");
+  gateway.setTimeout(10);
+  gateway.setRetries(20);
+  server.setTimeout(10);
+
+  unsigned long start = millis();
+  pthread_t serverThread, receiverThread, producers[NUM_PRODUCERS];
+  pthread_create(&serverThread, NULL, serve, NULL);
+  pthread_create(&receiverThread, NULL, receiver, NULL);
+  for (long p = 0; p < NUM_PRODUCERS; p++)
+    pthread_create(&producers[p], NULL, producer, (void*)p);
+  for (uint8_t p = 0; p < NUM_PRODUCERS; p++)
+    pthread_join(producers[p], NULL);
+  producersDone = true;
+  pthread_join(receiverThread, NULL);
+  pthread_join(serverThread, NULL);
+
+  Serial.print("        ");
+  Serial.print(NUM_PRODUCERS * NUM_MESSAGES, DEC);
+  Serial.print(" messages from ");
+  Serial.print(NUM_PRODUCERS, DEC);
+  Serial.print(" producers in ");
+  Serial.print(millis() - start, DEC);
+  Serial.print(" ms, ");
+  Serial.print(gateway.retransmissions(), DEC);
+  Serial.print(" retransmissions, ");
+  Serial.print(reports, DEC);
+  Serial.println(" progress reports received");
+  check(sendFailures == 0, "every sendtoWait() acknowledged");
+  check(received == NUM_PRODUCERS * NUM_MESSAGES, "every message received exactly once");
+  check(corrupt == 0, "messages intact");
+  check(outOfOrder == 0, "each producer's messages in order");
+  check(wrongHeaders == 0, "each message with its producer's headers");
+  check(badReports == 0, "progress reports intact");
+  check(gatewayDriver.overlaps == 0 && serverDriver.overlaps == 0, "drivers never called by 2 threads at once");
+
+  checkExit();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,219 @@
+// simulator_reliable_multicast.pde
+// -*- mode: C++ -*-
+// Example sketch that tests reliable multicast with RHReliableDatagram::sendtoGroupWait().
+// A sender broadcasts messages to a group of 3 members over a simulated ether inside this process
+// that loses some of the frames, each member in its own thread. Checks every message is acknowledged
+// by every member and received by each exactly once, that recvfromAck() returns multicast messages without
+// waiting for the multicast ACK spread, and that an empty group is refused without sending anything.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/simulator/simulator_reliable_multicast/simulator_reliable_multicast.ino tools/simMain.cpp RHReliableDatagram.cpp RHDatagram.cpp RHGenericDriver.cpp -o simulator_reliable_multicast -lpthread
+// Run with ./simulator_reliable_multicast
+
+#include <RHReliableDatagram.h>
+#include <pthread.h>
+#include <RHutil/RHSelfTest.h>
+
+#define SENDER_ADDRESS 1
+
+// Members of the group, at addresses 2, 3, 4
+#define NUM_MEMBERS 3
+
+// Messages sent to the group
+#define NUM_MESSAGES 50
+
+// Percentage of frames lost
+#define LOSS_PERCENT 5
+
+// Time over which the members spread their ACKs, in milliseconds
+#define ACK_SPREAD 40
+
+// Frames that can wait for each node
+#define INBOX_LEN 16
+
+// A frame in the ether
+typedef struct
+{
+  uint8_t to, from, id, flags;
+  uint8_t len;
+  uint8_t data[RH_MAX_MESSAGE_LEN];
+} Frame;
+
+class EtherDriver;
+
+// Connects the nodes: every frame sent is delivered to every other node, unless lost
+pthread_mutex_t ether = PTHREAD_MUTEX_INITIALIZER;
+EtherDriver* nodes[NUM_MEMBERS + 1];
+unsigned int seed = 1;
+unsigned long framesSent = 0;
+
+// A radio driver on the simulated ether
+class EtherDriver : public RHGenericDriver
+{
+public:
+  EtherDriver() : head(0), tail(0) {}
+
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return RH_MAX_MESSAGE_LEN; }
+
+  bool available()
+  {
+    pthread_mutex_lock(&ether);
+    // Discard frames not for us, as a radio would
+    while (head != tail && inbox[tail % INBOX_LEN].to != _thisAddress
+	   && inbox[tail % INBOX_LEN].to != RH_BROADCAST_ADDRESS)
+      tail++;
+    bool ret = head != tail;
+    pthread_mutex_unlock(&ether);
+    return ret;
+  }
+
+  bool recv(uint8_t* buf, uint8_t* len)
+  {
+    if (!available())
+      return false;
+    pthread_mutex_lock(&ether);
+    Frame* frame = &inbox[tail++ % INBOX_LEN];
+    _rxHeaderTo = frame->to;
+    _rxHeaderFrom = frame->from;
+    _rxHeaderId = frame->id;
+    _rxHeaderFlags = frame->flags;
+    if (buf && len)
+    {
+      if (*len > frame->len)
+	*len = frame->len;
+      memcpy(buf, frame->data, *len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    pthread_mutex_lock(&ether);
+    framesSent++;
+    for (uint8_t i = 0; i < NUM_MEMBERS + 1; i++)
+    {
+      EtherDriver* node = nodes[i];
+      if (node == this || node->head - node->tail >= INBOX_LEN || (rand_r(&seed) % 100) < LOSS_PERCENT)
+	continue;
+      Frame* frame = &node->inbox[node->head++ % INBOX_LEN];
+      frame->to = _txHeaderTo;
+      frame->from = _txHeaderFrom;
+      frame->id = _txHeaderId;
+      frame->flags = _txHeaderFlags;
+      frame->len = len;
+      memcpy(frame->data, data, len);
+    }
+    pthread_mutex_unlock(&ether);
+    return true;
+  }
+
+  Frame    inbox[INBOX_LEN];
+  uint32_t head, tail;
+};
+
+EtherDriver drivers[NUM_MEMBERS + 1];
+RHReliableDatagram* managers[NUM_MEMBERS + 1];
+
+volatile bool done = false;
+
+// What each member received
+uint8_t timesReceived[NUM_MEMBERS][NUM_MESSAGES];
+unsigned corrupt[NUM_MEMBERS];
+unsigned long slowestRecv[NUM_MEMBERS]; // microseconds
+
+// Runs a member: receives the messages and counts them
+void* runMember(void* arg)
+{
+  uint8_t m = (uint8_t)(long)arg;
+  RHReliableDatagram* manager = managers[m + 1];
+  while (!done)
+  {
+    if (!manager->waitAvailableTimeout(10))
+      continue;
+    uint8_t buf[RH_MAX_MESSAGE_LEN];
+    uint8_t len = sizeof(buf);
+    uint8_t from, flags;
+    unsigned long start = micros();
+    if (!manager->recvfromAck(buf, &len, &from, NULL, NULL, &flags))
+      continue;
+    unsigned long took = micros() - start;
+    if (took > slowestRecv[m])
+      slowestRecv[m] = took;
+    if (from != SENDER_ADDRESS || !(flags & RH_FLAGS_MULTICAST) || len != 2 || buf[0] >= NUM_MESSAGES
+	|| buf[1] != (uint8_t)~buf[0])
+      corrupt[m]++;
+    else
+      timesReceived[m][buf[0]]++;
+  }
+  // The last ACK may still be pending
+  manager->flushAcks();
+  return NULL;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  for (uint8_t n = 0; n < NUM_MEMBERS + 1; n++)
+  {
+    nodes[n] = &drivers[n];
+    managers[n] = new RHReliableDatagram(drivers[n], SENDER_ADDRESS + n);
+    managers[n]->init();
+    managers[n]->setTimeout(50);
+    managers[n]->setRetries(5);
+    managers[n]->setMulticastAckSpread(ACK_SPREAD);
+  }
+  pthread_t threads[NUM_MEMBERS];
+  for (uint8_t m = 0; m < NUM_MEMBERS; m++)
+    pthread_create(&threads[m], NULL, runMember, (void*)(long)m);
+
+  RHReliableDatagram& sender = *managers[0];
+  uint8_t members[NUM_MEMBERS] = { 2, 3, 4 };
+  uint8_t buf[2];
+  uint32_t acked;
+
+  // An empty group
+  unsigned long before = framesSent;
+  check(!sender.sendtoGroupWait(buf, sizeof(buf), members, 0, &acked), "empty group refused");
+  check(framesSent == before, "nothing sent to an empty group");
+
+  unsigned failures = 0;
+  for (uint8_t n = 0; n < NUM_MESSAGES; n++)
+  {
+    buf[0] = n;
+    buf[1] = ~n;
+    if (!sender.sendtoGroupWait(buf, sizeof(buf), members, NUM_MEMBERS, &acked) || acked != 0x7)
+      failures++;
+  }
+  printf("%u messages to %u members: %lu frames sent, %lu retransmissions\n",
+	 NUM_MESSAGES, NUM_MEMBERS, framesSent, (unsigned long)sender.retransmissions());
+
+  done = true;
+  for (uint8_t m = 0; m < NUM_MEMBERS; m++)
+    pthread_join(threads[m], NULL);
+
+  bool once = true;
+  unsigned bad = 0;
+  unsigned long slowest = 0;
+  for (uint8_t m = 0; m < NUM_MEMBERS; m++)
+  {
+    for (uint8_t n = 0; n < NUM_MESSAGES; n++)
+      if (timesReceived[m][n] != 1)
+	once = false;
+    bad += corrupt[m];
+    if (slowestRecv[m] > slowest)
+      slowest = slowestRecv[m];
+  }
+  printf("Slowest recvfromAck(): %lu us, ACK spread %u ms\n", slowest, ACK_SPREAD);
+  check(failures == 0, "every message acknowledged by every member");
+  check(once, "every message received once by every member");
+  check(bad == 0, "messages intact");
+  check(slowest < ACK_SPREAD * 1000UL / 4, "recvfromAck() does not wait for the ACK spread");
+
+  checkExit();
+}
+
+void loop()
+{
+}
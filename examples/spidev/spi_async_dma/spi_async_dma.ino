@@ -0,0 +1,333 @@
+// spi_async_dma.pde
+// -*- mode: C++ -*-
+// Example sketch that tests the asynchronous SPI burst transfers of RHSPIDriver
+// (spiBurstReadAsync(), spiBurstWriteAsync() and spiBatchAsync()) on Linux without any SPI hardware.
+// SimulatedDMASPI is an RHGenericSPI whose asynchronous transfers are done by a
+// simulated DMA controller: a separate thread that moves one octet every 8 microseconds
+// (as a 1MHz SPI bus would) to and from a simulated device with registers and a FIFO like
+// an SX1276, and then calls the completion callback, as a DMA complete interrupt would.
+// Checks that the CPU carries on while a 255 octet FIFO transfer is in progress, that the
+// data arrives intact, that a second transfer cannot be started while one is in progress,
+// that a completion callback can start the next transfer, that the FIFO can be loaded as RH_RF95::send()
+// does, also when the interface can not start the transfer, that a register read waits for a transfer
+// in progress, and that interfaces without DMA (which emulate asynchronous transfers synchronously)
+// give the same results. The asynchronous transfers are only built with RH_SPI_ASYNC defined to 1.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_SPI_ASYNC=1 -I . -I RHutil -x c++ examples/spidev/spi_async_dma/spi_async_dma.ino tools/simMain.cpp RHGenericSPI.cpp RHSPIDriver.cpp RHGenericDriver.cpp -o spi_async_dma -lpthread
+// Run with ./spi_async_dma
+
+#include <RHSPIDriver.h>
+#include <pthread.h>
+#include <time.h>
+#include <RHutil/RHSelfTest.h>
+
+#if !RH_SPI_ASYNC
+ #error Build with -DRH_SPI_ASYNC=1
+#endif
+
+#define REG_FIFO          0x00
+#define REG_FIFO_ADDR_PTR 0x0d
+
+// Time to move one octet on a 1MHz SPI bus
+#define OCTET_NS 8000
+
+// A device with registers and a FIFO, on an SPI interface without DMA.
+// Each register transaction starts with the register address octet, as after chip select
+class SimulatedSPI : public RHGenericSPI
+{
+public:
+  SimulatedSPI() : fifoPtr(0), first(true)
+  {
+    memset(regs, 0, sizeof(regs));
+    memset(fifo, 0, sizeof(fifo));
+  }
+  void begin() {}
+  void end() {}
+  void beginTransaction() { first = true; }
+  void endTransaction() {}
+  uint8_t spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
+  {
+    first = true;
+    return RHGenericSPI::spiBurstRead(reg, dest, len);
+  }
+  uint8_t spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
+  {
+    first = true;
+    return RHGenericSPI::spiBurstWrite(reg, src, len);
+  }
+
+  uint8_t transfer(uint8_t data)
+  {
+    if (first)
+    {
+      // The register address octet
+      first = false;
+      reg = data & 0x7f;
+      write = data & 0x80;
+      return 0x42; // Status
+    }
+    uint8_t ret = 0;
+    if (reg == REG_FIFO)
+    {
+      if (write)
+        fifo[fifoPtr] = data;
+      ret = fifo[fifoPtr++];
+    }
+    else
+    {
+      if (write)
+      {
+        regs[reg] = data;
+        if (reg == REG_FIFO_ADDR_PTR)
+          fifoPtr = data;
+      }
+      ret = regs[reg++];
+    }
+    return ret;
+  }
+
+  uint8_t regs[128];
+  uint8_t fifo[256];
+  uint8_t fifoPtr;
+
+protected:
+  bool    first;
+  uint8_t reg;
+  bool    write;
+};
+
+// The same device on an SPI interface with a (simulated) DMA controller
+class SimulatedDMASPI : public SimulatedSPI
+{
+public:
+  SimulatedDMASPI() : busy(false), transfers(0) {}
+
+  bool spiBurstReadAsync(uint8_t reg, uint8_t* dest, uint8_t len, TransferCallback callback, void* context)
+  {
+    return start(reg, dest, len, callback, context);
+  }
+  bool spiBurstWriteAsync(uint8_t reg, const uint8_t* src, uint8_t len, TransferCallback callback, void* context)
+  {
+    return start(reg, (uint8_t*)src, len, callback, context);
+  }
+
+  volatile bool busy;
+  unsigned long transfers;
+
+protected:
+  bool start(uint8_t reg, uint8_t* data, uint8_t len, TransferCallback callback, void* context)
+  {
+    if (busy)
+      return false;
+    busy = true;
+    first = true;
+    dmaReg = reg;
+    dmaData = data;
+    dmaLen = len;
+    dmaCallback = callback;
+    dmaContext = context;
+    transfers++;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dma, this) != 0)
+    {
+      busy = false;
+      return false;
+    }
+    pthread_detach(thread);
+    return true;
+  }
+
+  // The DMA controller
+  static void* dma(void* arg)
+  {
+    SimulatedDMASPI* self = (SimulatedDMASPI*)arg;
+    struct timespec ts = { 0, OCTET_NS };
+    nanosleep(&ts, NULL);
+    uint8_t status = self->transfer(self->dmaReg);
+    for (uint8_t i = 0; i < self->dmaLen; i++)
+    {
+      nanosleep(&ts, NULL);
+      self->dmaData[i] = self->transfer(self->dmaData[i]);
+    }
+    __sync_synchronize();
+    self->busy = false;
+    // The DMA complete interrupt
+    if (self->dmaCallback)
+      self->dmaCallback(self->dmaContext, status);
+    return NULL;
+  }
+
+  uint8_t          dmaReg;
+  uint8_t*         dmaData;
+  uint8_t          dmaLen;
+  TransferCallback dmaCallback;
+  void*            dmaContext;
+};
+
+// RHSPIDriver is abstract: this is the least needed to use its register access
+class RegisterDriver : public RHSPIDriver
+{
+public:
+  RegisterDriver(RHGenericSPI& spi) : RHSPIDriver(RH_INVALID_PIN, spi) {}
+  bool available() { return false; }
+  bool recv(uint8_t* buf, uint8_t* len) { (void)buf; (void)len; return false; }
+  bool send(const uint8_t* data, uint8_t len) { (void)data; (void)len; return false; }
+  uint8_t maxMessageLength() { return 0; }
+};
+
+SimulatedDMASPI dmaSpi;
+RegisterDriver  dmaDriver(dmaSpi);
+SimulatedSPI    plainSpi;
+RegisterDriver  plainDriver(plainSpi);
+
+volatile unsigned int completions = 0;
+volatile uint8_t lastStatus = 0;
+
+void completed(void* context, uint8_t status)
+{
+  (void)context;
+  lastStatus = status;
+  completions++;
+}
+
+// Started by the callback of the first transfer of a chain
+uint8_t chained[255];
+void startChained(void* context, uint8_t status)
+{
+  completed(context, status);
+  RegisterDriver* driver = (RegisterDriver*)context;
+  driver->spiWrite(REG_FIFO_ADDR_PTR, 0);
+  driver->spiBurstReadAsync(REG_FIFO, chained, sizeof(chained), completed, NULL);
+}
+
+// The transactions that load the FIFO, as in RH_RF95::send()
+uint8_t fifoAddr;
+uint8_t headers[4] = { 0x11, 0x22, 0x33, 0x44 };
+RHGenericSPI::Transaction load[3];
+
+void loadFifo(RegisterDriver& driver, SimulatedSPI& device, uint8_t* data)
+{
+  (void)driver;
+  memset(device.fifo, 0, sizeof(device.fifo));
+  fifoAddr = 0x10;
+  load[0].reg = REG_FIFO_ADDR_PTR; load[0].write = true; load[0].data = &fifoAddr; load[0].len = 1;
+  load[1].reg = REG_FIFO; load[1].write = true; load[1].data = headers; load[1].len = sizeof(headers);
+  load[2].reg = REG_FIFO; load[2].write = true; load[2].data = data; load[2].len = 100;
+}
+
+bool fifoLoaded(SimulatedSPI& device, uint8_t* data)
+{
+  return memcmp(device.fifo + 0x10, headers, sizeof(headers)) == 0 && memcmp(device.fifo + 0x14, data, 100) == 0;
+}
+
+unsigned long nanos()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// Runs the same tests on a driver and its device, and returns the number of loop iterations
+// the CPU did while the 255 octet FIFO read was in progress
+unsigned long test(RegisterDriver& driver, SimulatedSPI& device, const char* name)
+{
+  Serial.println(name);
+  uint8_t out[255], in[255];
+  uint16_t i;
+  for (i = 0; i < sizeof(out); i++)
+    out[i] = i * 7 + 3;
+
+  // Write the FIFO asynchronously
+  unsigned int before = completions;
+  driver.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  check(driver.spiBurstWriteAsync(REG_FIFO, out, sizeof(out), completed, NULL), "write started");
+  // The callback is called just after spiAsyncBusy() becomes false
+  while (driver.spiAsyncBusy() || completions != before + 1)
+    ;
+  check(lastStatus == 0x42, "write completion callback with status");
+  check(memcmp(device.fifo, out, sizeof(out)) == 0, "FIFO written");
+
+  // Read it back asynchronously, and see how much else we can do meanwhile
+  memset(in, 0, sizeof(in));
+  driver.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  unsigned long t0 = nanos();
+  check(driver.spiBurstReadAsync(REG_FIFO, in, sizeof(in), completed, NULL), "read started");
+  uint8_t dummy;
+  bool refused = !driver.spiAsyncBusy() || !driver.spiBurstReadAsync(REG_FIFO, &dummy, 1, completed, NULL);
+  unsigned long iterations = 0;
+  while (driver.spiAsyncBusy())
+    iterations++;
+  unsigned long elapsed = nanos() - t0;
+  while (completions != before + 2)
+    ;
+  check(refused, "second transfer refused while one is in progress");
+  check(memcmp(in, out, sizeof(out)) == 0, "FIFO read back");
+  Serial.print("        255 octet read took ");
+  Serial.print(elapsed / 1000, DEC);
+  Serial.print(" us, CPU looped ");
+  Serial.print(iterations, DEC);
+  Serial.println(" times meanwhile");
+
+  // A completion callback can start the next transfer
+  memset(chained, 0, sizeof(chained));
+  for (i = 0; i < sizeof(out); i++)
+    out[i] = 255 - i;
+  driver.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  check(driver.spiBurstWriteAsync(REG_FIFO, out, sizeof(out), startChained, &driver), "chain started");
+  while (completions != before + 4)
+    ;
+  while (driver.spiAsyncBusy())
+    ;
+  check(memcmp(chained, out, sizeof(out)) == 0, "transfer started from completion callback");
+
+  // Ordinary register access still works afterwards
+  driver.spiWrite(0x06, 0x6c);
+  check(driver.spiRead(0x06) == 0x6c && device.regs[0x06] == 0x6c, "register access afterwards");
+
+  // Load the FIFO as RH_RF95::send() does: the address pointer, the headers and the data in one transaction
+  loadFifo(driver, device, out);
+  check(driver.spiBatchAsync(load, 3, completed, NULL), "batch started");
+  while (driver.spiAsyncBusy() || completions != before + 5)
+    ;
+  check(fifoLoaded(device, out), "FIFO loaded by batch");
+
+  // A register read during an asynchronous transfer waits for it to finish
+  memset(in, 0, sizeof(in));
+  driver.spiWrite(REG_FIFO_ADDR_PTR, 0x14);
+  check(driver.spiBurstReadAsync(REG_FIFO, in, 100, completed, NULL), "read started");
+  check(driver.spiRead(0x06) == 0x6c && !driver.spiAsyncBusy() && memcmp(in, out, 100) == 0, "register read waited for the transfer");
+  while (completions != before + 6)
+    ;
+  return iterations;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  dmaDriver.init();
+  plainDriver.init();
+
+  unsigned long dmaIterations = test(dmaDriver, dmaSpi, "With simulated DMA:");
+  check(dmaIterations > 0, "CPU ran during the transfer");
+  check(dmaSpi.transfers == 6, "transfers done by DMA");
+
+  // The interface is busy with another driver's transfer: RH_RF95::send() does it with spiBatch() instead
+  uint8_t data[100];
+  memset(data, 0x5a, sizeof(data));
+  loadFifo(dmaDriver, dmaSpi, data);
+  dmaSpi.busy = true;
+  check(!dmaDriver.spiBatchAsync(load, 3) && !dmaDriver.spiAsyncBusy(), "batch refused while the interface is busy");
+  dmaSpi.busy = false;
+  dmaDriver.spiBatch(load, 3);
+  check(fifoLoaded(dmaSpi, data), "FIFO loaded by the synchronous batch");
+
+  unsigned long plainIterations = test(plainDriver, plainSpi, "Without DMA (emulated synchronously):");
+  check(plainIterations == 0, "transfer finished before spiBurstReadAsync returned");
+
+  checkExit();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,229 @@
+// spi_bus_stress.pde
+// -*- mode: C++ -*-
+// Example sketch that stress tests RHSPIBus on Linux without any SPI hardware.
+// 2 simulated devices share one mock SPI interface. Device A uses 1MHz, data mode 0 and
+// registers 0x00 to 0x3f; device B uses 8MHz, data mode 3 and registers 0x40 to 0x7f.
+// Each device is used by 2 threads at once (like an application thread and a
+// radio interrupt thread), each writing and reading back its own registers, with
+// single register and burst transfers. The mock interface counts overlapping
+// transactions (2 slaves selected at once), transactions done with the wrong device's settings,
+// and registers that read back wrongly.
+// First runs the threads without RHSPIBus, to show what goes wrong, then with it, which must
+// give no errors. Then checks that when the bus is released, the waiting device with the
+// highest priority gets it first.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/spidev/spi_bus_stress/spi_bus_stress.ino tools/simMain.cpp RHSPIBus.cpp RHGenericSPI.cpp RHSPIDriver.cpp RHGenericDriver.cpp -o spi_bus_stress -lpthread
+// Run with ./spi_bus_stress
+
+#include <RHSPIBus.h>
+#include <RHSPIDriver.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <RHutil/RHSelfTest.h>
+
+// Transactions per thread
+#define ITERATIONS 20000
+
+// The shared SPI interface, with both devices behind it
+class MockBusSPI : public RHGenericSPI
+{
+public:
+  MockBusSPI() : inTransaction(false), first(true), overlaps(0), wrongSettings(0)
+  {
+    memset(regs, 0, sizeof(regs));
+  }
+  void begin()
+  {
+    activeFrequency = _frequency;
+    activeDataMode = _dataMode;
+  }
+  void end() {}
+  void beginTransaction()
+  {
+    if (inTransaction)
+      overlaps++;
+    inTransaction = true;
+    first = true;
+  }
+  void endTransaction() { inTransaction = false; }
+
+  uint8_t transfer(uint8_t data)
+  {
+    if (first)
+    {
+      first = false;
+      reg = data & 0x7f;
+      write = data & 0x80;
+      // Device A has the low registers, and B the high ones
+      if (reg < 0x40 ? (activeFrequency != Frequency1MHz || activeDataMode != DataMode0)
+	             : (activeFrequency != Frequency8MHz || activeDataMode != DataMode3))
+	wrongSettings++;
+      // Give other threads a chance to get in the way
+      sched_yield();
+      return 0;
+    }
+    uint8_t r = reg++ & 0x7f;
+    if (write)
+      regs[r] = data;
+    return regs[r];
+  }
+
+  uint8_t regs[128];
+  volatile bool inTransaction;
+  bool first;
+  uint8_t reg;
+  bool write;
+  Frequency activeFrequency;
+  DataMode activeDataMode;
+  volatile unsigned long overlaps;
+  volatile unsigned long wrongSettings;
+};
+
+// RHSPIDriver is abstract: this is the least needed to use its register access
+class RegisterDriver : public RHSPIDriver
+{
+public:
+  RegisterDriver(RHGenericSPI& spi) : RHSPIDriver(RH_INVALID_PIN, spi) {}
+  bool available() { return false; }
+  bool recv(uint8_t* buf, uint8_t* len) { (void)buf; (void)len; return false; }
+  bool send(const uint8_t* data, uint8_t len) { (void)data; (void)len; return false; }
+  uint8_t maxMessageLength() { return 0; }
+};
+
+MockBusSPI spi;
+RHSPIBus bus(spi);
+RHSPIBusDevice spiA(bus, RHGenericSPI::Frequency1MHz, RHGenericSPI::BitOrderMSBFirst, RHGenericSPI::DataMode0);
+RHSPIBusDevice spiB(bus, RHGenericSPI::Frequency8MHz, RHGenericSPI::BitOrderMSBFirst, RHGenericSPI::DataMode3);
+
+// Each thread works on 16 registers of its own
+struct Worker
+{
+  RegisterDriver* driver;
+  uint8_t firstReg;
+  unsigned long errors;
+};
+
+void* work(void* arg)
+{
+  Worker* w = (Worker*)arg;
+  unsigned int seed = w->firstReg;
+  uint8_t out[8], in[8];
+  for (unsigned long i = 0; i < ITERATIONS; i++)
+  {
+    uint8_t reg = w->firstReg + (i % 8);
+    uint8_t val = rand_r(&seed);
+    w->driver->spiWrite(reg, val);
+    if (w->driver->spiRead(reg) != val)
+      w->errors++;
+    for (uint8_t j = 0; j < sizeof(out); j++)
+      out[j] = rand_r(&seed);
+    w->driver->spiBurstWrite(w->firstReg + 8, out, sizeof(out));
+    w->driver->spiBurstRead(w->firstReg + 8, in, sizeof(in));
+    if (memcmp(in, out, sizeof(out)) != 0)
+      w->errors++;
+  }
+  return NULL;
+}
+
+// Runs 2 threads on each driver, and returns the number of registers read back wrongly
+unsigned long stress(RegisterDriver& driverA, RegisterDriver& driverB)
+{
+  Worker workers[4] = {
+    { &driverA, 0x00, 0 }, { &driverA, 0x10, 0 },
+    { &driverB, 0x40, 0 }, { &driverB, 0x50, 0 }
+  };
+  pthread_t threads[4];
+  uint8_t i;
+  for (i = 0; i < 4; i++)
+    pthread_create(&threads[i], NULL, work, &workers[i]);
+  unsigned long errors = 0;
+  for (i = 0; i < 4; i++)
+  {
+    pthread_join(threads[i], NULL);
+    errors += workers[i].errors;
+  }
+  return errors;
+}
+
+void report(const char* name, unsigned long errors)
+{
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(spi.overlaps, DEC);
+  Serial.print(" overlapping transactions, ");
+  Serial.print(spi.wrongSettings, DEC);
+  Serial.print(" with wrong settings, ");
+  Serial.print(errors, DEC);
+  Serial.println(" read back errors");
+}
+
+// For the priority test
+RHSPIBusDevice spiLow(bus, RHGenericSPI::Frequency1MHz, RHGenericSPI::BitOrderMSBFirst, RHGenericSPI::DataMode0, 0);
+RHSPIBusDevice spiHigh(bus, RHGenericSPI::Frequency8MHz, RHGenericSPI::BitOrderMSBFirst, RHGenericSPI::DataMode3, 5);
+RegisterDriver driverLow(spiLow);
+RegisterDriver driverHigh(spiHigh);
+volatile unsigned int order = 0;
+unsigned int lowOrder, highOrder;
+
+void* readLow(void*)
+{
+  driverLow.spiRead(0x20);
+  lowOrder = __sync_fetch_and_add(&order, 1);
+  return NULL;
+}
+
+void* readHigh(void*)
+{
+  driverHigh.spiRead(0x60);
+  highOrder = __sync_fetch_and_add(&order, 1);
+  return NULL;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  // Without the bus, there is nothing to stop 2 threads using the interface at once
+  spi.setFrequency(RHGenericSPI::Frequency1MHz);
+  spi.begin();
+  RegisterDriver unsharedA(spi), unsharedB(spi);
+  unsigned long errors = stress(unsharedA, unsharedB);
+  report("Without RHSPIBus", errors);
+
+  // With it
+  spi.overlaps = spi.wrongSettings = 0;
+  RegisterDriver driverA(spiA), driverB(spiB);
+  driverA.init();
+  driverB.init();
+  errors = stress(driverA, driverB);
+  report("With RHSPIBus   ", errors);
+  check(spi.overlaps == 0, "no overlapping transactions");
+  check(spi.wrongSettings == 0, "each device used with its own settings");
+  check(errors == 0, "no read back errors");
+  Serial.print("        ");
+  Serial.print(bus.waits(), DEC);
+  Serial.print(" waits for the bus, ");
+  Serial.print(bus.settingsChanges(), DEC);
+  Serial.println(" settings changes");
+
+  // Priority: hold the bus, let a low priority device start waiting, then a
+  // high priority one, and release it
+  spiA.beginTransaction();
+  pthread_t low, high;
+  pthread_create(&low, NULL, readLow, NULL);
+  usleep(20000);
+  pthread_create(&high, NULL, readHigh, NULL);
+  usleep(20000);
+  spiA.endTransaction();
+  pthread_join(low, NULL);
+  pthread_join(high, NULL);
+  check(highOrder == 0 && lowOrder == 1, "high priority device got the bus first");
+
+  checkExit();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,304 @@
+// spidev_mock.pde
+// -*- mode: C++ -*-
+// Example sketch that tests RHSpidevSPI and RHSPIDriver on Linux without any SPI hardware,
+// by overriding RHSpidevSPI::message() with a mock spidev device that behaves like the
+// registers and FIFO of an SX1276 (as used by RH_RF95): register 0x00 is the FIFO, and 
+// RegFifoAddrPtr (0x0d) is the FIFO address pointer.
+// Checks that register reads and writes and 255 octet FIFO bursts are each sent as
+// a single SPI message (ioctl), with the right octets on the bus, and that a batch of
+// register transactions with RHSPIDriver::spiBatch() is also a single message.
+// Also checks the RHSPIDriver shadow registers, and counts the messages sent by the register accesses
+// of the RH_RF95 modem setters with and without them. The shadow registers need RH_SPI_SHADOW_REGISTERS,
+// which must be set for the library as well as this sketch.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -DRH_SPI_SHADOW_REGISTERS=128 -I . -I RHutil -x c++ examples/spidev/spidev_mock/spidev_mock.ino tools/simMain.cpp RHSpidevSPI.cpp RHGenericSPI.cpp RHSPIDriver.cpp RHGenericDriver.cpp -o spidev_mock
+// Run with ./spidev_mock
+
+#include <RHSpidevSPI.h>
+#include <RHSPIDriver.h>
+#include <RHutil/RHSelfTest.h>
+
+#define REG_FIFO         0x00
+#define REG_FIFO_ADDR_PTR 0x0d
+
+// Simulates the device at the other end of /dev/spidev0.0
+class MockSpidev : public RHSpidevSPI
+{
+public:
+  MockSpidev() : RHSpidevSPI("mock"), fifoPtr(0), lastLen(0)
+  {
+    memset(regs, 0, sizeof(regs));
+    memset(fifo, 0, sizeof(fifo));
+  }
+  // No device to open
+  void begin() { _speedHz = 1000000UL << _frequency; _messages = 0; }
+  void end() {}
+
+  uint8_t regs[128];
+  uint8_t fifo[256];
+  uint8_t fifoPtr;
+  // The octets sent on the bus in the last message
+  uint8_t lastTx[300];
+  uint16_t lastLen;
+
+protected:
+  // A chip select period starts with the address octet, the rest are data for consecutive
+  // registers, except that the FIFO stays put. A message is one chip select period,
+  // except that cs_change on a segment (other than the last) releases the chip select after it
+  bool message(struct spi_ioc_transfer* segments, uint8_t count)
+  {
+    uint8_t addr = 0;
+    bool write = false;
+    bool first = true;
+    lastLen = 0;
+    for (uint8_t s = 0; s < count; s++)
+    {
+      const uint8_t* tx = (const uint8_t*)(unsigned long)segments[s].tx_buf;
+      uint8_t* rx = (uint8_t*)(unsigned long)segments[s].rx_buf;
+      if (segments[s].speed_hz != _speedHz || segments[s].bits_per_word != 8)
+        Serial.println("bad segment settings");
+      for (uint32_t i = 0; i < segments[s].len; i++)
+      {
+        uint8_t out = tx ? tx[i] : 0; // spidev sends zeros if there is no tx_buf
+        uint8_t in = 0;
+        if (lastLen < sizeof(lastTx))
+          lastTx[lastLen++] = out;
+        if (first)
+        {
+          addr = out & 0x7f;
+          write = out & 0x80;
+          first = false;
+        }
+        else if (addr == REG_FIFO)
+        {
+          if (write)
+            fifo[fifoPtr++] = out;
+          else
+            in = fifo[fifoPtr++];
+        }
+        else
+        {
+          if (write)
+            regs[addr] = out;
+          else
+            in = regs[addr];
+          if (addr == REG_FIFO_ADDR_PTR && write)
+            fifoPtr = out;
+          addr = (addr + 1) & 0x7f;
+        }
+        if (rx)
+          rx[i] = in;
+      }
+      if (segments[s].cs_change)
+        first = true;
+    }
+    return true;
+  }
+};
+
+// Just the SPI register access of a driver
+class RegisterDriver : public RHSPIDriver
+{
+public:
+  RegisterDriver(RHGenericSPI& spi) : RHSPIDriver(RH_INVALID_PIN, spi) {} // The kernel does chip select
+  bool available() { return false; }
+  bool recv(uint8_t*, uint8_t*) { return false; }
+  bool send(const uint8_t*, uint8_t) { return false; }
+  uint8_t maxMessageLength() { return 0; }
+};
+
+MockSpidev spidev;
+RegisterDriver radio(spidev);
+
+#if RH_SPI_SHADOW_REGISTERS
+// The register accesses of RH_RF95::setSignalBandwidth(), setCodingRate4(), setSpreadingFactor(),
+// setPayloadCRC() and setLowDatarate(), in that order. Each setter except the last two also calls setLowDatarate()
+void rf95LowDatarate()
+{
+  radio.spiRead(0x1d);
+  radio.spiRead(0x1e);
+  radio.spiWrite(0x26, radio.spiRead(0x26) | 0x08);
+}
+
+void rf95Setters(uint8_t n)
+{
+  radio.spiWrite(0x1d, (radio.spiRead(0x1d) & 0x0f) | 0x70);            // setSignalBandwidth()
+  rf95LowDatarate();
+  radio.spiWrite(0x1d, (radio.spiRead(0x1d) & 0xf1) | ((n & 3) + 1) << 1); // setCodingRate4()
+  radio.spiWrite(0x1e, (radio.spiRead(0x1e) & 0x0f) | 0x70);            // setSpreadingFactor()
+  rf95LowDatarate();
+  radio.spiWrite(0x1e, radio.spiRead(0x1e) | 0x04);                     // setPayloadCRC()
+  rf95LowDatarate();                                                    // setLowDatarate()
+}
+#endif
+
+void setup()
+{
+  Serial.begin(9600);
+  radio.init();
+
+  // Single register write and read: one message each
+  uint32_t before = spidev.messages();
+  radio.spiWrite(0x01, 0x81);
+  check(spidev.messages() == before + 1, "spiWrite is one message");
+  check(spidev.lastLen == 2 && spidev.lastTx[0] == 0x81 && spidev.lastTx[1] == 0x81, "spiWrite octets");
+  check(radio.spiRead(0x01) == 0x81, "spiRead value");
+  check(spidev.messages() == before + 2, "spiRead is one message");
+  check(spidev.lastLen == 2 && spidev.lastTx[0] == 0x01, "spiRead octets");
+
+  // Consecutive registers
+  uint8_t config[3] = { 0x72, 0x74, 0x04 };
+  radio.spiBurstWrite(0x1d, config, sizeof(config));
+  uint8_t readback[3];
+  radio.spiBurstRead(0x1d, readback, sizeof(readback));
+  check(memcmp(config, readback, sizeof(config)) == 0, "register burst");
+
+  // Fill and empty the FIFO
+  uint8_t data[255], received[255];
+  uint16_t i;
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = i * 7;
+  radio.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  before = spidev.messages();
+  radio.spiBurstWrite(REG_FIFO, data, sizeof(data));
+  check(spidev.messages() == before + 1, "FIFO write is one message");
+  check(spidev.lastLen == 256 && spidev.lastTx[0] == 0x80, "FIFO write octets");
+  radio.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  before = spidev.messages();
+  radio.spiBurstRead(REG_FIFO, received, sizeof(received));
+  uint32_t burstMessages = spidev.messages() - before;
+  check(burstMessages == 1, "FIFO read is one message");
+  check(memcmp(data, received, sizeof(data)) == 0, "FIFO contents");
+
+  // For comparison: the same read as individual octet transfers, as before
+  radio.spiWrite(REG_FIFO_ADDR_PTR, 0);
+  before = spidev.messages();
+  spidev.RHGenericSPI::spiBurstRead(REG_FIFO, received, sizeof(received));
+  uint32_t octetMessages = spidev.messages() - before;
+
+  // The register accesses of RH_RF95::handleInterrupt() for a received packet, as
+  // individual transactions and as batches
+  uint8_t clear = 0xff;
+  struct { uint8_t rxCurrentAddr; uint8_t irqFlagsMask; uint8_t irqFlags; uint8_t rxBytes; } rx;
+  struct { uint8_t snr; uint8_t pktRssi; uint8_t rssi; uint8_t hopChannel; } pkt;
+  spidev.regs[0x10] = 0x20; // RegFifoRxCurrentAddr
+  spidev.regs[0x12] = 0x40; // RegIrqFlags: RxDone
+  spidev.regs[0x13] = 100;  // RegRxNbBytes
+  spidev.regs[0x19] = 0xf8; // RegPktSnrValue
+  spidev.regs[0x1a] = 50;   // RegPktRssiValue
+  spidev.regs[0x1c] = 0x40; // RegHopChannel: CRC on
+  before = spidev.messages();
+  rx.irqFlags = radio.spiRead(0x12);
+  pkt.hopChannel = radio.spiRead(0x1c);
+  radio.spiWrite(0x12, 0xff);
+  rx.rxBytes = radio.spiRead(0x13);
+  radio.spiWrite(REG_FIFO_ADDR_PTR, radio.spiRead(0x10));
+  radio.spiBurstRead(REG_FIFO, received, rx.rxBytes);
+  pkt.snr = radio.spiRead(0x19);
+  pkt.pktRssi = radio.spiRead(0x1a);
+  uint32_t singleMessages = spidev.messages() - before;
+
+  memset(&rx, 0, sizeof(rx));
+  memset(&pkt, 0, sizeof(pkt));
+  spidev.regs[0x12] = 0x40;
+  before = spidev.messages();
+  RHGenericSPI::Transaction status[] =
+  {
+    { 0x10, false, &rx.rxCurrentAddr, sizeof(rx) },
+    { 0x19, false, &pkt.snr, sizeof(pkt) },
+    { 0x12, true, &clear, 1 },
+  };
+  radio.spiBatch(status, 3);
+  RHGenericSPI::Transaction fifo[] =
+  {
+    { REG_FIFO_ADDR_PTR, true, &rx.rxCurrentAddr, 1 },
+    { REG_FIFO, false, received, rx.rxBytes },
+  };
+  radio.spiBatch(fifo, 2);
+  uint32_t batchMessages = spidev.messages() - before;
+  check(batchMessages == 2, "two batches are two messages");
+  check(rx.irqFlags == 0x40 && rx.rxBytes == 100 && pkt.hopChannel == 0x40
+        && pkt.snr == 0xf8 && pkt.pktRssi == 50, "batch register values");
+  check(spidev.regs[0x12] == 0xff && status[2].reg == 0x92, "batch write");
+  check(memcmp(received, spidev.fifo + 0x20, 100) == 0, "batch FIFO read");
+
+#if RH_SPI_SHADOW_REGISTERS
+  // Shadow registers: read-modify-write of 2 configuration registers, as
+  // RH_RF95::setSignalBandwidth() and setCodingRate4() do
+  radio.spiSetShadowCacheable(0x1d, 2);
+  radio.spiSetShadowEnabled(true);
+  before = spidev.messages();
+  for (i = 0; i < 10; i++)
+  {
+    radio.spiWrite(0x1d, (radio.spiRead(0x1d) & 0x0f) | 0x70);
+    radio.spiWrite(0x1e, (radio.spiRead(0x1e) & 0x0f) | (i << 4));
+  }
+  uint32_t shadowMessages = spidev.messages() - before;
+  // Only the first read of each register goes to the device
+  check(shadowMessages == 22 && radio.spiTransactionsSaved() == 18, "shadow reads saved");
+  check(spidev.regs[0x1e] == 0x94 && radio.spiRead(0x1e) == 0x94, "shadow write through");
+  // Verify mode reads the device, and notices a register that changed behind our back
+  radio.spiSetShadowVerify(true);
+  check(radio.spiRead(0x1d) == spidev.regs[0x1d] && radio.spiShadowMismatches() == 0, "shadow verify");
+  spidev.regs[0x1d] ^= 0x01;
+  radio.spiRead(0x1d);
+  check(radio.spiShadowMismatches() == 1, "shadow mismatch detected");
+  // The FIFO is volatile: a burst write to it leaves the shadows alone
+  radio.spiBurstWrite(REG_FIFO, data, 0x20);
+  check(radio.spiRead(0x1e) == 0x94, "FIFO burst leaves shadows alone");
+  radio.spiSetShadowVerify(false);
+  radio.spiSetShadowEnabled(false);
+
+  // Ten rounds of the RH_RF95 modem setters, without and with shadow registers
+  radio.spiSetShadowCacheable(0x26);
+  uint8_t modemConfig[] = { spidev.regs[0x1d], spidev.regs[0x1e], spidev.regs[0x26] };
+  before = spidev.messages();
+  for (i = 0; i < 10; i++)
+    rf95Setters(i);
+  uint32_t settersMessages = spidev.messages() - before;
+  uint8_t config1 = spidev.regs[0x1d], config2 = spidev.regs[0x1e], config3 = spidev.regs[0x26];
+  spidev.regs[0x1d] = modemConfig[0];
+  spidev.regs[0x1e] = modemConfig[1];
+  spidev.regs[0x26] = modemConfig[2];
+  radio.spiSetShadowEnabled(true);
+  before = spidev.messages();
+  for (i = 0; i < 10; i++)
+    rf95Setters(i);
+  uint32_t settersShadowMessages = spidev.messages() - before;
+  radio.spiSetShadowEnabled(false);
+  check(settersMessages == 200, "RH_RF95 setters without shadow registers");
+  // Each write, and the first read of each register
+  check(settersShadowMessages == 73, "RH_RF95 setters with shadow registers");
+  check(spidev.regs[0x1d] == config1 && spidev.regs[0x1e] == config2 && spidev.regs[0x26] == config3,
+        "RH_RF95 setters leave the same configuration");
+#else
+  Serial.println("Build the library and this sketch with -DRH_SPI_SHADOW_REGISTERS=128 to test shadow registers");
+#endif
+
+  Serial.print("RH_RF95 receive interrupt: ");
+  Serial.print(batchMessages, DEC);
+  Serial.print(" ioctls with spiBatch(), ");
+  Serial.print(singleMessages, DEC);
+  Serial.println(" with single register accesses");
+  Serial.print("255 octet FIFO read: ");
+  Serial.print(burstMessages, DEC);
+  Serial.print(" ioctl, was ");
+  Serial.print(octetMessages, DEC);
+  Serial.println(" with one transfer() per octet");
+#if RH_SPI_SHADOW_REGISTERS
+  Serial.print("10 read-modify-writes of 2 registers: ");
+  Serial.print(shadowMessages, DEC);
+  Serial.println(" ioctls with shadow registers, 40 without");
+  Serial.print("10 rounds of the RH_RF95 modem setters: ");
+  Serial.print(settersShadowMessages, DEC);
+  Serial.print(" ioctls with shadow registers, ");
+  Serial.print(settersMessages, DEC);
+  Serial.println(" without");
+#endif
+  checkExit();
+}
+
+void loop()
+{
+}
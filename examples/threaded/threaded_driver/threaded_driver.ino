@@ -0,0 +1,290 @@
+// threaded_driver.pde
+// -*- mode: C++ -*-
+// Example sketch that tests RHThreadedDriver on Linux with a simulated radio.
+// The simulated radio has a receive FIFO and a transmitter, which are driven by an "air" thread
+// that plays the part of the radio hardware: it delivers a stream of numbered messages to the
+// FIFO, raising an interrupt for each one (RHThreadedDriver::interrupt()), and checks the messages
+// the radio transmits, raising an interrupt when each has been sent.
+// The application thread receives and sends messages through RHThreadedDriver while keeping
+// itself busy. Checks that every message arrives intact and in order in both directions, with its
+// headers (whether set with the header setters or passed with each message), and that the radio driver
+// is only ever called by the service thread.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/threaded/threaded_driver/threaded_driver.ino tools/simMain.cpp RHThreadedDriver.cpp RHGenericDriver.cpp -o threaded_driver -lpthread
+// Run with ./threaded_driver
+
+#include <RHThreadedDriver.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <RHutil/RHSelfTest.h>
+
+// Messages in each direction
+#define NUM_MESSAGES 2000
+
+// Time between received messages, in microseconds
+#define RX_INTERVAL 200
+
+// Time to transmit a message, in microseconds
+#define TX_TIME 50
+
+#define MY_ADDRESS   1
+#define PEER_ADDRESS 7
+
+// A radio whose hardware side is simulated by the air thread
+class SimulatedRadio : public RHGenericDriver
+{
+public:
+  SimulatedRadio() : rxDone(false), txPending(false), txDone(false), wrongThread(0)
+  {
+    pthread_mutex_init(&hardware, NULL);
+  }
+
+  bool init()
+  {
+    ownerKnown = false;
+    _mode = RHModeIdle;
+    return true;
+  }
+  uint8_t maxMessageLength() { return 60; }
+
+  // The radio interrupted: collect the received message, or finish transmitting
+  void serviceInterrupt()
+  {
+    checkThread();
+    pthread_mutex_lock(&hardware);
+    if (rxDone)
+    {
+      rxDone = false;
+      _rxHeaderTo = fifo[0];
+      _rxHeaderFrom = fifo[1];
+      _rxHeaderId = fifo[2];
+      _rxHeaderFlags = fifo[3];
+      _lastRssi = -40 - fifo[2] % 50;
+      bufLen = fifoLen - 4;
+      memcpy(buf, fifo + 4, bufLen);
+      bufValid = _promiscuous || _rxHeaderTo == _thisAddress || _rxHeaderTo == RH_BROADCAST_ADDRESS;
+    }
+    if (txDone)
+    {
+      txDone = false;
+      _mode = RHModeIdle;
+      _txGood++;
+    }
+    pthread_mutex_unlock(&hardware);
+  }
+
+  bool available()
+  {
+    checkThread();
+    if (_mode == RHModeTx)
+      return false;
+    _mode = RHModeRx;
+    return bufValid;
+  }
+
+  bool recv(uint8_t* data, uint8_t* len)
+  {
+    checkThread();
+    if (!bufValid)
+      return false;
+    if (data && len)
+    {
+      if (*len > bufLen)
+	*len = bufLen;
+      memcpy(data, buf, *len);
+    }
+    bufValid = false;
+    return true;
+  }
+
+  bool send(const uint8_t* data, uint8_t len)
+  {
+    checkThread();
+    pthread_mutex_lock(&hardware);
+    txFrame[0] = _txHeaderTo;
+    txFrame[1] = _txHeaderFrom;
+    txFrame[2] = _txHeaderId;
+    txFrame[3] = _txHeaderFlags;
+    memcpy(txFrame + 4, data, len);
+    txLen = len + 4;
+    txPending = true;
+    _mode = RHModeTx;
+    pthread_mutex_unlock(&hardware);
+    return true;
+  }
+
+  // Counts calls from any thread but the first one to call after init()
+  void checkThread()
+  {
+    if (!ownerKnown)
+    {
+      owner = pthread_self();
+      ownerKnown = true;
+    }
+    else if (!pthread_equal(owner, pthread_self()))
+      wrongThread++;
+  }
+
+  // The hardware, shared with the air thread
+  pthread_mutex_t hardware;
+  uint8_t fifo[64];
+  uint8_t fifoLen;
+  bool    rxDone;
+  uint8_t txFrame[64];
+  uint8_t txLen;
+  bool    txPending;
+  bool    txDone;
+
+  // Driver state
+  uint8_t buf[60];
+  uint8_t bufLen;
+  bool    bufValid;
+  pthread_t owner;
+  bool    ownerKnown;
+  unsigned long wrongThread;
+};
+
+SimulatedRadio radio;
+RHThreadedDriver driver(radio);
+
+// Results from the air thread
+volatile unsigned long txReceived = 0, txErrors = 0;
+
+// The radio hardware and the other end of the link
+void* air(void*)
+{
+  unsigned long rxSent = 0;
+  unsigned long nextRx = micros();
+  while (rxSent < NUM_MESSAGES || txReceived < NUM_MESSAGES)
+  {
+    bool interrupt = false;
+    pthread_mutex_lock(&radio.hardware);
+    // A message arrives, if the last one has been collected
+    if (rxSent < NUM_MESSAGES && !radio.rxDone && (long)(micros() - nextRx) >= 0)
+    {
+      uint32_t now = micros();
+      radio.fifo[0] = (rxSent % 5) ? MY_ADDRESS : RH_BROADCAST_ADDRESS;
+      radio.fifo[1] = PEER_ADDRESS;
+      radio.fifo[2] = rxSent;
+      radio.fifo[3] = rxSent >> 8;
+      memcpy(radio.fifo + 4, &rxSent, sizeof(uint32_t));
+      memcpy(radio.fifo + 8, &now, sizeof(now));
+      radio.fifoLen = 12 + rxSent % 20;
+      radio.rxDone = true;
+      interrupt = true;
+      rxSent++;
+      nextRx += RX_INTERVAL;
+    }
+    // A message has been transmitted
+    if (radio.txPending)
+    {
+      radio.txPending = false;
+      uint32_t seq;
+      memcpy(&seq, radio.txFrame + 4, sizeof(seq));
+      if (   seq != txReceived || radio.txLen != 4 + 8 + seq % 30
+	  || radio.txFrame[0] != PEER_ADDRESS || radio.txFrame[1] != MY_ADDRESS
+	  || radio.txFrame[2] != (uint8_t)seq || radio.txFrame[3] != (seq & 0x0f))
+	txErrors++;
+      txReceived++;
+      radio.txDone = true;
+      interrupt = true;
+    }
+    pthread_mutex_unlock(&radio.hardware);
+    if (interrupt)
+      driver.interrupt();
+    usleep(TX_TIME);
+  }
+  return NULL;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  driver.setThisAddress(MY_ADDRESS);
+  driver.setHeaderFrom(MY_ADDRESS);
+  driver.setHeaderTo(PEER_ADDRESS);
+  check(driver.init(), "init");
+
+  pthread_t airThread;
+  pthread_create(&airThread, NULL, air, NULL);
+
+  unsigned long received = 0, rxErrors = 0, sent = 0, busy = 0;
+  unsigned long maxLatency = 0, totalLatency = 0;
+  uint8_t data[60];
+  while (received < NUM_MESSAGES || sent < NUM_MESSAGES)
+  {
+    // Collect received messages
+    uint8_t buf[60];
+    uint8_t len = sizeof(buf);
+    RHGenericDriver::RxMessageInfo info;
+    if (driver.recvWithInfo(buf, &len, &info))
+    {
+      uint32_t seq, stamp;
+      memcpy(&seq, buf, sizeof(seq));
+      memcpy(&stamp, buf + 4, sizeof(stamp));
+      unsigned long latency = micros() - stamp;
+      if (latency > maxLatency)
+	maxLatency = latency;
+      totalLatency += latency;
+      if (   seq != received || len != 8 + seq % 20
+	  || driver.headerFrom() != PEER_ADDRESS
+	  || driver.headerTo() != ((seq % 5) ? MY_ADDRESS : RH_BROADCAST_ADDRESS)
+	  || driver.headerId() != (uint8_t)seq || driver.headerFlags() != (uint8_t)(seq >> 8)
+	  || driver.lastRssi() != -40 - (int)(seq % 256) % 50
+	  || info.header.from != driver.headerFrom() || info.header.to != driver.headerTo()
+	  || info.header.id != driver.headerId() || info.header.flags != driver.headerFlags()
+	  || info.rssi != driver.lastRssi() || info.timestamp != driver.lastRxTime())
+	rxErrors++;
+      received++;
+    }
+    // Queue messages to send, with changing headers, alternately set with the setters
+    // and passed with the message
+    if (sent < NUM_MESSAGES)
+    {
+      uint32_t seq = sent;
+      memcpy(data, &seq, sizeof(seq));
+      bool ok;
+      if (seq & 1)
+      {
+	RHGenericDriver::MessageHeader header = { PEER_ADDRESS, MY_ADDRESS, (uint8_t)seq, (uint8_t)(seq & 0x0f) };
+	ok = driver.sendWithHeader(data, 8 + seq % 30, header);
+      }
+      else
+      {
+	driver.setHeaderId(seq);
+	driver.setHeaderFlags(seq & 0x0f, 0xff);
+	ok = driver.send(data, 8 + seq % 30);
+      }
+      if (ok)
+	sent++;
+    }
+    // The application has other work to do too
+    for (volatile int i = 0; i < 2000; i++)
+      busy++;
+  }
+  driver.waitPacketSent();
+  pthread_join(airThread, NULL);
+  driver.stop();
+
+  Serial.print("        received ");
+  Serial.print(received, DEC);
+  Serial.print(", average latency ");
+  Serial.print(totalLatency / received, DEC);
+  Serial.print(" us, worst ");
+  Serial.print(maxLatency, DEC);
+  Serial.print(" us; ");
+  Serial.print(driver.interrupts(), DEC);
+  Serial.println(" interrupts");
+  check(rxErrors == 0, "received messages intact and in order, with headers and RSSI");
+  check(driver.rxDropped() == 0, "no received messages dropped");
+  check(txReceived == NUM_MESSAGES && txErrors == 0, "sent messages intact and in order, with headers");
+  check(radio.txGood() == NUM_MESSAGES, "driver sent them all");
+  check(radio.wrongThread == 0, "radio driver only called by the service thread");
+
+  checkExit();
+}
+
+void loop()
+{
+}
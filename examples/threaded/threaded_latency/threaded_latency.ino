@@ -0,0 +1,136 @@
+// threaded_latency.pde
+// -*- mode: C++ -*-
+// Example sketch that measures the latency from a radio interrupt to the FIFO read by the
+// service thread of RHThreadedDriver on Linux, under synthetic load: several threads spin on every CPU
+// while a simulated radio interrupts every millisecond. Runs once with the normal time sharing
+// scheduler, and once with the real time options of RHutil/RHRealtime.h (SCHED_FIFO priority,
+// CPU pinning and mlockall), and prints the latency histograms of both.
+// The real time run needs root (or CAP_SYS_NICE and CAP_IPC_LOCK), and is skipped without.
+// Build on Linux with
+// cd whatever/RadioHead
+// g++ -O2 -I . -I RHutil -x c++ examples/threaded/threaded_latency/threaded_latency.ino tools/simMain.cpp RHThreadedDriver.cpp RHGenericDriver.cpp -o threaded_latency -lpthread
+// Run with sudo ./threaded_latency
+
+#include <RHThreadedDriver.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <RHutil/RHSelfTest.h>
+
+// Interrupts in each run
+#define NUM_INTERRUPTS 1000
+
+// Time between interrupts, in microseconds
+#define INTERRUPT_INTERVAL 1000
+
+// Load threads per CPU
+#define LOAD_PER_CPU 4
+
+// A radio that interrupts with a message in its FIFO, which is never addressed to us
+class SimulatedRadio : public RHGenericDriver
+{
+public:
+  SimulatedRadio() : fifoReads(0) {}
+  bool init() { _mode = RHModeIdle; return true; }
+  uint8_t maxMessageLength() { return 60; }
+  void serviceInterrupt()
+  {
+    memcpy(buf, fifo, sizeof(buf));
+    fifoReads++;
+  }
+  bool available() { _mode = RHModeRx; return false; }
+  bool recv(uint8_t* data, uint8_t* len) { (void)data; (void)len; return false; }
+  bool send(const uint8_t* data, uint8_t len) { (void)data; (void)len; return false; }
+
+  uint8_t fifo[64];
+  uint8_t buf[64];
+  volatile unsigned long fifoReads;
+};
+
+SimulatedRadio radio;
+RHThreadedDriver driver(radio);
+
+volatile bool loadRunning;
+
+// Spins, to keep the CPUs busy
+void* load(void*)
+{
+  volatile unsigned long spins = 0;
+  while (loadRunning)
+    spins++;
+  return NULL;
+}
+
+// The radio: interrupts at a steady rate
+void* interrupts(void*)
+{
+  // At a higher priority than the service thread, where allowed, so the interrupts come on time
+  RHRealtime::setPriority(60);
+  unsigned long next = micros();
+  for (int i = 0; i < NUM_INTERRUPTS; i++)
+  {
+    next += INTERRUPT_INTERVAL;
+    while ((long)(next - micros()) > 0)
+      delayMicroseconds(next - micros());
+    driver.interrupt();
+  }
+  return NULL;
+}
+
+// Measures the latency under load
+void run(const char* title)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int numLoad = cpus * LOAD_PER_CPU;
+  if (numLoad > 64)
+    numLoad = 64;
+  pthread_t loadThreads[64];
+  loadRunning = true;
+  for (int i = 0; i < numLoad; i++)
+    pthread_create(&loadThreads[i], NULL, load, NULL);
+
+  driver.interruptLatency().reset();
+  unsigned long reads = radio.fifoReads;
+  pthread_t interruptThread;
+  pthread_create(&interruptThread, NULL, interrupts, NULL);
+  pthread_join(interruptThread, NULL);
+  delay(100); // Let the last interrupts be serviced
+
+  loadRunning = false;
+  for (int i = 0; i < numLoad; i++)
+    pthread_join(loadThreads[i], NULL);
+
+  Serial.print("        ");
+  Serial.print(numLoad, DEC);
+  Serial.print(" load threads on ");
+  Serial.print(cpus, DEC);
+  Serial.println(" CPUs");
+  driver.interruptLatency().print(title);
+  unsigned long serviced = radio.fifoReads - reads;
+  check(serviced > 0 && serviced <= NUM_INTERRUPTS, "interrupts serviced");
+  check(driver.interruptLatency().count() == serviced, "one latency recorded per FIFO read");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  check(driver.init(), "init");
+
+  driver.setRealtime(0);
+  run("Time sharing");
+  uint64_t normal99 = driver.interruptLatency().percentile(99);
+
+  if (driver.setRealtime(50, 0, true))
+  {
+    run("SCHED_FIFO, CPU 0, mlockall");
+    check(driver.interruptLatency().percentile(99) <= normal99, "real time 99th percentile no worse");
+  }
+  else
+    Serial.println("        real time options refused (not root?): skipped");
+  driver.stop();
+
+  checkExit();
+}
+
+void loop()
+{
+}
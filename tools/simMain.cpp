@@ -8,7 +8,7 @@
 
 #include <stdio.h>
 #include <RHutil/simulator.h>
-#include <sys/time.h>
+#include <RHutil/RHClock.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -18,28 +18,17 @@ SerialSimulator Serial;
 extern void setup();
 extern void loop();
 
-// Millis at the start of the process
-unsigned long start_millis;
-
 int    _simulator_argc;
 char** _simulator_argv;
 
-// Returns milliseconds since beginning of day
-unsigned long time_in_millis()
-{    
-    struct timeval te; 
-    gettimeofday(&te, NULL); // get current time
-    unsigned long milliseconds = te.tv_sec*1000LL + te.tv_usec/1000; // caclulate milliseconds
-    return milliseconds;
-}
-
 // Run the Arduino standard functions in the main loop
 int main(int argc, char** argv)
 {
     // Let simulated program have access to argc and argv
     _simulator_argc = argc;
     _simulator_argv = argv;
-    start_millis = time_in_millis();
+    // Start the monotonic clock
+    RHClock::clock();
     // Seed the random number generator
     srand(getpid() ^ (unsigned) time(NULL)/2);
     setup();
@@ -47,16 +36,7 @@ int main(int argc, char** argv)
 	loop();
 }
 
-void delay(unsigned long ms)
-{
-    usleep(ms * 1000);
-}
-
-// Arduino equivalent, milliseconds since process start
-unsigned long millis()
-{
-    return time_in_millis() - start_millis;
-}
+// millis(), micros(), delay(), delayMicroseconds() and delayUntil() are in RHClock.h
 
 long random(long from, long to)
 {